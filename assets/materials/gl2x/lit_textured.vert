@@ -0,0 +1,55 @@
+#version 120
+attribute vec3 s_position;
+attribute vec3 s_normal;
+attribute vec2 s_texcoord0;
+
+/* Streamed per instance for instanced draws, otherwise the renderer sets it
+ * as a constant for each draw */
+attribute mat4 s_instance_model;
+
+/* Keyframed meshes blend towards the next frame by the weight, which the
+ * renderer leaves at zero for anything that isn't morphing */
+attribute vec3 s_morph_position;
+attribute vec3 s_morph_normal;
+uniform float s_morph_weight;
+
+/* Skinned meshes give up to four joints per vertex, indexing the rig's pose.
+ * Rigs with more joints than the palette holds are skinned on the CPU. The
+ * weights are all zero for anything that isn't skinned, and whatever weight
+ * is missing goes to the identity so those vertices stay where they are */
+attribute vec4 s_joint_indices;
+attribute vec4 s_joint_weights;
+uniform mat4 s_joint_palette[24];
+
+uniform mat4 s_view;
+uniform mat4 s_projection;
+uniform vec4 s_light_position;
+
+varying vec4 vertex_position_eye;
+varying vec3 vertex_normal_eye;
+varying vec4 light_position_eye;
+varying vec2 frag_texcoord0;
+
+void main() {
+    vec3 position = mix(s_position, s_morph_position, s_morph_weight);
+    vec3 normal = mix(s_normal, s_morph_normal, s_morph_weight);
+
+    mat4 skin = s_joint_palette[int(s_joint_indices.x)] * s_joint_weights.x +
+        s_joint_palette[int(s_joint_indices.y)] * s_joint_weights.y +
+        s_joint_palette[int(s_joint_indices.z)] * s_joint_weights.z +
+        s_joint_palette[int(s_joint_indices.w)] * s_joint_weights.w +
+        mat4(1.0) * (1.0 - dot(s_joint_weights, vec4(1.0)));
+
+    position = (skin * vec4(position, 1.0)).xyz;
+    normal = mat3(skin) * normal;
+
+    mat4 modelview = s_view * s_instance_model;
+
+    /* There's no per-instance inverse transpose, so this assumes uniform scaling */
+    vertex_normal_eye = normalize(mat3(modelview) * normal);
+    vertex_position_eye = modelview * vec4(position, 1.0);
+    light_position_eye = s_view * s_light_position;
+    frag_texcoord0 = s_texcoord0;
+
+    gl_Position = s_projection * vertex_position_eye;
+}
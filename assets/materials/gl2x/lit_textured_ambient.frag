@@ -0,0 +1,12 @@
+#version 120
+uniform vec4 s_global_ambient;
+uniform vec4 s_material_ambient;
+uniform vec4 s_material_emission;
+uniform sampler2D s_diffuse_map;
+
+varying vec2 frag_texcoord0;
+
+void main() {
+    vec4 texel = texture2D(s_diffuse_map, frag_texcoord0.st);
+    gl_FragColor = (s_global_ambient * s_material_ambient + s_material_emission) * texel;
+}
@@ -0,0 +1,48 @@
+#version 120
+uniform vec4 s_light_diffuse;
+uniform vec4 s_light_specular;
+uniform float s_light_constant_attenuation;
+uniform float s_light_linear_attenuation;
+uniform float s_light_quadratic_attenuation;
+
+uniform vec4 s_material_diffuse;
+uniform vec4 s_material_specular;
+uniform float s_material_shininess;
+uniform sampler2D s_diffuse_map;
+
+varying vec4 vertex_position_eye;
+varying vec3 vertex_normal_eye;
+varying vec4 light_position_eye;
+varying vec2 frag_texcoord0;
+
+void main() {
+    vec3 light_dir = light_position_eye.xyz - (vertex_position_eye.xyz * light_position_eye.w);
+    vec3 n_eye = normalize(vertex_normal_eye);
+    vec3 s_eye = normalize(light_dir);
+    vec3 v_eye = normalize(-vertex_position_eye.xyz);
+    vec3 h_eye = normalize(v_eye + s_eye);
+
+    vec4 colour = vec4(0.0);
+    float intensity = max(dot(s_eye, n_eye), 0.0);
+
+    if(intensity > 0.0) {
+        float attenuation = 1.0;
+
+        if(light_position_eye.w > 0.0) {
+            float d = length(light_dir);
+            attenuation = 1.0 / (
+                s_light_constant_attenuation +
+                s_light_linear_attenuation * d +
+                s_light_quadratic_attenuation * d * d
+            );
+        }
+
+        vec4 texel = texture2D(s_diffuse_map, frag_texcoord0.st);
+        colour += attenuation * (s_light_diffuse * s_material_diffuse * texel * intensity);
+
+        float spec = max(dot(h_eye, n_eye), 0.0);
+        colour += attenuation * (s_light_specular * s_material_specular) * pow(spec, s_material_shininess);
+    }
+
+    gl_FragColor = colour;
+}
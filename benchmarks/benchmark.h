@@ -0,0 +1,54 @@
+#pragma once
+
+/* Minimal timing helpers shared by the benchmark executables. Each
+ * benchmark is a standalone program that prints one line per case so
+ * results can be diffed between runs. */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "simulant/time_keeper.h"
+#include "simulant/utils/formatter.h"
+
+namespace smlt {
+namespace benchmark {
+
+class Timer {
+public:
+    Timer():
+        start_(TimeKeeper::now_in_us()) {}
+
+    uint64_t elapsed_us() const {
+        return TimeKeeper::now_in_us() - start_;
+    }
+
+    void restart() {
+        start_ = TimeKeeper::now_in_us();
+    }
+
+private:
+    uint64_t start_;
+};
+
+/* Prints the total time for a case and the average cost per operation */
+inline void report(const std::string& name, uint64_t operations, uint64_t elapsed_us) {
+    double ns_per_op = (operations) ? (double(elapsed_us) * 1000.0) / double(operations) : 0.0;
+
+    std::printf(
+        "%-48s %12llu ops %10.3f ms %12.1f ns/op\n",
+        name.c_str(),
+        (unsigned long long) operations,
+        double(elapsed_us) / 1000.0,
+        ns_per_op
+    );
+}
+
+/* Prevents the optimiser from discarding a computed value */
+template<typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}
+}
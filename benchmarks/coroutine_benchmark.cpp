@@ -0,0 +1,72 @@
+/* Measures the cost of a resume/yield round-trip with 1, 100 and 10k
+ * live coroutines, mirroring what Window::update_coroutines does each
+ * frame. */
+
+#include <vector>
+
+#include "simulant/coroutines/coroutine.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+static void run_case(std::size_t coroutine_count, std::size_t frames) {
+    std::vector<cort::CoroutineID> routines;
+    routines.reserve(coroutine_count);
+
+    uint64_t counter = 0;
+
+    for(std::size_t i = 0; i < coroutine_count; ++i) {
+        routines.push_back(cort::start_coroutine([&counter]() {
+            while(true) {
+                ++counter;
+                cort::yield_coroutine();
+            }
+        }));
+    }
+
+    /* The first resume starts each coroutine, don't count it */
+    for(auto id: routines) {
+        cort::resume_coroutine(id);
+    }
+
+    benchmark::Timer timer;
+    for(std::size_t f = 0; f < frames; ++f) {
+        for(auto id: routines) {
+            cort::resume_coroutine(id);
+        }
+    }
+
+    auto elapsed = timer.elapsed_us();
+    benchmark::do_not_optimize(counter);
+
+    benchmark::report(
+        _F("resume/yield ({0} coroutines)").format(coroutine_count),
+        coroutine_count * frames,
+        elapsed
+    );
+
+    timer.restart();
+    for(auto id: routines) {
+        cort::stop_coroutine(id);
+    }
+
+    benchmark::report(
+        _F("stop ({0} coroutines)").format(coroutine_count),
+        coroutine_count,
+        timer.elapsed_us()
+    );
+}
+
+int main() {
+#ifdef SIMULANT_COROUTINE_UCONTEXT
+    std::printf("Coroutine backend: ucontext\n");
+#else
+    std::printf("Coroutine backend: threads\n");
+#endif
+
+    run_case(1, 100000);
+    run_case(100, 1000);
+    run_case(10000, 10);
+
+    return 0;
+}
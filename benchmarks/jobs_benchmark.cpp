@@ -0,0 +1,77 @@
+/* Measures how the job scheduler scales from 0 workers up to one per core.
+ * Each worker count runs a streaming parallel_for, a parallel_reduce, and a
+ * batch of tiny jobs which mostly measures scheduling overhead. */
+
+#include <cmath>
+#include <vector>
+
+#include "simulant/jobs/parallel.h"
+#include "benchmark.h"
+
+using namespace smlt;
+using namespace smlt::jobs;
+
+static void run_case(std::size_t worker_count) {
+    const std::size_t repeats = 10;
+    const std::size_t element_count = 1 << 22;
+    const std::size_t tiny_job_count = 100000;
+
+    JobScheduler scheduler(worker_count);
+
+    auto name = [&](const std::string& what) -> std::string {
+        return _F("{0} ({1} workers)").format(what, worker_count);
+    };
+
+    std::vector<float> values(element_count, 1.0f);
+
+    benchmark::Timer timer;
+    for(std::size_t r = 0; r < repeats; ++r) {
+        parallel_for_range(scheduler, 0, values.size(), 4096, [&](std::size_t begin, std::size_t end) {
+            for(auto i = begin; i < end; ++i) {
+                values[i] = std::sqrt(values[i] * 1.5f + 2.0f);
+            }
+        });
+    }
+    benchmark::report(name("parallel_for"), repeats * element_count, timer.elapsed_us());
+
+    float total = 0.0f;
+    timer.restart();
+    for(std::size_t r = 0; r < repeats; ++r) {
+        total += parallel_reduce(
+            scheduler, 0, values.size(), 4096, 0.0f,
+            [&](std::size_t begin, std::size_t end) {
+                float sum = 0.0f;
+                for(auto i = begin; i < end; ++i) {
+                    sum += values[i];
+                }
+                return sum;
+            },
+            [](float a, float b) { return a + b; }
+        );
+    }
+    benchmark::report(name("parallel_reduce"), repeats * element_count, timer.elapsed_us());
+
+    std::vector<uint32_t> slots(tiny_job_count, 0);
+
+    timer.restart();
+    Counter counter;
+    for(std::size_t i = 0; i < tiny_job_count; ++i) {
+        auto slot = &slots[i];
+        scheduler.run([slot]() { *slot += 1; }, &counter);
+    }
+    scheduler.wait(counter);
+    benchmark::report(name("tiny jobs"), tiny_job_count, timer.elapsed_us());
+
+    benchmark::do_not_optimize(total);
+    benchmark::do_not_optimize(slots[0]);
+}
+
+int main() {
+    auto max_workers = std::max<std::size_t>(thread::cpu_count() - 1, 1);
+
+    for(std::size_t workers = 0; workers <= max_workers; ++workers) {
+        run_case(workers);
+    }
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+/* Measures the structure-of-arrays particle kernels with 10k, 100k and 1M
+ * particles. Each frame integrates, removes expired particles, tops the
+ * system back up, and streams the billboards into an interleaved buffer
+ * laid out the same way as the particle system's vertex data. */
+
+#include <random>
+#include <vector>
+
+#include "simulant/nodes/particles/particle.h"
+#include "benchmark.h"
+
+using namespace smlt;
+using namespace smlt::particles;
+
+static void run_case(std::size_t particle_count) {
+    const std::size_t frames = 50;
+    const float dt = 1.0f / 60.0f;
+
+    /* Position (3F), texcoord (2F), diffuse (4F) */
+    const uint32_t stride = sizeof(float) * 9;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> life(0.1f, 2.0f);
+
+    ParticleArrays particles;
+    particles.set_capacity(particle_count);
+
+    auto emit = [&]() {
+        while(!particles.full()) {
+            particles.push(
+                Vec3(unit(rng), unit(rng), unit(rng)),
+                Vec3(unit(rng), unit(rng) + 2.0f, unit(rng)),
+                Vec2(1.0f, 1.0f), life(rng), Colour::WHITE
+            );
+        }
+    };
+
+    emit();
+
+    std::vector<uint8_t> vertices(particle_count * 4 * stride);
+
+    auto name = [&](const std::string& what) -> std::string {
+        return _F("{0} ({1} particles)").format(what, particle_count);
+    };
+
+    uint64_t simulate_us = 0, write_us = 0;
+    std::size_t killed = 0;
+
+    for(std::size_t f = 0; f < frames; ++f) {
+        benchmark::Timer timer;
+        integrate(particles, dt);
+        killed += kill_expired(particles);
+        simulate_us += timer.elapsed_us();
+
+        emit();
+
+        timer.restart();
+        write_billboards(
+            particles, Vec3::POSITIVE_Y, Vec3::POSITIVE_X,
+            &vertices[0], stride, 0, sizeof(float) * 5
+        );
+        write_us += timer.elapsed_us();
+    }
+
+    benchmark::report(name("integrate + kill"), frames * particle_count, simulate_us);
+    benchmark::report(name("write billboards"), frames * particle_count, write_us);
+
+    benchmark::do_not_optimize(killed);
+    benchmark::do_not_optimize(vertices[0]);
+}
+
+int main() {
+    run_case(10000);
+    run_case(100000);
+    run_case(1000000);
+
+    return 0;
+}
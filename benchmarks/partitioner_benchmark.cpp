@@ -0,0 +1,120 @@
+/* Compares the frustum, spatial hash and BVH partitioners with 1k, 10k and
+ * 100k actors scattered across a large flat world. For each case it measures
+ * the initial insertion, a visibility query from a static camera, and a
+ * frame where 10% of the actors move before the query. */
+
+#include <random>
+#include <vector>
+
+#include "simulant/simulant.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+class BenchmarkApp: public Application {
+public:
+    BenchmarkApp(const AppConfig& config):
+        Application(config) {}
+
+private:
+    bool init() {
+        return true;
+    }
+};
+
+static const char* partitioner_name(AvailablePartitioner partitioner) {
+    switch(partitioner) {
+        case PARTITIONER_FRUSTUM: return "frustum";
+        case PARTITIONER_HASH: return "hash";
+        case PARTITIONER_BVH: return "bvh";
+        default: return "null";
+    }
+}
+
+static void run_case(Window* window, AvailablePartitioner partitioner, std::size_t actor_count) {
+    const std::size_t frames = 20;
+    const float world_size = 2000.0f;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> horizontal(-world_size * 0.5f, world_size * 0.5f);
+    std::uniform_real_distribution<float> vertical(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> nudge(-2.0f, 2.0f);
+
+    auto stage = window->new_stage(partitioner);
+    auto camera = stage->new_camera();
+    camera->set_perspective_projection(Degrees(45.0f), 4.0f / 3.0f, 1.0f, 500.0f);
+
+    auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+    mesh->new_submesh_as_cube("cube", stage->assets->new_material(), 1.0f);
+
+    std::vector<ActorPtr> actors;
+    actors.reserve(actor_count);
+
+    for(std::size_t i = 0; i < actor_count; ++i) {
+        auto actor = stage->new_actor_with_mesh(mesh);
+        actor->move_to(horizontal(rng), vertical(rng), horizontal(rng));
+        actors.push_back(actor);
+    }
+
+    auto name = [&](const std::string& what) -> std::string {
+        return _F("{0} {1} ({2} actors)").format(partitioner_name(partitioner), what, actor_count);
+    };
+
+    benchmark::Timer timer;
+    stage->transforms->resolve_all();
+    stage->partitioner->_apply_writes();
+    benchmark::report(name("insert"), actor_count, timer.elapsed_us());
+
+    std::vector<LightID> lights;
+    std::vector<StageNode*> nodes;
+
+    timer.restart();
+    for(std::size_t f = 0; f < frames; ++f) {
+        lights.clear();
+        nodes.clear();
+        stage->partitioner->lights_and_geometry_visible_from(camera->id(), lights, nodes);
+    }
+    benchmark::report(name("static query"), frames, timer.elapsed_us());
+
+    timer.restart();
+    for(std::size_t f = 0; f < frames; ++f) {
+        for(std::size_t i = f % 10; i < actors.size(); i += 10) {
+            actors[i]->move_by(nudge(rng), 0, nudge(rng));
+        }
+
+        stage->transforms->resolve_all();
+        stage->partitioner->_apply_writes();
+
+        lights.clear();
+        nodes.clear();
+        stage->partitioner->lights_and_geometry_visible_from(camera->id(), lights, nodes);
+    }
+    benchmark::report(name("moving frame"), frames, timer.elapsed_us());
+
+    benchmark::do_not_optimize(nodes.size());
+
+    window->destroy_stage(stage->id());
+    window->run_frame();
+}
+
+int main() {
+    AppConfig config;
+    config.width = 640;
+    config.height = 480;
+    config.fullscreen = false;
+
+    BenchmarkApp app(config);
+    auto window = app.window.get();
+
+    AvailablePartitioner partitioners[] = {
+        PARTITIONER_FRUSTUM, PARTITIONER_HASH, PARTITIONER_BVH
+    };
+
+    for(auto partitioner: partitioners) {
+        run_case(window, partitioner, 1000);
+        run_case(window, partitioner, 10000);
+        run_case(window, partitioner, 100000);
+    }
+
+    return 0;
+}
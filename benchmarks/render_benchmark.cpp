@@ -0,0 +1,104 @@
+/* Runs whole frames against the null renderer and headless window, so the
+ * CPU side of rendering (culling, render queue building, sorting and
+ * traversal) can be measured without a GPU. A static scene exercises the
+ * retained render queue, a moving one regenerates every node each frame. */
+
+#include "simulant/simulant.h"
+#include "simulant/renderers/null/null_renderer.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+class BenchmarkApp : public Application {
+public:
+    BenchmarkApp(const AppConfig& config):
+        Application(config) {}
+
+private:
+    bool init() override {
+        return true;
+    }
+};
+
+static void run_case(Window* window, const std::string& name, std::vector<ActorPtr>& actors, bool moving) {
+    const std::size_t frames = 200;
+
+    auto renderer = dynamic_cast<NullRenderer*>(window->renderer.get());
+
+    /* The first frame is ignored by the window's timers, and fills the queue */
+    window->run_frame();
+    renderer->reset_stats();
+
+    uint64_t cull = 0, gather = 0, traversal = 0;
+
+    benchmark::Timer timer;
+    for(std::size_t i = 0; i < frames; ++i) {
+        if(moving) {
+            for(auto& actor: actors) {
+                actor->move_by(0.0f, 0.0f, (i % 2) ? 0.01f : -0.01f);
+            }
+        }
+
+        window->run_frame();
+
+        cull += window->stats->cull_time_us();
+        gather += window->stats->gather_time_us();
+        traversal += window->stats->traversal_time_us();
+    }
+    auto elapsed = timer.elapsed_us();
+
+    benchmark::report(name + " frame", frames, elapsed);
+    benchmark::report(name + " cull", frames, cull);
+    benchmark::report(name + " gather", frames, gather);
+    benchmark::report(name + " traversal", frames, traversal);
+
+    auto& stats = renderer->stats();
+    std::printf(
+        "%-48s %u draws %u group changes %u pass changes per frame\n",
+        (name + " submitted").c_str(),
+        unsigned(stats.draws / frames),
+        unsigned(stats.render_group_changes / frames),
+        unsigned(stats.material_pass_changes / frames)
+    );
+}
+
+int main() {
+    const uint32_t grid = 40;
+    const uint32_t material_count = 8;
+
+    AppConfig config;
+    config.width = 640;
+    config.height = 480;
+    config.target_frame_rate = 0;
+    config.development.force_renderer = NULL_RENDERER_NAME;
+
+    BenchmarkApp app(config);
+    Window* window = app.window;
+
+    auto stage = window->new_stage(PARTITIONER_FRUSTUM);
+    auto camera = stage->new_camera();
+    camera->set_perspective_projection(Degrees(60.0), float(window->width()) / float(window->height()), 1.0, 1000.0);
+
+    window->compositor->render(stage, camera)->activate();
+
+    std::vector<MeshPtr> meshes;
+    for(uint32_t i = 0; i < material_count; ++i) {
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", stage->assets->new_material(), 1.0f);
+        meshes.push_back(mesh);
+    }
+
+    std::vector<ActorPtr> actors;
+    for(uint32_t x = 0; x < grid; ++x) {
+        for(uint32_t y = 0; y < grid; ++y) {
+            auto actor = stage->new_actor_with_mesh(meshes[(x * grid + y) % material_count]);
+            actor->move_to(float(x) - (grid / 2.0f), float(y) - (grid / 2.0f), -50.0f);
+            actors.push_back(actor);
+        }
+    }
+
+    run_case(window, "static", actors, false);
+    run_case(window, "moving", actors, true);
+
+    return 0;
+}
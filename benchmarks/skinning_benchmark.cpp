@@ -0,0 +1,71 @@
+/* Measures the linear blend skinning kernel with 10k, 100k and 1M
+ * vertices, each attached to two joints of a 64 joint palette. Only the
+ * kernel is timed, building the bind pose happens once per mesh. */
+
+#include <random>
+#include <vector>
+
+#include "simulant/vertex_data.h"
+#include "simulant/assets/meshes/skeleton.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+static void run_case(uint32_t vertex_count) {
+    const std::size_t frames = 50;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_int_distribution<int32_t> joint(0, MAX_JOINTS_PER_MESH - 1);
+
+    VertexData vertex_data(VertexSpecification::DEFAULT);
+    std::vector<SkeletonVertex> vertices(vertex_count);
+
+    for(uint32_t i = 0; i < vertex_count; ++i) {
+        vertex_data.position(Vec3(unit(rng), unit(rng), unit(rng)));
+        vertex_data.normal(Vec3(unit(rng), unit(rng), unit(rng)).normalized());
+        vertex_data.move_next();
+
+        vertices[i].joints[0] = joint(rng);
+        vertices[i].joints[1] = joint(rng);
+        vertices[i].weights[0] = 0.6f;
+        vertices[i].weights[1] = 0.4f;
+    }
+    vertex_data.done();
+
+    SkinningBindPose bind_pose;
+    bind_pose.build(&vertex_data, vertices);
+
+    SkinnedVertices skinned;
+    skinned.resize(bind_pose.block_count() * SKINNING_BLOCK_SIZE);
+
+    std::vector<SkinningMatrix> palette(MAX_JOINTS_PER_MESH);
+
+    uint64_t elapsed = 0;
+    for(std::size_t f = 0; f < frames; ++f) {
+        for(auto& matrix: palette) {
+            for(auto& m: matrix.m) {
+                m = unit(rng);
+            }
+        }
+
+        benchmark::Timer timer;
+        skin_vertices(bind_pose, palette.data(), 0, bind_pose.block_count(), skinned);
+        elapsed += timer.elapsed_us();
+    }
+
+    benchmark::report(
+        _F("skin vertices ({0} vertices)").format(vertex_count),
+        frames * vertex_count, elapsed
+    );
+
+    benchmark::do_not_optimize(skinned.px[0]);
+}
+
+int main() {
+    run_case(10000);
+    run_case(100000);
+    run_case(1000000);
+
+    return 0;
+}
@@ -19,6 +19,15 @@ public:
 
         camera_->set_perspective_projection(Degrees(45.0), float(window->width()) / float(window->height()), 10.0, 10000.0);
         ship_mesh_id_ = window->shared_assets->new_mesh_from_file("sample_data/fighter_good/space_frigate_6.obj");
+
+        /* Every ship shares the mesh, with this material they're drawn
+         * with a single instanced call per submesh */
+        for(auto submesh: window->shared_assets->mesh(ship_mesh_id_)->each_submesh()) {
+            auto material = window->shared_assets->new_material_from_file(Material::BuiltIns::LIT_TEXTURED);
+            material->set_diffuse_map(submesh->material()->diffuse_map());
+            submesh->set_material(material);
+        }
+
         generate_ships();
 
         stage_->set_ambient_light(smlt::Colour(0.2, 0.2, 0.2, 1.0));
@@ -21,7 +21,10 @@ public:
         window->vfs->add_search_path("sample_data/quake2/textures");
 
         auto mesh = stage_->assets->new_mesh_from_file("sample_data/quake2/maps/demo1.bsp");
-        stage_->new_geom_with_mesh(mesh->id());
+        // Only draw the parts of the map which are potentially visible
+        GeomCullerOptions culler_options;
+        culler_options.type = GEOM_CULLER_TYPE_BSP_PVS;
+        stage_->new_geom_with_mesh(mesh->id(), culler_options);
 
         cr_yield();
 
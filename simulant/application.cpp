@@ -43,6 +43,9 @@ namespace smlt { typedef SDL2Window SysWindow; }
 #endif
 
 #include "application.h"
+#include "headless_window.h"
+#include "renderers/renderer_config.h"
+#include "renderers/null/null_renderer.h"
 #include "scenes/loading.h"
 #include "input/input_state.h"
 #include "platform.h"
@@ -141,7 +144,12 @@ void Application::construct_window(const AppConfig& config) {
 
     S_DEBUG("Constructing the window");
 
-    window_ = SysWindow::create(this);
+    /* The null renderer has no context so doesn't need a real window */
+    if(chosen_renderer_name(config_copy.development.force_renderer) == NULL_RENDERER_NAME) {
+        window_ = HeadlessWindow::create(this);
+    } else {
+        window_ = SysWindow::create(this);
+    }
 
     /* Fallback. If fullscreen is disabled and there is no width
      * or height, then default to 640x480 */
@@ -73,6 +73,16 @@ struct AppConfig {
 
     struct General {
         uint32_t stage_node_pool_size = 64;
+
+        /* Number of job scheduler worker threads, in addition to the main
+         * thread. -1 uses one fewer than the number of CPU cores */
+        int32_t job_worker_count = -1;
+
+        /* Threads which read and decode files for the AssetManager's
+         * *_async methods, and the time spent each frame creating the
+         * assets they've finished with */
+        uint32_t async_loader_thread_count = 1;
+        uint32_t async_load_budget_us = 2000;
     } general;
 
     struct Desktop {
@@ -96,8 +106,9 @@ struct AppConfig {
         bool force_profiling = false;
 #endif
         /*
-         * Set to gl1x or gl2x to force that renderer if available
-            FIXME: Not yet working
+         * Set to gl1x or gl2x to force that renderer if available, or null
+         * to run without a GL context (in a headless window). The
+         * SIMULANT_RENDERER environment variable overrides this.
         */
         std::string force_renderer = "";
         std::string force_sound_driver = "";
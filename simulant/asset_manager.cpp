@@ -17,9 +17,13 @@
 //     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
+#include <stdexcept>
+
 #include "window.h"
 #include "asset_manager.h"
 #include "loader.h"
+#include "vfs.h"
 #include "procedural/mesh.h"
 #include "utils/gl_thread_check.h"
 #include "loaders/heightmap_loader.h"
@@ -48,6 +52,13 @@ AssetManager::AssetManager(Window* window, AssetManager* parent):
 }
 
 AssetManager::~AssetManager() {
+    /* Their finalise steps refer to this manager */
+    for(auto& load: async_loads_) {
+        if(auto request = load.lock()) {
+            request->cancel();
+        }
+    }
+
     if(parent_) {
         S_DEBUG("Unregistering resource manager: {0}", this);
         base_manager()->unregister_child(this);
@@ -290,8 +301,6 @@ MeshPtr AssetManager::new_mesh_from_file(const Path& path,
     const MeshLoadOptions& options,
     GarbageCollectMethod garbage_collect) {
 
-    //Load the material
-    auto mesh = new_mesh(desired_specification, GARBAGE_COLLECT_NEVER);
     auto loader = window->loader_for(path);
     assert(loader && "Unable to locate a loader for the specified mesh file");
 
@@ -300,11 +309,34 @@ MeshPtr AssetManager::new_mesh_from_file(const Path& path,
         return MeshPtr();
     }
 
+    return mesh_from_loader(path, loader, desired_specification, options, garbage_collect);
+}
+
+MeshPtr AssetManager::mesh_from_loader(const Path& path, Loader::ptr loader,
+    const VertexSpecification& desired_specification,
+    const MeshLoadOptions& options,
+    GarbageCollectMethod garbage_collect) {
+
+    auto mesh = new_mesh(desired_specification, GARBAGE_COLLECT_NEVER);
+
     LoaderOptions loader_options;
     loader_options[MESH_LOAD_OPTIONS_KEY] = options;
 
     loader->into(mesh, loader_options);
 
+    if(options.generate_lods) {
+        auto report = mesh->generate_lods(options.lod_options);
+
+        S_INFO(
+            "Generated LODs for {0}: {1} -> {2} triangles",
+            path.str(),
+            report.triangle_counts[DETAIL_LEVEL_NEAREST],
+            report.triangle_counts[DETAIL_LEVEL_FARTHEST]
+        );
+
+        mesh->data->stash(report, "lod_report");
+    }
+
     mesh_manager_.set_garbage_collection_method(mesh->id(), garbage_collect);
     return mesh;
 }
@@ -534,30 +566,32 @@ TexturePtr AssetManager::new_texture_from_file(const Path& path, GarbageCollectM
 TexturePtr AssetManager::new_texture_from_file(const Path& path, TextureFlags flags, GarbageCollectMethod garbage_collect) {
     //Load the texture
     S_DEBUG("Loading texture from file: {0}", path);
-    smlt::TexturePtr tex = new_texture(8, 8, TEXTURE_FORMAT_RGBA_4UB_8888, garbage_collect);
+    S_DEBUG("Finding loader for: {0}", path);
+    auto loader = window->loader_for(path, LOADER_HINT_TEXTURE);
+    if(!loader) {
+        S_WARN("Couldn't find loader for texture");
+        return smlt::TexturePtr();
+    }
 
-    {
-        S_DEBUG("Finding loader for: {0}", path);
-        auto loader = window->loader_for(path, LOADER_HINT_TEXTURE);
-        if(!loader) {
-            S_WARN("Couldn't find loader for texture");
-            return smlt::TexturePtr();
-        }
+    S_DEBUG("Loader found, loading...");
+    return texture_from_loader(loader, flags, garbage_collect);
+}
 
-        S_DEBUG("Loader found, loading...");
-        loader->into(tex);
+TexturePtr AssetManager::texture_from_loader(Loader::ptr loader, TextureFlags flags, GarbageCollectMethod garbage_collect) {
+    smlt::TexturePtr tex = new_texture(8, 8, TEXTURE_FORMAT_RGBA_4UB_8888, garbage_collect);
 
-        if(flags.flip_vertically) {
-            S_DEBUG("Flipping texture vertically");
-            tex->flip_vertically();
-        }
+    loader->into(tex);
 
-        tex->set_mipmap_generation(flags.mipmap);
-        tex->set_texture_wrap(flags.wrap, flags.wrap, flags.wrap);
-        tex->set_texture_filter(flags.filter);
-        tex->set_auto_upload(flags.auto_upload);
+    if(flags.flip_vertically) {
+        S_DEBUG("Flipping texture vertically");
+        tex->flip_vertically();
     }
 
+    tex->set_mipmap_generation(flags.mipmap);
+    tex->set_texture_wrap(flags.wrap, flags.wrap, flags.wrap);
+    tex->set_texture_filter(flags.filter);
+    tex->set_auto_upload(flags.auto_upload);
+
     S_DEBUG("Texture loaded");
     return tex;
 }
@@ -587,12 +621,14 @@ std::size_t AssetManager::texture_count() const {
 }
 
 SoundPtr AssetManager::new_sound_from_file(const Path& path, GarbageCollectMethod garbage_collect) {
+    return sound_from_loader(path, window->loader_for(path), garbage_collect);
+}
+
+SoundPtr AssetManager::sound_from_loader(const Path& path, Loader::ptr loader, GarbageCollectMethod garbage_collect) {
     //Load the sound
     auto snd = sound_manager_.make(this, window->_sound_driver());
     sound_manager_.set_garbage_collection_method(snd->id(), garbage_collect);
 
-    auto loader = window->loader_for(path);
-
     if(loader) {
         loader->into(snd);
     } else {
@@ -604,6 +640,87 @@ SoundPtr AssetManager::new_sound_from_file(const Path& path, GarbageCollectMetho
     return snd;
 }
 
+template<typename T>
+AssetFuture<T> AssetManager::load_async(const Path& path, LoaderHint hint, const LoaderOptions& options, int priority, std::function<std::shared_ptr<T> (Loader::ptr)> create) {
+    Window* win = get_window();
+
+    auto loader = std::make_shared<Loader::ptr>();
+    auto result = std::make_shared<std::shared_ptr<T>>();
+
+    /* The VFS search paths aren't guarded, so the file is located here on
+     * the calling thread. A missing file fails the load when it's prepared
+     * rather than throwing from here. */
+    Path resolved;
+    try {
+        resolved = win->vfs->locate_file(path);
+    } catch(AssetMissingError&) {}
+
+    /* Runs on a loader thread, finding the loader opens the file so it's
+     * done here too. The resolved path is absolute, so the VFS doesn't
+     * search again. */
+    auto prepare = [win, path, resolved, hint, options, loader]() {
+        if(resolved.str().empty()) {
+            throw AssetMissingError("Unable to find file: " + path.str());
+        }
+
+        *loader = win->loader_for(resolved, hint);
+        if(!*loader) {
+            throw std::runtime_error("Unable to find a loader for: " + path.str());
+        }
+
+        (*loader)->prepare(options);
+    };
+
+    auto finalise = [loader, result, create]() {
+        *result = create(*loader);
+    };
+
+    auto request = std::make_shared<AsyncLoadRequest>(priority, prepare, finalise);
+
+    async_loads_.erase(
+        std::remove_if(async_loads_.begin(), async_loads_.end(), [](const std::weak_ptr<AsyncLoadRequest>& load) {
+            auto request = load.lock();
+            return !request || request->is_finished();
+        }),
+        async_loads_.end()
+    );
+
+    async_loads_.push_back(request);
+
+    win->async_loader->submit(request);
+    return AssetFuture<T>(request, result);
+}
+
+AssetFuture<Texture> AssetManager::new_texture_from_file_async(const Path& path, TextureFlags flags, int priority, GarbageCollectMethod garbage_collect) {
+    return load_async<Texture>(path, LOADER_HINT_TEXTURE, LoaderOptions(), priority, [=](Loader::ptr loader) -> TexturePtr {
+        auto tex = texture_from_loader(loader, flags, garbage_collect);
+
+        /* Upload now so it counts towards the load budget, rather than
+         * the render which first uses it. This runs while the window has
+         * a context. */
+        if(tex->auto_upload()) {
+            tex->flush();
+        }
+
+        return tex;
+    });
+}
+
+AssetFuture<Mesh> AssetManager::new_mesh_from_file_async(const Path& path, const VertexSpecification& desired_specification, const MeshLoadOptions& options, int priority, GarbageCollectMethod garbage_collect) {
+    LoaderOptions loader_options;
+    loader_options[MESH_LOAD_OPTIONS_KEY] = options;
+
+    return load_async<Mesh>(path, LOADER_HINT_NONE, loader_options, priority, [=](Loader::ptr loader) -> MeshPtr {
+        return mesh_from_loader(path, loader, desired_specification, options, garbage_collect);
+    });
+}
+
+AssetFuture<Sound> AssetManager::new_sound_from_file_async(const Path& path, int priority, GarbageCollectMethod garbage_collect) {
+    return load_async<Sound>(path, LOADER_HINT_NONE, LoaderOptions(), priority, [=](Loader::ptr loader) -> SoundPtr {
+        return sound_from_loader(path, loader, garbage_collect);
+    });
+}
+
 SoundPtr AssetManager::find_sound(const std::string &name) {
     return sound_manager_.find_object(name);
 }
@@ -32,6 +32,7 @@
 #include "font.h"
 #include "assets/particle_script.h"
 #include "path.h"
+#include "async_loader.h"
 
 namespace smlt {
 
@@ -189,6 +190,17 @@ public:
     MeshPtr new_mesh_as_cube_with_submesh_per_face(float width, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
     MaterialPtr new_material_from_texture(TextureID texture, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
 
+    /*
+     * Background versions of new_X_from_file. The file is read (and for
+     * images, .obj meshes and .wav sounds, parsed) on the window's async
+     * loader threads, then the asset is created on the main thread during
+     * a later frame. Loads still outstanding when the manager is destroyed
+     * are cancelled.
+     */
+    AssetFuture<Texture> new_texture_from_file_async(const Path& path, TextureFlags flags=TextureFlags(), int priority=ASYNC_LOAD_PRIORITY_DEFAULT, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
+    AssetFuture<Mesh> new_mesh_from_file_async(const Path& path, const VertexSpecification& desired_specification=VertexSpecification::DEFAULT, const MeshLoadOptions& options=MeshLoadOptions(), int priority=ASYNC_LOAD_PRIORITY_DEFAULT, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
+    AssetFuture<Sound> new_sound_from_file_async(const Path& path, int priority=ASYNC_LOAD_PRIORITY_DEFAULT, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
+
     void update(float dt);
 
     virtual FontPtr default_font(DefaultFontStyle style) const;
@@ -219,6 +231,15 @@ private:
 
     MaterialPtr get_template_material(const Path &path);
 
+    TexturePtr texture_from_loader(Loader::ptr loader, TextureFlags flags, GarbageCollectMethod garbage_collect);
+    MeshPtr mesh_from_loader(const Path& path, Loader::ptr loader, const VertexSpecification& desired_specification, const MeshLoadOptions& options, GarbageCollectMethod garbage_collect);
+    SoundPtr sound_from_loader(const Path& path, Loader::ptr loader, GarbageCollectMethod garbage_collect);
+
+    template<typename T>
+    AssetFuture<T> load_async(const Path& path, LoaderHint hint, const LoaderOptions& options, int priority, std::function<std::shared_ptr<T> (Loader::ptr)> create);
+
+    std::vector<std::weak_ptr<AsyncLoadRequest>> async_loads_;
+
     std::set<AssetManager*> children_;
     void register_child(AssetManager* child) {
         children_.insert(child);
@@ -33,6 +33,7 @@ namespace smlt {
 const std::string Material::BuiltIns::DEFAULT = "simulant/materials/${RENDERER}/default.smat";
 const std::string Material::BuiltIns::TEXTURE_ONLY = "simulant/materials/${RENDERER}/texture_only.smat";
 const std::string Material::BuiltIns::DIFFUSE_ONLY = "simulant/materials/${RENDERER}/diffuse_only.smat";
+const std::string Material::BuiltIns::LIT_TEXTURED = "simulant/materials/${RENDERER}/lit_textured.smat";
 
 /* This list is used by the particle script loader to determine if a specified material
  * is a built-in or not. Please keep this up-to-date when changing the above materials!
@@ -41,6 +42,7 @@ const std::unordered_map<std::string, std::string> Material::BUILT_IN_NAMES = {
     {"DEFAULT", Material::BuiltIns::DEFAULT},
     {"TEXTURE_ONLY", Material::BuiltIns::TEXTURE_ONLY},
     {"DIFFUSE_ONLY", Material::BuiltIns::DIFFUSE_ONLY},
+    {"LIT_TEXTURED", Material::BuiltIns::LIT_TEXTURED},
 };
 
 std::unordered_map<MaterialPropertyNameHash, Material::PropertyName> Material::hashes_to_names_;
@@ -85,6 +87,7 @@ bool Material::set_pass_count(uint8_t pass_count) {
     }
 
     passes_.resize(pass_count, MaterialPass(this));
+    increment_version();
 
     return true;
 }
@@ -109,8 +112,13 @@ Material &Material::operator=(const Material &rhs) {
         pop_name(prop.first);
     }
 
+    /* The version must keep increasing, not be copied from the rhs */
+    auto version = version_;
+
     MaterialObject::operator=(rhs);
 
+    version_ = version + 1;
+
     /* Update refcounts for those names being transferred
      * from the rhs */
     std::string name;
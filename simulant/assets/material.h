@@ -32,6 +32,7 @@
 
 #include "materials/material_object.h"
 #include "materials/constants.h"
+#include "materials/parameter_block.h"
 
 namespace smlt {
 
@@ -76,11 +77,20 @@ public:
 
     const Material* material() const;
 
+    /* Every property value of this pass, resolved and packed for upload.
+     * This is only rebuilt when the pass or its material changes */
+    const MaterialParameterBlock& parameter_block() const {
+        parameter_block_.update(this);
+        return parameter_block_;
+    }
+
 private:
     IterationType iteration_type_ = ITERATION_TYPE_ONCE;
     uint8_t max_iterations_ = 1;
 
     GPUProgramPtr program_;
+
+    mutable MaterialParameterBlock parameter_block_;
 };
 
 typedef uint8_t PropertyIndex;
@@ -101,6 +111,11 @@ public:
         static const std::string DEFAULT;
         static const std::string TEXTURE_ONLY;
         static const std::string DIFFUSE_ONLY;
+
+        /* Lit and diffuse mapped. On GL2 its shader reads the model matrix
+         * per instance, so repeated meshes are drawn instanced, and it can
+         * blend vertex morph keyframes and skin rigs of up to 24 joints */
+        static const std::string LIT_TEXTURED;
     };
 
     static const std::unordered_map<std::string, std::string> BUILT_IN_NAMES;
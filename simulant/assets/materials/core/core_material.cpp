@@ -354,16 +354,18 @@ const PropertyList& core_properties() {
 
         {DEPTH_WRITE_ENABLED_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_BOOL},
         {DEPTH_TEST_ENABLED_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_BOOL},
+        {LIGHTING_ENABLED_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_BOOL},
+        {TEXTURES_ENABLED_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_INT},
 
         {DIFFUSE_MAP_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_TEXTURE},
         {SPECULAR_MAP_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_TEXTURE},
         {LIGHT_MAP_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_TEXTURE},
         {NORMAL_MAP_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_TEXTURE},
 
-        {DIFFUSE_MAP_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_MAT4},
-        {SPECULAR_MAP_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_MAT4},
-        {LIGHT_MAP_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_MAT4},
-        {NORMAL_MAP_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_MAT4},
+        {DIFFUSE_MAP_MATRIX_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_MAT4},
+        {SPECULAR_MAP_MATRIX_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_MAT4},
+        {LIGHT_MAP_MATRIX_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_MAT4},
+        {NORMAL_MAP_MATRIX_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_MAT4},
 
         {BLEND_FUNC_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_INT},
         {POLYGON_MODE_PROPERTY_NAME, MATERIAL_PROPERTY_TYPE_INT},
@@ -35,6 +35,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const bool&
     bool_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_BOOL;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_BOOL);
 }
 
@@ -54,6 +55,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const float
     float_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_FLOAT;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_FLOAT);
 }
 
@@ -73,6 +75,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const int32
     int_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_INT;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_INT);
 }
 
@@ -96,6 +99,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const Vec4&
     vec4_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_VEC4;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_VEC4);
 }
 
@@ -115,6 +119,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const Vec3&
     vec3_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_VEC3;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_VEC3);
 }
 
@@ -134,6 +139,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const Vec2&
     vec2_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_VEC2;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_VEC2);
 }
 
@@ -150,6 +156,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const Mat3&
     mat3_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_MAT3;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_MAT3);
 }
 
@@ -169,6 +176,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const Mat4&
     mat4_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_MAT4;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_MAT4);
 }
 
@@ -188,6 +196,7 @@ void MaterialPropertyOverrider::set_property_value(const char* name, const Textu
     texture_properties_[hsh] = value;
     all_overrides_[hsh] = MATERIAL_PROPERTY_TYPE_TEXTURE;
 
+    increment_version();
     on_override(hsh, name, MATERIAL_PROPERTY_TYPE_TEXTURE);
 }
 
@@ -297,6 +306,7 @@ bool MaterialPropertyOverrider::clear_override(const unsigned hsh) {
         }
 
         all_overrides_.erase(hsh);
+        increment_version();
         return true;
     }
 
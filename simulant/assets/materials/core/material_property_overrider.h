@@ -70,7 +70,17 @@ public:
 
     bool property_type(const char* property_name, MaterialPropertyType* type) const;
 
+    /* Incremented whenever a property is overridden or cleared on this
+     * object, or on any object which uses it as a parent */
+    uint32_t version() const { return version_; }
+
 protected:
+    void increment_version() const {
+        for(auto o = this; o; o = o->parent_) {
+            ++o->version_;
+        }
+    }
+
     virtual void on_override(
         MaterialPropertyNameHash hsh,
         const char* name,
@@ -91,6 +101,8 @@ protected:
 
     const MaterialPropertyOverrider* parent_ = nullptr;
 
+    mutable uint32_t version_ = 0;
+
     std::unordered_map<MaterialPropertyNameHash, MaterialPropertyType> all_overrides_;
     std::unordered_map<MaterialPropertyNameHash, int32_t> int_properties_;
     std::unordered_map<MaterialPropertyNameHash, float> float_properties_;
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+
+#include "parameter_block.h"
+#include "../material.h"
+#include "../../threads/mutex.h"
+
+namespace smlt {
+
+/* Shared by every block so that versions are never reused */
+static std::atomic<uint32_t> block_counter(0);
+
+/* Blocks with the same parameters, in the same order, share a layout id.
+ * Programs then keep the uniform locations they resolved when switching
+ * between materials */
+static uint32_t intern_layout(const std::vector<MaterialParameter>& parameters, const std::vector<MaterialParameter>& texture_parameters) {
+    static thread::Mutex lock;
+    static std::map<std::vector<uint64_t>, uint32_t> layouts;
+
+    std::vector<uint64_t> key;
+    key.reserve(parameters.size() + texture_parameters.size() + 1);
+
+    for(auto& parameter: parameters) {
+        key.push_back((uint64_t(parameter.hash) << 8) | parameter.type);
+    }
+
+    /* Keeps a value parameter from matching a texture one */
+    key.push_back(~uint64_t(0));
+
+    for(auto& parameter: texture_parameters) {
+        key.push_back((uint64_t(parameter.hash) << 8) | parameter.type);
+    }
+
+    thread::Lock<thread::Mutex> g(lock);
+    auto it = layouts.find(key);
+    if(it == layouts.end()) {
+        it = layouts.insert(std::make_pair(key, uint32_t(layouts.size() + 1))).first;
+    }
+
+    return it->second;
+}
+
+static uint32_t std140_alignment(MaterialPropertyType type) {
+    switch(type) {
+        case MATERIAL_PROPERTY_TYPE_VEC2: return 8;
+        case MATERIAL_PROPERTY_TYPE_VEC3:
+        case MATERIAL_PROPERTY_TYPE_VEC4:
+        case MATERIAL_PROPERTY_TYPE_MAT3:
+        case MATERIAL_PROPERTY_TYPE_MAT4: return 16;
+    default:
+        return 4;
+    }
+}
+
+static uint32_t std140_size(MaterialPropertyType type) {
+    switch(type) {
+        case MATERIAL_PROPERTY_TYPE_VEC2: return 8;
+        case MATERIAL_PROPERTY_TYPE_VEC3: return 12;
+        case MATERIAL_PROPERTY_TYPE_VEC4: return 16;
+        case MATERIAL_PROPERTY_TYPE_MAT3: return 48;
+        case MATERIAL_PROPERTY_TYPE_MAT4: return 64;
+        case MATERIAL_PROPERTY_TYPE_TEXTURE: return 0;
+    default:
+        return 4;
+    }
+}
+
+bool MaterialParameterBlock::update(const MaterialPass* pass) {
+    auto material = pass->material();
+    auto material_version = (material) ? material->version() : 0;
+
+    if(built_ && pass_version_ == pass->version() && material_version_ == material_version) {
+        return false;
+    }
+
+    rebuild_layout(pass);
+    write_values(pass);
+
+    pass_version_ = pass->version();
+    material_version_ = material_version;
+    version_ = ++block_counter;
+    built_ = true;
+
+    return true;
+}
+
+const MaterialParameter* MaterialParameterBlock::find(MaterialPropertyNameHash hash) const {
+    for(auto& parameter: parameters_) {
+        if(parameter.hash == hash) {
+            return &parameter;
+        }
+    }
+
+    return nullptr;
+}
+
+void MaterialParameterBlock::rebuild_layout(const MaterialPass* pass) {
+    std::vector<MaterialParameter> parameters;
+    std::vector<MaterialParameter> texture_parameters;
+
+    auto push = [&](const std::string& name, MaterialPropertyNameHash hash, MaterialPropertyType type) {
+        MaterialParameter parameter;
+        parameter.name = name;
+        parameter.hash = hash;
+        parameter.type = type;
+
+        if(type == MATERIAL_PROPERTY_TYPE_TEXTURE) {
+            texture_parameters.push_back(parameter);
+        } else {
+            parameters.push_back(parameter);
+        }
+    };
+
+    for(auto& property: core_properties()) {
+        /* Core textures are only bound once the material sets them, which
+         * puts them in its texture properties below */
+        if(property.second != MATERIAL_PROPERTY_TYPE_TEXTURE) {
+            push(property.first, material_property_hash(property.first.c_str()), property.second);
+        }
+    }
+
+    auto material = pass->material();
+    if(material) {
+        std::string name;
+        for(auto& property: material->custom_properties()) {
+            if(property.second != MATERIAL_PROPERTY_TYPE_TEXTURE && material->property_name(property.first, name)) {
+                push(name, property.first, property.second);
+            }
+        }
+
+        for(auto hash: material->texture_properties()) {
+            if(material->property_name(hash, name)) {
+                push(name, hash, MATERIAL_PROPERTY_TYPE_TEXTURE);
+            }
+        }
+
+        /* Each texture can have a counterpart matrix. The core ones are
+         * already listed, custom ones are picked up if the pass has one */
+        for(auto& texture: texture_parameters) {
+            auto matrix_name = texture.name + "_matrix";
+            auto matrix_hash = material_property_hash(matrix_name.c_str());
+
+            const Mat4* matrix = nullptr;
+            bool listed = std::any_of(parameters.begin(), parameters.end(), [matrix_hash](const MaterialParameter& p) {
+                return p.hash == matrix_hash;
+            });
+
+            if(!listed && pass->property_value(matrix_hash, matrix)) {
+                push(matrix_name, matrix_hash, MATERIAL_PROPERTY_TYPE_MAT4);
+            }
+        }
+    }
+
+    /* Only bump the layout if the set of parameters actually changed, so
+     * that renderers can keep anything they've resolved against it */
+    auto same = [](const std::vector<MaterialParameter>& a, const std::vector<MaterialParameter>& b) {
+        if(a.size() != b.size()) {
+            return false;
+        }
+
+        for(std::size_t i = 0; i < a.size(); ++i) {
+            if(a[i].hash != b[i].hash || a[i].type != b[i].type) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    if(built_ && same(parameters, parameters_) && same(texture_parameters, texture_parameters_)) {
+        return;
+    }
+
+    uint32_t offset = 0;
+    for(auto& parameter: parameters) {
+        auto alignment = std140_alignment(parameter.type);
+        offset = (offset + alignment - 1) & ~(alignment - 1);
+        parameter.offset = offset;
+        offset += std140_size(parameter.type);
+    }
+
+    /* The size of a uniform block is rounded up to a vec4 */
+    data_.assign((offset + 15) & ~15u, 0);
+
+    parameters_ = std::move(parameters);
+    texture_parameters_ = std::move(texture_parameters);
+    layout_ = intern_layout(parameters_, texture_parameters_);
+}
+
+void MaterialParameterBlock::write_values(const MaterialPass* pass) {
+    auto copy = [this](const MaterialParameter& parameter, const void* src, std::size_t size) {
+        if(src) {
+            std::memcpy(&data_[parameter.offset], src, size);
+        } else {
+            std::memset(&data_[parameter.offset], 0, size);
+        }
+    };
+
+    for(auto& parameter: parameters_) {
+        auto hash = parameter.hash;
+
+        switch(parameter.type) {
+        case MATERIAL_PROPERTY_TYPE_BOOL: {
+            const bool* v = nullptr;
+            pass->property_value(hash, v);
+            int32_t i = (v && *v) ? 1 : 0;
+            copy(parameter, &i, sizeof(int32_t));
+        } break;
+        case MATERIAL_PROPERTY_TYPE_INT: {
+            const int32_t* v = nullptr;
+            pass->property_value(hash, v);
+            copy(parameter, v, sizeof(int32_t));
+        } break;
+        case MATERIAL_PROPERTY_TYPE_FLOAT: {
+            const float* v = nullptr;
+            pass->property_value(hash, v);
+            copy(parameter, v, sizeof(float));
+        } break;
+        case MATERIAL_PROPERTY_TYPE_VEC2: {
+            const Vec2* v = nullptr;
+            pass->property_value(hash, v);
+            copy(parameter, v, sizeof(float) * 2);
+        } break;
+        case MATERIAL_PROPERTY_TYPE_VEC3: {
+            const Vec3* v = nullptr;
+            pass->property_value(hash, v);
+            copy(parameter, v, sizeof(float) * 3);
+        } break;
+        case MATERIAL_PROPERTY_TYPE_VEC4: {
+            const Vec4* v = nullptr;
+            pass->property_value(hash, v);
+            copy(parameter, v, sizeof(float) * 4);
+        } break;
+        case MATERIAL_PROPERTY_TYPE_MAT3: {
+            const Mat3* v = nullptr;
+            pass->property_value(hash, v);
+
+            /* Each column is padded out to a vec4 */
+            float columns[12] = {0};
+            for(auto c = 0; v && c < 3; ++c) {
+                std::memcpy(&columns[c * 4], v->data() + (c * 3), sizeof(float) * 3);
+            }
+            copy(parameter, columns, sizeof(columns));
+        } break;
+        case MATERIAL_PROPERTY_TYPE_MAT4: {
+            const Mat4* v = nullptr;
+            pass->property_value(hash, v);
+            copy(parameter, (v) ? v->data() : nullptr, sizeof(float) * 16);
+        } break;
+        default:
+            break;
+        }
+    }
+
+    textures_.resize(texture_parameters_.size());
+    for(std::size_t i = 0; i < texture_parameters_.size(); ++i) {
+        const TexturePtr* texture = nullptr;
+        pass->property_value(texture_parameters_[i].hash, texture);
+        textures_[i] = (texture) ? *texture : TexturePtr();
+    }
+}
+
+}
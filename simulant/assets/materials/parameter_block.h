@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../types.h"
+#include "core/core_material.h"
+
+namespace smlt {
+
+class MaterialPass;
+
+struct MaterialParameter {
+    std::string name;
+    MaterialPropertyNameHash hash;
+    MaterialPropertyType type;
+
+    /* Byte offset into MaterialParameterBlock::data(), unused for textures */
+    uint32_t offset = 0;
+};
+
+/*
+ * The resolved value of every property of a material pass, flattened into a
+ * single buffer so that the renderer doesn't have to look each one up
+ * through the pass, its material and the core material on every pass switch.
+ *
+ * Values are laid out following the std140 rules so the data can be copied
+ * straight into a uniform buffer. Booleans are stored as 32 bit integers and
+ * each column of a mat3 is padded to a vec4. Textures aren't part of the
+ * buffer, they're listed separately.
+ *
+ * The block is rebuilt lazily when the pass or its material changes.
+ */
+class MaterialParameterBlock {
+public:
+    /* Rebuilds the block if the pass, or its material, has changed since the
+     * last update. Returns true if anything was rebuilt */
+    bool update(const MaterialPass* pass);
+
+    const std::vector<MaterialParameter>& parameters() const { return parameters_; }
+    const std::vector<MaterialParameter>& texture_parameters() const { return texture_parameters_; }
+
+    /* The texture for each entry in texture_parameters() */
+    const std::vector<TexturePtr>& textures() const { return textures_; }
+
+    const uint8_t* data() const { return data_.data(); }
+    uint32_t size() const { return data_.size(); }
+
+    const MaterialParameter* find(MaterialPropertyNameHash hash) const;
+
+    template<typename T>
+    const T* value(const MaterialParameter& parameter) const {
+        return reinterpret_cast<const T*>(&data_[parameter.offset]);
+    }
+
+    /* Unique across all blocks, and changes whenever this one is rebuilt. If
+     * two blocks share a version they hold identical values */
+    uint32_t version() const { return version_; }
+
+    /* Identifies the names and types of the parameters, blocks with the
+     * same parameters share a layout whichever material they belong to */
+    uint32_t layout() const { return layout_; }
+
+private:
+    void rebuild_layout(const MaterialPass* pass);
+    void write_values(const MaterialPass* pass);
+
+    bool built_ = false;
+    uint32_t pass_version_ = 0;
+    uint32_t material_version_ = 0;
+
+    uint32_t version_ = 0;
+    uint32_t layout_ = 0;
+
+    std::vector<MaterialParameter> parameters_;
+    std::vector<MaterialParameter> texture_parameters_;
+    std::vector<TexturePtr> textures_;
+    std::vector<uint8_t> data_;
+};
+
+}
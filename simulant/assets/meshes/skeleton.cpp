@@ -4,6 +4,9 @@
 #include "rig.h"
 
 #include "../../debug.h"
+#include "../../window.h"
+#include "../../asset_manager.h"
+#include "../../jobs/parallel.h"
 
 namespace smlt {
 
@@ -135,7 +138,6 @@ void SkeletalFrameUnpacker::unpack_frame(
 
     /* Initialise the interpolated vertex data with all the mesh data (so UV etc. are populated) */
     mesh_->vertex_data->clone_into(*out);
-    auto skeleton = mesh_->skeleton.get();
 
     /* Debug draw the joints */
     if(debug) {
@@ -153,39 +155,148 @@ void SkeletalFrameUnpacker::unpack_frame(
 
     auto vdata = mesh_->vertex_data.get();
 
-    /* Go through each skeleton vertex, and update the counterpart
-     * actual vertex by manipulating its position to take into account the current
-     * joint position vs the original joint position for each joint that has a
-     * weighting */
-    for(std::size_t i = 0; i < vertices_.size(); ++i) {
-        Vec3 p = *vdata->position_at<Vec3>(i);
-        Vec3 n = *vdata->normal_at<Vec3>(i);
-        auto sv = vertices_[i];
+    if(bind_pose_dirty_ || bind_pose_version_ != vdata->last_updated()) {
+        bind_pose_.build(vdata, vertices_);
+        bind_pose_dirty_ = false;
+        bind_pose_version_ = vdata->last_updated();
+    }
 
-        Vec3 po, no;
-        for(auto k = 0; k < MAX_JOINTS_PER_VERTEX; ++k) {
-            auto j = sv.joints[k];
-            if(j > -1) {
-                auto q = rig->joint(j)->absolute_rotation_;
-                auto d = rig->joint(j)->absolute_translation_;
+    build_palette(rig);
+
+    skinned_.resize(bind_pose_.block_count() * SKINNING_BLOCK_SIZE);
 
-                auto joint = skeleton->joint(j);
+    const uint32_t block_count = bind_pose_.block_count();
+    auto skin = [this](std::size_t first, std::size_t last) {
+        skin_vertices(bind_pose_, palette_.data(), first, last, skinned_);
+    };
 
-                /* FIXME: Optimise! Using matrices may be fewer instructions */
-                Quaternion rot = q * joint->absolute_rotation().inversed();
-                po += ((p - joint->absolute_translation()) * rot) + d * sv.weights[k];
-                no += rot * n;
+    auto jobs = mesh_->asset_manager().window->jobs.get();
+    if(jobs && bind_pose_.count >= SKINNING_PARALLEL_MIN_VERTICES) {
+        jobs::parallel_for_range(
+            *jobs, 0, block_count,
+            SKINNING_PARALLEL_MIN_VERTICES / SKINNING_BLOCK_SIZE, skin
+        );
+    } else {
+        skin(0, block_count);
+    }
+
+    /* Write the results back into the interleaved vertex data. Full
+     * precision positions and normals are written in place, anything
+     * else goes through the cursor */
+    auto& spec = out->vertex_specification();
+    const bool in_place = (
+        spec.position_attribute == VERTEX_ATTRIBUTE_3F &&
+        spec.normal_attribute == VERTEX_ATTRIBUTE_3F
+    );
+
+    const bool has_normals = spec.has_normals();
+
+    for(uint32_t i = 0; i < bind_pose_.count; ++i) {
+        Vec3 p(skinned_.px[i], skinned_.py[i], skinned_.pz[i]);
+        Vec3 n(skinned_.nx[i], skinned_.ny[i], skinned_.nz[i]);
+        n.normalize();
+
+        if(in_place) {
+            uint8_t* vertex = out->data() + (i * out->stride());
+            std::memcpy(vertex + spec.position_offset(false), &p, sizeof(float) * 3);
+            std::memcpy(vertex + spec.normal_offset(false), &n, sizeof(float) * 3);
+        } else {
+            out->move_to(i);
+            out->position(p);
+            if(has_normals) {
+                out->normal(n);
             }
         }
-
-        out->move_to(i);
-        out->position(po);
-        out->normal(no.normalized());
     }
 
     out->done();
 }
 
+void SkeletalFrameUnpacker::build_palette(Rig* const rig) {
+    /* Each matrix takes a vertex from the bind pose to the posed joint,
+     * p' = R(p - b) + d where R is the rotation from the bind pose to the
+     * current pose, b the joint's bind position and d its posed position */
+    auto skeleton = mesh_->skeleton.get();
+
+    palette_.resize(rig->joint_count());
+    for(std::size_t j = 0; j < rig->joint_count(); ++j) {
+        auto joint = skeleton->joint(j);
+        auto rig_joint = rig->joint(j);
+
+        Quaternion rot = rig_joint->absolute_rotation_ * joint->absolute_rotation().inversed();
+
+        const Vec3 x = rot * Vec3(1, 0, 0);
+        const Vec3 y = rot * Vec3(0, 1, 0);
+        const Vec3 z = rot * Vec3(0, 0, 1);
+        const Vec3 t = rig_joint->absolute_translation_ - (rot * joint->absolute_translation());
+
+        float* m = palette_[j].m;
+        m[0] = x.x; m[1] = y.x; m[2] = z.x; m[3] = t.x;
+        m[4] = x.y; m[5] = y.y; m[6] = z.y; m[7] = t.y;
+        m[8] = x.z; m[9] = y.z; m[10] = z.z; m[11] = t.z;
+    }
+}
+
+const VertexData* SkeletalFrameUnpacker::skin_vertex_data() {
+    if(skin_vertex_data_) {
+        return skin_vertex_data_.get();
+    }
+
+    VertexSpecification spec(
+        VERTEX_ATTRIBUTE_NONE, VERTEX_ATTRIBUTE_NONE,
+        VERTEX_ATTRIBUTE_4F, VERTEX_ATTRIBUTE_4F
+    );
+
+    /* Joint indices are floats as GL2 has no integer attributes, unused
+     * slots point at joint 0 with no weight */
+    const uint32_t stride = spec.stride();
+    std::vector<uint8_t> data(vertices_.size() * stride, 0);
+
+    for(std::size_t i = 0; i < vertices_.size(); ++i) {
+        auto& vertex = vertices_[i];
+
+        float joints[MAX_JOINTS_PER_VERTEX];
+        float weights[MAX_JOINTS_PER_VERTEX];
+        for(auto k = 0; k < MAX_JOINTS_PER_VERTEX; ++k) {
+            joints[k] = (vertex.joints[k] > -1) ? float(vertex.joints[k]) : 0.0f;
+            weights[k] = (vertex.joints[k] > -1) ? vertex.weights[k] : 0.0f;
+        }
+
+        std::memcpy(&data[i * stride + spec.texcoord0_offset()], joints, sizeof(joints));
+        std::memcpy(&data[i * stride + spec.texcoord1_offset()], weights, sizeof(weights));
+    }
+
+    skin_vertex_data_ = std::make_shared<VertexData>(spec);
+    skin_vertex_data_->assign(data.data(), vertices_.size());
+    skin_vertex_data_->done();
+
+    return skin_vertex_data_.get();
+}
+
+void SkeletalFrameUnpacker::build_joint_palette(Rig* const rig, std::vector<Mat4>& palette) {
+    if(!rig) {
+        palette.clear();
+        return;
+    }
+
+    rig->recalc_absolute_transformations();
+    build_palette(rig);
+
+    /* Mat4 is column major */
+    palette.resize(palette_.size());
+    for(std::size_t j = 0; j < palette_.size(); ++j) {
+        const float* m = palette_[j].m;
+        Mat4& out = palette[j];
+
+        for(int c = 0; c < 4; ++c) {
+            out[c * 4 + 0] = m[c];
+            out[c * 4 + 1] = m[4 + c];
+            out[c * 4 + 2] = m[8 + c];
+            out[c * 4 + 3] = (c == 3) ? 1.0f : 0.0f;
+        }
+    }
+}
+
 void SkeletalFrameUnpacker::rebuild_key_frame_absolute_transforms() {
     for(auto& frame: skeleton_frames_) {
         for(std::size_t i = 0; i < mesh_->skeleton->joint_count(); ++i) {
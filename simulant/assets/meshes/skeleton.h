@@ -5,10 +5,14 @@
 #include "../../math/quaternion.h"
 #include "../../math/vec3.h"
 #include "../../meshes/mesh.h"
+#include "skinning.h"
 
 #define MAX_JOINTS_PER_VERTEX 4
 #define MAX_JOINTS_PER_MESH 64
 
+/* Meshes with at least this many vertices are skinned on the job scheduler */
+#define SKINNING_PARALLEL_MIN_VERTICES 2048
+
 namespace smlt {
 
 struct Bone;
@@ -176,6 +180,9 @@ public:
         Debug* const debug=nullptr
     ) override;
 
+    const VertexData* skin_vertex_data() override;
+    void build_joint_palette(Rig* const rig, std::vector<Mat4>& palette) override;
+
     void set_joint_state_at_frame(std::size_t frame, std::size_t joint, JointState state) {
         skeleton_frames_[frame].joints[joint] = state;
     }
@@ -197,6 +204,8 @@ public:
             if(vert->joints[i] < 0) {
                 vert->joints[i] = j;
                 vert->weights[i] = weight;
+                bind_pose_dirty_ = true;
+                skin_vertex_data_.reset();
                 return true;
             }
         }
@@ -213,6 +222,21 @@ private:
     /* Key frames for skeletal animation */
     std::vector<SkeletonFrame> skeleton_frames_;
     std::vector<SkeletonVertex> vertices_;
+
+    /* Rebuilt when the mesh vertices or the joint links change */
+    SkinningBindPose bind_pose_;
+    bool bind_pose_dirty_ = true;
+    uint64_t bind_pose_version_ = 0;
+
+    /* Scratch space, reused between calls. unpack_frame isn't reentrant,
+     * the compositor evaluates poses one node at a time */
+    std::vector<SkinningMatrix> palette_;
+    SkinnedVertices skinned_;
+
+    /* Built on first use for renderers which skin on the GPU */
+    std::shared_ptr<VertexData> skin_vertex_data_;
+
+    void build_palette(Rig* const rig);
 };
 
 }
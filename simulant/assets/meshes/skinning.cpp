@@ -0,0 +1,198 @@
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SIMULANT_SKINNING_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMULANT_SKINNING_NEON 1
+#endif
+
+#include "skinning.h"
+#include "skeleton.h"
+#include "../../vertex_data.h"
+
+namespace smlt {
+
+static_assert(MAX_JOINTS_PER_VERTEX == 4, "SkinningBindPose assumes four joints per vertex");
+
+namespace {
+
+#if defined(SIMULANT_SKINNING_SSE)
+
+typedef __m128 float4;
+
+inline float4 load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, float4 v) { _mm_storeu_ps(p, v); }
+inline float4 zero() { return _mm_setzero_ps(); }
+inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+/* Fills out[0..3] with element 0..3 of the given row of each lane's matrix */
+inline void gather_row(const SkinningMatrix* palette, const int32_t* j, int row, float4* out) {
+    out[0] = _mm_loadu_ps(palette[j[0]].m + row * 4);
+    out[1] = _mm_loadu_ps(palette[j[1]].m + row * 4);
+    out[2] = _mm_loadu_ps(palette[j[2]].m + row * 4);
+    out[3] = _mm_loadu_ps(palette[j[3]].m + row * 4);
+    _MM_TRANSPOSE4_PS(out[0], out[1], out[2], out[3]);
+}
+
+#elif defined(SIMULANT_SKINNING_NEON)
+
+typedef float32x4_t float4;
+
+inline float4 load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, float4 v) { vst1q_f32(p, v); }
+inline float4 zero() { return vdupq_n_f32(0.0f); }
+inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+
+inline void gather_row(const SkinningMatrix* palette, const int32_t* j, int row, float4* out) {
+    /* Interleaving loads de-interleave by four, so this is a transpose */
+    float rows[16];
+    for(int l = 0; l < 4; ++l) {
+        vst1q_f32(rows + l * 4, vld1q_f32(palette[j[l]].m + row * 4));
+    }
+
+    float32x4x4_t t = vld4q_f32(rows);
+    out[0] = t.val[0];
+    out[1] = t.val[1];
+    out[2] = t.val[2];
+    out[3] = t.val[3];
+}
+
+#else
+
+struct float4 {
+    float v[4];
+};
+
+inline float4 load(const float* p) { return float4{{p[0], p[1], p[2], p[3]}}; }
+inline void store(float* p, float4 v) { for(int i = 0; i < 4; ++i) { p[i] = v.v[i]; } }
+inline float4 zero() { return float4{{0, 0, 0, 0}}; }
+
+inline float4 madd(float4 a, float4 b, float4 c) {
+    float4 o;
+    for(int i = 0; i < 4; ++i) {
+        o.v[i] = a.v[i] * b.v[i] + c.v[i];
+    }
+    return o;
+}
+
+inline void gather_row(const SkinningMatrix* palette, const int32_t* j, int row, float4* out) {
+    for(int e = 0; e < 4; ++e) {
+        for(int l = 0; l < 4; ++l) {
+            out[e].v[l] = palette[j[l]].m[row * 4 + e];
+        }
+    }
+}
+
+#endif
+
+/* The rows of the blended matrices of four vertices, element e of row r is
+ * m[r * 4 + e] */
+struct BlendedMatrices {
+    float4 m[12];
+};
+
+inline void transform(const BlendedMatrices& b, float4 x, float4 y, float4 z, bool translate, float4* out) {
+    for(int r = 0; r < 3; ++r) {
+        const float4* row = &b.m[r * 4];
+        float4 o = (translate) ? row[3] : zero();
+        o = madd(row[0], x, o);
+        o = madd(row[1], y, o);
+        o = madd(row[2], z, o);
+        out[r] = o;
+    }
+}
+
+}
+
+void SkinningBindPose::build(const VertexData* vertex_data, const std::vector<SkeletonVertex>& vertices) {
+    count = vertices.size();
+
+    const uint32_t padded = block_count() * SKINNING_BLOCK_SIZE;
+
+    for(auto array: {&px, &py, &pz, &nx, &ny, &nz}) {
+        array->assign(padded, 0.0f);
+    }
+
+    for(uint32_t k = 0; k < MAX_JOINTS_PER_VERTEX; ++k) {
+        joints[k].assign(padded, 0);
+        weights[k].assign(padded, 0.0f);
+    }
+
+    const bool has_normals = vertex_data->vertex_specification().has_normals();
+
+    for(uint32_t i = 0; i < count; ++i) {
+        const Vec3 p = *vertex_data->position_at<Vec3>(i);
+        px[i] = p.x;
+        py[i] = p.y;
+        pz[i] = p.z;
+
+        if(has_normals) {
+            const Vec3 n = *vertex_data->normal_at<Vec3>(i);
+            nx[i] = n.x;
+            ny[i] = n.y;
+            nz[i] = n.z;
+        }
+
+        for(uint32_t k = 0; k < MAX_JOINTS_PER_VERTEX; ++k) {
+            if(vertices[i].joints[k] > -1) {
+                joints[k][i] = vertices[i].joints[k];
+                weights[k][i] = vertices[i].weights[k];
+            }
+        }
+    }
+}
+
+void SkinnedVertices::resize(uint32_t padded_count) {
+    for(auto array: {&px, &py, &pz, &nx, &ny, &nz}) {
+        array->resize(padded_count);
+    }
+}
+
+void skin_vertices(
+    const SkinningBindPose& bind_pose,
+    const SkinningMatrix* palette,
+    uint32_t first_block, uint32_t last_block,
+    SkinnedVertices& out) {
+
+    for(uint32_t block = first_block; block < last_block; ++block) {
+        const uint32_t i = block * SKINNING_BLOCK_SIZE;
+
+        BlendedMatrices blended;
+        for(auto& m: blended.m) {
+            m = zero();
+        }
+
+        for(uint32_t k = 0; k < MAX_JOINTS_PER_VERTEX; ++k) {
+            const float* w = &bind_pose.weights[k][i];
+
+            /* Most vertices only use the first one or two slots */
+            if(w[0] == 0.0f && w[1] == 0.0f && w[2] == 0.0f && w[3] == 0.0f) {
+                continue;
+            }
+
+            const float4 weight = load(w);
+            const int32_t* j = &bind_pose.joints[k][i];
+
+            float4 row[4];
+            for(int r = 0; r < 3; ++r) {
+                gather_row(palette, j, r, row);
+                for(int e = 0; e < 4; ++e) {
+                    blended.m[r * 4 + e] = madd(row[e], weight, blended.m[r * 4 + e]);
+                }
+            }
+        }
+
+        float4 result[3];
+        transform(blended, load(&bind_pose.px[i]), load(&bind_pose.py[i]), load(&bind_pose.pz[i]), true, result);
+        store(&out.px[i], result[0]);
+        store(&out.py[i], result[1]);
+        store(&out.pz[i], result[2]);
+
+        transform(blended, load(&bind_pose.nx[i]), load(&bind_pose.ny[i]), load(&bind_pose.nz[i]), false, result);
+        store(&out.nx[i], result[0]);
+        store(&out.ny[i], result[1]);
+        store(&out.nz[i], result[2]);
+    }
+}
+
+}
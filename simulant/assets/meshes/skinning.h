@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace smlt {
+
+class VertexData;
+struct SkeletonVertex;
+
+/*
+ * Linear blend skinning, used by SkeletalFrameUnpacker. A pose is flattened
+ * to a palette with a matrix per joint, each vertex blends the matrices of
+ * the joints it's attached to by weight, and transforms its bind pose
+ * position and normal by the result.
+ *
+ * Vertices are processed in blocks of SKINNING_BLOCK_SIZE, four at a time
+ * with SSE or NEON where they're available.
+ */
+
+const uint32_t SKINNING_BLOCK_SIZE = 4;
+
+/* Row major 3x4, the last column is the translation */
+struct SkinningMatrix {
+    float m[12];
+};
+
+/* The bind pose and joint weights as structure-of-arrays. Everything is
+ * padded to a whole number of blocks, padding vertices have no weight */
+struct SkinningBindPose {
+    uint32_t count = 0;
+
+    std::vector<float> px, py, pz;
+    std::vector<float> nx, ny, nz;
+
+    /* Unused slots point at joint 0 with a zero weight */
+    std::vector<int32_t> joints[4];
+    std::vector<float> weights[4];
+
+    uint32_t block_count() const {
+        return (count + SKINNING_BLOCK_SIZE - 1) / SKINNING_BLOCK_SIZE;
+    }
+
+    void build(const VertexData* vertex_data, const std::vector<SkeletonVertex>& vertices);
+};
+
+/* The skinned positions and normals, normals aren't renormalised */
+struct SkinnedVertices {
+    std::vector<float> px, py, pz;
+    std::vector<float> nx, ny, nz;
+
+    void resize(uint32_t padded_count);
+};
+
+/* Skins the vertices in blocks [first_block, last_block) into out, which
+ * must be sized for the whole bind pose. Different block ranges can be
+ * skinned on different threads. */
+void skin_vertices(
+    const SkinningBindPose& bind_pose,
+    const SkinningMatrix* palette,
+    uint32_t first_block, uint32_t last_block,
+    SkinnedVertices& out
+);
+
+}
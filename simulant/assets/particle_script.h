@@ -32,7 +32,10 @@ struct Emitter {
 };
 
 
-struct Particle;
+namespace particles {
+    class ParticleArrays;
+}
+
 class ParticleScript;
 
 class Manipulator {
@@ -43,8 +46,11 @@ public:
 
     virtual ~Manipulator() {}
 
-    void manipulate(ParticleSystem* system, Particle* particles, std::size_t particle_count, float dt) const {
-        do_manipulate(system, particles, particle_count, dt);
+    /* Manipulates the live particles in the arrays, implementations can
+     * process particles in blocks of PARTICLE_SIMD_WIDTH up to
+     * particles.padded_count() */
+    void manipulate(ParticleSystem* system, particles::ParticleArrays& particles, float dt) const {
+        do_manipulate(system, particles, dt);
     }
 
     virtual void set_linear_curve(float rate);
@@ -53,7 +59,7 @@ public:
 
 private:
     std::string name_;
-    virtual void do_manipulate(ParticleSystem* system, Particle* particles, std::size_t particle_count, float dt) const = 0;
+    virtual void do_manipulate(ParticleSystem* system, particles::ParticleArrays& particles, float dt) const = 0;
 
 protected:
     typedef std::function<float (float, float, float)> CurveFunc;
@@ -0,0 +1,57 @@
+#include <algorithm>
+
+#include "colour_fader.h"
+
+#include "../../nodes/particle_system.h"
+#include "../../nodes/particles/simd.h"
+
+namespace smlt {
+
+void ColourFader::do_manipulate(ParticleSystem*, particles::ParticleArrays& particles, float) const {
+    using namespace particles;
+    using namespace simd;
+
+    if(colours_.empty()) {
+        return;
+    }
+
+    const auto n = particles.padded_count();
+    const uint32_t last = colours_.size() - 1;
+    const float4 size = splat(float(colours_.size()));
+
+    for(std::size_t i = 0; i < n; i += PARTICLE_SIMD_WIDTH) {
+        float4 elapsed, normalised;
+        lifetime_progress(particles.ttl + i, particles.lifetime + i, elapsed, normalised);
+
+        alignas(16) float t[PARTICLE_SIMD_WIDTH];
+        store(t, mul(normalised, size));
+
+        /* Gather the two colours each particle is between, then blend all
+         * four particles channel by channel */
+        alignas(16) float from[4][PARTICLE_SIMD_WIDTH];
+        alignas(16) float to[4][PARTICLE_SIMD_WIDTH];
+        alignas(16) float f[PARTICLE_SIMD_WIDTH];
+
+        for(std::size_t j = 0; j < PARTICLE_SIMD_WIDTH; ++j) {
+            /* Padding lanes can hold anything, so clamp to the palette */
+            float v = (t[j] > 0.0f) ? std::min(t[j], float(last)) : 0.0f;
+            uint32_t c = uint32_t(v);
+
+            const Colour& a = colours_[c];
+            const Colour& b = colours_[std::min(c + 1, last)];
+
+            from[0][j] = a.r; from[1][j] = a.g; from[2][j] = a.b; from[3][j] = a.a;
+            to[0][j] = b.r; to[1][j] = b.g; to[2][j] = b.b; to[3][j] = b.a;
+            f[j] = (interpolate_) ? v - float(c) : 0.0f;
+        }
+
+        const float4 factor = load(f);
+        float* channels[4] = {particles.r, particles.g, particles.b, particles.a};
+        for(int c = 0; c < 4; ++c) {
+            float4 start = load(from[c]);
+            store(channels[c] + i, madd(sub(load(to[c]), start), factor, start));
+        }
+    }
+}
+
+}
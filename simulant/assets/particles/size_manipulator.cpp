@@ -2,39 +2,56 @@
 
 #include "curves.h"
 #include "../../nodes/particle_system.h"
+#include "../../nodes/particles/simd.h"
 #include "../../macros.h"
 
 namespace smlt {
 
-void SizeManipulator::do_manipulate(ParticleSystem* system, Particle* particles, std::size_t particle_count, float dt) const {
+void SizeManipulator::do_manipulate(ParticleSystem* system, particles::ParticleArrays& particles, float dt) const {
     _S_UNUSED(dt);
 
-    /* We always have to set the curve before manipulation to take into
-         * account any scaling of the particle system */
-
-    auto create_scaled_curve = [this](float size) -> CurveFunc {
-        using namespace std::placeholders;
-
-        if(is_bell_curve_) {
-            return std::bind(&bell_curve, _1, _2, _3, peak_ * size, deviation_);
-        } else {
-            assert(is_linear_curve_);
-            return std::bind(&linear_curve, _1, _2, _3, rate_ * size);
+    using namespace particles;
+    using namespace simd;
+
+    /* The curve is scaled on every manipulation to take into account any
+     * scaling of the particle system. We have to only respect X scale here,
+     * no other option! */
+    const float scale = system->scale().x;
+    const auto n = particles.padded_count();
+
+    if(is_bell_curve_) {
+        const float peak = peak_ * scale;
+
+        for(std::size_t i = 0; i < n; i += PARTICLE_SIMD_WIDTH) {
+            float4 elapsed, normalised;
+            lifetime_progress(particles.ttl + i, particles.lifetime + i, elapsed, normalised);
+
+            /* The exponent isn't vectorised, but the curve is the same for
+             * both axes so it's only evaluated once per particle */
+            alignas(16) float e[PARTICLE_SIMD_WIDTH], t[PARTICLE_SIMD_WIDTH], y[PARTICLE_SIMD_WIDTH];
+            store(e, elapsed);
+            store(t, normalised);
+            for(std::size_t j = 0; j < PARTICLE_SIMD_WIDTH; ++j) {
+                y[j] = bell_curve(0.0f, t[j], e[j], peak, deviation_);
+            }
+
+            float4 growth = load(y);
+            store(particles.width + i, add(load(particles.initial_width + i), growth));
+            store(particles.height + i, add(load(particles.initial_height + i), growth));
         }
-    };
+    } else {
+        assert(is_linear_curve_);
 
+        const float4 rate = splat(rate_ * scale);
 
-    /* We have to only respect X scale here, no other option! */
-    auto curve = create_scaled_curve(system->scale().x);
+        for(std::size_t i = 0; i < n; i += PARTICLE_SIMD_WIDTH) {
+            float4 elapsed, normalised;
+            lifetime_progress(particles.ttl + i, particles.lifetime + i, elapsed, normalised);
 
-    Particle* particle = particles;
-    for(auto i = 0u; i < particle_count; ++i) {
-        float e = (particle->lifetime - particle->ttl);
-        float n =  e / particle->lifetime;
-        particle->dimensions.x = curve(particle->initial_dimensions.x, n, e);
-        particle->dimensions.y = curve(particle->initial_dimensions.y, n, e);
-
-        ++particle;
+            float4 growth = mul(elapsed, rate);
+            store(particles.width + i, add(load(particles.initial_width + i), growth));
+            store(particles.height + i, add(load(particles.initial_height + i), growth));
+        }
     }
 }
 
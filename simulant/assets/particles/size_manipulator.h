@@ -29,7 +29,7 @@ public:
     }
 
 private:
-    void do_manipulate(ParticleSystem* system, Particle* particles, std::size_t particle_count, float dt) const override;
+    void do_manipulate(ParticleSystem* system, particles::ParticleArrays& particles, float dt) const override;
 
     bool is_bell_curve_ = false;
     bool is_linear_curve_ = false;
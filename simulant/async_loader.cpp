@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "async_loader.h"
+#include "time_keeper.h"
+#include "logging.h"
+
+namespace smlt {
+
+bool AsyncLoadRequest::cancel() {
+    int current = status_.load();
+    while(current != ASYNC_LOAD_STATUS_FINALISING &&
+          current != ASYNC_LOAD_STATUS_COMPLETE &&
+          current != ASYNC_LOAD_STATUS_FAILED &&
+          current != ASYNC_LOAD_STATUS_CANCELLED) {
+
+        if(status_.compare_exchange_weak(current, ASYNC_LOAD_STATUS_CANCELLED)) {
+            return true;
+        }
+    }
+
+    return current == ASYNC_LOAD_STATUS_CANCELLED;
+}
+
+AsyncLoader::AsyncLoader(std::size_t thread_count) {
+    for(std::size_t i = 0; i < thread_count; ++i) {
+        threads_.push_back(new thread::Thread(&AsyncLoader::worker_main, this));
+    }
+
+    S_DEBUG("Started async loader with {0} threads", thread_count);
+}
+
+AsyncLoader::~AsyncLoader() {
+    {
+        thread::Lock<thread::Mutex> g(lock_);
+        stopping_ = true;
+    }
+
+    work_available_.notify_all();
+
+    for(auto t: threads_) {
+        t->join();
+        delete t;
+    }
+
+    /* Nothing will finalise these now */
+    for(auto queue: {&queued_, &prepared_}) {
+        for(auto& request: *queue) {
+            request->cancel();
+            request->release();
+        }
+    }
+}
+
+/* Orders the heaps so that the highest priority, then oldest, request is at
+ * the front */
+bool AsyncLoader::runs_after(const AsyncLoadRequestPtr& lhs, const AsyncLoadRequestPtr& rhs) {
+    if(lhs->priority() != rhs->priority()) {
+        return lhs->priority() < rhs->priority();
+    }
+
+    return lhs->sequence_ > rhs->sequence_;
+}
+
+void AsyncLoader::push(std::vector<AsyncLoadRequestPtr>& heap, AsyncLoadRequestPtr request) {
+    heap.push_back(request);
+    std::push_heap(heap.begin(), heap.end(), &AsyncLoader::runs_after);
+}
+
+AsyncLoadRequestPtr AsyncLoader::pop(std::vector<AsyncLoadRequestPtr>& heap) {
+    std::pop_heap(heap.begin(), heap.end(), &AsyncLoader::runs_after);
+    auto request = heap.back();
+    heap.pop_back();
+    return request;
+}
+
+void AsyncLoader::submit(AsyncLoadRequestPtr request) {
+    {
+        thread::Lock<thread::Mutex> g(lock_);
+        request->sequence_ = next_sequence_++;
+        push(queued_, request);
+    }
+
+    work_available_.notify_one();
+}
+
+void AsyncLoader::prepare(AsyncLoadRequestPtr request) {
+    if(!request->transition(ASYNC_LOAD_STATUS_QUEUED, ASYNC_LOAD_STATUS_PREPARING)) {
+        /* Cancelled while it was queued */
+        request->release();
+        return;
+    }
+
+    try {
+        request->prepare_();
+    } catch(std::exception& e) {
+        S_ERROR("Asynchronous load failed: {0}", e.what());
+        request->transition(ASYNC_LOAD_STATUS_PREPARING, ASYNC_LOAD_STATUS_FAILED);
+        request->release();
+        return;
+    }
+
+    if(!request->transition(ASYNC_LOAD_STATUS_PREPARING, ASYNC_LOAD_STATUS_PREPARED)) {
+        request->release();
+        return;
+    }
+
+    thread::Lock<thread::Mutex> g(lock_);
+    push(prepared_, request);
+}
+
+void AsyncLoader::worker_main() {
+    while(true) {
+        AsyncLoadRequestPtr request;
+
+        {
+            thread::Lock<thread::Mutex> g(lock_);
+            while(!stopping_ && queued_.empty()) {
+                work_available_.wait(lock_);
+            }
+
+            if(stopping_) {
+                return;
+            }
+
+            request = pop(queued_);
+        }
+
+        prepare(request);
+    }
+}
+
+std::size_t AsyncLoader::update(uint64_t budget_us) {
+    const uint64_t start = TimeKeeper::now_in_us();
+    std::size_t finalised = 0;
+
+    while(true) {
+        AsyncLoadRequestPtr request;
+        bool needs_preparing = false;
+
+        {
+            thread::Lock<thread::Mutex> g(lock_);
+            if(!prepared_.empty()) {
+                request = pop(prepared_);
+            } else if(threads_.empty() && !queued_.empty()) {
+                request = pop(queued_);
+                needs_preparing = true;
+            }
+        }
+
+        if(!request) {
+            break;
+        }
+
+        if(needs_preparing) {
+            /* Lands in prepared_ (unless it failed), and is picked up next
+             * time around */
+            prepare(request);
+            continue;
+        }
+
+        /* From here on cancel() fails, so nothing can overwrite the result */
+        if(!request->transition(ASYNC_LOAD_STATUS_PREPARED, ASYNC_LOAD_STATUS_FINALISING)) {
+            request->release();
+            continue;
+        }
+
+        try {
+            request->finalise_();
+            request->transition(ASYNC_LOAD_STATUS_FINALISING, ASYNC_LOAD_STATUS_COMPLETE);
+        } catch(std::exception& e) {
+            S_ERROR("Asynchronous load failed: {0}", e.what());
+            request->transition(ASYNC_LOAD_STATUS_FINALISING, ASYNC_LOAD_STATUS_FAILED);
+        }
+
+        request->release();
+
+        ++finalised;
+        if(TimeKeeper::now_in_us() - start >= budget_us) {
+            break;
+        }
+    }
+
+    return finalised;
+}
+
+std::size_t AsyncLoader::pending_count() const {
+    thread::Lock<thread::Mutex> g(lock_);
+
+    /* Cancelled requests stay queued until something pops them, but they
+     * won't be finalised */
+    auto is_live = [](const AsyncLoadRequestPtr& request) {
+        return request->status() != ASYNC_LOAD_STATUS_CANCELLED;
+    };
+
+    return std::count_if(queued_.begin(), queued_.end(), is_live) +
+        std::count_if(prepared_.begin(), prepared_.end(), is_live);
+}
+
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "threads/thread.h"
+#include "threads/mutex.h"
+#include "threads/condition.h"
+
+namespace smlt {
+
+enum AsyncLoadStatus {
+    ASYNC_LOAD_STATUS_QUEUED,
+    ASYNC_LOAD_STATUS_PREPARING,
+    ASYNC_LOAD_STATUS_PREPARED,
+    ASYNC_LOAD_STATUS_FINALISING,
+    ASYNC_LOAD_STATUS_COMPLETE,
+    ASYNC_LOAD_STATUS_FAILED,
+    ASYNC_LOAD_STATUS_CANCELLED
+};
+
+/* Loads with a higher priority are prepared and finalised first */
+const int ASYNC_LOAD_PRIORITY_DEFAULT = 0;
+
+class AsyncLoader;
+
+/*
+ * A load split in two. prepare() runs on one of the AsyncLoader's threads
+ * and does the file I/O and decoding, it mustn't touch any managers.
+ * finalise() runs later on the main thread and creates the asset.
+ */
+class AsyncLoadRequest {
+public:
+    typedef std::function<void ()> Step;
+
+    AsyncLoadRequest(int priority, Step prepare, Step finalise):
+        priority_(priority),
+        prepare_(prepare),
+        finalise_(finalise),
+        status_(ASYNC_LOAD_STATUS_QUEUED) {}
+
+    AsyncLoadStatus status() const {
+        return (AsyncLoadStatus) status_.load();
+    }
+
+    int priority() const {
+        return priority_;
+    }
+
+    bool is_finished() const {
+        auto s = status();
+        return s == ASYNC_LOAD_STATUS_COMPLETE ||
+            s == ASYNC_LOAD_STATUS_FAILED ||
+            s == ASYNC_LOAD_STATUS_CANCELLED;
+    }
+
+    /* Stops the load unless it's already finalising, complete or failed,
+     * returns true if the load is now cancelled. Once finalise() has started
+     * on the main thread the load can't be cancelled. */
+    bool cancel();
+
+private:
+    friend class AsyncLoader;
+
+    bool transition(AsyncLoadStatus from, AsyncLoadStatus to) {
+        int expected = from;
+        return status_.compare_exchange_strong(expected, to);
+    }
+
+    /* Drops anything the steps captured, e.g. decoded data */
+    void release() {
+        prepare_ = Step();
+        finalise_ = Step();
+    }
+
+    int priority_;
+    uint64_t sequence_ = 0;
+
+    Step prepare_;
+    Step finalise_;
+
+    std::atomic<int> status_;
+};
+
+typedef std::shared_ptr<AsyncLoadRequest> AsyncLoadRequestPtr;
+
+/*
+ * Returned by the AssetManager's *_async methods. This never blocks, poll
+ * is_ready() (e.g. from an update) and then call result().
+ */
+template<typename T>
+class AssetFuture {
+public:
+    typedef std::shared_ptr<T> ptr_type;
+
+    AssetFuture() = default;
+
+    AssetFuture(AsyncLoadRequestPtr request, std::shared_ptr<ptr_type> result):
+        request_(request),
+        result_(result) {}
+
+    bool is_valid() const { return bool(request_); }
+
+    AsyncLoadStatus status() const {
+        return (request_) ? request_->status() : ASYNC_LOAD_STATUS_FAILED;
+    }
+
+    bool is_ready() const { return status() == ASYNC_LOAD_STATUS_COMPLETE; }
+    bool is_failed() const { return status() == ASYNC_LOAD_STATUS_FAILED; }
+    bool is_cancelled() const { return status() == ASYNC_LOAD_STATUS_CANCELLED; }
+
+    /* Ready, failed or cancelled */
+    bool is_finished() const { return !request_ || request_->is_finished(); }
+
+    bool cancel() {
+        return request_ && request_->cancel();
+    }
+
+    /* The loaded asset, or null if it isn't ready */
+    ptr_type result() const {
+        return (is_ready()) ? *result_ : ptr_type();
+    }
+
+private:
+    AsyncLoadRequestPtr request_;
+    std::shared_ptr<ptr_type> result_;
+};
+
+/*
+ * A small pool of threads which prepare AsyncLoadRequests, and a queue of
+ * prepared requests which the Window finalises each frame within a time
+ * budget (AppConfig::general::async_load_budget_us).
+ *
+ * With no threads, requests are prepared during update() instead.
+ */
+class AsyncLoader {
+public:
+    AsyncLoader(std::size_t thread_count);
+    ~AsyncLoader();
+
+    AsyncLoader(const AsyncLoader&) = delete;
+    AsyncLoader& operator=(const AsyncLoader&) = delete;
+
+    void submit(AsyncLoadRequestPtr request);
+
+    /* Finalises prepared requests, highest priority first, until budget_us
+     * has passed. At least one request is finalised per call so that a slow
+     * asset can't stall the queue. Must be called from the main thread,
+     * returns the number of requests finalised. */
+    std::size_t update(uint64_t budget_us);
+
+    /* Requests which are queued or prepared but not yet finalised,
+     * cancelled requests aren't counted */
+    std::size_t pending_count() const;
+
+    std::size_t thread_count() const {
+        return threads_.size();
+    }
+
+private:
+    void worker_main();
+    void prepare(AsyncLoadRequestPtr request);
+
+    static bool runs_after(const AsyncLoadRequestPtr& lhs, const AsyncLoadRequestPtr& rhs);
+    void push(std::vector<AsyncLoadRequestPtr>& heap, AsyncLoadRequestPtr request);
+    AsyncLoadRequestPtr pop(std::vector<AsyncLoadRequestPtr>& heap);
+
+    mutable thread::Mutex lock_;
+    thread::Condition work_available_;
+
+    std::vector<AsyncLoadRequestPtr> queued_;
+    std::vector<AsyncLoadRequestPtr> prepared_;
+    uint64_t next_sequence_ = 0;
+    bool stopping_ = false;
+
+    std::vector<thread::Thread*> threads_;
+};
+
+}
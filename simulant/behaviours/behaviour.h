@@ -191,6 +191,16 @@ public:
         }
     }
 
+    bool behaviours_are_update_thread_safe() const {
+        for(auto& behaviour: behaviours_) {
+            if(!behaviour->is_update_thread_safe()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
 private:
     template<typename T>
     void add_behaviour(std::shared_ptr<T> behaviour) {
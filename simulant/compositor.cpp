@@ -18,6 +18,7 @@
 //
 
 #include <unordered_map>
+#include <algorithm>
 
 #include "generic/algorithm.h"
 #include "compositor.h"
@@ -29,6 +30,8 @@
 #include "window.h"
 #include "partitioner.h"
 #include "loader.h"
+#include "jobs/parallel.h"
+#include "time_keeper.h"
 
 namespace smlt {
 
@@ -90,6 +93,7 @@ void Compositor::destroy_pipeline_immediately(const std::string& name) {
 
     queued_for_destruction_.erase(pip);
     ordered_pipelines_.remove(pip);
+    render_queues_.erase(pip);
 
     pool_.remove_if([name](const Pipeline::ptr& pip) -> bool {
         return pip->name() == name;
@@ -100,6 +104,7 @@ void Compositor::clean_up() {
     for(auto pip: queued_for_destruction_) {
         pip->deactivate();
         ordered_pipelines_.remove(pip);
+        render_queues_.erase(pip);
 
         auto name = pip->name();
         pool_.remove_if([name](const Pipeline::ptr& pip) -> bool {
@@ -157,6 +162,9 @@ PipelinePtr Compositor::new_pipeline(
 
 void Compositor::set_renderer(Renderer* renderer) {
     renderer_ = renderer;
+
+    /* Retained render groups were prepared by the old renderer */
+    render_queues_.clear();
 }
 
 void Compositor::run() {
@@ -168,19 +176,163 @@ void Compositor::run() {
     renderer_->pre_render();
 
     int actors_rendered = 0;
+    state_changes_ = draws_saved_ = nodes_occluded_ = 0;
+    cull_time_us_ = gather_time_us_ = traversal_time_us_ = 0;
+    poses_evaluated_ = poses_reused_ = 0;
+
+    /* Pipelines rendering the same animated node this frame share its pose */
+    ++pose_frame_id_;
+
     for(auto& pipeline: ordered_pipelines_) {
         run_pipeline(pipeline, actors_rendered);
     }
 
     window->stats->set_subactors_rendered(actors_rendered);
+    window->stats->set_state_changes(state_changes_);
+    window->stats->set_draws_saved_by_batching(draws_saved_);
+    window->stats->set_nodes_occluded(nodes_occluded_);
+    window->stats->set_render_phase_times(cull_time_us_, gather_time_us_, traversal_time_us_);
+    window->stats->set_pose_counts(poses_evaluated_, poses_reused_);
 }
 
 
+void Compositor::set_parallel_gather_enabled(bool value) {
+    parallel_gather_enabled_ = value;
+
+    if(!value) {
+        gather_queues_.clear();
+    }
+}
+
 uint64_t generate_frame_id() {
     static uint64_t frame_id = 0;
     return ++frame_id;
 }
 
+DetailLevel Compositor::detail_level_for_node(StageNode* node, PipelinePtr pipeline, CameraPtr camera) {
+    float distance_to_camera = camera->absolute_position().distance_to(node->transformed_aabb());
+
+    /* Find the ideal detail level at this distance from the camera */
+    return pipeline->detail_level_at_distance(distance_to_camera);
+}
+
+void Compositor::set_node_lights(
+    StageNode* node, const std::vector<LightPtr>& lights_visible,
+    jobs::FrameAllocator* scratch, batcher::RenderQueue* render_queue) {
+
+    /* This runs for every visible node, so avoid a heap allocation each
+     * time. The queue copies the lights it needs, so the candidates only
+     * have to live until the end of the frame */
+    std::vector<LightPtr> fallback;
+    LightPtr* renderable_lights = nullptr;
+    if(scratch) {
+        renderable_lights = scratch->allocate_array<LightPtr>(lights_visible.size());
+    } else {
+        fallback.resize(lights_visible.size());
+        renderable_lights = fallback.data();
+    }
+
+    uint32_t candidate_count = 0;
+    for(auto& light: lights_visible) {
+        // Filter by whether or not the renderable bounds intersects the light bounds
+        bool affects_node = false;
+        if(light->type() == LIGHT_TYPE_DIRECTIONAL) {
+            affects_node = true;
+        } else if(light->type() == LIGHT_TYPE_SPOT_LIGHT) {
+            affects_node = node->transformed_aabb().intersects_aabb(light->transformed_aabb());
+        } else {
+            affects_node = node->transformed_aabb().intersects_sphere(light->absolute_position(), light->range() * 2);
+        }
+
+        if(affects_node) {
+            renderable_lights[candidate_count++] = light;
+        }
+    }
+
+    auto light_count = std::min(MAX_LIGHTS_PER_RENDERABLE, candidate_count);
+
+    std::partial_sort(
+        renderable_lights,
+        renderable_lights + light_count,
+        renderable_lights + candidate_count,
+        [=](LightPtr lhs, LightPtr rhs) {
+            /* FIXME: Sorting by the centre point is problematic. A renderable is made up
+             * of many polygons, by choosing the light closest to the center you may find that
+             * that polygons far away from the center aren't affected by lights when they should be.
+             * This needs more thought, probably. */
+            if(lhs->type() == LIGHT_TYPE_DIRECTIONAL && rhs->type() != LIGHT_TYPE_DIRECTIONAL) {
+                return true;
+            } else if(rhs->type() == LIGHT_TYPE_DIRECTIONAL && lhs->type() != LIGHT_TYPE_DIRECTIONAL) {
+                return false;
+            }
+
+            float lhs_dist = (node->centre() - lhs->position()).length_squared();
+            float rhs_dist = (node->centre() - rhs->position()).length_squared();
+            return lhs_dist < rhs_dist;
+        }
+    );
+
+    render_queue->set_node_lights(renderable_lights, (uint8_t) light_count);
+}
+
+void Compositor::gather_renderables(
+    StageNode* node, PipelinePtr pipeline, CameraPtr camera,
+    const std::vector<LightPtr>& lights_visible, jobs::FrameAllocator* scratch,
+    batcher::RenderQueue* render_queue) {
+
+    assert(node);
+
+    if(!node->is_visible()) {
+        return;
+    }
+
+    auto level = detail_level_for_node(node, pipeline, camera);
+
+    /* Push any renderables for this node, unless the ones from the last
+     * frame are still valid */
+    if(!render_queue->begin_node(node, node->renderables_version(), level)) {
+        node->_get_renderables(render_queue, camera, level);
+    }
+
+    set_node_lights(node, lights_visible, scratch, render_queue);
+    render_queue->end_node();
+}
+
+uint32_t Compositor::cull_occluded_nodes(CameraPtr camera, std::vector<StageNode*>& nodes) {
+    occlusion_buffer_.begin(camera->projection_matrix() * camera->view_matrix());
+
+    /* Only occluders which passed frustum culling can hide anything */
+    bool found_occluder = false;
+    for(auto node: nodes) {
+        if(node->is_occluder() && node->is_visible()) {
+            occlusion_buffer_.rasterize(node->occluder_transformation(), *node->occluder_geometry());
+            found_occluder = true;
+        }
+    }
+
+    if(!found_occluder) {
+        return 0;
+    }
+
+    occlusion_buffer_.finish();
+
+    /* Occluders are skipped, they'd always pass as they're drawn into the
+     * buffer themselves */
+    auto count = nodes.size();
+    nodes.erase(
+        std::remove_if(nodes.begin(), nodes.end(), [this](StageNode* node) -> bool {
+            if(node->is_occluder() || !node->is_cullable()) {
+                return false;
+            }
+
+            return !occlusion_buffer_.is_visible(node->transformed_aabb());
+        }),
+        nodes.end()
+    );
+
+    return count - nodes.size();
+}
+
 void Compositor::run_pipeline(PipelinePtr pipeline_stage, int &actors_rendered) {
     /*
      * This is where rendering actually happens.
@@ -213,8 +365,11 @@ void Compositor::run_pipeline(PipelinePtr pipeline_stage, int &actors_rendered)
      *  time we hit a render target when processing the pipelines. We keep track of the targets that have been rendered each frame
      *  and this list is cleared at the start of run().
      */
+    /* Headless renderers have no context to clear */
+    bool headless = renderer_->is_headless();
+
     if(targets_rendered_this_frame_.find(&target) == targets_rendered_this_frame_.end()) {
-        if(target.clear_every_frame_flags()) {
+        if(target.clear_every_frame_flags() && !headless) {
             Viewport view(smlt::VIEWPORT_TYPE_FULL, target.clear_every_frame_colour());
             view.clear(target, target.clear_every_frame_flags());
         }
@@ -225,7 +380,9 @@ void Compositor::run_pipeline(PipelinePtr pipeline_stage, int &actors_rendered)
     auto& viewport = pipeline_stage->viewport;
 
     uint32_t clear = pipeline_stage->clear_flags();
-    if(clear) {
+    if(headless) {
+        /* Nothing to clear or apply */
+    } else if(clear) {
         viewport->clear(target, clear); //Implicitly calls apply
     } else {
         viewport->apply(target); //FIXME apply shouldn't exist, it ties Viewport to OpenGL...
@@ -236,6 +393,10 @@ void Compositor::run_pipeline(PipelinePtr pipeline_stage, int &actors_rendered)
     // Trigger a signal to indicate the stage is about to be rendered
     stage->signal_stage_pre_render()(camera->id(), viewport);
 
+    // Recalculate anything that moved this frame, this updates the bounds
+    // of the nodes in the partitioner
+    stage->transforms->resolve_all();
+
     // Apply any outstanding writes to the partitioner
     stage->partitioner->_apply_writes();
 
@@ -246,106 +407,150 @@ void Compositor::run_pipeline(PipelinePtr pipeline_stage, int &actors_rendered)
     light_ids.resize(0);
     nodes_visible.resize(0);
 
+    auto phase_start = TimeKeeper::now_in_us();
+
     // Gather the lights and geometry visible to the camera
     stage->partitioner->lights_and_geometry_visible_from(camera->id(), light_ids, nodes_visible);
 
-    // Get the actual lights from the IDs
-    auto lights_visible = map<decltype(light_ids), std::vector<LightPtr>>(
-        light_ids, [&](const LightID& light_id) -> LightPtr { return stage->light(light_id); }
-    );
-
-    // Reset it, ready for this pipeline
-    render_queue_.reset(stage, window->renderer.get(), camera);
+    if(pipeline_stage->is_occlusion_culling_enabled()) {
+        nodes_occluded_ += cull_occluded_nodes(camera, nodes_visible);
+    }
 
-    // Mark the visible objects as visible
-    for(auto& node: nodes_visible) {
-        assert(node);
+    auto now = TimeKeeper::now_in_us();
+    cull_time_us_ += now - phase_start;
+    phase_start = now;
 
+    /* Bring animated nodes up to date before gathering, so only the nodes
+     * that survived culling pay for it and gathering (which may run on
+     * several threads) only ever reads the result */
+    for(auto node: nodes_visible) {
         if(!node->is_visible()) {
             continue;
         }
 
-        auto renderable_lights = filter(lights_visible, [&node](const LightPtr& light) -> bool {
-            // Filter by whether or not the renderable bounds intersects the light bounds
-            if(light->type() == LIGHT_TYPE_DIRECTIONAL) {
-                return true;
-            } else if(light->type() == LIGHT_TYPE_SPOT_LIGHT) {
-                return node->transformed_aabb().intersects_aabb(light->transformed_aabb());
-            } else {
-                return node->transformed_aabb().intersects_sphere(light->absolute_position(), light->range() * 2);
-            }
-        });
+        switch(node->evaluate_pose(pose_frame_id_)) {
+            case POSE_EVALUATION_EVALUATED:
+                ++poses_evaluated_;
+            break;
+            case POSE_EVALUATION_REUSED:
+                ++poses_reused_;
+            break;
+            default:
+            break;
+        }
+    }
 
-        std::partial_sort(
-            renderable_lights.begin(),
-            renderable_lights.begin() + std::min(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) renderable_lights.size()),
-            renderable_lights.end(),
-            [=](LightPtr lhs, LightPtr rhs) {
-                /* FIXME: Sorting by the centre point is problematic. A renderable is made up
-                 * of many polygons, by choosing the light closest to the center you may find that
-                 * that polygons far away from the center aren't affected by lights when they should be.
-                 * This needs more thought, probably. */
-                if(lhs->type() == LIGHT_TYPE_DIRECTIONAL && rhs->type() != LIGHT_TYPE_DIRECTIONAL) {
-                    return true;
-                } else if(rhs->type() == LIGHT_TYPE_DIRECTIONAL && lhs->type() != LIGHT_TYPE_DIRECTIONAL) {
-                    return false;
-                }
-
-                float lhs_dist = (node->centre() - lhs->position()).length_squared();
-                float rhs_dist = (node->centre() - rhs->position()).length_squared();
-                return lhs_dist < rhs_dist;
-            }
-        );
+    // Get the actual lights from the IDs
+    auto lights_visible = map<decltype(light_ids), std::vector<LightPtr>>(
+        light_ids, [&](const LightID& light_id) -> LightPtr { return stage->light(light_id); }
+    );
 
-        float distance_to_camera = camera->absolute_position().distance_to(node->transformed_aabb());
+    auto& render_queue = render_queues_[pipeline_stage];
+    if(!render_queue) {
+        render_queue.reset(new batcher::RenderQueue());
+    }
 
-        /* Find the ideal detail level at this distance from the camera */
-        auto level = pipeline_stage->detail_level_at_distance(distance_to_camera);
+    // Reset it, ready for this pipeline
+    render_queue->reset(stage, window->renderer.get(), camera);
+    render_queue->set_dynamic_batching_threshold(dynamic_batching_threshold_);
+
+    /* There's no scheduler before the window is initialised, or once it's
+     * been cleaned up */
+    auto jobs = window->jobs.get();
+    auto gather_chunk_count = (parallel_gather_enabled_ && jobs && jobs->worker_count()) ?
+        std::min(
+            jobs->thread_count() * jobs::PARALLEL_CHUNKS_PER_THREAD,
+            nodes_visible.size() / PARALLEL_GATHER_MIN_NODES_PER_CHUNK
+        ) : 0;
+
+    /* The compositor runs on the thread which owns the scheduler */
+    auto scratch = (jobs) ? &jobs->frame_allocator() : nullptr;
+
+    if(gather_chunk_count > 1) {
+        while(gather_queues_.size() < gather_chunk_count) {
+            gather_queues_.push_back(std::unique_ptr<batcher::RenderQueue>(new batcher::RenderQueue()));
+            gather_queues_.back()->set_sorting_enabled(false);
+        }
 
-        /* Push any renderables for this node */
-        auto initial = render_queue_.renderable_count();
-        node->_get_renderables(&render_queue_, camera, level);
+        /* Bounds and transformations are lazily recalculated (and may fire
+         * signals) so make sure that happens here, not on the workers */
+        camera->absolute_transformation();
+        for(auto& light: lights_visible) {
+            light->transformed_aabb();
+            light->absolute_transformation();
+        }
 
-        // FIXME: Change _get_renderables to return the number inserted
-        auto count = render_queue_.renderable_count() - initial;
+        /* Nodes which haven't changed are reused here, the rest are
+         * begun (so they keep their place in the queue) and gathered on
+         * the workers */
+        nodes_to_gather_.clear();
 
-        for(auto i = initial; i < initial + count; ++i) {
-            auto renderable = render_queue_.renderable(i);
+        for(auto& node: nodes_visible) {
+            node->transformed_aabb();
+            node->absolute_transformation();
 
-            assert(
-                renderable->arrangement == MESH_ARRANGEMENT_LINES ||
-                renderable->arrangement == MESH_ARRANGEMENT_LINE_STRIP ||
-                renderable->arrangement == MESH_ARRANGEMENT_QUADS ||
-                renderable->arrangement == MESH_ARRANGEMENT_TRIANGLES ||
-                renderable->arrangement == MESH_ARRANGEMENT_TRIANGLE_FAN ||
-                renderable->arrangement == MESH_ARRANGEMENT_TRIANGLE_STRIP
-            );
+            if(!node->is_visible()) {
+                continue;
+            }
 
-            assert(renderable->material);
-            assert(renderable->index_data);
-            assert(renderable->vertex_data);
+            auto level = detail_level_for_node(node, pipeline_stage, camera);
+            if(render_queue->begin_node(node, node->renderables_version(), level)) {
+                set_node_lights(node, lights_visible, scratch, render_queue.get());
+            } else {
+                nodes_to_gather_.push_back(node);
+            }
 
-            renderable->light_count = renderable_lights.size();
-            for(auto i = 0u; i < renderable->light_count; ++i) {
-                renderable->lights_affecting_this_frame[i] = renderable_lights[i];
+            render_queue->end_node();
+        }
+
+        auto node_count = nodes_to_gather_.size();
+        jobs::parallel_for(*jobs, 0, gather_chunk_count, 1, [&](std::size_t chunk) {
+            auto queue = gather_queues_[chunk].get();
+            queue->reset(stage, window->renderer.get(), camera);
+
+            auto begin = (node_count * chunk) / gather_chunk_count;
+            auto end = (node_count * (chunk + 1)) / gather_chunk_count;
+            for(auto i = begin; i < end; ++i) {
+                gather_renderables(
+                    nodes_to_gather_[i], pipeline_stage, camera, lights_visible,
+                    &jobs->frame_allocator(), queue
+                );
             }
+        });
+
+        /* Every node was begun above in culling order, merging only fills
+         * in their batches. So the queue holds the same batches in the same
+         * order as the serial path, and sorts and traverses the same way */
+        for(std::size_t i = 0; i < gather_chunk_count; ++i) {
+            render_queue->merge(*gather_queues_[i]);
+        }
+    } else {
+        for(auto& node: nodes_visible) {
+            gather_renderables(node, pipeline_stage, camera, lights_visible, scratch, render_queue.get());
         }
     }
 
-    actors_rendered += render_queue_.renderable_count();
+    actors_rendered += render_queue->renderable_count();
+
+    now = TimeKeeper::now_in_us();
+    gather_time_us_ += now - phase_start;
+    phase_start = now;
 
     using namespace std::placeholders;
 
     auto visitor = renderer_->get_render_queue_visitor(camera);
 
     // Render the visible objects
-    render_queue_.traverse(visitor.get(), frame_id);
+    render_queue->traverse(visitor.get(), frame_id);
+    state_changes_ += render_queue->state_change_count();
+    draws_saved_ += render_queue->draws_saved_count();
+
+    traversal_time_us_ += TimeKeeper::now_in_us() - phase_start;
 
     // Trigger a signal to indicate the stage has been rendered
     stage->signal_stage_post_render()(camera->id(), viewport);
 
     signal_pipeline_finished_(*pipeline_stage);
-    render_queue_.clear();
 }
 
 }
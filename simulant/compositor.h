@@ -22,11 +22,14 @@
 #include <vector>
 #include <memory>
 #include <list>
+#include <unordered_map>
 
 #include "generic/managed.h"
 #include "generic/property.h"
 
 #include "renderers/renderer.h"
+#include "renderers/batching/dynamic_batcher.h"
+#include "renderers/occlusion_buffer.h"
 #include "types.h"
 #include "viewport.h"
 #include "partitioner.h"
@@ -34,6 +37,14 @@
 
 namespace smlt {
 
+namespace jobs {
+    class FrameAllocator;
+}
+
+/* Pipelines with fewer visible nodes than this (per worker thread) are
+ * always gathered on the main thread */
+const static std::size_t PARALLEL_GATHER_MIN_NODES_PER_CHUNK = 32;
+
 struct RenderOptions {
     bool wireframe_enabled;
     bool texture_enabled;
@@ -85,6 +96,23 @@ public:
     void run();
     void clean_up();
 
+    /* When enabled, the renderables of the nodes visible to a pipeline are
+     * gathered across worker threads and then merged into the render queue.
+     * The resulting queue is identical to the one built on the main thread.
+     *
+     * _get_renderables() implementations must only write to the node
+     * they are called on if this is enabled. */
+    void set_parallel_gather_enabled(bool value);
+    bool is_parallel_gather_enabled() const { return parallel_gather_enabled_; }
+
+    /* Small renderables (up to max_vertices each) which share a material
+     * pass, vertex format and lights are merged into a single draw, with their
+     * vertices pre-transformed on the CPU. Zero (the default) disables dynamic
+     * batching, batcher::DYNAMIC_BATCH_DEFAULT_VERTEX_THRESHOLD is a good
+     * starting point when enabling it. */
+    void set_dynamic_batching_threshold(uint32_t max_vertices) { dynamic_batching_threshold_ = max_vertices; }
+    uint32_t dynamic_batching_threshold() const { return dynamic_batching_threshold_; }
+
     sig::signal<void (Pipeline&)>& signal_pipeline_started() { return signal_pipeline_started_; }
     sig::signal<void (Pipeline&)>& signal_pipeline_finished() { return signal_pipeline_finished_; }
 
@@ -102,10 +130,51 @@ public:
 private:
     void sort_pipelines();
     void run_pipeline(PipelinePtr stage, int& actors_rendered);
+    void gather_renderables(
+        StageNode* node, PipelinePtr pipeline, CameraPtr camera,
+        const std::vector<LightPtr>& lights_visible, jobs::FrameAllocator* scratch,
+        batcher::RenderQueue* render_queue
+    );
+
+    /* Removes the nodes which are hidden behind occluders, returning how
+     * many were removed */
+    uint32_t cull_occluded_nodes(CameraPtr camera, std::vector<StageNode*>& nodes);
+
+    DetailLevel detail_level_for_node(StageNode* node, PipelinePtr pipeline, CameraPtr camera);
+
+    /* Picks the closest lights to the node. The candidate lights are kept
+     * in scratch, which should be the calling thread's frame allocator,
+     * or null if there's no job scheduler */
+    void set_node_lights(
+        StageNode* node, const std::vector<LightPtr>& lights_visible,
+        jobs::FrameAllocator* scratch, batcher::RenderQueue* render_queue
+    );
 
     Window* window_ = nullptr;
     Renderer* renderer_ = nullptr;
-    batcher::RenderQueue render_queue_;
+
+    /* Render queues are retained between frames, so each pipeline has its
+     * own to avoid pipelines throwing away each other's renderables */
+    std::unordered_map<Pipeline*, std::unique_ptr<batcher::RenderQueue>> render_queues_;
+    uint32_t state_changes_ = 0;
+    uint32_t draws_saved_ = 0;
+    uint32_t nodes_occluded_ = 0;
+
+    /* Shared by every pipeline, they're run one at a time */
+    OcclusionBuffer occlusion_buffer_;
+
+    uint64_t cull_time_us_ = 0;
+    uint64_t gather_time_us_ = 0;
+    uint64_t traversal_time_us_ = 0;
+
+    uint64_t pose_frame_id_ = 0;
+    uint32_t poses_evaluated_ = 0;
+    uint32_t poses_reused_ = 0;
+
+    bool parallel_gather_enabled_ = false;
+    uint32_t dynamic_batching_threshold_ = 0;
+    std::vector<std::unique_ptr<batcher::RenderQueue>> gather_queues_;
+    std::vector<StageNode*> nodes_to_gather_;
 
     std::list<std::shared_ptr<Pipeline>> pool_;
     std::list<PipelinePtr> ordered_pipelines_;
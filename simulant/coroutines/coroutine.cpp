@@ -1,24 +1,199 @@
 #include <unordered_map>
 #include <utility>
+#include <vector>
 #include "coroutine.h"
+#include "../errors.h"
 #include "../threads/thread.h"
 #include "../threads/mutex.h"
 #include "../threads/condition.h"
 
+#ifdef SIMULANT_COROUTINE_UCONTEXT
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace smlt {
 namespace cort {
 
+#ifdef SIMULANT_COROUTINE_UCONTEXT
+
+/* Coroutines are switched in user-space on the thread that resumes
+ * them. Each one gets its own mmap'd stack with a PROT_NONE guard page
+ * at the bottom so that an overflow faults rather than scribbling over
+ * a neighbouring stack. Stacks are returned to a pool when a coroutine
+ * is stopped so that short-lived coroutines don't hit mmap every time */
+
+const static std::size_t COROUTINE_STACK_SIZE = 512 * 1024;
+const static std::size_t MAX_POOLED_STACKS = 128;
+
+struct Stack {
+    uint8_t* base = nullptr;
+    std::size_t size = 0;
+};
+
+static std::vector<Stack> STACK_POOL;
+
+static std::size_t page_size() {
+    static std::size_t size = (std::size_t) sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+static Stack allocate_stack() {
+    if(!STACK_POOL.empty()) {
+        Stack ret = STACK_POOL.back();
+        STACK_POOL.pop_back();
+        return ret;
+    }
+
+    Stack stack;
+    stack.size = COROUTINE_STACK_SIZE + page_size();
+
+    void* mem = mmap(
+        nullptr, stack.size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1, 0
+    );
+
+    if(mem == MAP_FAILED) {
+        FATAL_ERROR(ERROR_CODE_COROUTINE_STACK_ALLOCATION_FAILED, "Unable to allocate coroutine stack");
+    }
+
+    /* Stacks grow downwards, so the guard page is the lowest one */
+    if(mprotect(mem, page_size(), PROT_NONE) != 0) {
+        FATAL_ERROR(ERROR_CODE_COROUTINE_STACK_ALLOCATION_FAILED, "Unable to protect coroutine stack guard page");
+    }
+
+    stack.base = (uint8_t*) mem;
+    return stack;
+}
+
+static void release_stack(Stack stack) {
+    if(!stack.base) {
+        return;
+    }
+
+    if(STACK_POOL.size() < MAX_POOLED_STACKS) {
+        STACK_POOL.push_back(stack);
+    } else {
+        munmap(stack.base, stack.size);
+    }
+}
+
+/* Thrown from yield_coroutine() to unwind the stack of a coroutine
+ * that is being stopped before it finished */
+struct CoroutineTerminated {};
+
+static void run_coroutine();
+
+#if defined(__x86_64__)
+
+/* swapcontext saves and restores the signal mask with a syscall on every
+ * switch, which dominates the cost of a yield. On x86-64 we only need to
+ * preserve the callee-saved registers and the FPU/SSE control words, so
+ * we switch stacks directly. */
+
+struct MachineContext {
+    void* sp = nullptr;
+};
+
+extern "C" void simulant_coroutine_switch(void** from_sp, void* to_sp);
+
+asm(
+    ".text\n"
+    ".globl simulant_coroutine_switch\n"
+    ".type simulant_coroutine_switch,@function\n"
+    "simulant_coroutine_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size simulant_coroutine_switch,.-simulant_coroutine_switch\n"
+);
+
+static void init_machine_context(MachineContext* ctx, const Stack& stack) {
+    uintptr_t top = (uintptr_t) (stack.base + stack.size);
+    top &= ~uintptr_t(15);
+
+    /* Build the frame that simulant_coroutine_switch expects to pop. The
+     * null slot at the top is a fake return address for run_coroutine,
+     * which leaves the stack correctly aligned on entry. */
+    uint64_t* frame = (uint64_t*) top;
+    *(--frame) = 0;
+    *(--frame) = (uint64_t) (uintptr_t) &run_coroutine;
+    for(int i = 0; i < 6; ++i) {
+        *(--frame) = 0; /* rbp, rbx, r12-r15 */
+    }
+
+    /* Default MXCSR and x87 control word */
+    *(--frame) = (uint64_t(0x037F) << 32) | uint64_t(0x1F80);
+
+    ctx->sp = frame;
+}
+
+static void switch_context(MachineContext* from, MachineContext* to) {
+    simulant_coroutine_switch(&from->sp, to->sp);
+}
+
+#else
+
+struct MachineContext {
+    ucontext_t uc;
+};
+
+static void init_machine_context(MachineContext* ctx, const Stack& stack) {
+    getcontext(&ctx->uc);
+    ctx->uc.uc_stack.ss_sp = stack.base + page_size();
+    ctx->uc.uc_stack.ss_size = COROUTINE_STACK_SIZE;
+    ctx->uc.uc_link = nullptr;
+    makecontext(&ctx->uc, &run_coroutine, 0);
+}
+
+static void switch_context(MachineContext* from, MachineContext* to) {
+    swapcontext(&from->uc, &to->uc);
+}
+
+#endif
+
+#endif
+
 struct Context {
     CoroutineID id;
     bool is_running = false;
     bool is_started = false;
     bool is_finished = false;
     bool is_terminating = false;
-    thread::Thread* thread = nullptr;
+    bool termination_thrown = false;
     std::function<void ()> func;
 
+#ifdef SIMULANT_COROUTINE_UCONTEXT
+    Stack stack;
+    MachineContext context;
+    MachineContext caller;
+#else
+    thread::Thread* thread = nullptr;
+
     thread::Mutex mutex;
     thread::Condition cond;
+#endif
 
     Context* next = nullptr;
     Context* prev = nullptr;
@@ -27,6 +202,10 @@ struct Context {
 static Context* CONTEXTS = nullptr;
 static CoroutineID ID_COUNTER = 0;
 
+/* Window::update_coroutines resumes every coroutine each frame, so
+ * finding one by id mustn't walk the list */
+static std::unordered_map<CoroutineID, Context*> CONTEXT_LOOKUP;
+
 #if defined(__PSP__) || defined(__DREAMCAST__)
 
 static thread::Mutex CURRENT_CONTEXT_MUTEX;
@@ -79,19 +258,98 @@ CoroutineID start_coroutine(std::function<void ()> f) {
         CONTEXTS->func = f;
     }
 
+    CONTEXT_LOOKUP[CONTEXTS->id] = CONTEXTS;
+
     return CONTEXTS->id;
 }
 
 static Context* find_coroutine(CoroutineID id) {
-    for(auto c = CONTEXTS; c; c = c->next) {
-        if(c->id == id) {
-            return c;
-        }
+    auto it = CONTEXT_LOOKUP.find(id);
+    return (it == CONTEXT_LOOKUP.end()) ? nullptr : it->second;
+}
+
+#ifdef SIMULANT_COROUTINE_UCONTEXT
+
+/* Entry point of every coroutine stack. This never returns, once the
+ * function has finished we switch back to the caller for good */
+static void run_coroutine() {
+    Context* context = current_context();
+
+    try {
+        context->func();
+    } catch(CoroutineTerminated&) {
+        /* stop_coroutine was called, the stack has now unwound */
+    }
+
+    context->is_running = false;
+    context->is_finished = true;
+
+    switch_context(&context->context, &context->caller);
+}
+
+COResult resume_coroutine(CoroutineID id) {
+    assert(!current_context());
+
+    auto routine = find_coroutine(id);
+
+    if(!routine) {
+        return CO_RESULT_INVALID;
+    }
+
+    /* We've finished, do nothing */
+    if(routine->is_finished) {
+        return CO_RESULT_FINISHED;
+    }
+
+    auto& context = *routine;
+    if(!context.is_started) {
+        context.stack = allocate_stack();
+        init_machine_context(&context.context, context.stack);
+        context.is_started = true;
+    }
+
+    context.is_running = true;
+    set_current_context(routine);
+
+    /* Run until the coroutine yields or returns */
+    switch_context(&context.caller, &context.context);
+
+    set_current_context(nullptr);
+
+    return CO_RESULT_RUNNING;
+}
+
+void yield_coroutine() {
+    if(!current_context()) {
+        /* Yield called from outside a coroutine
+         * just return */
+        return;
     }
 
-    return nullptr;
+    auto current = current_context();
+
+    current->is_running = false;
+    switch_context(&current->context, &current->caller);
+
+    if(current->is_terminating) {
+        if(current->termination_thrown) {
+            /* Something (e.g. a catch(...)) swallowed the exception and
+             * the coroutine carried on, stop_coroutine would never return */
+            FATAL_ERROR(
+                ERROR_CODE_COROUTINE_TERMINATION_SWALLOWED,
+                "A coroutine yielded after it was stopped. Exceptions caught with catch(...) in a coroutine must be rethrown"
+            );
+        }
+
+        /* This forces an incomplete coroutine to
+         * end if stop_coroutine has been called */
+        current->termination_thrown = true;
+        throw CoroutineTerminated();
+    }
 }
 
+#else
+
 static void run_coroutine(Context* context) {
     set_current_context(context);
 
@@ -163,6 +421,8 @@ void yield_coroutine() {
     }
 }
 
+#endif
+
 bool within_coroutine() {
     return bool(current_context());
 }
@@ -174,6 +434,21 @@ void stop_coroutine(CoroutineID id) {
 
     if(routine) {
         auto& context = *routine;
+
+#ifdef SIMULANT_COROUTINE_UCONTEXT
+        if(context.is_started) {
+            context.is_terminating = true;
+
+            /* Each resume throws from the pending yield, keep going
+             * until the coroutine has unwound completely */
+            while(!context.is_finished) {
+                resume_coroutine(id);
+            }
+
+            release_stack(context.stack);
+            context.stack = Stack();
+        }
+#else
         if(context.is_started) {
             context.mutex.lock();
             context.is_terminating = true;
@@ -188,6 +463,9 @@ void stop_coroutine(CoroutineID id) {
             delete context.thread;
             context.thread = nullptr;
         }
+#endif
+
+        CONTEXT_LOOKUP.erase(id);
 
         if(CONTEXTS == routine) {
             CONTEXTS = routine->next;
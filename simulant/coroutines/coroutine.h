@@ -5,6 +5,13 @@
 
 #include "../generic/optional.h"
 
+/* Coroutines are context-switched in user-space where ucontext is
+ * available, otherwise each coroutine is backed by its own thread.
+ * Define SIMULANT_COROUTINE_THREADS to force the thread backend. */
+#if !defined(SIMULANT_COROUTINE_THREADS) && defined(__linux__) && !defined(__ANDROID__)
+#define SIMULANT_COROUTINE_UCONTEXT 1
+#endif
+
 namespace smlt {
 namespace cort {
 
@@ -20,6 +27,11 @@ enum COResult {
 
 
 CoroutineID start_coroutine(std::function<void ()> func);
+
+/* Stopping a coroutine which hasn't finished unwinds its stack with an
+ * internal exception thrown from its pending yield. A coroutine which
+ * catches everything with catch(...) must rethrow, yielding again after
+ * it has been stopped is a fatal error. */
 void stop_coroutine(CoroutineID id);
 COResult resume_coroutine(CoroutineID id);
 void yield_coroutine();
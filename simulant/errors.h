@@ -23,7 +23,10 @@ enum ErrorCode {
     ERROR_CODE_THREAD_SPAWN_FAILED,
     ERROR_CODE_THREAD_JOIN_FAILED,
     ERROR_CODE_SDL_INIT_FAILED,
-    ERROR_CODE_INVALID_TYPE_ERROR
+    ERROR_CODE_INVALID_TYPE_ERROR,
+    ERROR_CODE_COROUTINE_STACK_ALLOCATION_FAILED,
+    ERROR_CODE_JOB_SCHEDULER_INVALID_THREAD,
+    ERROR_CODE_COROUTINE_TERMINATION_SWALLOWED
 };
 
 namespace _errors {
@@ -18,6 +18,16 @@
 //
 
 #include <cassert>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SIMULANT_FRUSTUM_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMULANT_FRUSTUM_NEON 1
+#endif
+
 #include "frustum.h"
 #include "types.h"
 #include "math/plane.h"
@@ -27,64 +37,188 @@ namespace smlt {
 Frustum::Frustum():
     initialized_(false) {
 
+    build_culling_planes();
 }
 
-bool Frustum::intersects_cube(const Vec3& centre, float size) const {
-    const float& x = centre.x;
-    const float& y = centre.y;
-    const float& z = centre.z;
+void Frustum::build_culling_planes() {
+    auto& cp = culling_planes_;
+
+    for(uint32_t i = 0; i < 8; ++i) {
+        if(i < planes_.size()) {
+            const Plane& p = planes_[i];
+            cp.nx[i] = p.n.x;
+            cp.ny[i] = p.n.y;
+            cp.nz[i] = p.n.z;
+            cp.d[i] = p.d;
+        } else {
+            /* Every box is in front of this plane */
+            cp.nx[i] = cp.ny[i] = cp.nz[i] = 0.0f;
+            cp.d[i] = 1.0f;
+        }
 
-    size *= 0.5f;
+        cp.ax[i] = std::abs(cp.nx[i]);
+        cp.ay[i] = std::abs(cp.ny[i]);
+        cp.az[i] = std::abs(cp.nz[i]);
+    }
+}
 
-    const float xplus = x + size;
-    const float xminus = x - size;
-    const float yplus = y + size;
-    const float yminus = y - size;
-    const float zplus = z + size;
-    const float zminus = z - size;
+#if defined(SIMULANT_FRUSTUM_SSE) || defined(SIMULANT_FRUSTUM_NEON)
+
+/* Tests a box against all 8 planes at once, returning a bitmask of the planes
+ * the box is entirely behind, and a bitmask of the planes it's entirely in
+ * front of */
+static inline void classify_all_planes(
+    const float* nx, const float* ny, const float* nz, const float* d,
+    const float* ax, const float* ay, const float* az,
+    const Vec3& c, const Vec3& e, uint32_t& outside, uint32_t& inside) {
+
+    outside = inside = 0;
+
+#ifdef SIMULANT_FRUSTUM_SSE
+    const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+    const __m128 zero = _mm_setzero_ps();
+
+    for(uint32_t g = 0; g < 8; g += 4) {
+        __m128 dist = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(nx + g), cx), _mm_mul_ps(_mm_loadu_ps(ny + g), cy)),
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(nz + g), cz), _mm_loadu_ps(d + g))
+        );
+
+        __m128 r = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ax + g), ex), _mm_mul_ps(_mm_loadu_ps(ay + g), ey)),
+            _mm_mul_ps(_mm_loadu_ps(az + g), ez)
+        );
+
+        /* p-vertex behind the plane, and n-vertex in front of it */
+        outside |= uint32_t(_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, r), zero))) << g;
+        inside |= uint32_t(_mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(dist, r), zero))) << g;
+    }
+#else
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const uint32_t bits_data[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vld1q_u32(bits_data);
+
+    auto movemask = [&bits](uint32x4_t v) -> uint32_t {
+        uint32x4_t m = vandq_u32(v, bits);
+        uint32x2_t s = vadd_u32(vget_low_u32(m), vget_high_u32(m));
+        return vget_lane_u32(vpadd_u32(s, s), 0);
+    };
+
+    for(uint32_t g = 0; g < 8; g += 4) {
+        float32x4_t dist = vld1q_f32(d + g);
+        dist = vmlaq_n_f32(dist, vld1q_f32(nx + g), c.x);
+        dist = vmlaq_n_f32(dist, vld1q_f32(ny + g), c.y);
+        dist = vmlaq_n_f32(dist, vld1q_f32(nz + g), c.z);
+
+        float32x4_t r = vmulq_n_f32(vld1q_f32(ax + g), e.x);
+        r = vmlaq_n_f32(r, vld1q_f32(ay + g), e.y);
+        r = vmlaq_n_f32(r, vld1q_f32(az + g), e.z);
+
+        outside |= movemask(vcltq_f32(vaddq_f32(dist, r), zero)) << g;
+        inside |= movemask(vcgeq_f32(vsubq_f32(dist, r), zero)) << g;
+    }
+#endif
+}
 
-    for(const Plane& plane: planes_) {
-        if(plane.n.x * xminus + plane.n.y * yminus + plane.n.z * zminus + plane.d > 0)
-          continue;
-        if(plane.n.x * xplus + plane.n.y * yminus + plane.n.z * zminus + plane.d > 0)
-          continue;
-        if(plane.n.x * xminus + plane.n.y * yplus + plane.n.z * zminus + plane.d > 0)
-          continue;
-        if(plane.n.x * xplus + plane.n.y * yplus + plane.n.z * zminus + plane.d > 0)
-          continue;
-        if(plane.n.x * xminus + plane.n.y * yminus + plane.n.z * zplus + plane.d > 0)
-          continue;
-        if(plane.n.x * xplus + plane.n.y * yminus + plane.n.z * zplus + plane.d > 0)
-          continue;
-        if(plane.n.x * xminus + plane.n.y * yplus + plane.n.z * zplus + plane.d > 0)
-          continue;
-        if(plane.n.x * xplus + plane.n.y * yplus + plane.n.z * zplus + plane.d > 0)
-          continue;
-        return false;
+#endif
+
+FrustumClassification Frustum::classify_aabb(const Vec3& centre, const Vec3& half_extents, uint8_t* plane_mask, uint8_t* last_failed_plane) const {
+    const auto& cp = culling_planes_;
+
+    uint8_t mask = (plane_mask) ? *plane_mask : FRUSTUM_PLANE_MASK_ALL;
+    if(!mask) {
+        /* Already known to be inside every plane */
+        return FRUSTUM_CONTAINS_ALL;
     }
 
-    return true;
-}
+    /* Coherent case: whatever rejected the box last time probably still does */
+    if(last_failed_plane && *last_failed_plane < FRUSTUM_PLANE_MAX && (mask & (1 << *last_failed_plane))) {
+        auto i = *last_failed_plane;
+        float dist = cp.nx[i] * centre.x + cp.ny[i] * centre.y + cp.nz[i] * centre.z + cp.d[i];
+        float r = cp.ax[i] * half_extents.x + cp.ay[i] * half_extents.y + cp.az[i] * half_extents.z;
 
-bool Frustum::intersects_aabb(const AABB& aabb) const {
-    for(const Plane& plane: planes_) {
-        auto points = aabb.corners();
+        if(dist + r < 0.0f) {
+            return FRUSTUM_CONTAINS_NONE;
+        }
+    }
+
+#if defined(SIMULANT_FRUSTUM_SSE) || defined(SIMULANT_FRUSTUM_NEON)
+    uint32_t outside, inside;
+    classify_all_planes(
+        cp.nx, cp.ny, cp.nz, cp.d, cp.ax, cp.ay, cp.az,
+        centre, half_extents, outside, inside
+    );
+
+    outside &= mask;
+    if(outside) {
+        if(last_failed_plane) {
+            uint8_t i = 0;
+            while(!(outside & (1 << i))) ++i;
+            *last_failed_plane = i;
+        }
+
+        return FRUSTUM_CONTAINS_NONE;
+    }
 
-        int32_t points_behind = 0;
-        for(Vec3& p: points) {
-            auto classification = plane.classify_point(p);
+    uint8_t straddling = mask & ~uint8_t(inside);
+#else
+    uint8_t straddling = mask;
 
-            if(classification == PLANE_CLASSIFICATION_IS_BEHIND_PLANE) {
-                points_behind++;
+    for(uint8_t i = 0; i < FRUSTUM_PLANE_MAX; ++i) {
+        if(!(mask & (1 << i))) {
+            continue;
+        }
+
+        float dist = cp.nx[i] * centre.x + cp.ny[i] * centre.y + cp.nz[i] * centre.z + cp.d[i];
+        float r = cp.ax[i] * half_extents.x + cp.ay[i] * half_extents.y + cp.az[i] * half_extents.z;
+
+        if(dist + r < 0.0f) {
+            if(last_failed_plane) {
+                *last_failed_plane = i;
             }
+
+            return FRUSTUM_CONTAINS_NONE;
         }
 
-        if(points_behind == 8) {
-            return false;
+        if(dist - r >= 0.0f) {
+            straddling &= ~(1 << i);
         }
     }
+#endif
 
-    return true;
+    if(plane_mask) {
+        *plane_mask = straddling;
+    }
+
+    return (straddling) ? FRUSTUM_CONTAINS_PARTIAL : FRUSTUM_CONTAINS_ALL;
+}
+
+std::size_t Frustum::cull_aabbs(const Vec3* centres, const Vec3* half_extents, std::size_t count, uint8_t* visible, uint8_t* last_failed_planes) const {
+    std::size_t visible_count = 0;
+
+    for(std::size_t i = 0; i < count; ++i) {
+        auto result = classify_aabb(
+            centres[i], half_extents[i], nullptr,
+            (last_failed_planes) ? &last_failed_planes[i] : nullptr
+        );
+
+        visible[i] = (result != FRUSTUM_CONTAINS_NONE);
+        visible_count += visible[i];
+    }
+
+    return visible_count;
+}
+
+bool Frustum::intersects_cube(const Vec3& centre, float size) const {
+    float half = size * 0.5f;
+    return classify_aabb(centre, Vec3(half, half, half)) != FRUSTUM_CONTAINS_NONE;
+}
+
+bool Frustum::intersects_aabb(const AABB& aabb) const {
+    return classify_aabb(
+        aabb.centre(), (aabb.max() - aabb.min()) * 0.5f
+    ) != FRUSTUM_CONTAINS_NONE;
 }
 
 Vec3 Frustum::direction() const {
@@ -182,6 +316,8 @@ void Frustum::build(const Mat4* modelview_projection) {
         planes_[FRUSTUM_PLANE_FAR]
     ).value();
 
+    build_culling_planes();
+
     initialized_ = true;
 }
 
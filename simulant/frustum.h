@@ -40,6 +40,12 @@ enum FrustumClassification {
     FRUSTUM_CONTAINS_ALL
 };
 
+/* One bit per FrustumPlane, used to skip planes when culling */
+const static uint8_t FRUSTUM_PLANE_MASK_ALL = (1 << FRUSTUM_PLANE_MAX) - 1;
+
+/* Value for a last_failed_plane cache entry which hasn't failed yet */
+const static uint8_t FRUSTUM_PLANE_NONE = FRUSTUM_PLANE_MAX;
+
 class Frustum {
 public:
     Frustum();
@@ -55,6 +61,29 @@ public:
     bool intersects_aabb(const AABB &box) const;
     bool intersects_cube(const Vec3& centre, float size) const;
 
+    /* Classifies a box (given as a centre and half-extents) against the planes
+     * set in plane_mask. On return plane_mask only contains the planes that the
+     * box straddles, so passing it on to boxes contained by this one (e.g.
+     * children in a tree) skips planes that they're known to be inside.
+     *
+     * last_failed_plane caches the plane which last rejected the box. It's
+     * tested first, which means boxes which stay outside the frustum across
+     * frames are usually rejected after a single plane test. Initialize it
+     * to FRUSTUM_PLANE_NONE. */
+    FrustumClassification classify_aabb(
+        const Vec3& centre, const Vec3& half_extents,
+        uint8_t* plane_mask=nullptr, uint8_t* last_failed_plane=nullptr
+    ) const;
+
+    /* Tests count boxes against the frustum, setting visible[i] to 1 if the box
+     * intersects it or 0 otherwise. last_failed_planes is optional, but should
+     * be kept between calls for the same objects. Returns the number of visible
+     * boxes. */
+    std::size_t cull_aabbs(
+        const Vec3* centres, const Vec3* half_extents, std::size_t count,
+        uint8_t* visible, uint8_t* last_failed_planes=nullptr
+    ) const;
+
     bool initialized() const { return initialized_; }
 
     float near_height() const {
@@ -115,6 +144,22 @@ private:
     std::vector<Vec3> near_corners_;
     std::vector<Vec3> far_corners_;
     std::vector<Plane> planes_;
+
+    /* The planes in SoA form for the culling kernels. Padded to 8 planes
+     * (two SIMD registers) with planes which contain everything */
+    struct CullingPlanes {
+        float nx[8];
+        float ny[8];
+        float nz[8];
+        float d[8];
+
+        /* Absolute normals, for projecting the half-extents */
+        float ax[8];
+        float ay[8];
+        float az[8];
+    } culling_planes_;
+
+    void build_culling_planes();
 };
 
 }
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace smlt {
+
+/*
+ * Stable LSD radix sort of values by a 64 bit unsigned key, one byte per
+ * pass. Histograms for every byte are built in a single read of the input
+ * and passes where every key has the same byte are skipped, so keys that
+ * only use a few bits (or have constant high bits) are cheap to sort.
+ *
+ * scratch is used as the second buffer and is resized as necessary, keeping
+ * it around between calls avoids reallocating each time.
+ */
+template<typename T, typename KeyFunc>
+void radix_sort(std::vector<T>& values, std::vector<T>& scratch, KeyFunc key) {
+    const std::size_t count = values.size();
+    if(count < 2) {
+        return;
+    }
+
+    uint32_t histograms[8][256];
+    std::memset(histograms, 0, sizeof(histograms));
+
+    for(auto& value: values) {
+        uint64_t k = key(value);
+        for(int b = 0; b < 8; ++b) {
+            histograms[b][(k >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    scratch.resize(count);
+
+    std::vector<T>* src = &values;
+    std::vector<T>* dst = &scratch;
+
+    for(int b = 0; b < 8; ++b) {
+        uint32_t* histogram = histograms[b];
+
+        /* If every key has the same byte here, this pass wouldn't
+         * change the order */
+        uint64_t first = (key((*src)[0]) >> (b * 8)) & 0xFF;
+        if(histogram[first] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for(int i = 0; i < 256; ++i) {
+            uint32_t c = histogram[i];
+            histogram[i] = offset;
+            offset += c;
+        }
+
+        for(auto& value: *src) {
+            auto byte = (key(value) >> (b * 8)) & 0xFF;
+            (*dst)[histogram[byte]++] = value;
+        }
+
+        std::swap(src, dst);
+    }
+
+    if(src != &values) {
+        values.swap(scratch);
+    }
+}
+
+}
@@ -0,0 +1,65 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Lesser General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "headless_window.h"
+#include "input/input_state.h"
+#include "sound_drivers/null_sound_driver.h"
+#include "renderers/renderer.h"
+
+namespace smlt {
+
+bool HeadlessWindow::_init_window() {
+    /* The width and height requested by create_window() are kept as-is
+     * so that viewports and cameras behave as they would on screen */
+    return true;
+}
+
+bool HeadlessWindow::_init_renderer(Renderer* renderer) {
+    if(!renderer->is_headless()) {
+        S_ERROR("The {0} renderer requires a GL context", renderer->name());
+        return false;
+    }
+
+    /* There's no context, but this is what enables rendering each frame */
+    set_has_context(true);
+    return true;
+}
+
+void HeadlessWindow::initialize_input_controller(InputState& controller) {
+    KeyboardDeviceInfo keyboard;
+    keyboard.id = 0;
+
+    MouseDeviceInfo mouse;
+    mouse.id = 0;
+    mouse.button_count = 3;
+    mouse.axis_count = 2;
+
+    controller._update_keyboard_devices({keyboard});
+    controller._update_mouse_devices({mouse});
+    controller._update_joystick_devices({});
+}
+
+std::shared_ptr<SoundDriver> HeadlessWindow::create_sound_driver(const std::string& from_config) {
+    _S_UNUSED(from_config);
+
+    S_DEBUG("Null sound driver activated");
+    return std::make_shared<NullSoundDriver>(this);
+}
+
+}
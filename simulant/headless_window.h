@@ -0,0 +1,60 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU Lesser General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU Lesser General Public License for more details.
+ *
+ *     You should have received a copy of the GNU Lesser General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "window.h"
+
+namespace smlt {
+
+/*
+ * A window with no display, no GL context and no input. Frames run
+ * exactly as they would otherwise (updates, partitioning, render queue
+ * building and traversal) but nothing is drawn. It's used whenever the
+ * null renderer is chosen, e.g. SIMULANT_RENDERER=null
+ */
+class HeadlessWindow : public Window {
+public:
+    static Window::ptr create(Application* app) {
+        return Window::create<HeadlessWindow>(app);
+    }
+
+    HeadlessWindow() = default;
+
+    void set_title(const std::string&) override {} // No-op
+    void cursor_position(int32_t& mouse_x, int32_t& mouse_y) override {
+        mouse_x = mouse_y = 0;
+    }
+
+    void show_cursor(bool) override {} // No-op
+    void lock_cursor(bool) override {} // No-op
+
+private:
+    bool _init_window() override;
+    bool _init_renderer(Renderer* renderer) override;
+
+    void destroy_window() override {}
+    void check_events() override {}
+    void swap_buffers() override {}
+
+    void initialize_input_controller(InputState& controller) override;
+
+    std::shared_ptr<SoundDriver> create_sound_driver(const std::string& from_config) override;
+};
+
+}
@@ -30,6 +30,13 @@ public:
         fixed_update(step);
     }
 
+    /* Return true if update() and fixed_update() only touch this object, so
+     * they can run on a worker thread alongside other objects' updates. See
+     * StageManager::set_parallel_update_enabled() for the full contract. */
+    virtual bool is_update_thread_safe() const {
+        return false;
+    }
+
 private:
     virtual void update(float dt) {
         _S_UNUSED(dt);
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <new>
+
+#include "frame_allocator.h"
+
+namespace smlt {
+namespace jobs {
+
+static uintptr_t align_up(uintptr_t value, std::size_t alignment) {
+    return (value + (alignment - 1)) & ~(alignment - 1);
+}
+
+FrameAllocator::FrameAllocator(std::size_t block_size):
+    block_size_(block_size) {
+
+}
+
+FrameAllocator::~FrameAllocator() {
+    for(auto& block: blocks_) {
+        ::operator delete(block.data);
+    }
+}
+
+void* FrameAllocator::allocate(std::size_t size, std::size_t alignment) {
+    alignment = std::max<std::size_t>(alignment, 1);
+
+    while(true) {
+        while(current_ < blocks_.size()) {
+            auto& block = blocks_[current_];
+            auto base = uintptr_t(block.data);
+            auto offset = align_up(base + offset_, alignment) - base;
+
+            if(offset + size <= block.size) {
+                offset_ = offset + size;
+                used_ += size;
+                return block.data + offset;
+            }
+
+            /* Move on to the next block, the rest of this one is wasted
+             * until the next reset */
+            ++current_;
+            offset_ = 0;
+        }
+
+        Block block;
+        block.size = std::max(block_size_, size + alignment);
+        block.data = (uint8_t*) ::operator new(block.size);
+        blocks_.push_back(block);
+    }
+}
+
+void FrameAllocator::reset() {
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+std::size_t FrameAllocator::capacity() const {
+    std::size_t total = 0;
+    for(auto& block: blocks_) {
+        total += block.size;
+    }
+    return total;
+}
+
+}
+}
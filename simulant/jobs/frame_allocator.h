@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace smlt {
+namespace jobs {
+
+const static std::size_t DEFAULT_FRAME_ALLOCATOR_BLOCK_SIZE = 64 * 1024;
+
+/*
+ * A linear allocator for scratch memory which only needs to live until the
+ * end of the frame. Allocating is a pointer bump, nothing is freed
+ * individually; reset() makes all of the memory available again without
+ * releasing it, so after the first few frames no system allocations happen.
+ *
+ * Destructors are never run, so only trivially destructible types can be
+ * allocated with allocate_array().
+ *
+ * A FrameAllocator isn't thread safe, the JobScheduler keeps one for each of
+ * its threads.
+ */
+class FrameAllocator {
+public:
+    FrameAllocator(std::size_t block_size=DEFAULT_FRAME_ALLOCATOR_BLOCK_SIZE);
+    ~FrameAllocator();
+
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    void* allocate(std::size_t size, std::size_t alignment=alignof(std::max_align_t));
+
+    template<typename T>
+    T* allocate_array(std::size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "Frame allocated types are never destroyed");
+
+        auto ret = (T*) allocate(sizeof(T) * count, alignof(T));
+        for(std::size_t i = 0; i < count; ++i) {
+            new (ret + i) T();
+        }
+        return ret;
+    }
+
+    /* Invalidates everything which has been allocated */
+    void reset();
+
+    /* Bytes handed out since the last reset */
+    std::size_t used() const { return used_; }
+
+    /* Total bytes held, including unused blocks */
+    std::size_t capacity() const;
+
+private:
+    struct Block {
+        uint8_t* data;
+        std::size_t size;
+    };
+
+    std::size_t block_size_;
+    std::vector<Block> blocks_;
+
+    std::size_t current_ = 0;
+    std::size_t offset_ = 0;
+    std::size_t used_ = 0;
+};
+
+}
+}
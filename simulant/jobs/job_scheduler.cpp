@@ -0,0 +1,255 @@
+#include "job_scheduler.h"
+#include "../errors.h"
+#include "../logging.h"
+
+namespace smlt {
+namespace jobs {
+
+/* Identifies the scheduler (and slot in it) which a worker thread belongs to */
+struct CurrentWorker {
+    const JobScheduler* scheduler = nullptr;
+    std::size_t index = 0;
+};
+
+static thread_local CurrentWorker CURRENT_WORKER;
+
+/* How many times an idle worker looks for jobs before going to sleep */
+const static int IDLE_SPIN_COUNT = 64;
+
+JobScheduler::JobScheduler(std::size_t worker_count):
+    owner_(thread::this_thread_id()),
+    queued_(0),
+    sleeping_(0),
+    stopping_(false) {
+
+    for(std::size_t i = 0; i < worker_count + 1; ++i) {
+        states_.push_back(std::unique_ptr<ThreadState>(new ThreadState()));
+        states_.back()->random = uint32_t(i * 2654435761u) | 1;
+    }
+
+    for(std::size_t i = 0; i < worker_count; ++i) {
+        workers_.push_back(new thread::Thread(&JobScheduler::worker_main, this, i + 1));
+    }
+
+    S_DEBUG("Started job scheduler with {0} workers", worker_count);
+}
+
+JobScheduler::~JobScheduler() {
+    {
+        thread::Lock<thread::Mutex> g(sleep_lock_);
+        stopping_.store(true);
+    }
+
+    work_available_.notify_all();
+
+    for(auto worker: workers_) {
+        worker->join();
+        delete worker;
+    }
+
+    /* Run anything left over so that counters are released */
+    Job* job = nullptr;
+    while((job = find_job(0))) {
+        execute(job);
+    }
+
+    for(auto& state: states_) {
+        while(state->free_jobs) {
+            auto next = state->free_jobs->next_;
+            delete state->free_jobs;
+            state->free_jobs = next;
+        }
+    }
+}
+
+std::size_t JobScheduler::thread_index() const {
+    if(CURRENT_WORKER.scheduler == this) {
+        return CURRENT_WORKER.index;
+    }
+
+    return (thread::this_thread_id() == owner_) ? 0 : thread_count();
+}
+
+FrameAllocator& JobScheduler::frame_allocator() {
+    auto index = thread_index();
+    if(index >= states_.size()) {
+        FATAL_ERROR(ERROR_CODE_JOB_SCHEDULER_INVALID_THREAD, "Frame allocators are only available to scheduler threads");
+    }
+
+    return states_[index]->allocator;
+}
+
+void JobScheduler::new_frame() {
+    assert(thread_index() == 0);
+
+    for(auto& state: states_) {
+        state->allocator.reset();
+    }
+}
+
+Job* JobScheduler::allocate_job() {
+    auto index = thread_index();
+    if(index < states_.size()) {
+        auto& state = states_[index];
+        if(state->free_jobs) {
+            auto job = state->free_jobs;
+            state->free_jobs = job->next_;
+            job->next_ = nullptr;
+            return job;
+        }
+    }
+
+    return new Job();
+}
+
+void JobScheduler::release_job(Job* job) {
+    auto index = thread_index();
+    if(index < states_.size()) {
+        auto& state = states_[index];
+        job->next_ = state->free_jobs;
+        state->free_jobs = job;
+    } else {
+        delete job;
+    }
+}
+
+void JobScheduler::schedule(Job* job) {
+    job->next_ = nullptr;
+
+    auto index = thread_index();
+    if(index < states_.size()) {
+        states_[index]->deque.push(job);
+    } else {
+        thread::Lock<thread::Mutex> g(injected_lock_);
+        injected_.push_back(job);
+    }
+
+    /* Pairs with the check in worker_main, either the worker sees the job
+     * or we see the sleeper */
+    queued_.fetch_add(1);
+    if(sleeping_.load() > 0) {
+        thread::Lock<thread::Mutex> g(sleep_lock_);
+        work_available_.notify_one();
+    }
+}
+
+void JobScheduler::execute(Job* job) {
+    auto counter = job->counter_;
+
+    job->invoke_(job->storage_);
+    release_job(job);
+
+    if(counter) {
+        finish(counter);
+    }
+}
+
+void JobScheduler::finish(Counter* counter) {
+    Job* continuations = nullptr;
+
+    {
+        thread::Lock<thread::Mutex> g(counter->lock_);
+        if(counter->value_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            continuations = counter->continuations_;
+            counter->continuations_ = nullptr;
+        }
+    }
+
+    while(continuations) {
+        auto next = continuations->next_;
+        schedule(continuations);
+        continuations = next;
+    }
+}
+
+Job* JobScheduler::find_job(std::size_t index) {
+    Job* job = nullptr;
+
+    if(index < states_.size()) {
+        job = states_[index]->deque.pop();
+    }
+
+    if(!job && queued_.load(std::memory_order_relaxed) > 0) {
+        {
+            thread::Lock<thread::Mutex> g(injected_lock_);
+            if(!injected_.empty()) {
+                job = injected_.front();
+                injected_.pop_front();
+            }
+        }
+
+        /* Steal, starting from a random victim so that thieves spread out */
+        auto count = states_.size();
+        auto start = std::size_t(0);
+        if(index < count) {
+            auto& random = states_[index]->random;
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            start = random % count;
+        }
+
+        for(std::size_t i = 0; !job && i < count; ++i) {
+            auto victim = (start + i) % count;
+            if(victim != index) {
+                job = states_[victim]->deque.steal();
+            }
+        }
+    }
+
+    if(job) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+void JobScheduler::wait(Counter& counter) {
+    auto index = thread_index();
+
+    while(!counter.is_complete()) {
+        auto job = find_job(index);
+        if(job) {
+            execute(job);
+        } else {
+            thread::yield();
+        }
+    }
+
+    /* The last job may still be holding the lock, it must let go before
+     * the counter can be destroyed */
+    thread::Lock<thread::Mutex> g(counter.lock_);
+}
+
+void JobScheduler::worker_main(std::size_t index) {
+    CURRENT_WORKER.scheduler = this;
+    CURRENT_WORKER.index = index;
+
+    int idle = 0;
+    while(!stopping_.load()) {
+        auto job = find_job(index);
+        if(job) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+
+        if(++idle < IDLE_SPIN_COUNT) {
+            thread::yield();
+            continue;
+        }
+
+        thread::Lock<thread::Mutex> g(sleep_lock_);
+        sleeping_.fetch_add(1);
+        while(!stopping_.load() && queued_.load() <= 0) {
+            work_available_.wait(sleep_lock_);
+        }
+        sleeping_.fetch_sub(1);
+        idle = 0;
+    }
+
+    CURRENT_WORKER.scheduler = nullptr;
+}
+
+}
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../threads/thread.h"
+#include "../threads/mutex.h"
+#include "../threads/condition.h"
+
+#include "work_stealing_deque.h"
+#include "frame_allocator.h"
+
+namespace smlt {
+namespace jobs {
+
+class JobScheduler;
+class Counter;
+
+/* Callables up to this size are stored in the job without allocating */
+const static std::size_t JOB_INLINE_STORAGE_SIZE = 48;
+
+class Job {
+private:
+    friend class JobScheduler;
+
+    typedef void (*Invoker)(void* storage);
+
+    template<typename Func>
+    void assign(Func&& func) {
+        typedef typename std::decay<Func>::type F;
+
+        if(sizeof(F) <= sizeof(storage_) && alignof(F) <= alignof(std::max_align_t)) {
+            new (storage_) F(std::forward<Func>(func));
+            invoke_ = [](void* storage) {
+                F* f = (F*) storage;
+                (*f)();
+                f->~F();
+            };
+        } else {
+            F* f = new F(std::forward<Func>(func));
+            new (storage_) F*(f);
+            invoke_ = [](void* storage) {
+                F* f = *(F**) storage;
+                (*f)();
+                delete f;
+            };
+        }
+    }
+
+    Invoker invoke_ = nullptr;
+
+    /* Decremented once the job has run, may be null */
+    Counter* counter_ = nullptr;
+
+    /* Links the job into a free list or a counter's continuations */
+    Job* next_ = nullptr;
+
+    alignas(std::max_align_t) uint8_t storage_[JOB_INLINE_STORAGE_SIZE];
+};
+
+/*
+ * Counts outstanding jobs. Pass a Counter when running jobs, then either
+ * wait() for it or use run_after() to start more work when it reaches zero.
+ *
+ * A Counter must outlive its jobs, and must be waited on with
+ * JobScheduler::wait() before it's destroyed (is_complete() alone isn't
+ * enough as the final job might still be releasing it).
+ */
+class Counter {
+public:
+    Counter():
+        value_(0) {}
+
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    bool is_complete() const {
+        return value_.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobScheduler;
+
+    std::atomic<int32_t> value_;
+
+    /* Guards reaching zero against adding continuations */
+    thread::Mutex lock_;
+    Job* continuations_ = nullptr;
+};
+
+/*
+ * A work stealing job scheduler.
+ *
+ * Each thread (the one which created the scheduler, plus worker_count workers)
+ * has its own Chase-Lev deque. Jobs run by a thread go onto its own deque and
+ * are popped LIFO, so nested work stays hot in the cache; idle threads steal
+ * the oldest (and usually biggest) jobs from the other end of someone else's.
+ * Jobs run from any other thread go onto a shared queue.
+ *
+ * Waiting on a Counter doesn't block, the waiting thread runs jobs until the
+ * counter reaches zero, so it's safe to wait from inside a job. Idle workers
+ * sleep until more jobs arrive.
+ *
+ * With no workers, jobs are still queued and run by whichever thread waits.
+ */
+class JobScheduler {
+public:
+    JobScheduler(std::size_t worker_count);
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    template<typename Func>
+    void run(Func&& func, Counter* counter=nullptr) {
+        auto job = prepare_job(std::forward<Func>(func), counter);
+        schedule(job);
+    }
+
+    /* Runs func once dependency reaches zero (or straight away if it
+     * already has). counter is incremented immediately. */
+    template<typename Func>
+    void run_after(Counter& dependency, Func&& func, Counter* counter=nullptr) {
+        auto job = prepare_job(std::forward<Func>(func), counter);
+
+        {
+            thread::Lock<thread::Mutex> g(dependency.lock_);
+            if(!dependency.is_complete()) {
+                job->next_ = dependency.continuations_;
+                dependency.continuations_ = job;
+                return;
+            }
+        }
+
+        schedule(job);
+    }
+
+    /* Runs jobs until counter reaches zero */
+    void wait(Counter& counter);
+
+    std::size_t worker_count() const {
+        return workers_.size();
+    }
+
+    /* Workers plus the thread which created the scheduler */
+    std::size_t thread_count() const {
+        return workers_.size() + 1;
+    }
+
+    /* Index of the calling thread, in the range [0, thread_count()). 0 is
+     * the thread which created the scheduler. Returns thread_count() if the
+     * calling thread doesn't belong to the scheduler. */
+    std::size_t thread_index() const;
+
+    /* Scratch memory for the calling thread, valid until the next call to
+     * new_frame(). Only threads which belong to the scheduler have one. */
+    FrameAllocator& frame_allocator();
+
+    /* Resets every thread's frame allocator. This must only be called by
+     * the thread which created the scheduler while no jobs are running. */
+    void new_frame();
+
+private:
+    struct ThreadState {
+        WorkStealingDeque<Job*> deque;
+        FrameAllocator allocator;
+
+        /* Jobs which finished on this thread, ready for reuse */
+        Job* free_jobs = nullptr;
+
+        uint32_t random = 0;
+    };
+
+    template<typename Func>
+    Job* prepare_job(Func&& func, Counter* counter) {
+        auto job = allocate_job();
+        job->assign(std::forward<Func>(func));
+        job->counter_ = counter;
+
+        if(counter) {
+            counter->value_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return job;
+    }
+
+    Job* allocate_job();
+    void release_job(Job* job);
+
+    void schedule(Job* job);
+    void execute(Job* job);
+    void finish(Counter* counter);
+
+    /* Returns a job for the calling thread to run, or null if there aren't any */
+    Job* find_job(std::size_t index);
+
+    void worker_main(std::size_t index);
+
+    thread::ThreadID owner_;
+
+    std::vector<std::unique_ptr<ThreadState>> states_;
+    std::vector<thread::Thread*> workers_;
+
+    /* Jobs run from threads outside of the scheduler */
+    thread::Mutex injected_lock_;
+    std::deque<Job*> injected_;
+
+    /* Jobs queued but not yet taken, used to decide whether to sleep */
+    std::atomic<int32_t> queued_;
+    std::atomic<int32_t> sleeping_;
+    std::atomic<bool> stopping_;
+
+    thread::Mutex sleep_lock_;
+    thread::Condition work_available_;
+};
+
+}
+}
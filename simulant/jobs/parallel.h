@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "job_scheduler.h"
+
+namespace smlt {
+namespace jobs {
+
+/* Ranges are split into at most this many chunks per scheduler thread, a
+ * few per thread lets stealing even out chunks which take longer */
+const static std::size_t PARALLEL_CHUNKS_PER_THREAD = 4;
+
+namespace _parallel {
+
+inline std::size_t chunk_count(const JobScheduler& scheduler, std::size_t count, std::size_t grain_size) {
+    grain_size = std::max<std::size_t>(grain_size, 1);
+
+    auto chunks = (count + grain_size - 1) / grain_size;
+    return std::min(chunks, scheduler.thread_count() * PARALLEL_CHUNKS_PER_THREAD);
+}
+
+}
+
+/*
+ * Calls func(chunk_begin, chunk_end) for consecutive chunks covering
+ * [begin, end), each at least grain_size long (apart from the last). Chunks
+ * run in parallel, the calling thread runs the first one and then helps
+ * with the rest until they are all done.
+ */
+template<typename Func>
+void parallel_for_range(JobScheduler& scheduler, std::size_t begin, std::size_t end, std::size_t grain_size, const Func& func) {
+    if(end <= begin) {
+        return;
+    }
+
+    auto count = end - begin;
+    auto chunks = _parallel::chunk_count(scheduler, count, grain_size);
+
+    if(chunks <= 1) {
+        func(begin, end);
+        return;
+    }
+
+    Counter counter;
+    auto func_ptr = &func;
+
+    for(std::size_t i = 1; i < chunks; ++i) {
+        auto chunk_begin = begin + (count * i) / chunks;
+        auto chunk_end = begin + (count * (i + 1)) / chunks;
+
+        scheduler.run([=]() {
+            (*func_ptr)(chunk_begin, chunk_end);
+        }, &counter);
+    }
+
+    func(begin, begin + count / chunks);
+    scheduler.wait(counter);
+}
+
+/* Calls func(i) for every i in [begin, end) */
+template<typename Func>
+void parallel_for(JobScheduler& scheduler, std::size_t begin, std::size_t end, std::size_t grain_size, const Func& func) {
+    parallel_for_range(scheduler, begin, end, grain_size, [&func](std::size_t chunk_begin, std::size_t chunk_end) {
+        for(auto i = chunk_begin; i < chunk_end; ++i) {
+            func(i);
+        }
+    });
+}
+
+/*
+ * Calls map(chunk_begin, chunk_end) for each chunk of [begin, end) in
+ * parallel, then combines the results with reduce(a, b), starting from
+ * identity. Results are combined in chunk order so reduce only needs to
+ * be associative, not commutative.
+ */
+template<typename T, typename Map, typename Reduce>
+T parallel_reduce(
+    JobScheduler& scheduler, std::size_t begin, std::size_t end, std::size_t grain_size,
+    const T& identity, const Map& map, const Reduce& reduce) {
+
+    if(end <= begin) {
+        return identity;
+    }
+
+    auto count = end - begin;
+    auto chunks = std::max<std::size_t>(_parallel::chunk_count(scheduler, count, grain_size), 1);
+
+    std::vector<T> partials(chunks, identity);
+
+    parallel_for_range(scheduler, 0, chunks, 1, [&](std::size_t first, std::size_t last) {
+        for(auto i = first; i < last; ++i) {
+            partials[i] = map(begin + (count * i) / chunks, begin + (count * (i + 1)) / chunks);
+        }
+    });
+
+    T result = identity;
+    for(auto& partial: partials) {
+        result = reduce(result, partial);
+    }
+
+    return result;
+}
+
+}
+}
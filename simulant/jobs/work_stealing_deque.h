@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace smlt {
+namespace jobs {
+
+/*
+ * Chase-Lev work stealing deque (using the memory orderings from
+ * "Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al.)
+ *
+ * The owning thread pushes and pops at the bottom, any other thread can
+ * steal from the top. T must be a pointer type, nullptr is returned when
+ * the deque is empty or a steal loses a race.
+ *
+ * When the buffer fills up it's doubled. Old buffers can still be read by
+ * a thief mid-steal so they are kept until the deque is destroyed, the
+ * total memory of which is never more than the current buffer.
+ */
+template<typename T>
+class WorkStealingDeque {
+public:
+    WorkStealingDeque(std::size_t initial_capacity=256):
+        top_(0),
+        bottom_(0) {
+
+        std::size_t capacity = 1;
+        while(capacity < initial_capacity) {
+            capacity <<= 1;
+        }
+
+        buffer_.store(new Buffer(capacity), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingDeque() {
+        delete buffer_.load(std::memory_order_relaxed);
+
+        for(auto buffer: retired_) {
+            delete buffer;
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    /* Owner only */
+    void push(T item) {
+        auto b = bottom_.load(std::memory_order_relaxed);
+        auto t = top_.load(std::memory_order_acquire);
+        auto buffer = buffer_.load(std::memory_order_relaxed);
+
+        if(b - t > buffer->capacity() - 1) {
+            buffer = grow(buffer, t, b);
+        }
+
+        /* Publishes the item (and anything it points to) to thieves */
+        buffer->put(b, item);
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+
+    /* Owner only */
+    T pop() {
+        auto b = bottom_.load(std::memory_order_relaxed) - 1;
+        auto buffer = buffer_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top_.load(std::memory_order_relaxed);
+
+        T item = nullptr;
+        if(t <= b) {
+            item = buffer->get(b);
+
+            if(t == b) {
+                /* Last item, race any thieves for it */
+                if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return item;
+    }
+
+    /* Any thread */
+    T steal() {
+        auto t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = bottom_.load(std::memory_order_acquire);
+
+        if(t < b) {
+            auto buffer = buffer_.load(std::memory_order_acquire);
+            T item = buffer->get(t);
+
+            if(!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+
+            return item;
+        }
+
+        return nullptr;
+    }
+
+    /* Only a hint when called by anything other than the owner */
+    bool empty() const {
+        auto b = bottom_.load(std::memory_order_relaxed);
+        auto t = top_.load(std::memory_order_relaxed);
+        return b <= t;
+    }
+
+private:
+    typedef std::ptrdiff_t Index;
+
+    class Buffer {
+    public:
+        Buffer(std::size_t capacity):
+            mask_(capacity - 1),
+            items_(new std::atomic<T>[capacity]) {}
+
+        ~Buffer() {
+            delete [] items_;
+        }
+
+        Index capacity() const {
+            return mask_ + 1;
+        }
+
+        void put(Index i, T item) {
+            items_[i & mask_].store(item, std::memory_order_relaxed);
+        }
+
+        T get(Index i) const {
+            return items_[i & mask_].load(std::memory_order_relaxed);
+        }
+
+    private:
+        Index mask_;
+        std::atomic<T>* items_;
+    };
+
+    Buffer* grow(Buffer* old, Index top, Index bottom) {
+        auto buffer = new Buffer(old->capacity() * 2);
+        for(Index i = top; i < bottom; ++i) {
+            buffer->put(i, old->get(i));
+        }
+
+        retired_.push_back(old);
+        buffer_.store(buffer, std::memory_order_release);
+        return buffer;
+    }
+
+    std::atomic<Index> top_;
+    std::atomic<Index> bottom_;
+    std::atomic<Buffer*> buffer_;
+
+    /* Only touched by the owner */
+    std::vector<Buffer*> retired_;
+};
+
+}
+}
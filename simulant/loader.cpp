@@ -17,6 +17,8 @@
 //     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <sstream>
+
 #include "logging.h"
 #include "loader.h"
 #include "texture.h"
@@ -59,6 +61,18 @@ Loader::~Loader() {
 
 }
 
+void Loader::prepare(const LoaderOptions& options) {
+    _S_UNUSED(options);
+
+    if(!data_) {
+        return;
+    }
+
+    auto buffer = std::make_shared<std::stringstream>();
+    *buffer << data_->rdbuf();
+    data_ = buffer;
+}
+
 namespace loaders {
 
 
@@ -67,15 +81,12 @@ void BaseTextureLoader::into(Loadable& resource, const LoaderOptions& options) {
     Texture* tex = dynamic_cast<Texture*>(res_ptr);
     assert(tex && "You passed a Resource that is not a texture to the texture loader");
 
-    assert(data_);
-
-    std::shared_ptr<FileIfstream> ifstream = std::dynamic_pointer_cast<FileIfstream>(
-        data_
-    );
-
-    assert(ifstream);
+    if(!prepared_) {
+        prepare();
+    }
 
-    auto result = do_load(ifstream);
+    TextureLoadResult result = std::move(*prepared_);
+    prepared_.reset();
 
     /* Respect the auto_upload option if it exists*/
     bool auto_upload = true;
@@ -99,5 +110,19 @@ void BaseTextureLoader::into(Loadable& resource, const LoaderOptions& options) {
     }
 }
 
+void BaseTextureLoader::prepare(const LoaderOptions& options) {
+    _S_UNUSED(options);
+
+    assert(data_);
+
+    std::shared_ptr<FileIfstream> ifstream = std::dynamic_pointer_cast<FileIfstream>(
+        data_
+    );
+
+    assert(ifstream);
+
+    prepared_ = std::make_shared<TextureLoadResult>(do_load(ifstream));
+}
+
 }
 }
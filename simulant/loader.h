@@ -37,6 +37,7 @@
 #include "assets/material.h"
 #include "texture.h"
 #include "path.h"
+#include "utils/mesh/simplify.h"
 
 namespace smlt {
 
@@ -84,6 +85,14 @@ public:
         into((Loadable&) window, options);
     }
 
+    /* Called before into() by the asynchronous loading API, on a loader
+     * thread, with the same options. Anything done here mustn't touch an
+     * asset or manager, so loaders which can parse the file into a
+     * staging structure here leave into() to only create the assets. By
+     * default the file is read into memory so that into() doesn't wait
+     * on I/O. */
+    virtual void prepare(const LoaderOptions& options=LoaderOptions());
+
     void set_vfs(VirtualFileSystem* locator) { locator_ = locator; }
 
     Property<VirtualFileSystem* Loader::*> vfs = { this, &Loader::locator_ };
@@ -148,9 +157,14 @@ public:
 
     void into(Loadable& resource, const LoaderOptions& options = LoaderOptions()) override;
 
+    /* Decodes the image, into() then only copies it to the texture */
+    void prepare(const LoaderOptions& options=LoaderOptions()) override;
+
 private:
     virtual bool format_stored_upside_down() const { return true; }
     virtual TextureLoadResult do_load(std::shared_ptr<FileIfstream> stream) = 0;
+
+    std::shared_ptr<TextureLoadResult> prepared_;
 };
 
 }
@@ -170,6 +184,11 @@ struct MeshLoadOptions {
      * force disabled. This is useful on the Dreamcast where having blending enabled
      * is costly */
     bool blending_enabled = true;
+
+    /* If set, lower detail meshes are generated once the mesh has loaded,
+     * see Mesh::generate_lods */
+    bool generate_lods = false;
+    LODOptions lod_options;
 };
 
 #define MESH_LOAD_OPTIONS_KEY "mesh_options"
@@ -178,6 +178,31 @@ public:
         _S_UNUSED(rig);
         _S_UNUSED(debug);  // We don't have any debugging for MD2 models. Maybe normals?
 
+        _write_frame(current_frame, next_frame, t, out);
+    }
+
+    const VertexData* keyframe_vertex_data(uint32_t frame) override {
+        if(frame >= frames_.size()) {
+            return nullptr;
+        }
+
+        /* Unlike the frame cache these are never evicted, once a renderer
+         * has uploaded a keyframe it's only ever drawn from the GPU copy */
+        keyframes_.resize(frames_.size());
+
+        auto& keyframe = keyframes_[frame];
+        if(!keyframe) {
+            keyframe = std::make_shared<VertexData>(VertexSpecification::DEFAULT);
+            _write_frame(frame, frame, 0.0f, keyframe.get());
+        }
+
+        return keyframe.get();
+    }
+
+private:
+    std::vector<std::shared_ptr<VertexData>> keyframes_;
+
+    void _write_frame(uint32_t current_frame, uint32_t next_frame, float t, VertexData* const out) {
         _expand_verts(current_frame);
         _expand_verts(next_frame);
 
@@ -298,7 +323,8 @@ void MD2Loader::into(Loadable &resource, const LoaderOptions &options) {
         S_WARN("Unable to locate MD2 skin: {0}", skin_name);
     }
 
-    auto material = asset_manager->clone_default_material();
+    /* The built-in lit material can blend the keyframes on the GPU */
+    auto material = asset_manager->new_material_from_file(Material::BuiltIns::LIT_TEXTURED);
     material->set_diffuse_map(asset_manager->texture(tex_id));
 
     submesh->set_material(material);
@@ -296,7 +296,8 @@ void MS3DLoader::into(Loadable& resource, const LoaderOptions& options) {
 
     for(auto& group: groups) {
         auto& material = materials[group.material_index];
-        smlt::MaterialPtr mat = assets->new_material();
+        /* The built-in lit material can skin the mesh on the GPU */
+        smlt::MaterialPtr mat = assets->new_material_from_file(Material::BuiltIns::LIT_TEXTURED);
 
         mat->set_ambient(material.ambient);
         mat->set_diffuse(material.diffuse);
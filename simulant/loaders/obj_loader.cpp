@@ -60,11 +60,39 @@ private:
     Path obj_filename_;
 };
 
-void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
-    Mesh* mesh = loadable_to<Mesh>(resource);
-
-    S_DEBUG("Loading mesh from {0}", filename_);
+/* Everything parsed from the file, none of it belongs to a manager */
+struct OBJData {
+    struct Material {
+        std::string name;
+        smlt::Colour diffuse;
+        smlt::Colour ambient;
+        smlt::Colour specular;
+        float shininess = 0.0f;
+
+        std::string texture_name;
+
+        /* Empty if the diffuse map couldn't be found */
+        std::string texture_path;
+    };
+
+    struct Vertex {
+        float position[3];
+        float colour[3];
+        float normal[3];
+        float tex_coord[2];
+    };
+
+    bool loaded = false;
+    IndexType index_type = INDEX_TYPE_16_BIT;
+
+    std::vector<Material> materials;
+    std::vector<Vertex> vertices;
+
+    /* One list per material, the last is for faces without one */
+    std::vector<std::vector<uint32_t>> indices;
+};
 
+static MeshLoadOptions mesh_load_options(const LoaderOptions& options) {
     MeshLoadOptions mesh_opts;
     auto it = options.find(MESH_LOAD_OPTIONS_KEY);
 
@@ -72,7 +100,13 @@ void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
         mesh_opts = smlt::any_cast<MeshLoadOptions>(it->second);
     }
 
-    S_DEBUG("Got MeshOptions");
+    return mesh_opts;
+}
+
+void OBJLoader::prepare(const LoaderOptions& options) {
+    prepared_ = std::make_shared<OBJData>();
+
+    MeshLoadOptions mesh_opts = mesh_load_options(options);
 
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
@@ -98,43 +132,31 @@ void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
 
     S_DEBUG("Mesh has {0} shapes and {1} materials", shapes.size(), materials.size());
 
-    VertexSpecification spec = mesh->vertex_data->vertex_specification();
-    mesh->reset(spec);  // Make sure we're empty before we begin
-
-    std::unordered_map<std::string, MaterialPtr> final_materials;
-    std::unordered_map<int32_t, SubMeshPtr> material_submeshes;
-    std::unordered_map<std::string, TexturePtr> loaded_textures;
-
-    auto index_type = (attrib.vertices.size() / 3 >= std::numeric_limits<uint16_t>::max()) ?
+    prepared_->loaded = true;
+    prepared_->index_type = (attrib.vertices.size() / 3 >= std::numeric_limits<uint16_t>::max()) ?
         INDEX_TYPE_32_BIT : INDEX_TYPE_16_BIT;
 
-    // First, load the materials, and create submeshes
-    uint32_t i = 0;
+    std::unordered_map<std::string, std::string> texture_paths;
+
     for(auto& material: materials) {
-        MaterialPtr new_mat = mesh->asset_manager().clone_default_material();
+        OBJData::Material staged;
+        staged.name = material.name;
 
         auto alpha = (material.dissolve) ? 1.0f : 0.0f;
+        staged.diffuse = smlt::Colour(material.diffuse[0], material.diffuse[1], material.diffuse[2], alpha);
+        staged.ambient = smlt::Colour(material.ambient[0], material.ambient[1], material.ambient[2], alpha);
+        staged.specular = smlt::Colour(material.specular[0], material.specular[1], material.specular[2], alpha);
 
-        new_mat->each([&](uint32_t, MaterialPass* pass) {
-            pass->set_diffuse(smlt::Colour(material.diffuse[0], material.diffuse[1], material.diffuse[2], alpha));
-            pass->set_ambient(smlt::Colour(material.ambient[0], material.ambient[1], material.ambient[2], alpha));
-            pass->set_specular(smlt::Colour(material.specular[0], material.specular[1], material.specular[2], alpha));
-
-            // Shininess values "normally" are between 0 and 1000, but OpenGL expects them to
-            // be up to 128 so we scale that here
-            pass->set_shininess((material.shininess / 1000.0f) * 128);
-            pass->set_cull_mode(mesh_opts.cull_mode);
-
-            if(!mesh_opts.blending_enabled) {
-                pass->set_blend_func(smlt::BLEND_NONE);
-            }
-        });
+        // Shininess values "normally" are between 0 and 1000, but OpenGL expects them to
+        // be up to 128 so we scale that here
+        staged.shininess = (material.shininess / 1000.0f) * 128;
 
-        /* Apply the diffuse texture (if any) */
+        /* Find the diffuse texture (if any) */
+        staged.texture_name = material.diffuse_texname;
         if(!material.diffuse_texname.empty()) {
-            auto it = loaded_textures.find(material.diffuse_texname);
-            if(it != loaded_textures.end()) {
-                new_mat->set_diffuse_map(it->second);
+            auto it = texture_paths.find(material.diffuse_texname);
+            if(it != texture_paths.end()) {
+                staged.texture_path = it->second;
             } else {
                 std::vector<std::string> possible_locations;
 
@@ -149,33 +171,28 @@ void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
                 // Check potentially absolute file path
                 possible_locations.push_back(material.diffuse_texname);
 
-                bool found = false;
                 for(auto& texture_file: possible_locations) {
                     if(kfs::path::exists(texture_file)) {
-                        auto tex = mesh->asset_manager().new_texture_from_file(texture_file);
-                        new_mat->set_diffuse_map(tex);
-                        loaded_textures.insert(std::make_pair(material.diffuse_texname, tex));
-                        found = true;
+                        staged.texture_path = texture_file;
                         break;
                     }
                 }
 
-                if(!found) {
+                if(staged.texture_path.empty()) {
                     S_WARN("Unable to locate texture {0}", material.diffuse_texname);
                 }
+
+                texture_paths.insert(std::make_pair(material.diffuse_texname, staged.texture_path));
             }
         }
 
-        final_materials.insert(std::make_pair(material.name, new_mat));
-
-        auto submesh = mesh->new_submesh_with_material(
-            material.name, new_mat->id(), MESH_ARRANGEMENT_TRIANGLES, index_type
-        );
-        material_submeshes.insert(std::make_pair(i++, submesh));
+        prepared_->materials.push_back(staged);
     }
 
     S_DEBUG("Loaded materials for obj model");
 
+    prepared_->indices.resize(materials.size() + 1);
+
     typedef std::tuple<int, int, int> VertexKey;
 
     std::unordered_map<VertexKey, uint32_t> shared_vertices;
@@ -190,21 +207,13 @@ void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
             assert(num_verts == 3 && "Only triangles supported");
 
             auto mat_id = shape.mesh.material_ids[f];
-            if(mat_id == -1 && !material_submeshes.count(mat_id)) {
-                // Special case, no material!
-                material_submeshes.insert(
-                    std::make_pair(
-                        mat_id,
-                        mesh->new_submesh("__default__", MESH_ARRANGEMENT_TRIANGLES, index_type)
-                    )
-                );
-            }
-
-            if(!material_submeshes.count(mat_id)) {
+            if(mat_id < -1 || mat_id >= (int32_t) materials.size()) {
                 S_ERROR("Unable to find submesh with mat id: {0}", mat_id);
+                offset += num_verts;
+                continue;
             }
 
-            auto submeshptr = material_submeshes.at(mat_id);
+            auto& indices = prepared_->indices[(mat_id == -1) ? materials.size() : mat_id];
 
             for(auto i = 0; i < num_verts; ++i) {
                 auto index = shape.mesh.indices[offset + i];
@@ -230,57 +239,127 @@ void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
                     float* n = (index.normal_index == -1) ?
                         &default_n[0] : &attrib.normals[3 * index.normal_index];
 
-                    mesh->vertex_data->position(pos[0], pos[1], pos[2]);
+                    OBJData::Vertex vertex;
+                    std::copy(pos, pos + 3, vertex.position);
 
                     /* Tinyobj loader loads the non-standard vertex colour extension
                      * but defaults to white anyway so it's safe to just read them in */
-                    if(spec.has_diffuse()) {
-                        mesh->vertex_data->diffuse(
-                            smlt::Colour(colour[0], colour[1], colour[2], 1.0)
-                        );
-                    }
+                    std::copy(colour, colour + 3, vertex.colour);
+                    std::copy(n, n + 3, vertex.normal);
+                    std::copy(tc, tc + 2, vertex.tex_coord);
 
-                    if(spec.has_normals()) {
-                        mesh->vertex_data->normal(n[0], n[1], n[2]);
-                    }
-
-                    if(spec.has_texcoord0()) {
-                        mesh->vertex_data->tex_coord0(tc[0], tc[1]);
-                    }
-
-                    mesh->vertex_data->move_next();
-
-                    auto idx = mesh->vertex_data->count() - 1;
+                    uint32_t idx = prepared_->vertices.size();
+                    prepared_->vertices.push_back(vertex);
                     shared_vertices.insert(std::make_pair(key, idx));
 
-                    submeshptr->index_data->index(idx);
+                    indices.push_back(idx);
                 } else {
-                    submeshptr->index_data->index(it->second);
+                    indices.push_back(it->second);
                 }
             }
 
             offset += num_verts;
-            submeshptr->index_data->done();
         }
     }
 
     S_DEBUG("Loaded shapes for obj model");
+}
 
-    std::vector<std::string> empty;
-    for(auto submesh: mesh->each_submesh()) {
-        if(!submesh->index_data->count()) {
-            empty.push_back(submesh->name());
-        }
+void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
+    Mesh* mesh = loadable_to<Mesh>(resource);
+
+    S_DEBUG("Loading mesh from {0}", filename_);
+
+    /* Loaded synchronously */
+    if(!prepared_) {
+        prepare(options);
     }
 
-    for(auto& name: empty) {
-        mesh->destroy_submesh(name);
+    auto prepared = prepared_;
+    prepared_.reset();
+
+    if(!prepared->loaded) {
+        return;
     }
 
-    S_DEBUG("Removed empty submeshes");
+    MeshLoadOptions mesh_opts = mesh_load_options(options);
+
+    VertexSpecification spec = mesh->vertex_data->vertex_specification();
+    mesh->reset(spec);  // Make sure we're empty before we begin
+
+    for(auto& vertex: prepared->vertices) {
+        mesh->vertex_data->position(vertex.position[0], vertex.position[1], vertex.position[2]);
+
+        if(spec.has_diffuse()) {
+            mesh->vertex_data->diffuse(
+                smlt::Colour(vertex.colour[0], vertex.colour[1], vertex.colour[2], 1.0)
+            );
+        }
+
+        if(spec.has_normals()) {
+            mesh->vertex_data->normal(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+        }
+
+        if(spec.has_texcoord0()) {
+            mesh->vertex_data->tex_coord0(vertex.tex_coord[0], vertex.tex_coord[1]);
+        }
+
+        mesh->vertex_data->move_next();
+    }
 
     mesh->vertex_data->done();
 
+    /* Only materials which are used by a face get a submesh */
+    std::unordered_map<std::string, TexturePtr> loaded_textures;
+
+    for(uint32_t i = 0; i < prepared->indices.size(); ++i) {
+        auto& indices = prepared->indices[i];
+        if(indices.empty()) {
+            continue;
+        }
+
+        SubMeshPtr submesh;
+
+        if(i == prepared->materials.size()) {
+            // Special case, no material!
+            submesh = mesh->new_submesh("__default__", MESH_ARRANGEMENT_TRIANGLES, prepared->index_type);
+        } else {
+            auto& material = prepared->materials[i];
+            MaterialPtr new_mat = mesh->asset_manager().clone_default_material();
+
+            new_mat->each([&](uint32_t, MaterialPass* pass) {
+                pass->set_diffuse(material.diffuse);
+                pass->set_ambient(material.ambient);
+                pass->set_specular(material.specular);
+                pass->set_shininess(material.shininess);
+                pass->set_cull_mode(mesh_opts.cull_mode);
+
+                if(!mesh_opts.blending_enabled) {
+                    pass->set_blend_func(smlt::BLEND_NONE);
+                }
+            });
+
+            /* Apply the diffuse texture (if any) */
+            if(!material.texture_path.empty()) {
+                auto it = loaded_textures.find(material.texture_name);
+                if(it != loaded_textures.end()) {
+                    new_mat->set_diffuse_map(it->second);
+                } else {
+                    auto tex = mesh->asset_manager().new_texture_from_file(material.texture_path);
+                    new_mat->set_diffuse_map(tex);
+                    loaded_textures.insert(std::make_pair(material.texture_name, tex));
+                }
+            }
+
+            submesh = mesh->new_submesh_with_material(
+                material.name, new_mat->id(), MESH_ARRANGEMENT_TRIANGLES, prepared->index_type
+            );
+        }
+
+        submesh->index_data->index(&indices[0], indices.size());
+        submesh->index_data->done();
+    }
+
     S_DEBUG("Mesh loaded");
 }
 
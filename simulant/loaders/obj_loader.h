@@ -24,12 +24,21 @@
 namespace smlt {
 namespace loaders {
 
+struct OBJData;
+
 class OBJLoader : public Loader {
 public:
     OBJLoader(const Path& filename, std::shared_ptr<std::istream> data):
         Loader(filename, data) {}
 
     void into(Loadable& resource, const LoaderOptions& options = LoaderOptions());
+
+    /* Parses the file and its materials, into() then only creates the
+     * mesh, materials and textures */
+    void prepare(const LoaderOptions& options=LoaderOptions()) override;
+
+private:
+    std::shared_ptr<OBJData> prepared_;
 };
 
 void parse_face(const std::string& input, int32_t& vertex_index, int32_t& tex_index, int32_t& normal_index);
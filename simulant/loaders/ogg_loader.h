@@ -34,6 +34,8 @@ public:
 
     void into(Loadable& resource, const LoaderOptions &options=LoaderOptions());
 
+    /* OGG sounds are decoded from the open file as they play */
+    void prepare(const LoaderOptions&) override {}
 };
 
 class OGGLoaderType : public LoaderType {
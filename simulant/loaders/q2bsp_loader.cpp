@@ -33,6 +33,7 @@
 #include "../behaviours/material/flowing.h"
 #include "../behaviours/material/warp.h"
 #include "../utils/rect_pack.h"
+#include "../nodes/geoms/bsp_pvs_culler.h"
 
 #include "q2bsp_loader.h"
 
@@ -336,6 +337,16 @@ void Q2BSPLoader::into(Loadable& resource, const LoaderOptions &options) {
     read_lump(file, header, Q2::LumpType::LIGHTMAPS, lightmap_data);
     read_lump(file, header, Q2::LumpType::EDGES, edges);
 
+    std::vector<Q2::Node> nodes;
+    std::vector<Q2::Leaf> leaves;
+    std::vector<uint16_t> leaf_faces;
+    std::vector<uint8_t> visibility_data;
+
+    read_lump(file, header, Q2::LumpType::NODES, nodes);
+    read_lump(file, header, Q2::LumpType::LEAVES, leaves);
+    read_lump(file, header, Q2::LumpType::LEAF_FACE_TABLE, leaf_faces);
+    read_lump(file, header, Q2::LumpType::VISIBILITY, visibility_data);
+
     std::for_each(vertices.begin(), vertices.end(), [&](Q2::Point3f& vert) {
         vert = vert.transformed_by(rotation);
     });
@@ -397,12 +408,19 @@ void Q2BSPLoader::into(Loadable& resource, const LoaderOptions &options) {
 
     std::vector<std::set<uint32_t>> face_indexes(faces.size());
 
+    /* The triangles of each face are kept for the PVS culler */
+    auto visibility = std::make_shared<BSPVisibility>();
+    visibility->faces.resize(faces.size());
+
     int32_t face_id = -1;
-    for(Q2::Face& f: faces) {
+    for(uint32_t bsp_face = 0; bsp_face < faces.size(); ++bsp_face) {
+        Q2::Face& f = faces[bsp_face];
         FaceUVLimits uv_limit;
 
         auto& tex = textures[f.texture_info];
         auto material_id = materials.at(f.texture_info);
+        visibility->faces[bsp_face].material = material_id;
+
         if(!material_id) {
             // Must be an invisible surface
             uv_limits.push_back(uv_limit);
@@ -458,6 +476,7 @@ void Q2BSPLoader::into(Loadable& resource, const LoaderOptions &options) {
                 if(index_lookup.count(tri_idx[j])) {
                     //We've already processed this vertex
                     sm->index_data->index(index_lookup[tri_idx[j]]);
+                    visibility->faces[bsp_face].indices.push_back(index_lookup[tri_idx[j]]);
                     continue;
                 }
 
@@ -492,6 +511,7 @@ void Q2BSPLoader::into(Loadable& resource, const LoaderOptions &options) {
                 mesh->vertex_data->move_next();
 
                 sm->index_data->index(mesh->vertex_data->count() - 1);
+                visibility->faces[bsp_face].indices.push_back(mesh->vertex_data->count() - 1);
 
                 //Cache this new vertex in the lookup
                 index_lookup[tri_idx[j]] = mesh->vertex_data->count() - 1;
@@ -535,6 +555,69 @@ void Q2BSPLoader::into(Loadable& resource, const LoaderOptions &options) {
 
     lightmap_texture->set_garbage_collection_method(GARBAGE_COLLECT_PERIODIC);
 
+    /* Keep the BSP tree and PVS so that a Geom can cull the map by cluster,
+     * the planes are rotated in the same way as the vertices */
+    for(auto& node: nodes) {
+        BSPVisibility::Node out;
+        auto& plane = planes.at(node.plane);
+        out.normal = plane.normal.rotated_by(rotation);
+        out.distance = plane.distance;
+        out.children[0] = node.front_child;
+        out.children[1] = node.back_child;
+        visibility->nodes.push_back(out);
+    }
+
+    uint32_t cluster_count = 0;
+    if(visibility_data.size() >= sizeof(uint32_t)) {
+        cluster_count = *((uint32_t*) &visibility_data[0]);
+    }
+
+    for(auto& leaf: leaves) {
+        if(leaf.cluster != Q2::NO_CLUSTER) {
+            cluster_count = std::max(cluster_count, uint32_t(leaf.cluster) + 1);
+        }
+    }
+
+    std::vector<std::set<uint32_t>> cluster_faces(cluster_count);
+    for(auto& leaf: leaves) {
+        BSPVisibility::Leaf out;
+        out.cluster = (leaf.cluster == Q2::NO_CLUSTER) ? -1 : int32_t(leaf.cluster);
+        visibility->leaves.push_back(out);
+
+        if(out.cluster < 0) {
+            continue;
+        }
+
+        for(uint32_t i = leaf.first_leaf_face; i < uint32_t(leaf.first_leaf_face) + leaf.num_leaf_faces; ++i) {
+            if(i < leaf_faces.size()) {
+                cluster_faces[out.cluster].insert(leaf_faces[i]);
+            }
+        }
+    }
+
+    for(auto& faces_in_cluster: cluster_faces) {
+        visibility->cluster_faces.push_back(
+            std::vector<uint32_t>(faces_in_cluster.begin(), faces_in_cluster.end())
+        );
+    }
+
+    /* The lump starts with the cluster count, then a PVS and PHS offset for
+     * each cluster, relative to the start of the lump */
+    visibility->pvs_offsets.assign(cluster_count, std::numeric_limits<uint32_t>::max());
+    if(visibility_data.size() >= sizeof(uint32_t)) {
+        auto stored_clusters = *((uint32_t*) &visibility_data[0]);
+        for(uint32_t i = 0; i < stored_clusters && i < cluster_count; ++i) {
+            auto offset_at = sizeof(uint32_t) + (i * sizeof(uint32_t) * 2);
+            if(offset_at + sizeof(uint32_t) <= visibility_data.size()) {
+                visibility->pvs_offsets[i] = *((uint32_t*) &visibility_data[offset_at]);
+            }
+        }
+
+        visibility->pvs_data = std::move(visibility_data);
+    }
+
+    mesh->data->stash(BSPVisibilityPtr(visibility), BSP_VISIBILITY_DATA_KEY);
+
     S_WARN("Finished loading Quake 2 BSP");
 
     mesh->vertex_data->done();
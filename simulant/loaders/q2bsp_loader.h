@@ -110,6 +110,30 @@ struct Face {
     uint32_t lightmap_offset;   // offset of the lightmap (in bytes) in the lightmap lump
 };
 
+struct Node {
+    uint32_t plane;
+    int32_t front_child;        // negative values are leaves: -(leaf + 1)
+    int32_t back_child;
+    int16_t bbox_min[3];
+    int16_t bbox_max[3];
+    uint16_t first_face;
+    uint16_t num_faces;
+};
+
+struct Leaf {
+    uint32_t brush_or;          // contents of the leaf's brushes, OR'd together
+    uint16_t cluster;           // 0xFFFF for solid leaves
+    uint16_t area;
+    int16_t bbox_min[3];
+    int16_t bbox_max[3];
+    uint16_t first_leaf_face;   // index into the leaf face table
+    uint16_t num_leaf_faces;
+    uint16_t first_leaf_brush;
+    uint16_t num_leaf_brushes;
+};
+
+const uint16_t NO_CLUSTER = 0xFFFF;
+
 struct Lump {
     uint32_t offset;
     uint32_t length;
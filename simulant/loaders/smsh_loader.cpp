@@ -0,0 +1,596 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#if !defined(__DREAMCAST__) && !defined(__PSP__) && !defined(_WIN32)
+#define SMSH_USE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "smsh_loader.h"
+
+#include "../meshes/mesh.h"
+#include "../asset_manager.h"
+#include "../assets/material.h"
+#include "../texture.h"
+#include "../vfs.h"
+
+namespace smlt {
+namespace loaders {
+
+const uint32_t SMSH_VERSION = 1;
+
+namespace {
+
+const char SMSH_MAGIC[4] = {'S', 'M', 'S', 'H'};
+const uint32_t NO_MATERIAL = ~0u;
+
+/* Maps the whole file into memory where the platform allows it, so the
+ * blobs can be copied straight out of the page cache. Otherwise (or if
+ * the file isn't on disk) the stream is read into a buffer */
+class MappedFile {
+public:
+    MappedFile(const Path& path, std::istream& fallback) {
+#ifdef SMSH_USE_MMAP
+        int fd = open(path.str().c_str(), O_RDONLY);
+        if(fd >= 0) {
+            struct stat st;
+            if(fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(mem != MAP_FAILED) {
+                    data_ = (const uint8_t*) mem;
+                    size_ = st.st_size;
+                    mapped_ = true;
+                }
+            }
+
+            /* The mapping outlives the descriptor */
+            close(fd);
+        }
+
+        if(mapped_) {
+            return;
+        }
+#else
+        _S_UNUSED(path);
+#endif
+
+        buffer_.assign(
+            std::istreambuf_iterator<char>(fallback),
+            std::istreambuf_iterator<char>()
+        );
+
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+    }
+
+    ~MappedFile() {
+#ifdef SMSH_USE_MMAP
+        if(mapped_) {
+            munmap((void*) data_, size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<uint8_t> buffer_;
+};
+
+class Reader {
+public:
+    Reader(const MappedFile& file, const Path& filename):
+        data_(file.data()),
+        size_(file.size()),
+        filename_(filename) {}
+
+    const uint8_t* bytes(std::size_t count) {
+        if(count > size_ - offset_) {
+            throw std::logic_error("Truncated SMSH file: " + filename_.str());
+        }
+
+        auto ret = data_ + offset_;
+        offset_ += count;
+        return ret;
+    }
+
+    template<typename T>
+    T read() {
+        T ret;
+        std::memcpy(&ret, bytes(sizeof(T)), sizeof(T));
+        return ret;
+    }
+
+    /* Reads an enum stored as S, anything past last is rejected */
+    template<typename E, typename S>
+    E read_enum(E last) {
+        auto value = read<S>();
+        check(value <= S(last), "unknown enum value");
+        return (E) value;
+    }
+
+    void check(bool condition, const std::string& what) {
+        if(!condition) {
+            throw std::logic_error("Corrupt SMSH file (" + what + "): " + filename_.str());
+        }
+    }
+
+    std::string read_string() {
+        auto length = read<uint32_t>();
+        auto chars = bytes(length);
+        return std::string((const char*) chars, length);
+    }
+
+    Colour read_colour() {
+        Colour ret;
+        ret.r = read<float>();
+        ret.g = read<float>();
+        ret.b = read<float>();
+        ret.a = read<float>();
+        return ret;
+    }
+
+    Vec3 read_vec3() {
+        Vec3 ret;
+        ret.x = read<float>();
+        ret.y = read<float>();
+        ret.z = read<float>();
+        return ret;
+    }
+
+private:
+    const uint8_t* data_;
+    std::size_t size_;
+    std::size_t offset_ = 0;
+    Path filename_;
+};
+
+class Writer {
+public:
+    Writer(std::ostream& out):
+        out_(out) {}
+
+    void bytes(const uint8_t* data, std::size_t count) {
+        if(count) {
+            out_.write((const char*) data, count);
+        }
+    }
+
+    template<typename T>
+    void write(const T& value) {
+        out_.write((const char*) &value, sizeof(T));
+    }
+
+    void write_string(const std::string& str) {
+        write<uint32_t>(str.size());
+        bytes((const uint8_t*) str.data(), str.size());
+    }
+
+    void write_colour(const Colour& colour) {
+        write<float>(colour.r);
+        write<float>(colour.g);
+        write<float>(colour.b);
+        write<float>(colour.a);
+    }
+
+    void write_vec3(const Vec3& v) {
+        write<float>(v.x);
+        write<float>(v.y);
+        write<float>(v.z);
+    }
+
+private:
+    std::ostream& out_;
+};
+
+/* Vertex morph frames, baked to complete vertices */
+class SMSHFrameData : public FrameUnpacker {
+public:
+    std::vector<std::shared_ptr<VertexData>> frames;
+
+    void prepare_unpack(uint32_t, uint32_t, float, Rig* const, Debug* const = nullptr) override {
+        // INTENTIONALLY BLANK
+    }
+
+    void unpack_frame(
+        const uint32_t current_frame,
+        const uint32_t next_frame,
+        const float t,
+        Rig* const rig,
+        VertexData* const out,
+        Debug* const debug=nullptr) override {
+
+        _S_UNUSED(rig);
+        _S_UNUSED(debug);
+
+        auto& current = *frames[current_frame];
+        auto& next = *frames[next_frame];
+
+        out->resize(current.count());
+        for(uint32_t i = 0; i < current.count(); ++i) {
+            current.interp_vertex(i, next, i, *out, i, t);
+        }
+
+        out->done();
+    }
+};
+
+VertexAttribute read_attribute(Reader& reader) {
+    return reader.read_enum<VertexAttribute, uint8_t>(VERTEX_ATTRIBUTE_PACKED_VEC4_1I);
+}
+
+/* The stored range has to cover every index, and every index has to be a
+ * vertex, otherwise drawing would read past the vertex data */
+template<typename T>
+bool indices_in_range(const uint8_t* data, uint32_t count, uint32_t min_index, uint32_t max_index) {
+    for(uint32_t i = 0; i < count; ++i) {
+        T index;
+        std::memcpy(&index, data + (i * sizeof(T)), sizeof(T));
+        if(index < min_index || index > max_index) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+void SMSHLoader::into(Loadable& resource, const LoaderOptions& options) {
+    Mesh* mesh = loadable_to<Mesh>(resource);
+    AssetManager* assets = &mesh->asset_manager();
+
+    MeshLoadOptions mesh_opts;
+    auto it = options.find(MESH_LOAD_OPTIONS_KEY);
+    if(it != options.end()) {
+        mesh_opts = smlt::any_cast<MeshLoadOptions>(it->second);
+    }
+
+    S_DEBUG("Loading SMSH mesh: {0}", filename_);
+
+    MappedFile file(filename_, *data_);
+    Reader reader(file, filename_);
+
+    if(file.size() < sizeof(SMSH_MAGIC) || std::memcmp(reader.bytes(sizeof(SMSH_MAGIC)), SMSH_MAGIC, sizeof(SMSH_MAGIC)) != 0) {
+        throw std::logic_error("Unsupported SMSH file: " + filename_.str());
+    }
+
+    auto version = reader.read<uint32_t>();
+    if(version != SMSH_VERSION) {
+        throw std::logic_error("Unsupported SMSH version in file: " + filename_.str());
+    }
+
+    // =========== HEADER =============
+    VertexSpecification spec;
+    spec.position_attribute = read_attribute(reader);
+    spec.normal_attribute = read_attribute(reader);
+    spec.texcoord0_attribute = read_attribute(reader);
+    spec.texcoord1_attribute = read_attribute(reader);
+    spec.texcoord2_attribute = read_attribute(reader);
+    spec.texcoord3_attribute = read_attribute(reader);
+    spec.texcoord4_attribute = read_attribute(reader);
+    spec.texcoord5_attribute = read_attribute(reader);
+    spec.texcoord6_attribute = read_attribute(reader);
+    spec.texcoord7_attribute = read_attribute(reader);
+    spec.diffuse_attribute = read_attribute(reader);
+    spec.specular_attribute = read_attribute(reader);
+
+    /* The blobs are only usable if the vertex layout hasn't changed since
+     * the file was written */
+    auto stride = reader.read<uint32_t>();
+    if(stride != spec.stride()) {
+        throw std::logic_error("SMSH file has a different vertex layout: " + filename_.str());
+    }
+
+    auto vertex_count = reader.read<uint32_t>();
+    auto animation_type = reader.read_enum<MeshAnimationType, uint32_t>(MESH_ANIMATION_TYPE_SKELETAL);
+    auto frame_count = reader.read<uint32_t>();
+    auto material_count = reader.read<uint32_t>();
+    auto submesh_count = reader.read<uint32_t>();
+
+    mesh->reset(spec);
+
+    // =========== VERTICES =============
+    /* This happens before there are any submeshes so that done() doesn't
+     * recalculate any bounds, they're stored in the file */
+    mesh->vertex_data->assign(reader.bytes(std::size_t(vertex_count) * stride), vertex_count);
+    mesh->vertex_data->done();
+
+    // =========== MATERIALS =============
+    std::vector<MaterialPtr> materials;
+    std::unordered_map<std::string, TexturePtr> loaded_textures;
+
+    for(uint32_t i = 0; i < material_count; ++i) {
+        auto material = assets->clone_default_material();
+        material->set_name(reader.read_string());
+
+        auto diffuse = reader.read_colour();
+        auto ambient = reader.read_colour();
+        auto specular = reader.read_colour();
+        auto shininess = reader.read<float>();
+        auto blend = reader.read_enum<BlendType, uint8_t>(BLEND_ONE_ONE_MINUS_ALPHA);
+        auto cull = reader.read_enum<CullMode, uint8_t>(CULL_MODE_FRONT_AND_BACK_FACE);
+        auto diffuse_map = reader.read_string();
+
+        material->each([&](uint32_t, MaterialPass* pass) {
+            pass->set_diffuse(diffuse);
+            pass->set_ambient(ambient);
+            pass->set_specular(specular);
+            pass->set_shininess(shininess);
+            pass->set_cull_mode(cull);
+            pass->set_blend_func((mesh_opts.blending_enabled) ? blend : BLEND_NONE);
+        });
+
+        if(!diffuse_map.empty()) {
+            auto tex = loaded_textures.find(diffuse_map);
+            if(tex != loaded_textures.end()) {
+                material->set_diffuse_map(tex->second);
+            } else {
+                try {
+                    auto texture = assets->new_texture_from_file(vfs->locate_file(diffuse_map));
+                    material->set_diffuse_map(texture);
+                    loaded_textures.insert(std::make_pair(diffuse_map, texture));
+                } catch(AssetMissingError&) {
+                    S_WARN("Unable to locate texture {0}", diffuse_map);
+                }
+            }
+        }
+
+        materials.push_back(material);
+    }
+
+    auto material_at = [&](uint32_t index) -> MaterialPtr {
+        return (index < materials.size()) ? materials[index] : MaterialPtr();
+    };
+
+    // =========== SUBMESHES =============
+    for(uint32_t i = 0; i < submesh_count; ++i) {
+        auto name = reader.read_string();
+
+        uint32_t slots[MATERIAL_SLOT_MAX];
+        for(auto& slot: slots) {
+            slot = reader.read<uint32_t>();
+        }
+
+        auto arrangement = reader.read_enum<MeshArrangement, uint8_t>(MESH_ARRANGEMENT_LINE_STRIP);
+        auto index_type = reader.read_enum<IndexType, uint8_t>(INDEX_TYPE_32_BIT);
+        auto index_count = reader.read<uint32_t>();
+        auto min_index = reader.read<uint32_t>();
+        auto max_index = reader.read<uint32_t>();
+
+        if(index_count) {
+            reader.check(min_index <= max_index && max_index < vertex_count, "index out of range");
+        }
+
+        AABB bounds;
+        bounds.set_min(reader.read_vec3());
+        bounds.set_max(reader.read_vec3());
+
+        auto index_data = std::make_shared<IndexData>(index_type);
+        auto indices = reader.bytes(std::size_t(index_count) * index_data->stride());
+
+        bool in_range = (index_type == INDEX_TYPE_8_BIT) ? indices_in_range<uint8_t>(indices, index_count, min_index, max_index) :
+            (index_type == INDEX_TYPE_16_BIT) ? indices_in_range<uint16_t>(indices, index_count, min_index, max_index) :
+            indices_in_range<uint32_t>(indices, index_count, min_index, max_index);
+
+        reader.check(in_range, "index out of range");
+
+        index_data->assign(indices, index_count, min_index, max_index);
+        index_data->done();
+
+        auto material = material_at(slots[MATERIAL_SLOT0]);
+        auto submesh = (material) ?
+            mesh->new_submesh_with_material(name, material->id(), index_data, arrangement) :
+            mesh->new_submesh(name, index_data, arrangement);
+
+        for(uint32_t slot = MATERIAL_SLOT1; slot < MATERIAL_SLOT_MAX; ++slot) {
+            if(auto slot_material = material_at(slots[slot])) {
+                submesh->set_material_at_slot((MaterialSlot) slot, slot_material);
+            }
+        }
+
+        submesh->bounds_ = bounds;
+    }
+
+    mesh->rebuild_aabb();
+
+    // =========== ANIMATION =============
+    if(animation_type == MESH_ANIMATION_TYPE_VERTEX_MORPH && frame_count) {
+        auto frame_data = std::make_shared<SMSHFrameData>();
+
+        for(uint32_t i = 0; i < frame_count; ++i) {
+            /* Frames are blended vertex by vertex with each other */
+            auto count = reader.read<uint32_t>();
+            reader.check(count == vertex_count, "frame vertex count");
+
+            auto frame = std::make_shared<VertexData>(spec);
+            frame->assign(reader.bytes(std::size_t(count) * stride), count);
+            frame_data->frames.push_back(frame);
+        }
+
+        mesh->enable_animation(MESH_ANIMATION_TYPE_VERTEX_MORPH, frame_count, frame_data);
+    }
+
+    mesh->set_default_fps(reader.read<float>());
+
+    auto animation_count = reader.read<uint32_t>();
+    for(uint32_t i = 0; i < animation_count; ++i) {
+        auto name = reader.read_string();
+        auto start = reader.read<uint32_t>();
+        auto end = reader.read<uint32_t>();
+        auto fps = reader.read<float>();
+
+        /* Meshes written without their frames (e.g. skeletal ones) keep
+         * their animations but never unpack them */
+        if(frame_count) {
+            reader.check(start <= end && end < frame_count, "animation frame range");
+        }
+
+        mesh->add_animation(name, start, end, fps);
+    }
+}
+
+bool SMSHWriter::write(const Path& filename) {
+    std::ofstream file(filename.str(), std::ios::binary);
+    if(!file.good()) {
+        S_ERROR("Unable to open {0} for writing", filename);
+        return false;
+    }
+
+    Writer out(file);
+
+    auto vertex_data = mesh_.vertex_data_.get();
+    auto& spec = vertex_data->vertex_specification();
+
+    auto animation_type = mesh_.animation_type();
+    if(animation_type == MESH_ANIMATION_TYPE_SKELETAL) {
+        S_WARN("SMSH doesn't support skeletal animation, writing {0} in its bind pose", filename);
+        animation_type = MESH_ANIMATION_TYPE_NONE;
+    }
+
+    /* Materials are shared between submeshes so they're written once each */
+    std::vector<MaterialPtr> materials;
+    std::unordered_map<Material*, uint32_t> material_indexes;
+
+    auto index_of = [&](MaterialPtr material) -> uint32_t {
+        if(!material) {
+            return NO_MATERIAL;
+        }
+
+        auto it = material_indexes.find(material.get());
+        if(it != material_indexes.end()) {
+            return it->second;
+        }
+
+        uint32_t index = materials.size();
+        materials.push_back(material);
+        material_indexes.insert(std::make_pair(material.get(), index));
+        return index;
+    };
+
+    for(auto submesh: mesh_.each_submesh()) {
+        for(uint32_t slot = 0; slot < MATERIAL_SLOT_MAX; ++slot) {
+            index_of(submesh->material_at_slot((MaterialSlot) slot));
+        }
+    }
+
+    // =========== HEADER =============
+    out.bytes((const uint8_t*) SMSH_MAGIC, sizeof(SMSH_MAGIC));
+    out.write<uint32_t>(SMSH_VERSION);
+
+    out.write<uint8_t>(spec.position_attribute);
+    out.write<uint8_t>(spec.normal_attribute);
+    out.write<uint8_t>(spec.texcoord0_attribute);
+    out.write<uint8_t>(spec.texcoord1_attribute);
+    out.write<uint8_t>(spec.texcoord2_attribute);
+    out.write<uint8_t>(spec.texcoord3_attribute);
+    out.write<uint8_t>(spec.texcoord4_attribute);
+    out.write<uint8_t>(spec.texcoord5_attribute);
+    out.write<uint8_t>(spec.texcoord6_attribute);
+    out.write<uint8_t>(spec.texcoord7_attribute);
+    out.write<uint8_t>(spec.diffuse_attribute);
+    out.write<uint8_t>(spec.specular_attribute);
+
+    out.write<uint32_t>(spec.stride());
+    out.write<uint32_t>(vertex_data->count());
+    out.write<uint32_t>(animation_type);
+    out.write<uint32_t>((animation_type == MESH_ANIMATION_TYPE_NONE) ? 0 : mesh_.animation_frames());
+    out.write<uint32_t>(materials.size());
+    out.write<uint32_t>(mesh_.submesh_count());
+
+    // =========== VERTICES =============
+    out.bytes(vertex_data->data(), vertex_data->count() * spec.stride());
+
+    // =========== MATERIALS =============
+    for(auto& material: materials) {
+        /* Passes fall back to the material's values so this picks up
+         * whichever were set */
+        MaterialObject* values = (material->pass_count()) ?
+            (MaterialObject*) material->pass(0) : (MaterialObject*) material.get();
+
+        out.write_string(material->name());
+        out.write_colour(values->diffuse());
+        out.write_colour(values->ambient());
+        out.write_colour(values->specular());
+        out.write<float>(values->shininess());
+        out.write<uint8_t>(values->blend_func());
+        out.write<uint8_t>(values->cull_mode());
+
+        auto& texture = values->diffuse_map();
+        out.write_string((texture) ? texture->source().str() : std::string());
+    }
+
+    // =========== SUBMESHES =============
+    for(auto submesh: mesh_.each_submesh()) {
+        auto index_data = submesh->index_data.get();
+
+        out.write_string(submesh->name());
+        for(uint32_t slot = 0; slot < MATERIAL_SLOT_MAX; ++slot) {
+            out.write<uint32_t>(index_of(submesh->material_at_slot((MaterialSlot) slot)));
+        }
+
+        out.write<uint8_t>(submesh->arrangement());
+        out.write<uint8_t>(index_data->index_type());
+        out.write<uint32_t>(index_data->count());
+        out.write<uint32_t>(index_data->min_index());
+        out.write<uint32_t>(index_data->max_index());
+
+        out.write_vec3(submesh->bounds_.min());
+        out.write_vec3(submesh->bounds_.max());
+
+        out.bytes(index_data->data(), index_data->count() * index_data->stride());
+    }
+
+    // =========== ANIMATION =============
+    if(animation_type == MESH_ANIMATION_TYPE_VERTEX_MORPH) {
+        VertexData frame(spec);
+        for(uint32_t i = 0; i < mesh_.animation_frames(); ++i) {
+            mesh_.animated_frame_data_->unpack_frame(i, i, 0.0f, nullptr, &frame);
+
+            out.write<uint32_t>(frame.count());
+            out.bytes(frame.data(), frame.count() * spec.stride());
+        }
+    }
+
+    out.write<float>(mesh_.default_fps());
+
+    /* The first animation is the one played by default, so it goes first */
+    std::vector<std::string> names;
+    if(!mesh_.first_animation_.empty()) {
+        names.push_back(mesh_.first_animation_);
+    }
+
+    for(auto& animation: mesh_.animations_) {
+        if(animation.first != mesh_.first_animation_) {
+            names.push_back(animation.first);
+        }
+    }
+
+    out.write<uint32_t>(names.size());
+    for(auto& name: names) {
+        auto& animation = *mesh_.animations_.at(name);
+        auto frames = animation.frames.second - animation.frames.first;
+
+        out.write_string(name);
+        out.write<uint32_t>(animation.frames.first);
+        out.write<uint32_t>(animation.frames.second);
+        out.write<float>((animation.duration > 0.0f) ? float(frames) / animation.duration : mesh_.default_fps());
+    }
+
+    return file.good();
+}
+
+}
+}
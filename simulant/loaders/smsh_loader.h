@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../loader.h"
+
+namespace smlt {
+
+class Mesh;
+
+namespace loaders {
+
+/*
+ * .smsh is Simulant's own binary mesh format. It's intended as a cache for
+ * meshes which have already been loaded from another format, it stores the
+ * vertex and index data exactly as they're laid out in memory so loading is
+ * a handful of bulk copies rather than parsing.
+ *
+ * Files are written in the native byte order and aren't portable between
+ * platforms with different endianness.
+ */
+
+extern const uint32_t SMSH_VERSION;
+
+class SMSHLoader : public Loader {
+public:
+    SMSHLoader(const Path& filename, std::shared_ptr<std::istream> data):
+        Loader(filename, data) {}
+
+    void into(Loadable& resource, const LoaderOptions& options=LoaderOptions()) override;
+};
+
+class SMSHLoaderType : public LoaderType {
+public:
+    SMSHLoaderType() {
+        add_hint(LOADER_HINT_MESH);
+    }
+
+    virtual ~SMSHLoaderType() {}
+
+    const char* name() override { return "SMSH"; }
+    bool supports(const Path& filename) const override {
+        return filename.ext() == ".smsh";
+    }
+
+    Loader::ptr loader_for(const Path& filename, std::shared_ptr<std::istream> data) const override {
+        return Loader::ptr(new SMSHLoader(filename, data));
+    }
+};
+
+/*
+ * Writes any loaded mesh to a .smsh file. Vertex morph animations are baked
+ * to one set of vertices per frame. Skeletal animations aren't supported and
+ * are written in their bind pose.
+ *
+ * Materials are stored by value, with the source path of the diffuse map if
+ * it was loaded from a file.
+ */
+class SMSHWriter {
+public:
+    SMSHWriter(const Mesh& mesh):
+        mesh_(mesh) {}
+
+    bool write(const Path& filename);
+
+private:
+    const Mesh& mesh_;
+};
+
+}
+}
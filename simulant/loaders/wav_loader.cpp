@@ -23,7 +23,18 @@ static int convert_to_int(char* buffer, int len) {
     return a;
 }
 
-static bool read_riff(std::istream* stream, Sound* sound, std::size_t len) {
+/* Everything read from the file, it's handed to the Sound by into() */
+struct WAVData {
+    bool loaded = false;
+
+    uint32_t sample_rate = 0;
+    uint8_t channels = 0;
+    AudioDataFormat format = AUDIO_DATA_FORMAT_MONO8;
+
+    std::shared_ptr<std::stringstream> samples;
+};
+
+static bool read_riff(std::istream* stream, WAVData* wav, std::size_t len) {
     _S_UNUSED(len);
 
     char buffer[4];
@@ -54,23 +65,23 @@ static bool read_riff(std::istream* stream, Sound* sound, std::size_t len) {
         format = (bps == 8) ? AUDIO_DATA_FORMAT_STEREO8 : (bps == 16) ? AUDIO_DATA_FORMAT_STEREO16 : AUDIO_DATA_FORMAT_STEREO24;
     }
 
-    sound->set_sample_rate(freq);
-    sound->set_channels(channels);
-    sound->set_format(format);
+    wav->sample_rate = freq;
+    wav->channels = channels;
+    wav->format = format;
     return true;
 }
 
-static bool read_junk(std::istream*, Sound*, std::size_t) {
+static bool read_junk(std::istream*, WAVData*, std::size_t) {
     return true;
 }
 
-static bool read_data(std::istream* stream, Sound* sound, std::size_t len) {
+static bool read_data(std::istream* stream, WAVData* wav, std::size_t len) {
     std::vector<uint8_t> data;
 
     data.resize(len);
     stream->read((char*) &data[0], len);
 
-    auto format = sound->format();
+    auto format = wav->format;
 
     if(format == AUDIO_DATA_FORMAT_MONO24 || format == AUDIO_DATA_FORMAT_STEREO24) {
         // Downsample to 16 bit
@@ -85,18 +96,18 @@ static bool read_data(std::istream* stream, Sound* sound, std::size_t len) {
         }
 
         std::swap(data, new_data);
-        sound->set_format((format == AUDIO_DATA_FORMAT_MONO24) ? AUDIO_DATA_FORMAT_MONO16 : AUDIO_DATA_FORMAT_STEREO16);
+        wav->format = (format == AUDIO_DATA_FORMAT_MONO24) ? AUDIO_DATA_FORMAT_MONO16 : AUDIO_DATA_FORMAT_STEREO16;
     }
 
     auto ss = std::make_shared<std::stringstream>();
     ss->write((char*) &data[0], data.size());
     ss->seekg(0);
 
-    sound->set_input_stream(ss);
+    wav->samples = ss;
     return true;
 }
 
-typedef std::function<bool (std::istream* stream, Sound* sound, std::size_t len)> ChunkFunc;
+typedef std::function<bool (std::istream* stream, WAVData* wav, std::size_t len)> ChunkFunc;
 
 static ChunkFunc get_chunk_func(const std::string& name) {
     if(name == std::string("RIFF")) return read_riff;
@@ -104,12 +115,10 @@ static ChunkFunc get_chunk_func(const std::string& name) {
     return read_junk;
 }
 
-void WAVLoader::into(Loadable& resource, const LoaderOptions &options) {
+void WAVLoader::prepare(const LoaderOptions& options) {
     _S_UNUSED(options);
 
-    Loadable* res_ptr = &resource;
-    Sound* sound = dynamic_cast<Sound*>(res_ptr);
-    assert(sound && "You passed a Resource that is not a Sound to the OGG loader");
+    prepared_ = std::make_shared<WAVData>();
 
     while(!data_->eof()) {
         char buffer[4];
@@ -129,7 +138,7 @@ void WAVLoader::into(Loadable& resource, const LoaderOptions &options) {
         }
 
         auto func = get_chunk_func(chunk_id);
-        if(!func(data_.get(), sound, size)) {
+        if(!func(data_.get(), prepared_.get(), size)) {
             S_ERROR("Unsupported .wav format");
             return;
         }
@@ -140,6 +149,34 @@ void WAVLoader::into(Loadable& resource, const LoaderOptions &options) {
         data_->seekg(offset + size);
     }
 
+    prepared_->loaded = true;
+}
+
+void WAVLoader::into(Loadable& resource, const LoaderOptions &options) {
+    Loadable* res_ptr = &resource;
+    Sound* sound = dynamic_cast<Sound*>(res_ptr);
+    assert(sound && "You passed a Resource that is not a Sound to the OGG loader");
+
+    /* Loaded synchronously */
+    if(!prepared_) {
+        prepare(options);
+    }
+
+    auto prepared = prepared_;
+    prepared_.reset();
+
+    if(!prepared->loaded) {
+        return;
+    }
+
+    sound->set_sample_rate(prepared->sample_rate);
+    sound->set_channels(prepared->channels);
+    sound->set_format(prepared->format);
+
+    if(prepared->samples) {
+        sound->set_input_stream(prepared->samples);
+    }
+
     std::weak_ptr<Sound> wptr = sound->shared_from_this();
 
     sound->set_playing_sound_init_function([wptr](PlayingSound& source) {
@@ -7,6 +7,8 @@
 namespace smlt {
 namespace loaders {
 
+struct WAVData;
+
 class WAVLoader : public Loader {
 public:
     WAVLoader(const Path& filename, std::shared_ptr<std::istream> data):
@@ -14,6 +16,12 @@ public:
 
     void into(Loadable& resource, const LoaderOptions &options=LoaderOptions());
 
+    /* Reads the header and samples, into() then only hands them to the
+     * sound */
+    void prepare(const LoaderOptions& options=LoaderOptions()) override;
+
+private:
+    std::shared_ptr<WAVData> prepared_;
 };
 
 class WAVLoaderType : public LoaderType {
@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+ * Minimal 4-wide float helpers used by the particle kernels and the occlusion
+ * buffer. This is an internal header, it's only included from .cpp files so
+ * that intrinsics don't leak into the public API.
+ *
+ * All loads and stores are aligned, callers must keep their streams 16-byte
+ * aligned.
+ */
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SIMULANT_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMULANT_SIMD_NEON 1
+#endif
+
+namespace smlt {
+namespace simd {
+
+#if defined(SIMULANT_SIMD_SSE)
+
+typedef __m128 float4;
+
+inline float4 load(const float* p) { return _mm_load_ps(p); }
+inline void store(float* p, float4 v) { _mm_store_ps(p, v); }
+inline float4 splat(float v) { return _mm_set1_ps(v); }
+inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+inline float4 div(float4 a, float4 b) { return _mm_div_ps(a, b); }
+inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline float4 min(float4 a, float4 b) { return _mm_min_ps(a, b); }
+inline float4 max(float4 a, float4 b) { return _mm_max_ps(a, b); }
+
+/* Bit n is set if lane n of a is <= lane n of b */
+inline uint32_t less_equal_mask(float4 a, float4 b) {
+    return uint32_t(_mm_movemask_ps(_mm_cmple_ps(a, b)));
+}
+
+#elif defined(SIMULANT_SIMD_NEON)
+
+typedef float32x4_t float4;
+
+inline float4 load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, float4 v) { vst1q_f32(p, v); }
+inline float4 splat(float v) { return vdupq_n_f32(v); }
+inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+inline float4 min(float4 a, float4 b) { return vminq_f32(a, b); }
+inline float4 max(float4 a, float4 b) { return vmaxq_f32(a, b); }
+
+inline float4 div(float4 a, float4 b) {
+    /* Reciprocal estimate plus two Newton-Raphson steps */
+    float4 r = vrecpeq_f32(b);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    return vmulq_f32(a, r);
+}
+
+inline uint32_t less_equal_mask(float4 a, float4 b) {
+    const uint32_t bits_data[4] = {1, 2, 4, 8};
+    uint32x4_t m = vandq_u32(vcleq_f32(a, b), vld1q_u32(bits_data));
+    uint32x2_t s = vadd_u32(vget_low_u32(m), vget_high_u32(m));
+    return vget_lane_u32(vpadd_u32(s, s), 0);
+}
+
+#else
+
+struct float4 {
+    float v[4];
+};
+
+#define _S_FLOAT4_OP(name, expr) \
+    inline float4 name(float4 a, float4 b) { \
+        float4 o; \
+        for(int i = 0; i < 4; ++i) { o.v[i] = (expr); } \
+        return o; \
+    }
+
+_S_FLOAT4_OP(add, a.v[i] + b.v[i])
+_S_FLOAT4_OP(sub, a.v[i] - b.v[i])
+_S_FLOAT4_OP(mul, a.v[i] * b.v[i])
+_S_FLOAT4_OP(div, a.v[i] / b.v[i])
+_S_FLOAT4_OP(min, (a.v[i] < b.v[i]) ? a.v[i] : b.v[i])
+_S_FLOAT4_OP(max, (a.v[i] > b.v[i]) ? a.v[i] : b.v[i])
+
+#undef _S_FLOAT4_OP
+
+inline float4 load(const float* p) { return float4{{p[0], p[1], p[2], p[3]}}; }
+inline void store(float* p, float4 v) { for(int i = 0; i < 4; ++i) { p[i] = v.v[i]; } }
+inline float4 splat(float v) { return float4{{v, v, v, v}}; }
+inline float4 madd(float4 a, float4 b, float4 c) { return add(mul(a, b), c); }
+
+inline uint32_t less_equal_mask(float4 a, float4 b) {
+    uint32_t mask = 0;
+    for(int i = 0; i < 4; ++i) {
+        mask |= uint32_t(a.v[i] <= b.v[i]) << i;
+    }
+    return mask;
+}
+
+#endif
+
+}
+}
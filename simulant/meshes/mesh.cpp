@@ -57,6 +57,7 @@ Mesh::Mesh(MeshID id,
 void Mesh::reset(VertexDataPtr vertex_data) {
     adjacency_.reset();
     submeshes_.clear();
+    ++submesh_version_;
 
     animation_type_ = MESH_ANIMATION_TYPE_NONE;
     animation_frames_ = 0;
@@ -77,6 +78,7 @@ void Mesh::reset(VertexDataPtr vertex_data) {
 void Mesh::reset(VertexSpecification vertex_specification) {
     adjacency_.reset();
     submeshes_.clear();
+    ++submesh_version_;
 
     animation_type_ = MESH_ANIMATION_TYPE_NONE;
     animation_frames_ = 0;
@@ -211,6 +213,7 @@ SubMesh* Mesh::new_submesh_with_material(
         this, name, mat, index_data, arrangement
     );
     submeshes_.push_back(new_submesh);
+    ++submesh_version_;
 
     signal_submesh_created_(id(), new_submesh.get());
 
@@ -652,6 +655,8 @@ void Mesh::destroy_submesh(const std::string& name) {
     if(it != submeshes_.end()) {
         auto submesh = (*it);
         submeshes_.erase(it);
+        ++submesh_version_;
+
         signal_submesh_destroyed_(id(), submesh.get());
     }
 }
@@ -729,6 +734,107 @@ SubMesh* Mesh::find_submesh(const std::string& name) const {
     return nullptr;
 }
 
+void Mesh::set_lod_mesh(DetailLevel detail_level, MeshPtr mesh) {
+    assert(detail_level < DETAIL_LEVEL_MAX);
+    lods_[detail_level] = mesh;
+    ++submesh_version_;
+
+    signal_lods_changed_(id());
+}
+
+MeshPtr Mesh::lod_mesh(DetailLevel detail_level) const {
+    assert(detail_level < DETAIL_LEVEL_MAX);
+    return lods_[detail_level];
+}
+
+LODReport Mesh::generate_lods(const LODOptions& options) {
+    LODReport report;
+
+    if(is_animated()) {
+        S_WARN("Not generating LODs for animated mesh {0}", id());
+        return report;
+    }
+
+    std::vector<Vec3> positions(vertex_data_->count());
+    for(uint32_t i = 0; i < positions.size(); ++i) {
+        auto p = vertex_data_->position_nd_at(i);
+        positions[i] = Vec3(p.x, p.y, p.z);
+    }
+
+    /* Only triangle lists are simplified, anything else is copied to every
+     * level unchanged */
+    std::vector<SubMesh*> sources;
+    std::vector<std::vector<uint32_t>> triangle_lists;
+    uint32_t source_triangles = 0;
+
+    for(auto submesh: submeshes_) {
+        if(submesh->arrangement() == MESH_ARRANGEMENT_TRIANGLES) {
+            sources.push_back(submesh.get());
+            triangle_lists.push_back(submesh->index_data->all());
+            source_triangles += triangle_lists.back().size() / 3;
+        }
+    }
+
+    report.triangle_counts[DETAIL_LEVEL_NEAREST] = source_triangles;
+
+    MeshPtr previous;
+    for(uint32_t level = DETAIL_LEVEL_NEAR; level < DETAIL_LEVEL_MAX; ++level) {
+        auto target = uint32_t(float(source_triangles) * options.ratios[level]);
+
+        /* Each level carries on from the last, which is both faster and
+         * keeps the levels consistent with each other */
+        auto result = utils::simplify(positions, triangle_lists, target, options.max_error);
+
+        report.triangle_counts[level] = result.triangles_after;
+        report.errors[level] = std::max(report.errors[level - 1], result.error);
+
+        /* Nothing more could be collapsed, reuse the last level (if any) */
+        if(result.triangles_after == result.triangles_before) {
+            set_lod_mesh((DetailLevel) level, previous);
+            continue;
+        }
+
+        auto lod = asset_manager().new_mesh(vertex_data_);
+
+        uint32_t list = 0;
+        for(auto submesh: submeshes_) {
+            auto index_type = submesh->index_data->index_type();
+            auto target_submesh = lod->new_submesh_with_material(
+                submesh->name(),
+                submesh->material_at_slot(MATERIAL_SLOT0)->id(),
+                submesh->arrangement(),
+                index_type
+            );
+
+            for(uint32_t slot = MATERIAL_SLOT1; slot < MATERIAL_SLOT_MAX; ++slot) {
+                auto material = submesh->material_at_slot((MaterialSlot) slot);
+                if(material) {
+                    target_submesh->set_material_at_slot((MaterialSlot) slot, material);
+                }
+            }
+
+            if(list < sources.size() && sources[list] == submesh.get()) {
+                auto& indices = triangle_lists[list++];
+                if(!indices.empty()) {
+                    target_submesh->index_data->index(&indices[0], indices.size());
+                }
+            } else {
+                auto indices = submesh->index_data->all();
+                if(!indices.empty()) {
+                    target_submesh->index_data->index(&indices[0], indices.size());
+                }
+            }
+
+            target_submesh->index_data->done();
+        }
+
+        set_lod_mesh((DetailLevel) level, lod);
+        previous = lod;
+    }
+
+    return report;
+}
+
 void Mesh::generate_adjacency_info() {
     adjacency_.reset(new AdjacencyInfo(this));
     adjacency_->rebuild();
@@ -39,6 +39,7 @@
 #include "../types.h"
 #include "../interfaces.h"
 #include "../animation.h"
+#include "../utils/mesh/simplify.h"
 
 namespace smlt {
 
@@ -49,6 +50,11 @@ class Rig;
 class Skeleton;
 class Debug;
 
+namespace loaders {
+    class SMSHLoader;
+    class SMSHWriter;
+}
+
 enum MeshAnimationType {
     MESH_ANIMATION_TYPE_NONE,
     MESH_ANIMATION_TYPE_VERTEX_MORPH,
@@ -88,6 +94,30 @@ public:
         VertexData* const out,
         Debug* const debug=nullptr
     ) = 0;
+
+    /* Vertex morph unpackers can return each keyframe as a complete,
+     * unchanging set of vertices. Renderers which support it then keep every
+     * keyframe on the GPU and blend the current and next frames in the
+     * shader, rather than calling unpack_frame. Returns null if the frame
+     * can't be provided this way. */
+    virtual const VertexData* keyframe_vertex_data(uint32_t frame) {
+        _S_UNUSED(frame);
+        return nullptr;
+    }
+
+    /* Skeletal unpackers can return the joint indices (texcoord0) and
+     * weights (texcoord1) of each vertex as unchanging vertex data, and
+     * the joint matrices of the rig's current pose. Renderers which support
+     * it then skin the mesh's own vertices in the shader, rather than
+     * calling unpack_frame. Returns null if that isn't possible. */
+    virtual const VertexData* skin_vertex_data() {
+        return nullptr;
+    }
+
+    virtual void build_joint_palette(Rig* const rig, std::vector<Mat4>& palette) {
+        _S_UNUSED(rig);
+        palette.clear();
+    }
 };
 
 typedef std::shared_ptr<FrameUnpacker> FrameUnpackerPtr;
@@ -269,16 +299,34 @@ public:
     void generate_adjacency_info();
     bool has_adjacency_info() const { return bool(adjacency_); }
 
+    /* Incremented whenever a submesh is created or destroyed, or has a
+     * material changed, or an LOD mesh is set */
+    uint32_t submesh_version() const { return submesh_version_; }
+
+    /* Lower detail versions of this mesh. Actors using this mesh will pick
+     * these up for any detail level they haven't been given a mesh for */
+    void set_lod_mesh(DetailLevel detail_level, MeshPtr mesh);
+    MeshPtr lod_mesh(DetailLevel detail_level) const;
+
+    /* Generates a simplified mesh for each detail level beyond
+     * DETAIL_LEVEL_NEAREST, sharing this mesh's vertex data. Animated meshes
+     * are left alone. */
+    LODReport generate_lods(const LODOptions& options=LODOptions());
+
 public:
     // Signals
 
     typedef sig::signal<void (Skeleton*)> SkeletonAddedSignal;
+    typedef sig::signal<void (MeshID)> LODsChangedSignal;
     typedef sig::signal<void (MeshID, SubMeshPtr)> SubMeshCreatedCallback;
     typedef sig::signal<void (MeshID, SubMeshPtr)> SubMeshDestroyedCallback;
     typedef sig::signal<void (MeshID, SubMeshPtr, MaterialSlot, MaterialID, MaterialID)> SubMeshMaterialChangedCallback;
 
     DEFINE_SIGNAL(SkeletonAddedSignal, signal_skeleton_added);
 
+    /* Fired whenever set_lod_mesh() (or generate_lods()) changes a level */
+    DEFINE_SIGNAL(LODsChangedSignal, signal_lods_changed);
+
     SubMeshCreatedCallback& signal_submesh_created() { return signal_submesh_created_; }
     SubMeshDestroyedCallback& signal_submesh_destroyed() { return signal_submesh_destroyed_; }
     SubMeshMaterialChangedCallback& signal_submesh_material_changed() { return signal_submesh_material_changed_; }
@@ -286,6 +334,8 @@ public:
 private:
     friend class SubMesh;
     friend class Actor;
+    friend class loaders::SMSHLoader;
+    friend class loaders::SMSHWriter;
 
     Skeleton* skeleton_ = nullptr;
 
@@ -295,6 +345,9 @@ private:
     FrameUnpackerPtr animated_frame_data_;
 
     std::vector<std::shared_ptr<SubMesh>> submeshes_;
+    uint32_t submesh_version_ = 0;
+
+    MeshPtr lods_[DETAIL_LEVEL_MAX];
 
     SubMeshCreatedCallback signal_submesh_created_;
     SubMeshDestroyedCallback signal_submesh_destroyed_;
@@ -288,6 +288,8 @@ void SubMesh::set_material_at_slot(MaterialSlot var, MaterialPtr mat) {
         materials_[var].reset();
     }
 
+    ++parent_->submesh_version_;
+
     signal_material_changed_(this, var, old_material_id, mat->id());
     parent_->signal_submesh_material_changed_(
         parent_->id(),
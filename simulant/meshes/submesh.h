@@ -12,6 +12,11 @@ class IndexData;
 class Mesh;
 class Renderer;
 
+namespace loaders {
+    class SMSHLoader;
+    class SMSHWriter;
+}
+
 enum MaterialSlot {
     MATERIAL_SLOT0,
     MATERIAL_SLOT1,
@@ -81,6 +86,8 @@ public:
 
 private:
     friend class Mesh;
+    friend class loaders::SMSHLoader;
+    friend class loaders::SMSHWriter;
 
     sig::connection material_change_connection_;
 
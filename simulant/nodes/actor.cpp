@@ -23,6 +23,7 @@
 #include "../stage.h"
 #include "../animation.h"
 #include "../renderers/renderer.h"
+#include "../window.h"
 #include "../assets/meshes/rig.h"
 
 #define DEBUG_ANIMATION 0  /* If enabled, will show debug animation overlay */
@@ -46,6 +47,7 @@ Actor::Actor(Stage* stage, SoundDriver *sound_driver, MeshID mesh):
 
 Actor::~Actor() {
     mesh_skeleton_added_.disconnect();
+    mesh_lods_changed_.disconnect();
     submesh_created_connection_.disconnect();
     submesh_destroyed_connection_.disconnect();
 }
@@ -91,9 +93,14 @@ void Actor::set_mesh(MeshID mesh, DetailLevel detail_level) {
             return;
         }
 
+        if(detail_level == DETAIL_LEVEL_NEAREST) {
+            mesh_lods_changed_.disconnect();
+        }
+
         meshes_[detail_level].reset();
         interpolated_vertex_data_.reset();
         recalc_effective_meshes();
+        invalidate_renderables();
 
         // FIXME: Delete vertex buffer!
         return;
@@ -144,12 +151,22 @@ void Actor::set_mesh(MeshID mesh, DetailLevel detail_level) {
             /* No skeleton on the mesh we just set, so delete the rig */
             rig_.reset();
         }
+
+        /* Pick up any LODs generated for the base mesh from now on */
+        mesh_lods_changed_.disconnect();
+        mesh_lods_changed_ = meshes_[DETAIL_LEVEL_NEAREST]->signal_lods_changed().connect(
+            [this](MeshID) {
+                recalc_effective_meshes();
+                invalidate_renderables();
+            }
+        );
     }
 
     recalc_effective_meshes();
 
     /* Recalculate the AABB if necessary */
     mark_transformed_aabb_dirty();
+    invalidate_renderables();
 
     signal_mesh_changed_(id());
 }
@@ -168,6 +185,8 @@ void Actor::refresh_animation_state(uint32_t current_frame, uint32_t next_frame,
 
     assert(base_mesh && base_mesh->is_animated());
 
+    pose_stale_ = true;
+
 #ifdef DEBUG_ANIMATION
     stage->enable_debug();
     stage->debug->set_transform(absolute_transformation());
@@ -241,28 +260,26 @@ void Actor::_get_renderables(batcher::RenderQueue* render_queue, const CameraPtr
         return;
     }
 
-    if(mesh->is_animated()) {
-        /*
-         * Update the vertices for the animated base mesh if that's the
-         * detail level we're using - if this is a skeletal animation then
-         * the current rig will be used
-         */
-        mesh->animated_frame_data_->unpack_frame(
-            animation_state->current_frame(),
-            animation_state->next_frame(),
-            animation_state->interp(),
-            rig_.get(),
-            interpolated_vertex_data_.get()
-    #if DEBUG_ANIMATION
-            , stage->debug
-    #endif
-        );
+    if(mesh->is_animated() && pose_stale_) {
+        /* The compositor evaluates the pose before gathering, this is only
+         * hit when renderables are requested outside of a frame */
+        refresh_pose(mesh);
     }
 
-    auto vdata = (has_animated_mesh()) ?
+    const VertexData* vdata = (has_animated_mesh()) ?
         interpolated_vertex_data_.get() :
         mesh->vertex_data.get();
 
+    const bool morphing = mesh->is_animated() && morph_from_;
+    if(morphing) {
+        vdata = morph_from_;
+    }
+
+    const bool skinning = mesh->is_animated() && skin_data_;
+    if(skinning) {
+        vdata = mesh->vertex_data.get();
+    }
+
     for(auto submesh: mesh->each_submesh()) {
         Renderable new_renderable;
         new_renderable.final_transformation = absolute_transformation();
@@ -270,6 +287,13 @@ void Actor::_get_renderables(batcher::RenderQueue* render_queue, const CameraPtr
         new_renderable.is_visible = is_visible();
         new_renderable.arrangement = submesh->arrangement();
         new_renderable.vertex_data = vdata;
+        if(morphing) {
+            new_renderable.morph_target = morph_to_;
+            new_renderable.morph_weight = morph_weight_;
+        } else if(skinning) {
+            new_renderable.skin_data = skin_data_;
+            new_renderable.joint_palette = &joint_palette_;
+        }
         new_renderable.index_data = submesh->index_data.get();
         new_renderable.index_element_count = new_renderable.index_data->count();
         new_renderable.material = submesh->material_at_slot(material_slot_, true).get();
@@ -279,14 +303,152 @@ void Actor::_get_renderables(batcher::RenderQueue* render_queue, const CameraPtr
     }
 }
 
-void Actor::recalc_effective_meshes() {
+void Actor::refresh_pose(MeshPtr mesh) {
+    if(!select_gpu_morph(mesh) && !select_gpu_skinning(mesh)) {
+        unpack_pose(mesh);
+    }
+
+    pose_stale_ = false;
+}
+
+void Actor::unpack_pose(MeshPtr mesh) {
+    /*
+     * Update the vertices for the animated base mesh - if this is a
+     * skeletal animation then the current rig will be used
+     */
+    mesh->animated_frame_data_->unpack_frame(
+        animation_state->current_frame(),
+        animation_state->next_frame(),
+        animation_state->interp(),
+        rig_.get(),
+        interpolated_vertex_data_.get()
+#if DEBUG_ANIMATION
+        , stage->debug
+#endif
+    );
+}
+
+bool Actor::select_gpu_morph(MeshPtr mesh) {
+    morph_from_ = morph_to_ = nullptr;
+
+    if(mesh->animation_type() != MESH_ANIMATION_TYPE_VERTEX_MORPH) {
+        return false;
+    }
+
+    /* This is re-checked each frame as materials can be swapped at any time */
+    auto renderer = stage->window->renderer.get();
+    for(auto submesh: mesh->each_submesh()) {
+        if(!renderer->supports_gpu_morphing(submesh->material_at_slot(material_slot_, true).get())) {
+            return false;
+        }
+    }
+
+    auto& unpacker = mesh->animated_frame_data_;
+    auto from = unpacker->keyframe_vertex_data(animation_state->current_frame());
+    auto to = unpacker->keyframe_vertex_data(animation_state->next_frame());
+
+    if(!from || !to) {
+        return false;
+    }
+
+    morph_from_ = from;
+    morph_to_ = to;
+    morph_weight_ = animation_state->interp();
+    return true;
+}
+
+bool Actor::select_gpu_skinning(MeshPtr mesh) {
+    skin_data_ = nullptr;
+
+    if(mesh->animation_type() != MESH_ANIMATION_TYPE_SKELETAL || !rig_) {
+        return false;
+    }
+
+    /* The renderer falls back to CPU skinning if the palette won't fit in
+     * its uniforms */
+    auto renderer = stage->window->renderer.get();
+    const uint32_t joint_count = rig_->joint_count();
+    for(auto submesh: mesh->each_submesh()) {
+        if(!renderer->supports_gpu_skinning(submesh->material_at_slot(material_slot_, true).get(), joint_count)) {
+            return false;
+        }
+    }
+
+    auto& unpacker = mesh->animated_frame_data_;
+    auto skin_data = unpacker->skin_vertex_data();
+    if(!skin_data) {
+        return false;
+    }
+
+    unpacker->build_joint_palette(rig_.get(), joint_palette_);
+    skin_data_ = skin_data;
+    return true;
+}
+
+PoseEvaluation Actor::evaluate_pose(uint64_t frame_id) {
+    if(!has_animated_mesh_ || !animation_state_) {
+        return POSE_EVALUATION_NONE;
+    }
+
+    if(frame_id == pose_frame_id_) {
+        return POSE_EVALUATION_REUSED;
+    }
+
+    refresh_pose(meshes_[DETAIL_LEVEL_NEAREST]);
+
+    pose_frame_id_ = frame_id;
+    return POSE_EVALUATION_EVALUATED;
+}
+
+uint64_t Actor::renderables_version() const {
+    /* Animated meshes are unpacked in _get_renderables so must
+     * always be gathered */
+    if(has_animated_mesh_) {
+        return 0;
+    }
+
+    /* Moving invalidates our renderables, but only once it's resolved */
+    resolve_transformation();
+
+    uint64_t mesh_versions = 0;
+    for(auto& mesh: meshes_) {
+        if(mesh) {
+            mesh_versions += mesh->submesh_version();
+        }
+    }
+
+    if(mesh_versions != last_mesh_versions_) {
+        last_mesh_versions_ = mesh_versions;
+
+        /* LOD meshes set on the base mesh are handled by
+         * signal_lods_changed, but their submeshes may have changed */
+        recalc_effective_meshes();
+        invalidate_renderables();
+    }
+
+    return cached_renderables_version();
+}
+
+void Actor::on_render_priority_changed(RenderPriority old_priority, RenderPriority new_priority) {
+    _S_UNUSED(old_priority);
+    _S_UNUSED(new_priority);
+
+    invalidate_renderables();
+}
+
+void Actor::recalc_effective_meshes() const {
     MeshPtr current = meshes_[0];
     for(auto i = 0; i < DETAIL_LEVEL_MAX; ++i) {
         effective_meshes_[i] = current;
 
         if(i < DETAIL_LEVEL_MAX - 1) {
-            if(meshes_[i + 1]) {
-                current = meshes_[i + 1];
+            auto level = (DetailLevel) (i + 1);
+
+            /* Meshes set on the actor win over any the mesh generated */
+            if(meshes_[level]) {
+                current = meshes_[level];
+            } else if(meshes_[0] && meshes_[0]->lod_mesh(level)) {
+                current = meshes_[0]->lod_mesh(level);
             }
         }
     }
@@ -79,9 +79,14 @@ public:
     }
 
     void _get_renderables(batcher::RenderQueue* render_queue, const CameraPtr camera, const DetailLevel detail_level) override;
+    uint64_t renderables_version() const override;
+    PoseEvaluation evaluate_pose(uint64_t frame_id) override;
 
     void use_material_slot(MaterialSlot var) {
-        material_slot_ = var;
+        if(var != material_slot_) {
+            material_slot_ = var;
+            invalidate_renderables();
+        }
     }
 
     MaterialSlot active_material_slot() const {
@@ -106,16 +111,48 @@ private:
     // Used for animated meshes
     std::shared_ptr<VertexData> interpolated_vertex_data_;
 
+    /* The compositor frame interpolated_vertex_data_ was last unpacked for,
+     * zero if it has never been asked */
+    uint64_t pose_frame_id_ = 0;
+
+    /* Set whenever the animation state moves on, cleared once the pose
+     * has been evaluated for it */
+    bool pose_stale_ = true;
+    void refresh_pose(MeshPtr mesh);
+    void unpack_pose(MeshPtr mesh);
+
+    /* When the renderer blends keyframes itself these are the two frames
+     * being drawn, and interpolated_vertex_data_ isn't touched */
+    const VertexData* morph_from_ = nullptr;
+    const VertexData* morph_to_ = nullptr;
+    float morph_weight_ = 0.0f;
+    bool select_gpu_morph(MeshPtr mesh);
+
+    /* Likewise when the renderer skins the mesh, the bind pose is drawn
+     * with these joint weights and the rig's current joint matrices */
+    const VertexData* skin_data_ = nullptr;
+    std::vector<Mat4> joint_palette_;
+    bool select_gpu_skinning(MeshPtr mesh);
+
     /* Meshes specified for each level */
     MeshPtr meshes_[DETAIL_LEVEL_MAX];
 
-    /* Quick lookup for which mesh is active at a detail level */
-    MeshPtr effective_meshes_[DETAIL_LEVEL_MAX];
+    /* Quick lookup for which mesh is active at a detail level, this
+     * depends on the LODs of the base mesh so is refreshed lazily */
+    mutable MeshPtr effective_meshes_[DETAIL_LEVEL_MAX];
 
-    void recalc_effective_meshes();
+    void recalc_effective_meshes() const;
 
     bool has_animated_mesh_ = false;
 
+    /* Sum of the submesh versions of meshes_ when renderables_version()
+     * was last called */
+    mutable uint64_t last_mesh_versions_ = 0;
+
+    void on_render_priority_changed(
+        RenderPriority old_priority, RenderPriority new_priority
+    ) override;
+
     std::shared_ptr<KeyFrameAnimationState> animation_state_;
 
     MeshChangedCallback signal_mesh_changed_;
@@ -133,6 +170,7 @@ private:
     std::unique_ptr<Rig> rig_;
     void add_rig(const Skeleton* skeleton);
     sig::connection mesh_skeleton_added_;
+    sig::connection mesh_lods_changed_;
 
 public:
     S_DEFINE_PROPERTY(animation_state, &Actor::animation_state_);
@@ -27,15 +27,24 @@ void Camera::update(float dt) {
     update_source(dt);
 }
 
-void Camera::update_transformation_from_parent() {
-    StageNode::update_transformation_from_parent();
-    transform_ = absolute_transformation();
+void Camera::on_transformation_resolved() {
+    StageNode::on_transformation_resolved();
     update_frustum();
 }
 
+const Mat4& Camera::view_matrix() const {
+    resolve_transformation();
+    return view_matrix_;
+}
+
+Frustum& Camera::frustum() {
+    resolve_transformation();
+    return frustum_;
+}
+
 void Camera::update_frustum() {
     //Recalculate the view matrix
-    view_matrix_ = transform_.inversed();
+    view_matrix_ = absolute_transformation().inversed();
 
     Mat4 mvp = projection_matrix_ * view_matrix_;
 
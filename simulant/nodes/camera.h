@@ -46,10 +46,10 @@ public:
     // Converts a pixel to OpenGL units (z-input should be read from the depth buffer)
     smlt::optional<Vec3> unproject_point(const RenderTarget& target, const Viewport& viewport, const Vec3& win_point);
 
-    const Mat4& view_matrix() const { return view_matrix_; }
+    const Mat4& view_matrix() const;
     const Mat4& projection_matrix() const { return projection_matrix_; }
 
-    Frustum& frustum() { return frustum_; }
+    Frustum& frustum();
 
     void set_perspective_projection(const Degrees &fov, double aspect, double near=1.0, double far=1000.0f);
     void set_orthographic_projection(double left, double right, double bottom, double top, double near=-1.0, double far=1.0);
@@ -59,13 +59,12 @@ private:
     AABB bounds_;
     Frustum frustum_;
 
-    smlt::Mat4 transform_;
     Mat4 view_matrix_;
     Mat4 projection_matrix_;
 
     void update_frustum();
 
-    void update_transformation_from_parent() override;
+    void on_transformation_resolved() override;
 };
 
 }
@@ -21,6 +21,7 @@
 #include "../stage.h"
 #include "geoms/octree_culler.h"
 #include "geoms/quadtree_culler.h"
+#include "geoms/bsp_pvs_culler.h"
 #include "camera.h"
 
 namespace smlt {
@@ -46,10 +47,20 @@ bool Geom::init() {
         return false;
     }
 
-    if(culler_options_.type == GEOM_CULLER_TYPE_QUADTREE) {
+    auto type = culler_options_.type;
+    if(type == GEOM_CULLER_TYPE_BSP_PVS && !mesh_ptr->data->exists(BSP_VISIBILITY_DATA_KEY)) {
+        S_WARN("Mesh has no BSP visibility data, falling back to an octree culler");
+        type = GEOM_CULLER_TYPE_OCTREE;
+    }
+
+    if(type == GEOM_CULLER_TYPE_QUADTREE) {
         culler_.reset(new QuadtreeCuller(this, mesh_ptr, culler_options_.quadtree_max_depth));
+    } else if(type == GEOM_CULLER_TYPE_BSP_PVS) {
+        culler_.reset(new BSPPVSCuller(
+            this, mesh_ptr, mesh_ptr->data->get<BSPVisibilityPtr>(BSP_VISIBILITY_DATA_KEY)
+        ));
     } else {
-        assert(culler_options_.type == GEOM_CULLER_TYPE_OCTREE);
+        assert(type == GEOM_CULLER_TYPE_OCTREE);
         culler_.reset(new OctreeCuller(this, mesh_ptr, culler_options_.octree_max_depth));
     }
 
@@ -67,7 +78,15 @@ const AABB &Geom::aabb() const {
 void Geom::_get_renderables(batcher::RenderQueue* render_queue, const CameraPtr camera, const DetailLevel detail_level) {
     _S_UNUSED(detail_level);
 
-    culler_->renderables_visible(camera->frustum(), render_queue);
+    culler_->renderables_visible(camera->frustum(), camera->absolute_position(), render_queue);
+}
+
+void Geom::use_mesh_as_occluder() {
+    set_occluder_mesh(stage->assets->mesh(mesh_id_));
+}
+
+Mat4 Geom::occluder_transformation() const {
+    return Mat4(desired_rotation, desired_transform, desired_scale);
 }
 
 
@@ -34,7 +34,11 @@ class GeomCuller;
 
 enum GeomCullerType {
     GEOM_CULLER_TYPE_OCTREE,
-    GEOM_CULLER_TYPE_QUADTREE
+    GEOM_CULLER_TYPE_QUADTREE,
+
+    /* Uses the BSP tree and PVS stashed in the mesh by its loader (e.g. Quake
+     * 2 maps), falls back to an octree if the mesh doesn't have them */
+    GEOM_CULLER_TYPE_BSP_PVS
 };
 
 struct GeomCullerOptions {
@@ -83,6 +87,14 @@ public:
     bool init() override;
 
     void _get_renderables(batcher::RenderQueue* render_queue, const CameraPtr camera, const DetailLevel detail_level) override;
+
+    /* Occlude with the Geom's own mesh. This is only worthwhile for simple
+     * geometry, otherwise pass a hull to set_occluder_mesh() */
+    void use_mesh_as_occluder();
+
+    /* The vertices of a Geom are transformed when it's compiled, rather
+     * than through the node */
+    Mat4 occluder_transformation() const override;
 private:
     MeshID mesh_id_;
     GeomCullerOptions culler_options_;
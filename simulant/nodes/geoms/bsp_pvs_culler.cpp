@@ -0,0 +1,269 @@
+#include <limits>
+
+#include "bsp_pvs_culler.h"
+
+#include "../../frustum.h"
+#include "../../meshes/mesh.h"
+#include "../../assets/material.h"
+#include "../../renderers/batching/render_queue.h"
+#include "../../renderers/batching/renderable.h"
+#include "../geom.h"
+
+namespace smlt {
+
+const char* BSP_VISIBILITY_DATA_KEY = "bsp_visibility";
+
+int32_t BSPVisibility::find_leaf(const Vec3& point) const {
+    if(leaves.empty()) {
+        return -1;
+    }
+
+    int32_t index = 0;
+    while(index >= 0) {
+        if(index >= (int32_t) nodes.size()) {
+            return -1;
+        }
+
+        auto& node = nodes[index];
+        float d = node.normal.dot(point) - node.distance;
+        index = node.children[(d >= 0.0f) ? 0 : 1];
+    }
+
+    auto leaf = -(index + 1);
+    return (leaf < (int32_t) leaves.size()) ? leaf : -1;
+}
+
+void BSPVisibility::decompress_pvs(int32_t cluster, std::vector<uint8_t>& out) const {
+    auto bytes = (cluster_count() + 7) / 8;
+
+    if(cluster < 0 || cluster >= (int32_t) pvs_offsets.size() || pvs_offsets[cluster] >= pvs_data.size()) {
+        /* No visibility information, so everything is potentially visible */
+        out.assign(bytes, 0xFF);
+        return;
+    }
+
+    out.assign(bytes, 0);
+
+    /* Non-zero bytes are copied as-is, a zero is followed by the number of
+     * zero bytes it stands for */
+    auto src = pvs_offsets[cluster];
+    uint32_t dest = 0;
+    while(dest < bytes && src < pvs_data.size()) {
+        if(pvs_data[src]) {
+            out[dest++] = pvs_data[src++];
+        } else if(src + 1 < pvs_data.size()) {
+            dest += pvs_data[src + 1];
+            src += 2;
+        } else {
+            break;
+        }
+    }
+}
+
+BSPPVSCuller::BSPPVSCuller(Geom* geom, const MeshPtr mesh, BSPVisibilityPtr visibility):
+    GeomCuller(geom, mesh),
+    visibility_(visibility) {
+
+    assert(visibility_);
+
+    index_type_ = (mesh->vertex_data->count() > std::numeric_limits<uint16_t>::max()) ?
+        INDEX_TYPE_32_BIT : INDEX_TYPE_16_BIT;
+}
+
+void BSPPVSCuller::_compile(const Vec3& pos, const Quaternion& rot, const Vec3& scale) {
+    /* Copy the vertex data as the mesh will be released */
+    vertices_.reset(new VertexData(mesh_->vertex_data->vertex_specification()));
+    mesh_->vertex_data->clone_into(*vertices_);
+
+    Mat4 transform(rot, pos, scale);
+    vertices_->transform_by(transform);
+
+    /* The BSP tree is in mesh space, so the camera is moved into it rather
+     * than transforming all the planes */
+    inverse_transformation_ = transform.inversed();
+
+    /* One batch per material, faces with a material that isn't used by the
+     * mesh (e.g. invisible surfaces) aren't drawn */
+    std::unordered_map<MaterialID, int32_t> batch_for_material;
+    for(auto submesh: mesh_->each_submesh()) {
+        auto material = submesh->material();
+        if(!material || batch_for_material.count(material->id())) {
+            continue;
+        }
+
+        Batch batch;
+        batch.material = material.get();
+        batch.indexes = std::make_shared<IndexData>(index_type_);
+
+        batch_for_material[material->id()] = batches_.size();
+        batches_.push_back(batch);
+    }
+
+    face_batches_.resize(visibility_->faces.size(), -1);
+    for(std::size_t i = 0; i < visibility_->faces.size(); ++i) {
+        auto it = batch_for_material.find(visibility_->faces[i].material);
+        if(it != batch_for_material.end()) {
+            face_batches_[i] = it->second;
+        }
+    }
+
+    face_marks_.resize(visibility_->faces.size(), 0);
+}
+
+const std::vector<uint8_t>& BSPPVSCuller::pvs_for_cluster(int32_t cluster) {
+    ++pvs_clock_;
+
+    CachedPVS* oldest = nullptr;
+    for(auto& entry: pvs_cache_) {
+        if(entry.cluster == cluster) {
+            entry.last_used = pvs_clock_;
+            return entry.bits;
+        }
+
+        if(!oldest || entry.last_used < oldest->last_used) {
+            oldest = &entry;
+        }
+    }
+
+    ++pvs_cache_misses_;
+
+    if(pvs_cache_.size() < BSP_PVS_CACHE_SIZE) {
+        pvs_cache_.push_back(CachedPVS());
+        oldest = &pvs_cache_.back();
+    }
+
+    oldest->cluster = cluster;
+    oldest->last_used = pvs_clock_;
+    visibility_->decompress_pvs(cluster, oldest->bits);
+    return oldest->bits;
+}
+
+void BSPPVSCuller::add_face(uint32_t face) {
+    if(face >= face_marks_.size() || face_marks_[face] == mark_) {
+        return;
+    }
+
+    face_marks_[face] = mark_;
+
+    auto batch_index = face_batches_[face];
+    if(batch_index < 0) {
+        return;
+    }
+
+    auto& batch = batches_[batch_index];
+    for(auto idx: visibility_->faces[face].indices) {
+        auto p = *vertices_->position_at<Vec3>(idx);
+
+        if(!batch.indexes->count()) {
+            batch.bounds.set_min(p);
+            batch.bounds.set_max(p);
+        } else {
+            batch.bounds.set_min(Vec3(
+                std::min(batch.bounds.min().x, p.x),
+                std::min(batch.bounds.min().y, p.y),
+                std::min(batch.bounds.min().z, p.z)
+            ));
+            batch.bounds.set_max(Vec3(
+                std::max(batch.bounds.max().x, p.x),
+                std::max(batch.bounds.max().y, p.y),
+                std::max(batch.bounds.max().z, p.z)
+            ));
+        }
+
+        batch.indexes->index(idx);
+    }
+}
+
+void BSPPVSCuller::build_visible_faces(int32_t cluster) {
+    for(auto& batch: batches_) {
+        batch.indexes->clear();
+    }
+
+    /* Wrapping around would leave stale marks behind */
+    if(++mark_ == 0) {
+        std::fill(face_marks_.begin(), face_marks_.end(), 0);
+        mark_ = 1;
+    }
+
+    if(cluster == ALL_CLUSTERS) {
+        for(uint32_t i = 0; i < visibility_->faces.size(); ++i) {
+            add_face(i);
+        }
+    } else {
+        auto& pvs = pvs_for_cluster(cluster);
+        for(uint32_t c = 0; c < visibility_->cluster_count(); ++c) {
+            if(!(pvs[c >> 3] & (1 << (c & 7)))) {
+                continue;
+            }
+
+            for(auto face: visibility_->cluster_faces[c]) {
+                add_face(face);
+            }
+        }
+    }
+
+    for(auto& batch: batches_) {
+        batch.indexes->done();
+    }
+
+    visible_cluster_ = cluster;
+}
+
+void BSPPVSCuller::insert_batches(const Frustum* frustum, batcher::RenderQueue* render_queue) {
+    for(auto& batch: batches_) {
+        if(!batch.indexes->count()) {
+            continue;
+        }
+
+        if(frustum && !frustum->intersects_aabb(batch.bounds)) {
+            continue;
+        }
+
+        Renderable new_renderable;
+
+        new_renderable.arrangement = smlt::MESH_ARRANGEMENT_TRIANGLES;
+        new_renderable.final_transformation = Mat4();
+        new_renderable.index_data = batch.indexes.get();
+        new_renderable.vertex_data = vertices_.get();
+        new_renderable.render_priority = this->geom()->render_priority();
+        new_renderable.index_element_count = new_renderable.index_data->count();
+        new_renderable.is_visible = this->geom()->is_visible();
+        new_renderable.material = batch.material;
+
+        render_queue->insert_renderable(std::move(new_renderable));
+    }
+}
+
+void BSPPVSCuller::_gather_renderables(const Frustum& frustum, batcher::RenderQueue* render_queue) {
+    /* Without a camera position there's no PVS to go on */
+    if(visible_cluster_ != ALL_CLUSTERS) {
+        build_visible_faces(ALL_CLUSTERS);
+    }
+
+    insert_batches(&frustum, render_queue);
+}
+
+void BSPPVSCuller::_gather_renderables_from(const Frustum& frustum, const Vec3& camera_position, batcher::RenderQueue* render_queue) {
+    auto leaf = visibility_->find_leaf(camera_position.transformed_by(inverse_transformation_));
+    auto cluster = (leaf >= 0) ? visibility_->leaves[leaf].cluster : ALL_CLUSTERS;
+
+    if(cluster < 0 || cluster >= (int32_t) visibility_->cluster_count()) {
+        cluster = ALL_CLUSTERS;
+    }
+
+    if(cluster != visible_cluster_) {
+        build_visible_faces(cluster);
+    }
+
+    insert_batches(&frustum, render_queue);
+}
+
+void BSPPVSCuller::_all_renderables(batcher::RenderQueue* render_queue) {
+    if(visible_cluster_ != ALL_CLUSTERS) {
+        build_visible_faces(ALL_CLUSTERS);
+    }
+
+    insert_batches(nullptr, render_queue);
+}
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "geom_culler.h"
+#include "../../math/vec3.h"
+#include "../../math/mat4.h"
+#include "../../math/aabb.h"
+#include "../../vertex_data.h"
+
+namespace smlt {
+
+/*
+ * The BSP tree and potentially visible sets (PVS) of a map, as compiled by
+ * tools like qbsp/qvis. Loaders stash this in the mesh's data under
+ * BSP_VISIBILITY_DATA_KEY so that a Geom can use a BSPPVSCuller.
+ *
+ * Everything is in the same space as the mesh vertices.
+ */
+struct BSPVisibility {
+    struct Node {
+        Vec3 normal;
+        float distance;
+
+        /* Front and back. Negative values are leaves: -(leaf + 1) */
+        int32_t children[2];
+    };
+
+    struct Leaf {
+        /* -1 for solid leaves, which can't be seen from or into */
+        int32_t cluster;
+    };
+
+    struct Face {
+        MaterialID material;
+
+        /* Triangles, indexing the mesh vertex data */
+        std::vector<uint32_t> indices;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Leaf> leaves;
+    std::vector<Face> faces;
+
+    /* The faces which can be seen from inside each cluster */
+    std::vector<std::vector<uint32_t>> cluster_faces;
+
+    /* The run-length encoded PVS of each cluster, as offsets into
+     * pvs_data. A cluster without one can see everything */
+    std::vector<uint8_t> pvs_data;
+    std::vector<uint32_t> pvs_offsets;
+
+    uint32_t cluster_count() const { return cluster_faces.size(); }
+
+    /* Returns the leaf containing the point, or -1 if there are no leaves */
+    int32_t find_leaf(const Vec3& point) const;
+
+    /* Expands the PVS of the cluster into one bit per cluster */
+    void decompress_pvs(int32_t cluster, std::vector<uint8_t>& out) const;
+};
+
+typedef std::shared_ptr<BSPVisibility> BSPVisibilityPtr;
+
+extern const char* BSP_VISIBILITY_DATA_KEY;
+
+/* How many decompressed PVS the culler holds on to */
+const uint32_t BSP_PVS_CACHE_SIZE = 8;
+
+/*
+ * Only draws the faces which are potentially visible from the cluster the
+ * camera is in.
+ *
+ * The visible faces only change when the camera moves into another cluster,
+ * so they're rebuilt into one set of indices per material when that happens,
+ * and are then frustum culled as a whole each frame. The most recently used
+ * PVS are kept decompressed, so moving back and forth across a cluster
+ * boundary is cheap.
+ *
+ * If the camera is outside the map, or inside a solid leaf, everything is
+ * drawn.
+ */
+class BSPPVSCuller : public GeomCuller {
+public:
+    BSPPVSCuller(Geom* geom, const MeshPtr mesh, BSPVisibilityPtr visibility);
+
+    /* The cluster the visible faces were last built for */
+    int32_t visible_cluster() const { return visible_cluster_; }
+
+    uint32_t pvs_cache_misses() const { return pvs_cache_misses_; }
+
+private:
+    struct Batch {
+        Material* material = nullptr;
+        IndexData::ptr indexes;
+        AABB bounds;
+    };
+
+    struct CachedPVS {
+        int32_t cluster;
+        uint64_t last_used;
+        std::vector<uint8_t> bits;
+    };
+
+    static const int32_t ALL_CLUSTERS = -1;
+    static const int32_t NOT_BUILT = -2;
+
+    void _compile(const Vec3& pos, const Quaternion& rot, const Vec3& scale) override;
+    void _gather_renderables(const Frustum& frustum, batcher::RenderQueue* render_queue) override;
+    void _gather_renderables_from(
+        const Frustum& frustum, const Vec3& camera_position, batcher::RenderQueue* render_queue
+    ) override;
+    void _all_renderables(batcher::RenderQueue* render_queue) override;
+
+    const std::vector<uint8_t>& pvs_for_cluster(int32_t cluster);
+    void build_visible_faces(int32_t cluster);
+    void add_face(uint32_t face);
+    void insert_batches(const Frustum* frustum, batcher::RenderQueue* render_queue);
+
+    BSPVisibilityPtr visibility_;
+    std::unique_ptr<VertexData> vertices_;
+    IndexType index_type_ = INDEX_TYPE_16_BIT;
+
+    Mat4 inverse_transformation_;
+
+    std::vector<Batch> batches_;
+
+    /* The batch for each face, or -1 if the face isn't drawn */
+    std::vector<int32_t> face_batches_;
+
+    /* Faces are listed in every cluster they're visible from, so this
+     * stops them being added twice */
+    std::vector<uint32_t> face_marks_;
+    uint32_t mark_ = 0;
+
+    int32_t visible_cluster_ = NOT_BUILT;
+
+    std::vector<CachedPVS> pvs_cache_;
+    uint64_t pvs_clock_ = 0;
+    uint32_t pvs_cache_misses_ = 0;
+};
+
+}
@@ -42,6 +42,10 @@ void GeomCuller::renderables_visible(const Frustum& frustum, batcher::RenderQueu
     _gather_renderables(frustum, render_queue);
 }
 
+void GeomCuller::renderables_visible(const Frustum& frustum, const Vec3& camera_position, batcher::RenderQueue* render_queue) {
+    _gather_renderables_from(frustum, camera_position, render_queue);
+}
+
 void GeomCuller::each_renderable(EachRenderableCallback cb) {
     batcher::RenderQueue queue;
 
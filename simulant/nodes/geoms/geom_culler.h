@@ -4,6 +4,7 @@
 #include <memory>
 #include <functional>
 #include "../../types.h"
+#include "../../macros.h"
 
 
 namespace smlt {
@@ -39,6 +40,9 @@ public:
     void compile(const Vec3& pos, const Quaternion& rot, const Vec3& scale);
     void renderables_visible(const Frustum& frustum, batcher::RenderQueue* render_queue);
 
+    /* As above, for cullers which also depend on where the camera is */
+    void renderables_visible(const Frustum& frustum, const Vec3& camera_position, batcher::RenderQueue* render_queue);
+
     void each_renderable(EachRenderableCallback cb);
 
     Geom* geom() const { return geom_; }
@@ -51,6 +55,13 @@ private:
 
     virtual void _compile(const Vec3& pos, const Quaternion& rot, const Vec3& scale) = 0;
     virtual void _gather_renderables(const Frustum& frustum, batcher::RenderQueue* render_queue) = 0;
+
+    /* Most cullers only need the frustum */
+    virtual void _gather_renderables_from(const Frustum& frustum, const Vec3& camera_position, batcher::RenderQueue* render_queue) {
+        _S_UNUSED(camera_position);
+        _gather_renderables(frustum, render_queue);
+    }
+
     virtual void _all_renderables(batcher::RenderQueue* rendre_queue) = 0;
 
     friend class GeomCullerRenderable;
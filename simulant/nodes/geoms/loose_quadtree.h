@@ -36,6 +36,9 @@ public:
 
         Vec3 centre;
         float size;
+
+        /* Frustum plane which last rejected this node, tested first next time */
+        uint8_t last_failed_plane = FRUSTUM_PLANE_NONE;
     };
 
     using TraverseCallback = void(Quadtree::Node*);
@@ -145,7 +148,7 @@ public:
             return;
         }
 
-        _visible_visitor(frustum, cb, nodes_[0]);
+        _visible_visitor(frustum, cb, nodes_[0], FRUSTUM_PLANE_MASK_ALL);
     }
 
     AABB bounds() const { return bounds_; }
@@ -153,14 +156,21 @@ public:
     TreeData* data() const { return tree_data_.get(); }
 private:
     template<typename Callback>
-    void _visible_visitor(const Frustum& frustum, const Callback& callback, Quadtree::Node& node) {
-        if(frustum.intersects_cube(node.centre, node.size * 2.0f)) {
+    void _visible_visitor(const Frustum& frustum, const Callback& callback, Quadtree::Node& node, uint8_t plane_mask) {
+        /* Nodes are loose, so the bounds are twice the node size. Children are
+         * contained by their parent so they only test the planes it straddled */
+        float half = node.size;
+        auto result = frustum.classify_aabb(
+            node.centre, Vec3(half, half, half), &plane_mask, &node.last_failed_plane
+        );
+
+        if(result != FRUSTUM_CONTAINS_NONE) {
             callback(&node);
 
             if(!is_leaf(node)) {
                 for(auto child: node.child_indexes) {
                     assert(child < nodes_.size());
-                    _visible_visitor(frustum, callback, nodes_[child]);
+                    _visible_visitor(frustum, callback, nodes_[child], plane_mask);
                 }
             }
         }
@@ -1,3 +1,6 @@
+#include <cstring>
+#include <limits>
+
 #include "particle_system.h"
 
 #include "../frustum.h"
@@ -139,94 +142,84 @@ void ParticleSystem::_get_renderables(batcher::RenderQueue* render_queue, const
 }
 
 void ParticleSystem::rebuild_vertex_data(const smlt::Vec3& up, const smlt::Vec3& right) {
-    vertex_data_->resize(particle_count_ * 4);
-    vertex_data_->move_to_start();
-
-    /* FIXME: Remove this when #193 is complete */
-    index_data_->resize(particle_count_ * 4);
-    index_data_->clear();
-
-    auto i = 0;
-    for(auto j = 0u; j < particle_count_; ++j) {
-        auto& p = particles_[j];
-
-        auto scaled_up = up * p.dimensions.y;
-        auto scaled_right = right * p.dimensions.x;
-        auto half_up = scaled_up * 0.5f;
-        auto half_right = scaled_right * 0.5f;
-
-        auto pos = p.position;
-        pos += -half_up;
-        pos += -half_right;
-
-        vertex_data_->position(pos);
-        vertex_data_->diffuse(p.colour);
-        vertex_data_->tex_coord0(0, 0);
-        vertex_data_->move_next();
-
-        pos += scaled_right;
-        vertex_data_->position(pos);
-        vertex_data_->diffuse(p.colour);
-        vertex_data_->tex_coord0(1, 0);
-        vertex_data_->move_next();
-
-        pos += scaled_up;
-        vertex_data_->position(pos);
-        vertex_data_->diffuse(p.colour);
-        vertex_data_->tex_coord0(1, 1);
-        vertex_data_->move_next();
-
-        pos += -scaled_right;
-        vertex_data_->position(pos);
-        vertex_data_->diffuse(p.colour);
-        vertex_data_->tex_coord0(0, 1);
-        vertex_data_->move_next();
-
-        index_data_->index(i++);
-        index_data_->index(i++);
-        index_data_->index(i++);
-        index_data_->index(i++);
+    const auto count = particles_.count();
+    const uint32_t vertex_count = count * 4;
+
+    vertex_data_->resize(vertex_count);
+
+    if(count) {
+        const auto& spec = vertex_data_->vertex_specification();
+        const auto stride = vertex_data_->stride();
+        uint8_t* data = vertex_data_->data();
+
+        if(texcoords_written_ < count) {
+            const float texcoords[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+            uint8_t* dest = data + (texcoords_written_ * 4 * stride) + spec.texcoord0_offset();
+
+            for(auto i = texcoords_written_ * 4; i < vertex_count; ++i) {
+                std::memcpy(dest, texcoords[i % 4], sizeof(float) * 2);
+                dest += stride;
+            }
+        }
+
+        particles::write_billboards(
+            particles_, up, right, data, stride,
+            spec.position_offset(), spec.diffuse_offset()
+        );
     }
 
+    /* Shrinking the vertex data throws away the tail, so anything past
+     * count will need its texture coordinates writing again */
+    texcoords_written_ = count;
     vertex_data_->done();
-    index_data_->done();
-}
 
-void ParticleSystem::update(float dt) {
-    update_source(dt); //Update any sounds attached to this particle system
+    /* The indices are always 0 to vertex_count, so they only ever need
+     * truncating or appending to */
+    auto index_count = index_data_->count();
+    if(index_count != vertex_count) {
+        if(index_count > vertex_count) {
+            index_data_->resize(vertex_count);
+        } else {
+            index_data_->reserve(vertex_count);
+            for(auto i = index_count; i < vertex_count; ++i) {
+                index_data_->index(i);
+            }
+        }
 
-    if(particles_.size() != script_->quota()) {
-        particles_.resize(script_->quota());
-        particles_.shrink_to_fit();
-        particle_count_ = std::min(particle_count_, particles_.size());
+        index_data_->done();
     }
+}
 
+void ParticleSystem::set_quota(std::size_t quota) {
+    particles_.set_capacity(quota);
 
-    // Update existing particles, erase any that are dead
-    for(auto i = 0u; i < particle_count_; ++i) {
-        Particle& particle = particles_[i];
+    auto index_type = (quota * 4 > std::numeric_limits<uint16_t>::max()) ?
+        INDEX_TYPE_32_BIT : INDEX_TYPE_16_BIT;
 
-        particle.position += particle.velocity * dt;
-        particle.ttl -= dt;
+    if(index_type != index_data_->index_type()) {
+        delete index_data_;
+        index_data_ = new IndexData(index_type);
+    }
+}
 
-        if(particle.ttl <= 0) {
-            // Swap dead particles to the end of the
-            // vector and decrease the particle count
-            // this means active particles are at the
-            // start of the vector
-            std::swap(particles_[i], particles_[particle_count_ - 1]);
+void ParticleSystem::update(float dt) {
+    update_source(dt); //Update any sounds attached to this particle system
 
-            --particle_count_;
-            assert(particle_count_ < particles_.size());
-        }
+    if(particles_.capacity() != script_->quota()) {
+        set_quota(script_->quota());
     }
 
+    // Update existing particles, then remove any that are dead. Live
+    // particles are always packed at the start of the arrays
+    particles::integrate(particles_, dt);
+    particles::kill_expired(particles_);
+
     // Run any manipulations on the particles, we do this before
     // we add new particles - otherwise they get manipulated before they're
     // even displayed!
     for(auto i = 0u; i < script_->manipulator_count(); ++i) {
         auto manipulator = script_->manipulator(i);
-        manipulator->manipulate(this, &particles_[0], particle_count_, dt);
+        manipulator->manipulate(this, particles_, dt);
     }
 
     for(auto i = 0u; i < script_->emitter_count(); ++i) {
@@ -236,8 +229,8 @@ void ParticleSystem::update(float dt) {
 
         update_emitter(i, dt);
 
-        if(particle_count_ < particles_.size()) {
-            auto max_can_emit = particles_.size() - particle_count_;
+        if(!particles_.full()) {
+            auto max_can_emit = particles_.capacity() - particles_.count();
             emit_particles(i, dt, max_can_emit);
         }
 
@@ -246,7 +239,7 @@ void ParticleSystem::update(float dt) {
         update_active_state(i, dt);
     }
 
-    if(!particle_count_ && !script_->has_repeating_emitters() && !has_active_emitters()) {
+    if(!particles_.count() && !script_->has_repeating_emitters() && !has_active_emitters()) {
         // If the particles are gone, and we don't have repeating emitters and all the emitters are inactive
         // Then destroy the particle system if that's what we've been told to do
         if(destroy_on_completion()) {
@@ -308,23 +301,21 @@ void ParticleSystem::emit_particles(uint16_t e, float dt, uint32_t max) {
     float decrement = 1.0f / float(emitter->emission_rate); //Work out how often to emit per second
 
     auto scale = absolute_scaling();
+    auto rot = absolute_rotation();
+    auto origin = absolute_position() + emitter->relative_position;
 
     uint32_t to_emit = max;
     while(state.emission_accumulator >= decrement) {
         //EMIT THE PARTICLE!
-        Particle p;
-        if(emitter->type == PARTICLE_EMITTER_POINT) {
-            p.position = absolute_position() + emitter->relative_position;
-        } else {
-            p.position = absolute_position() + emitter->relative_position;
-
+        Vec3 position = origin;
+        if(emitter->type != PARTICLE_EMITTER_POINT) {
             float hw = emitter->dimensions.x * 0.5f * scale.x;
             float hh = emitter->dimensions.y * 0.5f * scale.y;
             float hd = emitter->dimensions.z * 0.5f * scale.z;
 
-            p.position.x += random_.float_in_range(-hw, hw);
-            p.position.y += random_.float_in_range(-hh, hh);
-            p.position.z += random_.float_in_range(-hd, hd);
+            position.x += random_.float_in_range(-hw, hw);
+            position.y += random_.float_in_range(-hh, hh);
+            position.z += random_.float_in_range(-hd, hd);
         }
 
         Vec3 dir = emitter->direction;
@@ -334,22 +325,19 @@ void ParticleSystem::emit_particles(uint16_t e, float dt, uint32_t max) {
             dir = dir.random_deviant(ang).normalized();
         }
 
-        p.velocity = dir * random_.float_in_range(emitter->velocity_range.first, emitter->velocity_range.second) * scale;
+        Vec3 velocity = dir * random_.float_in_range(emitter->velocity_range.first, emitter->velocity_range.second) * scale;
 
         //We have to rotate the velocity by the system, because if the particle system is attached to something (e.g. the back of a spaceship)
         //when that entity rotates we want the velocity to stay pointing relative to the entity
-        auto rot = absolute_rotation();
-
-        p.velocity *= rot;
+        velocity *= rot;
 
-        p.lifetime = p.ttl = random_.float_in_range(emitter->ttl_range.first, emitter->ttl_range.second);
-        p.colour = emitter->colour;
-        p.initial_dimensions = p.dimensions = smlt::Vec2(script_->particle_width() * scale.x, script_->particle_height() * scale.y);
+        float ttl = random_.float_in_range(emitter->ttl_range.first, emitter->ttl_range.second);
+        Vec2 dimensions(script_->particle_width() * scale.x, script_->particle_height() * scale.y);
 
         //FIXME: Initialize other properties
-        particles_[particle_count_++] = p;
-
-        assert(particle_count_ <= particles_.size());
+        if(!particles_.push(position, velocity, dimensions, ttl, emitter->colour)) {
+            break;
+        }
 
         state.emission_accumulator -= decrement; //Decrement the accumulator while we can
         to_emit--;
@@ -4,6 +4,7 @@
 #include <unordered_map>
 
 #include "stage_node.h"
+#include "particles/particle.h"
 
 #include "../generic/identifiable.h"
 #include "../generic/managed.h"
@@ -18,17 +19,6 @@
 
 namespace smlt {
 
-struct Particle {
-    smlt::Vec3 position;
-    smlt::Vec3 velocity;
-    smlt::Vec2 dimensions;
-    smlt::Vec2 initial_dimensions;
-    float ttl;
-    float lifetime;
-    smlt::Colour colour;
-};
-
-
 class ParticleSystem;
 
 typedef sig::signal<void (ParticleSystem*, MaterialID, MaterialID)> ParticleSystemMaterialChangedSignal;
@@ -78,6 +68,14 @@ public:
         return script_.get();
     }
 
+    std::size_t particle_count() const {
+        return particles_.count();
+    }
+
+    const particles::ParticleArrays& particles() const {
+        return particles_;
+    }
+
     void update(float dt) override;
 
 private:
@@ -102,12 +100,17 @@ private:
 
     ParticleScriptPtr script_;
 
-    std::vector<Particle> particles_;
-    std::size_t particle_count_ = 0;
+    particles::ParticleArrays particles_;
 
     VertexData* vertex_data_ = nullptr;
     IndexData* index_data_ = nullptr;
 
+    /* Number of particles whose quads have had texture coordinates written,
+     * they never change so they're only written for new slots */
+    std::size_t texcoords_written_ = 0;
+
+    void set_quota(std::size_t quota);
+
     bool destroy_on_completion_ = false;
 
     void rebuild_vertex_data(const smlt::Vec3& up, const smlt::Vec3& right);
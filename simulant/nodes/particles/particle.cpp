@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstring>
+
+#include "particle.h"
+#include "simd.h"
+
+namespace smlt {
+namespace particles {
+
+static const uintptr_t STREAM_ALIGNMENT = 16;
+
+std::array<float**, ParticleArrays::STREAM_COUNT> ParticleArrays::streams() {
+    return {{
+        &x, &y, &z,
+        &vx, &vy, &vz,
+        &width, &height, &initial_width, &initial_height,
+        &ttl, &lifetime,
+        &r, &g, &b, &a
+    }};
+}
+
+void ParticleArrays::set_capacity(std::size_t capacity) {
+    if(capacity == capacity_) {
+        return;
+    }
+
+    auto padded = (capacity + PARTICLE_SIMD_WIDTH - 1) & ~(PARTICLE_SIMD_WIDTH - 1);
+    auto keep = std::min(count_, capacity);
+
+    /* Over-allocate so the first stream can be aligned, the padding keeps
+     * every following stream aligned too */
+    std::vector<float> storage(
+        (padded) ? (padded * STREAM_COUNT) + (STREAM_ALIGNMENT / sizeof(float)) : 0, 0.0f
+    );
+
+    float* base = nullptr;
+    if(padded) {
+        base = (float*) ((uintptr_t(storage.data()) + (STREAM_ALIGNMENT - 1)) & ~(STREAM_ALIGNMENT - 1));
+    }
+
+    auto stream_index = 0u;
+    for(auto stream: streams()) {
+        float* dest = (base) ? base + (stream_index++ * padded) : nullptr;
+        if(keep) {
+            std::memcpy(dest, *stream, sizeof(float) * keep);
+        }
+        *stream = dest;
+    }
+
+    storage_ = std::move(storage);
+    capacity_ = capacity;
+    count_ = keep;
+}
+
+bool ParticleArrays::push(const Vec3& position, const Vec3& velocity, const Vec2& dimensions, float life, const Colour& colour) {
+    if(full()) {
+        return false;
+    }
+
+    auto i = count_++;
+
+    x[i] = position.x;
+    y[i] = position.y;
+    z[i] = position.z;
+    vx[i] = velocity.x;
+    vy[i] = velocity.y;
+    vz[i] = velocity.z;
+    width[i] = initial_width[i] = dimensions.x;
+    height[i] = initial_height[i] = dimensions.y;
+    ttl[i] = lifetime[i] = life;
+    r[i] = colour.r;
+    g[i] = colour.g;
+    b[i] = colour.b;
+    a[i] = colour.a;
+
+    return true;
+}
+
+void ParticleArrays::copy(std::size_t from, std::size_t to) {
+    for(auto stream: streams()) {
+        (*stream)[to] = (*stream)[from];
+    }
+}
+
+void integrate(ParticleArrays& particles, float dt) {
+    using namespace simd;
+
+    const auto n = particles.padded_count();
+    const float4 delta = splat(dt);
+
+    for(std::size_t i = 0; i < n; i += PARTICLE_SIMD_WIDTH) {
+        store(particles.x + i, madd(load(particles.vx + i), delta, load(particles.x + i)));
+        store(particles.y + i, madd(load(particles.vy + i), delta, load(particles.y + i)));
+        store(particles.z + i, madd(load(particles.vz + i), delta, load(particles.z + i)));
+        store(particles.ttl + i, sub(load(particles.ttl + i), delta));
+    }
+}
+
+std::size_t kill_expired(ParticleArrays& particles) {
+    using namespace simd;
+
+    if(!particles.count_) {
+        return 0;
+    }
+
+    const float4 zero = splat(0.0f);
+    const auto initial_count = particles.count_;
+
+    /* Walk backwards so that whatever gets moved into a dead slot has already
+     * been checked and is known to be alive. Groups without any dead lanes
+     * are skipped with a single compare. */
+    auto group = (initial_count - 1) & ~(PARTICLE_SIMD_WIDTH - 1);
+    while(true) {
+        auto dead = less_equal_mask(load(particles.ttl + group), zero);
+
+        for(auto lane = PARTICLE_SIMD_WIDTH; dead && lane-- > 0;) {
+            auto i = group + lane;
+            if(i >= particles.count_ || !(dead & (1u << lane))) {
+                continue;
+            }
+
+            auto last = --particles.count_;
+            if(i != last) {
+                particles.copy(last, i);
+            }
+        }
+
+        if(!group) {
+            break;
+        }
+
+        group -= PARTICLE_SIMD_WIDTH;
+    }
+
+    return initial_count - particles.count_;
+}
+
+void write_billboards(
+    const ParticleArrays& particles, const Vec3& up, const Vec3& right,
+    uint8_t* vertices, uint32_t stride, uint32_t position_offset, uint32_t diffuse_offset) {
+
+    const auto count = particles.count();
+
+    auto write = [&](float px, float py, float pz, const float* colour) {
+        auto pos = (float*) (vertices + position_offset);
+        pos[0] = px;
+        pos[1] = py;
+        pos[2] = pz;
+
+        std::memcpy(vertices + diffuse_offset, colour, sizeof(float) * 4);
+        vertices += stride;
+    };
+
+    for(std::size_t i = 0; i < count; ++i) {
+        const float hw = particles.width[i] * 0.5f;
+        const float hh = particles.height[i] * 0.5f;
+
+        /* Half extents of the quad along the camera axes */
+        const float rx = right.x * hw, ry = right.y * hw, rz = right.z * hw;
+        const float ux = up.x * hh, uy = up.y * hh, uz = up.z * hh;
+
+        const float x = particles.x[i], y = particles.y[i], z = particles.z[i];
+        const float colour[4] = {particles.r[i], particles.g[i], particles.b[i], particles.a[i]};
+
+        write(x - rx - ux, y - ry - uy, z - rz - uz, colour);
+        write(x + rx - ux, y + ry - uy, z + rz - uz, colour);
+        write(x + rx + ux, y + ry + uy, z + rz + uz, colour);
+        write(x - rx + ux, y - ry + uy, z - rz + uz, colour);
+    }
+}
+
+}
+}
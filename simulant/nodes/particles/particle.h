@@ -1,5 +1,10 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 #include "../../math/vec3.h"
 #include "../../math/vec2.h"
 #include "../../colour.h"
@@ -7,6 +12,100 @@
 namespace smlt {
 namespace particles {
 
+/* Particle kernels process this many particles at a time */
+const std::size_t PARTICLE_SIMD_WIDTH = 4;
+
+/*
+ * Structure-of-arrays particle storage. Each attribute lives in its own
+ * 16-byte aligned stream, and every stream is padded to a multiple of
+ * PARTICLE_SIMD_WIDTH so that kernels never need a scalar tail. Live particles
+ * are always packed at the start of the streams.
+ *
+ * The stream pointers are invalidated by set_capacity()
+ */
+class ParticleArrays {
+public:
+    ParticleArrays() = default;
+    ParticleArrays(const ParticleArrays&) = delete;
+    ParticleArrays& operator=(const ParticleArrays&) = delete;
+
+    float* x = nullptr;
+    float* y = nullptr;
+    float* z = nullptr;
+
+    float* vx = nullptr;
+    float* vy = nullptr;
+    float* vz = nullptr;
+
+    float* width = nullptr;
+    float* height = nullptr;
+    float* initial_width = nullptr;
+    float* initial_height = nullptr;
+
+    float* ttl = nullptr;
+    float* lifetime = nullptr;
+
+    float* r = nullptr;
+    float* g = nullptr;
+    float* b = nullptr;
+    float* a = nullptr;
+
+    /* Changes the maximum number of particles, live particles beyond the new
+     * capacity are dropped */
+    void set_capacity(std::size_t capacity);
+
+    std::size_t capacity() const { return capacity_; }
+    std::size_t count() const { return count_; }
+
+    /* count() rounded up to PARTICLE_SIMD_WIDTH, kernels can safely
+     * read and write this many elements of every stream */
+    std::size_t padded_count() const {
+        return (count_ + PARTICLE_SIMD_WIDTH - 1) & ~(PARTICLE_SIMD_WIDTH - 1);
+    }
+
+    bool full() const { return count_ == capacity_; }
+
+    /* Appends a particle, returns false if we're already at capacity */
+    bool push(
+        const Vec3& position, const Vec3& velocity,
+        const Vec2& dimensions, float ttl, const Colour& colour
+    );
+
+    void clear() { count_ = 0; }
+
+    /* Overwrites the particle at `to` with the one at `from` */
+    void copy(std::size_t from, std::size_t to);
+
+    Vec3 position(std::size_t i) const { return Vec3(x[i], y[i], z[i]); }
+    Vec3 velocity(std::size_t i) const { return Vec3(vx[i], vy[i], vz[i]); }
+    Vec2 dimensions(std::size_t i) const { return Vec2(width[i], height[i]); }
+    Colour colour(std::size_t i) const { return Colour(r[i], g[i], b[i], a[i]); }
+
+private:
+    friend std::size_t kill_expired(ParticleArrays& particles);
+
+    static const std::size_t STREAM_COUNT = 16;
+    std::array<float**, STREAM_COUNT> streams();
+
+    std::vector<float> storage_;
+    std::size_t capacity_ = 0;
+    std::size_t count_ = 0;
+};
+
+/* Moves every live particle by its velocity and ages it by dt */
+void integrate(ParticleArrays& particles, float dt);
+
+/* Removes any particle whose ttl has run out by moving the last live particle
+ * into its slot. Returns the number of particles removed. */
+std::size_t kill_expired(ParticleArrays& particles);
+
+/* Streams camera facing quads for every live particle into an interleaved
+ * vertex buffer. Four vertices are written per particle using the given
+ * attribute offsets, texture coordinates are left untouched. */
+void write_billboards(
+    const ParticleArrays& particles, const Vec3& up, const Vec3& right,
+    uint8_t* vertices, uint32_t stride, uint32_t position_offset, uint32_t diffuse_offset
+);
 
 }
 }
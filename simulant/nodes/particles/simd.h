@@ -0,0 +1,27 @@
+#pragma once
+
+/*
+ * Particle specific helpers built on math/simd.h. Like that header, this is
+ * only included from .cpp files.
+ *
+ * Streams are aligned and padded by ParticleArrays.
+ */
+
+#include "../../math/simd.h"
+
+namespace smlt {
+namespace particles {
+
+/* Calculates the elapsed lifetime in seconds, and normalised to 0 - 1, of the
+ * four particles starting at ttl and lifetime */
+inline void lifetime_progress(const float* ttl, const float* lifetime, simd::float4& elapsed, simd::float4& normalised) {
+    using namespace simd;
+
+    /* Padding lanes may have a zero lifetime */
+    float4 l = max(load(lifetime), splat(1e-6f));
+    elapsed = sub(l, load(ttl));
+    normalised = div(elapsed, l);
+}
+
+}
+}
@@ -1,18 +1,35 @@
+#include <atomic>
+
 #include "../stage.h"
 #include "camera.h"
 #include "../window.h"
+#include "../renderers/occlusion_buffer.h"
 
 namespace smlt {
 
+/* Shared between all nodes so that a node which is destroyed, and another
+ * allocated at the same address, never ends up with the same version */
+static std::atomic<uint64_t> renderables_version_counter(0);
+
 StageNode::StageNode(Stage *stage, smlt::StageNodeType node_type):
     TreeNode(),
     stage_(stage),
     node_type_(node_type) {
 
+    /* The Stage is constructed as a StageNode before its own members
+     * exist, but it never moves so doesn't need a slot */
+    if(stage_ && node_type_ != STAGE_NODE_TYPE_STAGE) {
+        transforms_ = stage_->transforms.get();
+        transform_slot_ = transforms_->allocate(this);
+    }
+
+    invalidate_renderables();
 }
 
 StageNode::~StageNode() {
-
+    if(transforms_) {
+        transforms_->release(transform_slot_);
+    }
 }
 
 StageNodeType StageNode::node_type() const {
@@ -60,38 +77,60 @@ void StageNode::clean_up() {
     TwoPhaseConstructed::clean_up();
 }
 
+void StageNode::resolve_transformation() const {
+    if(transforms_) {
+        transforms_->resolve(transform_slot_);
+    }
+}
+
 Vec3 StageNode::absolute_position() const {
-    return absolute_position_;
+    if(!transforms_) {
+        return position_;
+    }
+
+    resolve_transformation();
+    return transforms_->absolute_position(transform_slot_);
 }
 
 Quaternion StageNode::absolute_rotation() const {
-    return absolute_rotation_;
+    if(!transforms_) {
+        return rotation_;
+    }
+
+    resolve_transformation();
+    return transforms_->absolute_rotation(transform_slot_);
 }
 
 Vec3 StageNode::absolute_scaling() const {
-    return absolute_scale_;
+    if(!transforms_) {
+        return scaling_;
+    }
+
+    resolve_transformation();
+    return transforms_->absolute_scale(transform_slot_);
 }
 
 Mat4 StageNode::absolute_transformation() const {
-    if(!absolute_transformation_is_dirty_) {
-        return absolute_transformation_;
+    if(!transforms_) {
+        /* No parent to compose with, so this is the local transformation,
+         * built the same way as the TransformSystem builds it */
+        Mat4 s;
+        Mat4 t;
+        Mat4 r(rotation_);
+
+        s[0] = scaling_.x;
+        s[5] = scaling_.y;
+        s[10] = scaling_.z;
+
+        t[12] = position_.x;
+        t[13] = position_.y;
+        t[14] = position_.z;
+
+        return t * r * s;
     }
 
-    Mat4 scale;
-    Mat4 trans;
-    Mat4 rot(absolute_rotation_);
-
-    scale[0] = absolute_scale_.x;
-    scale[5] = absolute_scale_.y;
-    scale[10] = absolute_scale_.z;
-
-    trans[12] = absolute_position_.x;
-    trans[13] = absolute_position_.y;
-    trans[14] = absolute_position_.z;
-
-    absolute_transformation_ = trans * rot * scale;
-    absolute_transformation_is_dirty_ = false;
-    return absolute_transformation_;
+    resolve_transformation();
+    return transforms_->absolute_transformation(transform_slot_);
 }
 
 void StageNode::recalc_visibility() {
@@ -172,32 +211,20 @@ void StageNode::rotate_to_absolute(const Degrees& degrees, float x, float y, flo
 }
 
 void StageNode::on_transformation_changed() {
-    update_transformation_from_parent();
-}
-
-void StageNode::update_transformation_from_parent() {
-    StageNode* parent = parent_stage_node_;
-
-    if(!parent || parent_is_stage()) {
-        absolute_rotation_ = rotation_;
-        absolute_position_ = position_;
-        absolute_scale_ = scaling_;
-    } else {
-        auto parent_pos = parent->absolute_position();
-        auto parent_rot = parent->absolute_rotation();
-        auto parent_scale = parent->absolute_scaling();
-
-        absolute_rotation_ = parent_rot * rotation_;
-        absolute_position_ = parent_pos + parent_rot * position_;
-        absolute_scale_ = parent_scale * scaling_;
+    if(transforms_) {
+        /* This only marks the subtree dirty, absolute transformations are
+         * recalculated on access or at the end of the frame */
+        transforms_->set_local(transform_slot_, position_, rotation_, scaling_);
     }
+}
 
+void StageNode::on_transformation_resolved() {
     mark_transformed_aabb_dirty();
-    mark_absolute_transformation_dirty();
+    invalidate_renderables();
+}
 
-    for(auto& node: each_child()) {
-        node.update_transformation_from_parent();
-    }
+void StageNode::invalidate_renderables() const {
+    renderables_version_ = ++renderables_version_counter;
 }
 
 void StageNode::on_parent_set(TreeNode* oldp, TreeNode* newp) {
@@ -206,7 +233,12 @@ void StageNode::on_parent_set(TreeNode* oldp, TreeNode* newp) {
     parent_stage_node_ = dynamic_cast<StageNode*>(newp);
     assert(parent_stage_node_);
 
-    update_transformation_from_parent();
+    if(transforms_) {
+        transforms_->set_parent(
+            transform_slot_,
+            (parent_is_stage()) ? NULL_TRANSFORM_SLOT : parent_stage_node_->transform_slot_
+        );
+    }
 }
 
 AABB StageNode::calculate_transformed_aabb() const {
@@ -243,7 +275,15 @@ bool StageNode::is_cullable() const {
     return cullable_;
 }
 
+void StageNode::set_occluder_mesh(MeshPtr mesh) {
+    occluder_ = (mesh) ? OccluderGeometry::from_mesh(mesh) : nullptr;
+}
+
 void StageNode::recalc_bounds_if_necessary() const {
+    /* The bounds are only marked dirty once a move has been resolved, so
+     * resolve here in case nothing has read the transformation yet */
+    resolve_transformation();
+
     if(!transformed_aabb_dirty_) {
         return;
     }
@@ -261,10 +301,6 @@ void StageNode::mark_transformed_aabb_dirty() {
     transformed_aabb_dirty_ = true;
 }
 
-void StageNode::mark_absolute_transformation_dirty() {
-    absolute_transformation_is_dirty_ = true;
-}
-
 void StageNode::update(float dt) {
     update_behaviours(dt);
 }
@@ -281,6 +317,10 @@ void StageNode::fixed_update(float step) {
     fixed_update_behaviours(step);
 }
 
+bool StageNode::is_update_thread_safe() const {
+    return update_thread_safe_ && behaviours_are_update_thread_safe();
+}
+
 bool StageNode::parent_is_stage() const {
     return bool(dynamic_cast<Stage*>(parent_));
 }
@@ -11,6 +11,7 @@
 #include "../generic/data_carrier.h"
 #include "../shadows.h"
 #include "../generic/manual_object.h"
+#include "transform_system.h"
 
 #include "iterators/sibling_iterator.h"
 #include "iterators/child_iterator.h"
@@ -21,21 +22,11 @@ namespace smlt {
 
 class RenderableFactory;
 class Seconds;
+struct OccluderGeometry;
 
 typedef sig::signal<void (AABB)> BoundsUpdatedSignal;
 typedef sig::signal<void ()> CleanedUpSignal;
 
-/* Used for multiple levels of detail when rendering stage nodes */
-
-enum DetailLevel {
-    DETAIL_LEVEL_NEAREST = 0,
-    DETAIL_LEVEL_NEAR,
-    DETAIL_LEVEL_MID,
-    DETAIL_LEVEL_FAR,
-    DETAIL_LEVEL_FARTHEST,
-    DETAIL_LEVEL_MAX
-};
-
 enum StageNodeType {
     STAGE_NODE_TYPE_STAGE,
     STAGE_NODE_TYPE_CAMERA,
@@ -46,6 +37,12 @@ enum StageNodeType {
     STAGE_NODE_TYPE_OTHER
 };
 
+enum PoseEvaluation {
+    POSE_EVALUATION_NONE,       /* The node isn't animated */
+    POSE_EVALUATION_EVALUATED,
+    POSE_EVALUATION_REUSED      /* Already evaluated for this frame */
+};
+
 class StageNode:
     public virtual DestroyableObject,
     public TreeNode,
@@ -202,6 +199,13 @@ public:
     void late_update(float dt) override;
     void fixed_update(float step) override;
 
+    /* Declares that update() and fixed_update() of this node only touch the
+     * node itself, so with parallel updates enabled it can be updated on a
+     * worker thread. The node is only treated as thread-safe if all of its
+     * behaviours are too. */
+    void set_update_thread_safe(bool value) { update_thread_safe_ = value; }
+    bool is_update_thread_safe() const override;
+
     bool parent_is_stage() const;
 
     void clean_up() override;
@@ -226,9 +230,36 @@ public:
         const DetailLevel detail_level
     ) = 0;
 
+    /* Identifies the renderables last returned from _get_renderables(). While
+     * this is unchanged the render queue reuses what it gathered on a previous
+     * frame instead of calling _get_renderables() again. Returning 0 (the
+     * default) means the renderables are regenerated every frame. */
+    virtual uint64_t renderables_version() const { return 0; }
+
+    /* Called by the compositor on each node visible to a pipeline, before
+     * any renderables are gathered. Animated nodes update their geometry
+     * here, once per frame_id, so every pipeline which sees them that frame
+     * shares the same pose. */
+    virtual PoseEvaluation evaluate_pose(uint64_t frame_id) {
+        _S_UNUSED(frame_id);
+        return POSE_EVALUATION_NONE;
+    }
+
     void set_cullable(bool v);
     bool is_cullable() const;
 
+    /* Makes this node hide whatever is behind it from pipelines with
+     * occlusion culling enabled. The triangles of the mesh are copied, so
+     * later changes to it aren't picked up. This should be a cheap hull which
+     * fits inside the visible geometry, rather than the render mesh itself.
+     * Passing a null mesh stops the node occluding. */
+    void set_occluder_mesh(MeshPtr mesh);
+    bool is_occluder() const { return bool(occluder_); }
+    const OccluderGeometry* occluder_geometry() const { return occluder_.get(); }
+
+    /* Takes the occluder geometry into world space */
+    virtual Mat4 occluder_transformation() const { return absolute_transformation(); }
+
 protected:
     // Faster than properties, useful for subclasses where a clean API isn't as important
     Stage* get_stage() const { return stage_; }
@@ -236,18 +267,35 @@ protected:
     void on_transformation_changed() override;
     void on_parent_set(TreeNode* oldp, TreeNode* newp) override;
 
-    virtual void update_transformation_from_parent();
+    /* Called by the stage's TransformSystem whenever the absolute
+     * transformation of this node has been recalculated */
+    virtual void on_transformation_resolved();
+
+    /* Make sure the absolute transformation is up-to-date, this is
+     * called by the absolute_* accessors */
+    void resolve_transformation() const;
 
     void recalc_bounds_if_necessary() const;
     void mark_transformed_aabb_dirty();
 
-    void mark_absolute_transformation_dirty();
+    /* Moves cached_renderables_version() on so that any renderables a
+     * render queue is holding for this node are thrown away */
+    void invalidate_renderables() const;
+    uint64_t cached_renderables_version() const { return renderables_version_; }
+
 private:
+    friend class TransformSystem;
+
     AABB calculate_transformed_aabb() const;
 
     Stage* stage_ = nullptr;
     StageNode* parent_stage_node_ = nullptr;
 
+    /* Absolute transformations are stored by the stage, the Stage
+     * itself doesn't have a slot */
+    TransformSystem* transforms_ = nullptr;
+    TransformSlot transform_slot_ = NULL_TRANSFORM_SLOT;
+
     StageNodeType node_type_ = STAGE_NODE_TYPE_ACTOR;
 
     generic::DataCarrier data_;
@@ -259,13 +307,6 @@ private:
     bool self_and_parents_visible_ = true;
     void recalc_visibility();
 
-    Vec3 absolute_position_;
-    Quaternion absolute_rotation_;
-    Vec3 absolute_scale_ = Vec3(1, 1, 1);
-
-    mutable Mat4 absolute_transformation_;
-    mutable bool absolute_transformation_is_dirty_ = true;
-
     /* Mutable so that AABB accesses can be const, but we delay
      * calculation until access */
     mutable AABB transformed_aabb_;
@@ -277,6 +318,12 @@ private:
 
     /* Whether or not this node should be culled by the partitioner (e.g. when offscreen) */
     bool cullable_ = true;
+
+    bool update_thread_safe_ = false;
+
+    std::shared_ptr<OccluderGeometry> occluder_;
+
+    mutable uint64_t renderables_version_ = 0;
 };
 
 
@@ -0,0 +1,214 @@
+#include <cassert>
+
+#include "transform_system.h"
+#include "stage_node.h"
+
+namespace smlt {
+
+TransformSlot TransformSystem::allocate(StageNode* node) {
+    assert(!deferred_);
+
+    TransformSlot slot;
+
+    if(!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        slot = (TransformSlot) node_.size();
+
+        local_position_.push_back(Vec3());
+        local_rotation_.push_back(Quaternion());
+        local_scale_.push_back(Vec3(1, 1, 1));
+
+        world_position_.push_back(Vec3());
+        world_rotation_.push_back(Quaternion());
+        world_scale_.push_back(Vec3(1, 1, 1));
+        world_matrix_.push_back(Mat4());
+
+        parent_.push_back(NULL_TRANSFORM_SLOT);
+        flags_.push_back(0);
+        pending_.push_back(0);
+        node_.push_back(nullptr);
+    }
+
+    local_position_[slot] = world_position_[slot] = Vec3();
+    local_rotation_[slot] = world_rotation_[slot] = Quaternion();
+    local_scale_[slot] = world_scale_[slot] = Vec3(1, 1, 1);
+    world_matrix_[slot] = Mat4();
+
+    parent_[slot] = NULL_TRANSFORM_SLOT;
+    node_[slot] = node;
+
+    /* A queued entry may still exist from the slot's previous owner, that's
+     * fine as resolve_all() only processes an entry if the flag is set */
+    flags_[slot] = TRANSFORM_FLAG_ALIVE | TRANSFORM_FLAG_QUEUED;
+    queued_.push_back(slot);
+
+    return slot;
+}
+
+void TransformSystem::release(TransformSlot slot) {
+    assert(flags_[slot] & TRANSFORM_FLAG_ALIVE);
+
+    /* Children which outlive the slot are detached, otherwise they'd follow
+     * whichever node reuses it */
+    for(auto& child: node_[slot]->each_child()) {
+        auto child_slot = child.transform_slot_;
+        if(child_slot == NULL_TRANSFORM_SLOT || parent_[child_slot] != slot) {
+            continue;
+        }
+
+        parent_[child_slot] = NULL_TRANSFORM_SLOT;
+
+        if(deferred_) {
+            pending_[child_slot] = 1;
+        } else {
+            mark_dirty(child_slot);
+        }
+    }
+
+    flags_[slot] = 0;
+    pending_[slot] = 0;
+    node_[slot] = nullptr;
+    parent_[slot] = NULL_TRANSFORM_SLOT;
+
+    free_slots_.push_back(slot);
+}
+
+void TransformSystem::set_local(TransformSlot slot, const Vec3& position, const Quaternion& rotation, const Vec3& scale) {
+    local_position_[slot] = position;
+    local_rotation_[slot] = rotation;
+    local_scale_[slot] = scale;
+
+    if(deferred_) {
+        pending_[slot] = 1;
+    } else {
+        mark_dirty(slot);
+    }
+}
+
+void TransformSystem::set_parent(TransformSlot slot, TransformSlot parent) {
+    assert(!deferred_);
+
+    parent_[slot] = parent;
+    mark_dirty(slot);
+}
+
+void TransformSystem::mark_dirty(TransformSlot slot) {
+    /* If this node is already dirty then so is everything below it */
+    if(flags_[slot] & TRANSFORM_FLAG_DIRTY) {
+        return;
+    }
+
+    flags_[slot] |= TRANSFORM_FLAG_DIRTY;
+
+    if(!(flags_[slot] & TRANSFORM_FLAG_QUEUED)) {
+        flags_[slot] |= TRANSFORM_FLAG_QUEUED;
+        queued_.push_back(slot);
+    }
+
+    for(auto& child: node_[slot]->each_child()) {
+        mark_dirty(child.transform_slot_);
+    }
+}
+
+void TransformSystem::resolve_dirty(TransformSlot slot) {
+    ancestors_.clear();
+
+    while(slot != NULL_TRANSFORM_SLOT && (flags_[slot] & TRANSFORM_FLAG_DIRTY)) {
+        ancestors_.push_back(slot);
+        slot = parent_[slot];
+    }
+
+    for(auto it = ancestors_.rbegin(); it != ancestors_.rend(); ++it) {
+        update_absolute(*it);
+    }
+}
+
+void TransformSystem::update_absolute(TransformSlot slot) {
+    auto parent = parent_[slot];
+
+    if(parent == NULL_TRANSFORM_SLOT) {
+        world_position_[slot] = local_position_[slot];
+        world_rotation_[slot] = local_rotation_[slot];
+        world_scale_[slot] = local_scale_[slot];
+    } else {
+        auto& parent_rot = world_rotation_[parent];
+
+        world_rotation_[slot] = parent_rot * local_rotation_[slot];
+        world_position_[slot] = world_position_[parent] + parent_rot * local_position_[slot];
+        world_scale_[slot] = world_scale_[parent] * local_scale_[slot];
+    }
+
+    auto& pos = world_position_[slot];
+    auto& scale = world_scale_[slot];
+
+    Mat4 s;
+    Mat4 t;
+    Mat4 r(world_rotation_[slot]);
+
+    s[0] = scale.x;
+    s[5] = scale.y;
+    s[10] = scale.z;
+
+    t[12] = pos.x;
+    t[13] = pos.y;
+    t[14] = pos.z;
+
+    world_matrix_[slot] = t * r * s;
+    flags_[slot] &= ~TRANSFORM_FLAG_DIRTY;
+
+    node_[slot]->on_transformation_resolved();
+}
+
+void TransformSystem::resolve_all() {
+    /* Bounds updates can trigger signal handlers which move other nodes, so
+     * this deliberately doesn't use iterators */
+    for(std::size_t i = 0; i < queued_.size(); ++i) {
+        auto slot = queued_[i];
+
+        if(!(flags_[slot] & TRANSFORM_FLAG_QUEUED)) {
+            continue;
+        }
+
+        flags_[slot] &= ~TRANSFORM_FLAG_QUEUED;
+
+        resolve(slot);
+
+        /* Nodes might've been resolved lazily already, but the partitioner
+         * still needs to hear about their new bounds */
+        node_[slot]->recalc_bounds_if_necessary();
+    }
+
+    queued_.clear();
+}
+
+void TransformSystem::begin_deferred_writes() {
+    assert(!deferred_);
+
+    /* Nothing may be resolved lazily while other threads are reading */
+    for(auto slot: queued_) {
+        if(flags_[slot] & TRANSFORM_FLAG_ALIVE) {
+            resolve(slot);
+        }
+    }
+
+    deferred_ = true;
+}
+
+void TransformSystem::end_deferred_writes() {
+    assert(deferred_);
+    deferred_ = false;
+
+    for(std::size_t i = 0; i < pending_.size(); ++i) {
+        if(pending_[i]) {
+            pending_[i] = 0;
+
+            if(flags_[i] & TRANSFORM_FLAG_ALIVE) {
+                mark_dirty(TransformSlot(i));
+            }
+        }
+    }
+}
+
+}
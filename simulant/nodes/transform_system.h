@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../math/vec3.h"
+#include "../math/quaternion.h"
+#include "../math/mat4.h"
+
+namespace smlt {
+
+class StageNode;
+
+typedef uint32_t TransformSlot;
+const static TransformSlot NULL_TRANSFORM_SLOT = ~0u;
+
+/*
+ * Stores the local and absolute (world) transformations of every StageNode
+ * in a stage in contiguous arrays, indexed by a slot which is assigned to the
+ * node on construction.
+ *
+ * Writing a local transformation only marks the node (and, the first time, its
+ * descendents) as dirty, so moving a node with a deep hierarchy several times
+ * a frame is cheap. Absolute transformations are recalculated either lazily
+ * when they are read, or all at once by resolve_all() which the compositor
+ * calls once per frame before partitioner writes and rendering.
+ *
+ * Dirty descendents are always queued after their ancestors, and resolving a
+ * node always resolves its dirty ancestors first, so the once-per-frame pass
+ * visits each node exactly once in topological order.
+ *
+ * Not thread-safe. Reads from other threads are only safe once resolve_all()
+ * has run and until the next write. The exception is between
+ * begin_deferred_writes() and end_deferred_writes(), where any thread may call
+ * set_local() on slots which no other thread is writing to; absolute
+ * transformations read in that time are those from the start.
+ */
+class TransformSystem {
+public:
+    TransformSystem() = default;
+    TransformSystem(const TransformSystem&) = delete;
+    TransformSystem& operator=(const TransformSystem&) = delete;
+
+    TransformSlot allocate(StageNode* node);
+    void release(TransformSlot slot);
+
+    void set_local(TransformSlot slot, const Vec3& position, const Quaternion& rotation, const Vec3& scale);
+    void set_parent(TransformSlot slot, TransformSlot parent);
+
+    /* Recalculate the absolute transformation of the slot (and any dirty
+     * ancestors) if necessary */
+    void resolve(TransformSlot slot) {
+        if(flags_[slot] & TRANSFORM_FLAG_DIRTY) {
+            resolve_dirty(slot);
+        }
+    }
+
+    /* Resolve everything written since the last call, and refresh the bounds
+     * of the nodes which moved */
+    void resolve_all();
+
+    /* Resolves anything dirty, then until end_deferred_writes() set_local()
+     * only records the new local transformation. end_deferred_writes() then
+     * marks the written slots dirty as usual. */
+    void begin_deferred_writes();
+    void end_deferred_writes();
+
+    bool is_dirty(TransformSlot slot) const {
+        return flags_[slot] & TRANSFORM_FLAG_DIRTY;
+    }
+
+    /* Accessors for absolute transformations, these don't resolve */
+    const Vec3& absolute_position(TransformSlot slot) const { return world_position_[slot]; }
+    const Quaternion& absolute_rotation(TransformSlot slot) const { return world_rotation_[slot]; }
+    const Vec3& absolute_scale(TransformSlot slot) const { return world_scale_[slot]; }
+    const Mat4& absolute_transformation(TransformSlot slot) const { return world_matrix_[slot]; }
+
+    TransformSlot parent(TransformSlot slot) const { return parent_[slot]; }
+
+    std::size_t slot_count() const { return node_.size(); }
+    std::size_t queued_count() const { return queued_.size(); }
+
+private:
+    enum TransformFlag {
+        TRANSFORM_FLAG_ALIVE = 1,
+        TRANSFORM_FLAG_DIRTY = 2,
+        TRANSFORM_FLAG_QUEUED = 4
+    };
+
+    void mark_dirty(TransformSlot slot);
+    void resolve_dirty(TransformSlot slot);
+    void update_absolute(TransformSlot slot);
+
+    std::vector<Vec3> local_position_;
+    std::vector<Quaternion> local_rotation_;
+    std::vector<Vec3> local_scale_;
+
+    std::vector<Vec3> world_position_;
+    std::vector<Quaternion> world_rotation_;
+    std::vector<Vec3> world_scale_;
+    std::vector<Mat4> world_matrix_;
+
+    std::vector<TransformSlot> parent_;
+    std::vector<uint8_t> flags_;
+    std::vector<StageNode*> node_;
+
+    std::vector<TransformSlot> free_slots_;
+
+    /* Slots written while writes were deferred. This is separate from flags_
+     * so that writers never touch the bytes which readers check */
+    std::vector<uint8_t> pending_;
+    bool deferred_ = false;
+
+    /* Slots which have been dirtied since the last resolve_all(), parents
+     * before children */
+    std::vector<TransformSlot> queued_;
+
+    /* Scratch space for walking up to the highest dirty ancestor */
+    std::vector<TransformSlot> ancestors_;
+};
+
+}
@@ -0,0 +1,140 @@
+#include "bvh_partitioner.h"
+#include "../nodes/actor.h"
+#include "../nodes/light.h"
+#include "../nodes/camera.h"
+#include "../nodes/particle_system.h"
+#include "../nodes/geom.h"
+#include "../stage.h"
+
+namespace smlt {
+
+BVHPartitioner::BVHPartitioner(Stage* ss):
+    Partitioner(ss) {
+
+}
+
+StageNode* BVHPartitioner::find_node(const UniqueIDKey& key) {
+    if(key.first == typeid(Actor)) {
+        return stage->actor(make_unique_id_from_key<ActorID>(key));
+    } else if(key.first == typeid(Geom)) {
+        return stage->geom(make_unique_id_from_key<GeomID>(key));
+    } else if(key.first == typeid(Light)) {
+        return stage->light(make_unique_id_from_key<LightID>(key));
+    } else if(key.first == typeid(ParticleSystem)) {
+        return stage->particle_system(make_unique_id_from_key<ParticleSystemID>(key));
+    }
+
+    assert(0 && "Not implemented");
+    return nullptr;
+}
+
+void BVHPartitioner::stage_add_node(const UniqueIDKey& key) {
+    thread::WriteLock<thread::SharedMutex> lock(lock_);
+
+    auto node = find_node(key);
+    if(!node) {
+        return;
+    }
+
+    bool always_visible = !node->is_cullable();
+
+    if(node->node_type() == STAGE_NODE_TYPE_LIGHT) {
+        auto light = static_cast<Light*>(node);
+        always_visible = always_visible || light->type() == LIGHT_TYPE_DIRECTIONAL;
+    }
+
+    if(always_visible) {
+        always_visible_[key] = node;
+    } else {
+        proxies_[key] = tree_.insert(node->transformed_aabb(), node);
+    }
+}
+
+void BVHPartitioner::stage_remove_node(const UniqueIDKey& key) {
+    thread::WriteLock<thread::SharedMutex> lock(lock_);
+
+    auto it = proxies_.find(key);
+    if(it != proxies_.end()) {
+        tree_.remove(it->second);
+        proxies_.erase(it);
+    } else {
+        always_visible_.erase(key);
+    }
+}
+
+void BVHPartitioner::_update_node(const UniqueIDKey& key, const AABB& bounds) {
+    thread::WriteLock<thread::SharedMutex> lock(lock_);
+
+    auto it = proxies_.find(key);
+    if(it != proxies_.end()) {
+        tree_.update(it->second, bounds);
+    }
+}
+
+void BVHPartitioner::apply_staged_write(const UniqueIDKey& key, const StagedWrite& write) {
+    if(write.operation == WRITE_OPERATION_ADD) {
+        stage_add_node(key);
+    } else if(write.operation == WRITE_OPERATION_UPDATE) {
+        _update_node(key, write.new_bounds);
+    } else if(write.operation == WRITE_OPERATION_REMOVE) {
+        stage_remove_node(key);
+    }
+}
+
+void BVHPartitioner::lights_and_geometry_visible_from(
+        CameraID camera_id, std::vector<LightID> &lights_out,
+        std::vector<StageNode*> &geom_out) {
+
+    thread::ReadLock<thread::SharedMutex> lock(lock_);
+
+    std::vector<void*> results;
+    tree_.find_objects_within_frustum(stage->camera(camera_id)->frustum(), results);
+
+    auto push = [&](StageNode* node) {
+        if(node->is_marked_for_destruction() || !node->is_visible()) {
+            return;
+        }
+
+        if(node->node_type() == STAGE_NODE_TYPE_LIGHT) {
+            lights_out.push_back(static_cast<Light*>(node)->id());
+        } else {
+            geom_out.push_back(node);
+        }
+    };
+
+    for(auto result: results) {
+        push(static_cast<StageNode*>(result));
+    }
+
+    for(auto& p: always_visible_) {
+        push(p.second);
+    }
+}
+
+void BVHPartitioner::nodes_within_box(const AABB& box, std::vector<StageNode*>& results) {
+    thread::ReadLock<thread::SharedMutex> lock(lock_);
+
+    std::vector<void*> candidates;
+    tree_.find_objects_within_box(box, candidates);
+
+    /* The tree stores fattened bounds, so check the real ones */
+    for(auto candidate: candidates) {
+        auto node = static_cast<StageNode*>(candidate);
+        if(node->transformed_aabb().intersects_aabb(box)) {
+            results.push_back(node);
+        }
+    }
+}
+
+void BVHPartitioner::nodes_intersecting_ray(const Vec3& start, const Vec3& dir, float max_distance, std::vector<StageNode*>& results) {
+    thread::ReadLock<thread::SharedMutex> lock(lock_);
+
+    std::vector<void*> candidates;
+    tree_.find_objects_intersecting_ray(start, dir, max_distance, candidates);
+
+    for(auto candidate: candidates) {
+        results.push_back(static_cast<StageNode*>(candidate));
+    }
+}
+
+}
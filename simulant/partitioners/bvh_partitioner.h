@@ -0,0 +1,59 @@
+#pragma once
+
+#include <map>
+
+#include "../partitioner.h"
+#include "./impl/aabb_tree.h"
+#include "../threads/shared_mutex.h"
+
+namespace smlt {
+
+/*
+ * Partitioner backed by a dynamic AABB tree. Each actor, geom, particle system
+ * and (non-directional) light is a leaf in the tree, updated as the bounds
+ * change. Directional lights and nodes which aren't cullable are always
+ * returned.
+ */
+class BVHPartitioner : public Partitioner {
+public:
+    BVHPartitioner(Stage* ss);
+
+    void lights_and_geometry_visible_from(
+        CameraID camera_id,
+        std::vector<LightID> &lights_out,
+        std::vector<StageNode*> &geom_out
+    ) override;
+
+    /* Nodes whose bounds intersect the box. Directional lights and nodes
+     * which aren't cullable are not included */
+    void nodes_within_box(const AABB& box, std::vector<StageNode*>& results);
+
+    /* Nodes whose bounds are hit by the ray, up to max_distance (in multiples
+     * of dir). The bounds tested are enlarged by the tree margin, so callers
+     * should refine the (unordered) results with a precise test */
+    void nodes_intersecting_ray(
+        const Vec3& start, const Vec3& dir, float max_distance,
+        std::vector<StageNode*>& results
+    );
+
+    std::size_t node_count() const { return tree_.size() + always_visible_.size(); }
+    int32_t tree_height() const { return tree_.height(); }
+
+private:
+    void apply_staged_write(const UniqueIDKey& key, const StagedWrite& write) override;
+
+    StageNode* find_node(const UniqueIDKey& key);
+
+    void stage_add_node(const UniqueIDKey& key);
+    void stage_remove_node(const UniqueIDKey& key);
+    void _update_node(const UniqueIDKey& key, const AABB& bounds);
+
+    AABBTree tree_;
+
+    std::map<UniqueIDKey, AABBTreeProxy> proxies_;
+    std::map<UniqueIDKey, StageNode*> always_visible_;
+
+    thread::SharedMutex lock_;
+};
+
+}
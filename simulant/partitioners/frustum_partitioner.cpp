@@ -34,28 +34,55 @@ void FrustumPartitioner::lights_and_geometry_visible_from(
 
     auto frustum = stage->camera(camera_id)->frustum();
 
-    for(auto& node: stage->each_descendent()) {
-        auto aabb = node.transformed_aabb();
-        auto centre = aabb.centre() + node.absolute_position();
+    /* Gather the bounds of everything cullable so they can be tested
+     * as a batch */
+    candidates_.clear();
+    centres_.clear();
+    half_extents_.clear();
 
+    for(auto& node: stage->each_descendent()) {
         /* Check that the node isn't being destroyed, and it's supposed to
          * be visible (otherwise we could end up doing work for nothing) */
-        if(!node.is_marked_for_destruction() && node.is_visible()) {
-            if(node.node_type() == STAGE_NODE_TYPE_LIGHT) {
-                auto light = dynamic_cast<Light*>(&node);
-                assert(light);
-
-                if(!light->is_cullable() ||
-                    frustum.intersects_sphere(centre, aabb.max_dimension())
-                ) {
-                    lights_out.push_back(light->id());
-                }
-            } else if(!node.is_cullable()) {
-                /* If the culling mode is NEVER then we always return */
-                geom_out.push_back(&node);
-            } else if(frustum.intersects_aabb(aabb)) {
-                geom_out.push_back(&node);
+        if(node.is_marked_for_destruction() || !node.is_visible()) {
+            continue;
+        }
+
+        if(node.node_type() == STAGE_NODE_TYPE_LIGHT) {
+            auto light = dynamic_cast<Light*>(&node);
+            assert(light);
+
+            auto aabb = node.transformed_aabb();
+            auto centre = aabb.centre() + node.absolute_position();
+
+            if(!light->is_cullable() ||
+                frustum.intersects_sphere(centre, aabb.max_dimension())
+            ) {
+                lights_out.push_back(light->id());
             }
+        } else if(!node.is_cullable()) {
+            /* If the culling mode is NEVER then we always return */
+            geom_out.push_back(&node);
+        } else {
+            auto aabb = node.transformed_aabb();
+            candidates_.push_back(&node);
+            centres_.push_back(aabb.centre());
+            half_extents_.push_back((aabb.max() - aabb.min()) * 0.5f);
+        }
+    }
+
+    /* The plane cache is indexed by traversal order, which only changes when
+     * nodes are added or removed. A stale entry just costs an extra plane test */
+    last_failed_planes_.resize(candidates_.size(), FRUSTUM_PLANE_NONE);
+    visible_.resize(candidates_.size());
+
+    frustum.cull_aabbs(
+        centres_.data(), half_extents_.data(), candidates_.size(),
+        visible_.data(), last_failed_planes_.data()
+    );
+
+    for(std::size_t i = 0; i < candidates_.size(); ++i) {
+        if(visible_[i]) {
+            geom_out.push_back(candidates_[i]);
         }
     }
 }
@@ -37,6 +37,13 @@ public:
 
 private:
     void apply_staged_write(const UniqueIDKey& key, const StagedWrite& write);
+
+    /* Kept between calls to avoid allocations */
+    std::vector<StageNode*> candidates_;
+    std::vector<Vec3> centres_;
+    std::vector<Vec3> half_extents_;
+    std::vector<uint8_t> visible_;
+    std::vector<uint8_t> last_failed_planes_;
 };
 
 }
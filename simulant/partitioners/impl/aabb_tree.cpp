@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "aabb_tree.h"
+#include "../../frustum.h"
+#include "../../math/plane.h"
+
+namespace smlt {
+
+namespace {
+
+float surface_area(const Vec3& min, const Vec3& max) {
+    float dx = max.x - min.x;
+    float dy = max.y - min.y;
+    float dz = max.z - min.z;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+Vec3 combined_min(const Vec3& a, const Vec3& b) {
+    return Vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+Vec3 combined_max(const Vec3& a, const Vec3& b) {
+    return Vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
+bool overlaps(const Vec3& amin, const Vec3& amax, const Vec3& bmin, const Vec3& bmax) {
+    return (
+        amin.x <= bmax.x && amax.x >= bmin.x &&
+        amin.y <= bmax.y && amax.y >= bmin.y &&
+        amin.z <= bmax.z && amax.z >= bmin.z
+    );
+}
+
+bool contains(const Vec3& outer_min, const Vec3& outer_max, const Vec3& min, const Vec3& max) {
+    return (
+        outer_min.x <= min.x && outer_min.y <= min.y && outer_min.z <= min.z &&
+        outer_max.x >= max.x && outer_max.y >= max.y && outer_max.z >= max.z
+    );
+}
+
+}
+
+AABBTree::AABBTree(float margin):
+    margin_(margin) {
+
+}
+
+AABBTreeProxy AABBTree::allocate_node() {
+    if(free_list_ == NULL_AABB_TREE_NODE) {
+        nodes_.push_back(Node());
+        nodes_.back().height = 0;
+        return AABBTreeProxy(nodes_.size() - 1);
+    }
+
+    auto node = free_list_;
+    free_list_ = nodes_[node].parent;
+
+    nodes_[node] = Node();
+    nodes_[node].height = 0;
+    return node;
+}
+
+void AABBTree::free_node(AABBTreeProxy node) {
+    nodes_[node].parent = free_list_;
+    nodes_[node].height = -1;
+    nodes_[node].user_data = nullptr;
+    free_list_ = node;
+}
+
+AABBTreeProxy AABBTree::insert(const AABB& box, void* user_data) {
+    auto proxy = allocate_node();
+
+    Vec3 margin(margin_, margin_, margin_);
+
+    auto& node = nodes_[proxy];
+    node.min = box.min() - margin;
+    node.max = box.max() + margin;
+    node.user_data = user_data;
+
+    insert_leaf(proxy);
+    ++leaf_count_;
+
+    return proxy;
+}
+
+void AABBTree::remove(AABBTreeProxy proxy) {
+    assert(nodes_[proxy].is_leaf());
+
+    remove_leaf(proxy);
+    free_node(proxy);
+    --leaf_count_;
+}
+
+bool AABBTree::update(AABBTreeProxy proxy, const AABB& box) {
+    auto& node = nodes_[proxy];
+    assert(node.is_leaf());
+
+    if(contains(node.min, node.max, box.min(), box.max())) {
+        /* Still inside the fat AABB, nothing to do */
+        return false;
+    }
+
+    remove_leaf(proxy);
+
+    Vec3 margin(margin_, margin_, margin_);
+    nodes_[proxy].min = box.min() - margin;
+    nodes_[proxy].max = box.max() + margin;
+
+    insert_leaf(proxy);
+    return true;
+}
+
+void AABBTree::insert_leaf(AABBTreeProxy leaf) {
+    if(root_ == NULL_AABB_TREE_NODE) {
+        root_ = leaf;
+        nodes_[root_].parent = NULL_AABB_TREE_NODE;
+        return;
+    }
+
+    /* Descend the tree choosing the cheapest sibling using the surface area
+     * heuristic. The cost of descending is the area we'd add to the current
+     * node plus whatever is added below */
+    const Vec3 leaf_min = nodes_[leaf].min;
+    const Vec3 leaf_max = nodes_[leaf].max;
+
+    auto index = root_;
+    while(!nodes_[index].is_leaf()) {
+        const auto& node = nodes_[index];
+
+        float area = surface_area(node.min, node.max);
+        float combined_area = surface_area(
+            combined_min(node.min, leaf_min), combined_max(node.max, leaf_max)
+        );
+
+        /* Cost of creating a new parent for this node and the new leaf */
+        float cost = 2.0f * combined_area;
+
+        /* Minimum cost of pushing the leaf further down the tree */
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        auto child_cost = [&](AABBTreeProxy child) -> float {
+            const auto& c = nodes_[child];
+            float new_area = surface_area(combined_min(c.min, leaf_min), combined_max(c.max, leaf_max));
+            if(c.is_leaf()) {
+                return new_area + inheritance_cost;
+            } else {
+                return (new_area - surface_area(c.min, c.max)) + inheritance_cost;
+            }
+        };
+
+        float cost_left = child_cost(node.left);
+        float cost_right = child_cost(node.right);
+
+        if(cost < cost_left && cost < cost_right) {
+            break;
+        }
+
+        index = (cost_left < cost_right) ? node.left : node.right;
+    }
+
+    auto sibling = index;
+
+    /* Create a new parent for the sibling and the leaf. allocate_node() may
+     * reallocate the node array so don't hold references across it */
+    auto old_parent = nodes_[sibling].parent;
+    auto new_parent = allocate_node();
+
+    nodes_[new_parent].parent = old_parent;
+    nodes_[new_parent].min = combined_min(leaf_min, nodes_[sibling].min);
+    nodes_[new_parent].max = combined_max(leaf_max, nodes_[sibling].max);
+    nodes_[new_parent].height = nodes_[sibling].height + 1;
+    nodes_[new_parent].left = sibling;
+    nodes_[new_parent].right = leaf;
+
+    if(old_parent != NULL_AABB_TREE_NODE) {
+        if(nodes_[old_parent].left == sibling) {
+            nodes_[old_parent].left = new_parent;
+        } else {
+            nodes_[old_parent].right = new_parent;
+        }
+    } else {
+        root_ = new_parent;
+    }
+
+    nodes_[sibling].parent = new_parent;
+    nodes_[leaf].parent = new_parent;
+
+    /* Walk back up refitting and rebalancing */
+    index = nodes_[leaf].parent;
+    while(index != NULL_AABB_TREE_NODE) {
+        index = balance(index);
+        refit(index);
+        index = nodes_[index].parent;
+    }
+}
+
+void AABBTree::remove_leaf(AABBTreeProxy leaf) {
+    if(leaf == root_) {
+        root_ = NULL_AABB_TREE_NODE;
+        return;
+    }
+
+    auto parent = nodes_[leaf].parent;
+    auto grand_parent = nodes_[parent].parent;
+    auto sibling = (nodes_[parent].left == leaf) ? nodes_[parent].right : nodes_[parent].left;
+
+    if(grand_parent != NULL_AABB_TREE_NODE) {
+        /* Replace the parent with the sibling */
+        if(nodes_[grand_parent].left == parent) {
+            nodes_[grand_parent].left = sibling;
+        } else {
+            nodes_[grand_parent].right = sibling;
+        }
+
+        nodes_[sibling].parent = grand_parent;
+        free_node(parent);
+
+        auto index = grand_parent;
+        while(index != NULL_AABB_TREE_NODE) {
+            index = balance(index);
+            refit(index);
+            index = nodes_[index].parent;
+        }
+    } else {
+        root_ = sibling;
+        nodes_[sibling].parent = NULL_AABB_TREE_NODE;
+        free_node(parent);
+    }
+
+    nodes_[leaf].parent = NULL_AABB_TREE_NODE;
+}
+
+void AABBTree::refit(AABBTreeProxy index) {
+    auto& node = nodes_[index];
+    const auto& left = nodes_[node.left];
+    const auto& right = nodes_[node.right];
+
+    node.min = combined_min(left.min, right.min);
+    node.max = combined_max(left.max, right.max);
+    node.height = 1 + std::max(left.height, right.height);
+}
+
+/* Performs a left or right rotation if the subtree rooted at a is
+ * imbalanced, returning the new subtree root */
+AABBTreeProxy AABBTree::balance(AABBTreeProxy a) {
+    if(nodes_[a].is_leaf() || nodes_[a].height < 2) {
+        return a;
+    }
+
+    auto b = nodes_[a].left;
+    auto c = nodes_[a].right;
+
+    int32_t balance = nodes_[c].height - nodes_[b].height;
+
+    auto rotate = [this, a](AABBTreeProxy up, AABBTreeProxy other) -> AABBTreeProxy {
+        /* `up` is the taller child of a, and `other` the shorter one. up
+         * replaces a, and a adopts the shorter of up's children */
+        auto f = nodes_[up].left;
+        auto g = nodes_[up].right;
+
+        nodes_[up].left = a;
+        nodes_[up].parent = nodes_[a].parent;
+        nodes_[a].parent = up;
+
+        auto up_parent = nodes_[up].parent;
+        if(up_parent != NULL_AABB_TREE_NODE) {
+            if(nodes_[up_parent].left == a) {
+                nodes_[up_parent].left = up;
+            } else {
+                nodes_[up_parent].right = up;
+            }
+        } else {
+            root_ = up;
+        }
+
+        bool a_left_is_up = nodes_[a].left == up;
+        auto keep = (nodes_[f].height > nodes_[g].height) ? f : g;
+        auto give = (keep == f) ? g : f;
+
+        nodes_[up].right = keep;
+
+        if(a_left_is_up) {
+            nodes_[a].left = give;
+            nodes_[a].right = other;
+        } else {
+            nodes_[a].left = other;
+            nodes_[a].right = give;
+        }
+
+        nodes_[give].parent = a;
+
+        refit(a);
+        refit(up);
+
+        return up;
+    };
+
+    if(balance > 1) {
+        return rotate(c, b);
+    } else if(balance < -1) {
+        return rotate(b, c);
+    }
+
+    return a;
+}
+
+void AABBTree::collect_leaves(AABBTreeProxy index, std::vector<void*>& results) const {
+    const auto& node = nodes_[index];
+    if(node.is_leaf()) {
+        results.push_back(node.user_data);
+    } else {
+        collect_leaves(node.left, results);
+        collect_leaves(node.right, results);
+    }
+}
+
+void AABBTree::find_objects_within_box(const AABB& box, std::vector<void*>& results) const {
+    if(root_ == NULL_AABB_TREE_NODE) {
+        return;
+    }
+
+    const Vec3& min = box.min();
+    const Vec3& max = box.max();
+
+    std::vector<AABBTreeProxy> stack;
+    stack.push_back(root_);
+
+    while(!stack.empty()) {
+        auto index = stack.back();
+        stack.pop_back();
+
+        const auto& node = nodes_[index];
+        if(!overlaps(node.min, node.max, min, max)) {
+            continue;
+        }
+
+        if(node.is_leaf()) {
+            results.push_back(node.user_data);
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
+
+void AABBTree::find_within_frustum(AABBTreeProxy index, const Frustum& frustum, uint8_t plane_mask, std::vector<void*>& results) const {
+    const auto& node = nodes_[index];
+
+    /* plane_mask has a bit set for each plane the parent straddled, planes
+     * the parent was entirely inside of don't need testing again */
+    auto result = frustum.classify_aabb(
+        (node.min + node.max) * 0.5f, (node.max - node.min) * 0.5f, &plane_mask
+    );
+
+    if(result == FRUSTUM_CONTAINS_NONE) {
+        return;
+    }
+
+    if(!plane_mask) {
+        /* Entirely inside the frustum */
+        collect_leaves(index, results);
+    } else if(node.is_leaf()) {
+        results.push_back(node.user_data);
+    } else {
+        find_within_frustum(node.left, frustum, plane_mask, results);
+        find_within_frustum(node.right, frustum, plane_mask, results);
+    }
+}
+
+void AABBTree::find_objects_within_frustum(const Frustum& frustum, std::vector<void*>& results) const {
+    if(root_ == NULL_AABB_TREE_NODE) {
+        return;
+    }
+
+    if(!frustum.initialized()) {
+        /* Matches Frustum::intersects_aabb, which has no planes to fail */
+        collect_leaves(root_, results);
+        return;
+    }
+
+    find_within_frustum(root_, frustum, FRUSTUM_PLANE_MASK_ALL, results);
+}
+
+void AABBTree::find_objects_intersecting_ray(const Vec3& start, const Vec3& dir, float max_distance, std::vector<void*>& results) const {
+    if(root_ == NULL_AABB_TREE_NODE) {
+        return;
+    }
+
+    /* Division by zero gives infinity, which the slab test handles */
+    const Vec3 inv(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+    auto hit = [&](const Node& node) -> bool {
+        float t1 = (node.min.x - start.x) * inv.x;
+        float t2 = (node.max.x - start.x) * inv.x;
+        float t3 = (node.min.y - start.y) * inv.y;
+        float t4 = (node.max.y - start.y) * inv.y;
+        float t5 = (node.min.z - start.z) * inv.z;
+        float t6 = (node.max.z - start.z) * inv.z;
+
+        float tmin = std::max(std::max(std::min(t1, t2), std::min(t3, t4)), std::min(t5, t6));
+        float tmax = std::min(std::min(std::max(t1, t2), std::max(t3, t4)), std::max(t5, t6));
+
+        return tmax >= 0.0f && tmin <= tmax && tmin <= max_distance;
+    };
+
+    std::vector<AABBTreeProxy> stack;
+    stack.push_back(root_);
+
+    while(!stack.empty()) {
+        auto index = stack.back();
+        stack.pop_back();
+
+        const auto& node = nodes_[index];
+        if(!hit(node)) {
+            continue;
+        }
+
+        if(node.is_leaf()) {
+            results.push_back(node.user_data);
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
+
+bool AABBTree::validate_node(AABBTreeProxy index) const {
+    const auto& node = nodes_[index];
+
+    if(node.is_leaf()) {
+        return node.height == 0 && node.right == NULL_AABB_TREE_NODE;
+    }
+
+    const auto& left = nodes_[node.left];
+    const auto& right = nodes_[node.right];
+
+    if(left.parent != index || right.parent != index) {
+        return false;
+    }
+
+    if(node.height != 1 + std::max(left.height, right.height)) {
+        return false;
+    }
+
+    if(!contains(node.min, node.max, left.min, left.max) || !contains(node.min, node.max, right.min, right.max)) {
+        return false;
+    }
+
+    return validate_node(node.left) && validate_node(node.right);
+}
+
+bool AABBTree::validate() const {
+    if(root_ == NULL_AABB_TREE_NODE) {
+        return leaf_count_ == 0;
+    }
+
+    if(nodes_[root_].parent != NULL_AABB_TREE_NODE) {
+        return false;
+    }
+
+    return validate_node(root_);
+}
+
+}
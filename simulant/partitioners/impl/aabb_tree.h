@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../../math/vec3.h"
+#include "../../math/aabb.h"
+
+/*
+ * Dynamic AABB tree (bounding volume hierarchy)
+ *
+ * Each leaf stores a "fat" AABB which is the object's bounds grown by a margin,
+ * so small movements don't touch the tree at all. When an object leaves its fat
+ * AABB the leaf is removed and reinserted; insertion picks a sibling using the
+ * surface area heuristic and refits the ancestors on the way back up, applying
+ * tree rotations to keep the tree balanced.
+ */
+
+namespace smlt {
+
+class Frustum;
+
+typedef int32_t AABBTreeProxy;
+const static AABBTreeProxy NULL_AABB_TREE_NODE = -1;
+
+const static float DEFAULT_AABB_TREE_MARGIN = 0.5f;
+
+class AABBTree {
+public:
+    AABBTree(float margin=DEFAULT_AABB_TREE_MARGIN);
+
+    AABBTreeProxy insert(const AABB& box, void* user_data);
+    void remove(AABBTreeProxy proxy);
+
+    /* Returns true if the leaf had to be moved in the tree */
+    bool update(AABBTreeProxy proxy, const AABB& box);
+
+    void* user_data(AABBTreeProxy proxy) const {
+        return nodes_[proxy].user_data;
+    }
+
+    AABB fat_aabb(AABBTreeProxy proxy) const {
+        return AABB(nodes_[proxy].min, nodes_[proxy].max);
+    }
+
+    /* All queries return the user data of leaves whose *fat* AABB passes
+     * the test, so callers should refine the results if they need to */
+    void find_objects_within_box(const AABB& box, std::vector<void*>& results) const;
+    void find_objects_within_frustum(const Frustum& frustum, std::vector<void*>& results) const;
+
+    /* Leaves hit by the ray from start in direction dir, up to max_distance (in
+     * multiples of dir) */
+    void find_objects_intersecting_ray(
+        const Vec3& start, const Vec3& dir, float max_distance, std::vector<void*>& results
+    ) const;
+
+    std::size_t size() const { return leaf_count_; }
+    bool empty() const { return leaf_count_ == 0; }
+
+    /* Height of the tree, a single leaf has a height of 0 */
+    int32_t height() const {
+        return (root_ == NULL_AABB_TREE_NODE) ? 0 : nodes_[root_].height;
+    }
+
+    /* Debug check that parent links, heights and bounds are consistent */
+    bool validate() const;
+
+private:
+    struct Node {
+        Vec3 min;
+        Vec3 max;
+
+        void* user_data = nullptr;
+
+        /* When the node is on the free list, parent is the next free node */
+        AABBTreeProxy parent = NULL_AABB_TREE_NODE;
+        AABBTreeProxy left = NULL_AABB_TREE_NODE;
+        AABBTreeProxy right = NULL_AABB_TREE_NODE;
+
+        /* 0 for leaves, -1 for free nodes */
+        int32_t height = -1;
+
+        bool is_leaf() const { return left == NULL_AABB_TREE_NODE; }
+    };
+
+    AABBTreeProxy allocate_node();
+    void free_node(AABBTreeProxy node);
+
+    void insert_leaf(AABBTreeProxy leaf);
+    void remove_leaf(AABBTreeProxy leaf);
+
+    void refit(AABBTreeProxy node);
+    AABBTreeProxy balance(AABBTreeProxy node);
+
+    void collect_leaves(AABBTreeProxy node, std::vector<void*>& results) const;
+    void find_within_frustum(
+        AABBTreeProxy node, const Frustum& frustum, uint8_t plane_mask, std::vector<void*>& results
+    ) const;
+
+    bool validate_node(AABBTreeProxy node) const;
+
+    float margin_;
+
+    std::vector<Node> nodes_;
+    AABBTreeProxy root_ = NULL_AABB_TREE_NODE;
+    AABBTreeProxy free_list_ = NULL_AABB_TREE_NODE;
+    std::size_t leaf_count_ = 0;
+};
+
+}
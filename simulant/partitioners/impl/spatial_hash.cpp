@@ -140,7 +140,18 @@ HGSHEntryList SpatialHash::find_objects_within_frustum(const Frustum &frustum) {
 
     for(auto& box: boxes) {
         for(auto& result: find_objects_within_box(box)) {
-            if(frustum.intersects_aabb(result->hash_aabb())) {
+            if(results.count(result)) {
+                /* Already found via another box */
+                continue;
+            }
+
+            auto& aabb = result->hash_aabb();
+            auto classification = frustum.classify_aabb(
+                aabb.centre(), (aabb.max() - aabb.min()) * 0.5f,
+                nullptr, &result->last_failed_plane
+            );
+
+            if(classification != FRUSTUM_CONTAINS_NONE) {
                 results.insert(result);
             }
         }
@@ -6,6 +6,7 @@
 #include <ostream>
 #include <unordered_set>
 #include "../../interfaces.h"
+#include "../../frustum.h"
 
 /*
  * Hierarchical Grid Spatial Hash implementation
@@ -110,6 +111,10 @@ public:
     }
 
     const AABB& hash_aabb() const { return hash_aabb_; }
+
+    /* Used by find_objects_within_frustum to test the plane which rejected
+     * this entry last time first */
+    uint8_t last_failed_plane = FRUSTUM_PLANE_NONE;
 private:
     KeyList keys_;
     AABB hash_aabb_;
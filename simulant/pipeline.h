@@ -76,6 +76,19 @@ public:
 
     PipelinePtr set_camera(CameraID c);
 
+    /* When enabled, nodes which are entirely hidden behind occluders (see
+     * StageNode::set_occluder_mesh) are skipped before their renderables are
+     * gathered. This costs a software rasterization of the occluders each
+     * frame, so it's only worth it for scenes with lots of hidden geometry. */
+    PipelinePtr set_occlusion_culling_enabled(bool value) {
+        occlusion_culling_enabled_ = value;
+        return this;
+    }
+
+    bool is_occlusion_culling_enabled() const {
+        return occlusion_culling_enabled_;
+    }
+
 private:
     void set_stage(StageID s);
 
@@ -88,6 +101,7 @@ private:
 
     uint32_t clear_mask_ = 0;
     bool is_active_ = false;
+    bool occlusion_culling_enabled_ = false;
     std::string name_;
 
     std::map<DetailLevel, float> detail_level_end_distances_;
@@ -0,0 +1,208 @@
+#include <cstring>
+
+#include "dynamic_batcher.h"
+#include "../../vertex_data.h"
+
+namespace smlt {
+namespace batcher {
+
+bool same_lights(const Renderable* a, const Renderable* b) {
+    if(a->light_count != b->light_count) {
+        return false;
+    }
+
+    for(auto i = 0u; i < a->light_count; ++i) {
+        if(a->lights_affecting_this_frame[i] != b->lights_affecting_this_frame[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool DynamicBatcher::is_candidate(const Renderable* renderable) const {
+    if(!is_enabled()) {
+        return false;
+    }
+
+    /* Strips and fans can't be joined without degenerate primitives */
+    if(renderable->arrangement != MESH_ARRANGEMENT_TRIANGLES && renderable->arrangement != MESH_ARRANGEMENT_LINES) {
+        return false;
+    }
+
+    /* Merging would bake the current keyframe or bind pose into the batch */
+    if(renderable->morph_target || renderable->skin_data) {
+        return false;
+    }
+
+    if(renderable->vertex_data->count() > vertex_threshold_) {
+        return false;
+    }
+
+    auto& spec = renderable->vertex_data->vertex_specification();
+    VertexAttribute position = spec.position_attribute;
+    VertexAttribute normal = spec.normal_attribute;
+
+    /* 2D positions have nowhere to keep the z of the transform, so baking
+     * them would flatten each source onto z = 0 */
+    if(position != VERTEX_ATTRIBUTE_3F && position != VERTEX_ATTRIBUTE_4F) {
+        return false;
+    }
+
+    return normal == VERTEX_ATTRIBUTE_NONE || normal == VERTEX_ATTRIBUTE_3F;
+}
+
+bool DynamicBatcher::are_compatible(const Renderable* a, const Renderable* b) {
+    return (
+        a->material == b->material &&
+        a->arrangement == b->arrangement &&
+        a->render_priority == b->render_priority &&
+        a->vertex_data->vertex_specification() == b->vertex_data->vertex_specification() &&
+        same_lights(a, b)
+    );
+}
+
+void DynamicBatcher::reset() {
+    used_ = 0;
+    draws_saved_ = 0;
+}
+
+const Renderable* DynamicBatcher::merge(const Renderable* const* renderables, std::size_t count) {
+    assert(count);
+
+    const Renderable* first = renderables[0];
+    auto& spec = first->vertex_data->vertex_specification();
+
+    if(used_ == pool_.size()) {
+        pool_.push_back(std::unique_ptr<Merged>(new Merged()));
+        pool_.back()->vertex_data = VertexData::create(spec);
+        pool_.back()->index_data = IndexData::create(INDEX_TYPE_16_BIT);
+    }
+
+    auto& merged = *pool_[used_++];
+
+    if(merged.vertex_data->vertex_specification() != spec) {
+        merged.vertex_data->reset(spec);
+    }
+
+    uint32_t vertex_count = 0;
+    for(std::size_t i = 0; i < count; ++i) {
+        vertex_count += renderables[i]->vertex_data->count();
+    }
+
+    assert(vertex_count <= DYNAMIC_BATCH_MAX_VERTICES);
+
+    auto vdata = merged.vertex_data.get();
+    vdata->resize(vertex_count);
+    merged.index_data->clear();
+    merged.sources.clear();
+
+    const uint32_t stride = spec.stride();
+    const auto position_offset = spec.position_offset();
+    const auto normal_offset = spec.normal_offset(false);
+    const VertexAttribute position_type = spec.position_attribute;
+    const bool has_normals = spec.has_normals();
+
+    uint8_t* out = vdata->data();
+    uint32_t base = 0;
+    Vec3 centre;
+
+    for(std::size_t i = 0; i < count; ++i) {
+        auto source = renderables[i];
+        auto src_vdata = source->vertex_data;
+        auto n = src_vdata->count();
+
+        std::memcpy(out, src_vdata->data(), n * stride);
+
+        const Mat4& transform = source->final_transformation;
+
+        /* Normals go through the inverse transpose, so that non-uniform
+         * scaling doesn't skew them */
+        Mat4 inverse = (has_normals) ? transform.inversed() : Mat4();
+
+        for(uint32_t v = 0; v < n; ++v) {
+            float* pos = (float*) (out + position_offset);
+            Vec4 p(pos[0], pos[1], pos[2], 1.0f);
+            if(position_type == VERTEX_ATTRIBUTE_4F) {
+                p.w = pos[3];
+            }
+
+            p = transform * p;
+
+            pos[0] = p.x;
+            pos[1] = p.y;
+            pos[2] = p.z;
+
+            if(position_type == VERTEX_ATTRIBUTE_4F) {
+                pos[3] = p.w;
+            }
+
+            if(has_normals) {
+                float* nrm = (float*) (out + normal_offset);
+                Vec3 t(
+                    inverse[0] * nrm[0] + inverse[1] * nrm[1] + inverse[2] * nrm[2],
+                    inverse[4] * nrm[0] + inverse[5] * nrm[1] + inverse[6] * nrm[2],
+                    inverse[8] * nrm[0] + inverse[9] * nrm[1] + inverse[10] * nrm[2]
+                );
+
+                t.normalize();
+                nrm[0] = t.x;
+                nrm[1] = t.y;
+                nrm[2] = t.z;
+            }
+
+            out += stride;
+        }
+
+        auto element_count = source->index_element_count;
+        index_scratch_.resize(element_count);
+        for(std::size_t e = 0; e < element_count; ++e) {
+            index_scratch_[e] = base + source->index_data->at(e);
+        }
+        merged.index_data->index(index_scratch_.data(), element_count);
+
+        base += n;
+        centre += source->centre;
+
+        Source s;
+        s.renderable = source;
+        s.vertex_version = src_vdata->last_updated();
+        s.index_version = source->index_data->last_updated();
+        merged.sources.push_back(s);
+    }
+
+    vdata->done();
+    merged.index_data->done();
+
+    auto& renderable = merged.renderable;
+    renderable = *first;
+    renderable.vertex_data = vdata;
+    renderable.index_data = merged.index_data.get();
+    renderable.index_element_count = merged.index_data->count();
+    renderable.final_transformation = Mat4();
+    renderable.centre = centre / float(count);
+
+    draws_saved_ += count - 1;
+
+    return &renderable;
+}
+
+bool DynamicBatcher::is_stale() const {
+    for(std::size_t i = 0; i < used_; ++i) {
+        auto& merged = *pool_[i];
+        for(auto& source: merged.sources) {
+            auto renderable = source.renderable;
+
+            if(renderable->vertex_data->last_updated() != source.vertex_version ||
+                renderable->index_data->last_updated() != source.index_version ||
+                !same_lights(renderable, &merged.renderable)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+}
+}
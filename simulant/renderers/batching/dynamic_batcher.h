@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "renderable.h"
+
+namespace smlt {
+namespace batcher {
+
+/* Merged renderables use 16 bit indices, so a batch can't go past this */
+const uint32_t DYNAMIC_BATCH_MAX_VERTICES = 65535;
+
+/* A sensible threshold for Compositor::set_dynamic_batching_threshold(),
+ * batching is off unless it's set */
+const uint32_t DYNAMIC_BATCH_DEFAULT_VERTEX_THRESHOLD = 300;
+
+/* True if both renderables are affected by the same lights, in the same order */
+bool same_lights(const Renderable* a, const Renderable* b);
+
+/*
+ * Merges runs of small renderables which share all of their render state into
+ * a single renderable, so they can be drawn with one call instead of one each.
+ * Vertices are transformed into world space on the CPU, and the merged
+ * renderable has an identity transformation.
+ *
+ * Merged renderables (and their vertex and index data) are pooled, and are
+ * valid until the next reset().
+ */
+class DynamicBatcher {
+public:
+    /* Renderables with more vertices than this are never merged. Zero
+     * disables batching */
+    void set_vertex_threshold(uint32_t value) { vertex_threshold_ = value; }
+    uint32_t vertex_threshold() const { return vertex_threshold_; }
+    bool is_enabled() const { return vertex_threshold_ > 0; }
+
+    /* Whether the renderable is small enough, and its vertex format simple
+     * enough, to be merged. Positions must be 3D or 4D */
+    bool is_candidate(const Renderable* renderable) const;
+
+    /* Whether two candidates can be drawn in the same call. They must also
+     * be using the same material pass */
+    static bool are_compatible(const Renderable* a, const Renderable* b);
+
+    void reset();
+
+    /* Merges the renderables into one. The total vertex count must not
+     * exceed DYNAMIC_BATCH_MAX_VERTICES */
+    const Renderable* merge(const Renderable* const* renderables, std::size_t count);
+
+    /* True if anything which was merged since the last reset() has changed
+     * its vertices, indices or lights. Transformations aren't checked. */
+    bool is_stale() const;
+
+    /* The number of draw calls saved by the merges since the last reset() */
+    std::size_t draws_saved() const { return draws_saved_; }
+
+private:
+    struct Source {
+        const Renderable* renderable;
+        uint64_t vertex_version;
+        uint64_t index_version;
+    };
+
+    struct Merged {
+        std::shared_ptr<VertexData> vertex_data;
+        std::shared_ptr<IndexData> index_data;
+        Renderable renderable;
+        std::vector<Source> sources;
+    };
+
+    uint32_t vertex_threshold_ = 0;
+
+    std::vector<std::unique_ptr<Merged>> pool_;
+    std::size_t used_ = 0;
+    std::size_t draws_saved_ = 0;
+
+    std::vector<uint32_t> index_scratch_;
+};
+
+}
+}
@@ -26,31 +26,230 @@
 #include "../../nodes/geoms/geom_culler.h"
 #include "../../nodes/camera.h"
 
+#include <cstring>
+
 #include "render_queue.h"
+#include "dynamic_batcher.h"
 #include "../../partitioner.h"
 
 namespace smlt {
 namespace batcher {
 
 
-RenderGroupKey generate_render_group_key(const uint8_t pass, const bool is_blended, const float distance_to_camera) {
+RenderGroupKey generate_render_group_key(
+    const uint8_t pass,
+    const bool is_blended,
+    const float distance_to_camera,
+    const uint16_t material_id,
+    const uint16_t texture_id) {
+
     RenderGroupKey key;
     key.pass = pass;
     key.is_blended = is_blended;
+    key.material_id = material_id;
     key.distance_to_camera = distance_to_camera;
+    key.texture_id = texture_id;
+    key.padding = 0;
     return key;
 }
 
-RenderQueue::RenderQueue() {
+uint32_t quantise_depth(const float distance) {
+    if(!(distance > 0.0f)) {
+        return 0;
+    }
+
+    /* The bit pattern of a positive float increases monotonically with its
+     * value, so the top 24 bits (after the sign) are an ordered depth with
+     * roughly 16 bits of relative precision at any range */
+    uint32_t bits;
+    std::memcpy(&bits, &distance, sizeof(float));
+    return (bits >> 7) & 0xFFFFFF;
+}
+
+uint64_t generate_render_key(const RenderPriority priority, const RenderGroupKey& key) {
+    const uint64_t p = uint64_t(priority - RENDER_PRIORITY_MIN) & 0x1FF;
+    const uint64_t pass = uint64_t(key.pass) & 0xF;
+    const uint64_t material = uint64_t(key.material_id) & 0x3FFF;
+    const uint64_t texture = uint64_t(key.texture_id) & 0xFFF;
+    const uint64_t depth = quantise_depth(key.distance_to_camera);
+
+    uint64_t ret = (p << 55) | (pass << 51);
+
+    if(key.is_blended) {
+        ret |= (uint64_t(1) << 50);
+        ret |= (uint64_t(~depth & 0xFFFFFF) << 26);
+        ret |= (material << 12);
+        ret |= texture;
+    } else {
+        ret |= (material << 36);
+        ret |= (texture << 24);
+        ret |= depth;
+    }
+
+    return ret;
+}
+
+struct RenderQueue::Batch {
+    /* Null for the batch of renderables inserted outside of begin_node() */
+    StageNode* node = nullptr;
+
+    uint64_t version = 0;
+    DetailLevel detail_level = DETAIL_LEVEL_NEAREST;
+    uint64_t last_frame = 0;
+    bool reused = false;
+
+    std::vector<Renderable> renderables;
+    std::vector<Entry> entries;
+
+    /* The version of each renderable's material when it was inserted */
+    std::vector<uint32_t> material_versions;
+};
+
+RenderQueue::RenderQueue():
+    unowned_(new Batch()),
+    dynamic_batcher_(new DynamicBatcher()) {
+
+}
+
+RenderQueue::~RenderQueue() {
 
 }
 
 void RenderQueue::reset(Stage* stage, RenderGroupFactory* factory, CameraPtr camera) {
+    thread::Lock<thread::Mutex> lock(queue_lock_);
+
     stage_ = stage;
     render_group_factory_ = factory;
     camera_ = camera;
 
-    clear();
+    ++frame_;
+
+    visible_.clear();
+    current_ = nullptr;
+    empty_batch(unowned_.get());
+
+    renderable_count_ = 0;
+    reused_node_count_ = 0;
+    rebuilt_node_count_ = 0;
+
+    if(camera_) {
+        auto plane = camera_->frustum().plane(FRUSTUM_PLANE_NEAR);
+        near_plane_changed_ = (plane.n != near_plane_.n || plane.d != near_plane_.d);
+        near_plane_ = plane;
+    }
+
+    if((frame_ % RENDER_QUEUE_BATCH_MAX_AGE) == 0) {
+        evict_stale_batches();
+    }
+}
+
+RenderQueue::Batch* RenderQueue::make_visible(Batch* batch) {
+    if(batch->last_frame != frame_) {
+        batch->last_frame = frame_;
+        visible_.push_back(batch);
+    }
+
+    return batch;
+}
+
+void RenderQueue::empty_batch(Batch* batch) {
+    batch->renderables.clear();
+    batch->entries.clear();
+    batch->material_versions.clear();
+    batch->reused = false;
+}
+
+bool RenderQueue::can_reuse(const Batch* batch, uint64_t version, DetailLevel detail_level) const {
+    if(!sorting_enabled_ || !version) {
+        return false;
+    }
+
+    if(batch->version != version || batch->detail_level != detail_level) {
+        return false;
+    }
+
+    /* Materials don't signal changes, so compare their versions. Index data
+     * can be changed in place so check that too */
+    for(std::size_t i = 0; i < batch->renderables.size(); ++i) {
+        auto& renderable = batch->renderables[i];
+        if(renderable.material->version() != batch->material_versions[i]) {
+            return false;
+        }
+
+        if(renderable.index_element_count != renderable.index_data->count()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void RenderQueue::update_distances(Batch* batch) {
+    for(auto& entry: batch->entries) {
+        auto& renderable = batch->renderables[entry.renderable_index];
+        entry.group.sort_key.distance_to_camera = near_plane_.distance_to(renderable.centre);
+        entry.key = generate_render_key(entry.priority, entry.group.sort_key);
+    }
+}
+
+void RenderQueue::evict_stale_batches() {
+    for(auto it = batches_.begin(); it != batches_.end();) {
+        if(it->second->last_frame + RENDER_QUEUE_BATCH_MAX_AGE < frame_) {
+            it = batches_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool RenderQueue::begin_node(StageNode* node, uint64_t version, DetailLevel detail_level) {
+    assert(node);
+    assert(!current_);
+
+    auto& batch = batches_[node];
+    if(!batch) {
+        batch.reset(new Batch());
+        batch->node = node;
+    }
+
+    current_ = make_visible(batch.get());
+
+    if(can_reuse(current_, version, detail_level)) {
+        current_->reused = true;
+        renderable_count_ += current_->renderables.size();
+        ++reused_node_count_;
+
+        if(near_plane_changed_) {
+            update_distances(current_);
+            sort_keys_dirty_ = true;
+        }
+
+        return true;
+    }
+
+    empty_batch(current_);
+    current_->version = version;
+    current_->detail_level = detail_level;
+    ++rebuilt_node_count_;
+    sort_keys_dirty_ = true;
+
+    return false;
+}
+
+void RenderQueue::set_node_lights(const LightPtr* lights, const uint8_t count) {
+    assert(current_);
+
+    for(auto& renderable: current_->renderables) {
+        for(auto i = 0u; i < count; ++i) {
+            renderable.lights_affecting_this_frame[i] = lights[i];
+        }
+
+        renderable.light_count = count;
+    }
+}
+
+void RenderQueue::end_node() {
+    current_ = nullptr;
 }
 
 void RenderQueue::insert_renderable(Renderable&& src_renderable) {
@@ -64,21 +263,43 @@ void RenderQueue::insert_renderable(Renderable&& src_renderable) {
     assert(camera_);
     assert(render_group_factory_);
 
-    auto idx = renderables_.size();
-    renderables_.push_back(src_renderable);
-    auto renderable = &renderables_.back();
-
-    if(!renderable->is_visible || !renderable->index_element_count) {
-        renderables_.pop_back();
+    if(!src_renderable.is_visible || !src_renderable.index_element_count) {
         return;
     }
 
+    Batch* batch = (current_) ? current_ : make_visible(unowned_.get());
+
+    /* Nothing should be inserted for a node which is being reused */
+    assert(!batch->reused);
+
+    auto idx = batch->renderables.size();
+    batch->renderables.push_back(std::move(src_renderable));
+    auto renderable = &batch->renderables.back();
+
+    assert(
+        renderable->arrangement == MESH_ARRANGEMENT_LINES ||
+        renderable->arrangement == MESH_ARRANGEMENT_LINE_STRIP ||
+        renderable->arrangement == MESH_ARRANGEMENT_QUADS ||
+        renderable->arrangement == MESH_ARRANGEMENT_TRIANGLES ||
+        renderable->arrangement == MESH_ARRANGEMENT_TRIANGLE_FAN ||
+        renderable->arrangement == MESH_ARRANGEMENT_TRIANGLE_STRIP
+    );
+
+    assert(renderable->index_data);
+    assert(renderable->vertex_data);
+
     auto material = renderable->material;
     assert(material);
 
-    auto pos = renderable->centre;
-    auto plane = camera_->frustum().plane(FRUSTUM_PLANE_NEAR);
-    auto renderable_dist_to_camera = plane.distance_to(pos);
+    batch->material_versions.push_back(material->version());
+    ++renderable_count_;
+
+    if(!sorting_enabled_) {
+        /* Render groups will be generated when this is merged */
+        return;
+    }
+
+    auto renderable_dist_to_camera = near_plane_.distance_to(renderable->centre);
     auto priority = renderable->render_priority;
 
     auto pass_count = material->pass_count();
@@ -94,95 +315,341 @@ void RenderQueue::insert_renderable(Renderable&& src_renderable) {
             i, is_blended, renderable_dist_to_camera
         );
 
-        // Priorities run from -250 to +250, so we need to offset the index
-        auto queue_number = priority + std::abs(RENDER_PRIORITY_MIN);
-        assert(queue_number < (int) priority_queues_.size());
+        assert(priority >= RENDER_PRIORITY_MIN && priority < RENDER_PRIORITY_MAX);
 
-        auto& priority_queue = priority_queues_[queue_number];
-        priority_queue.insert(std::move(group), std::move(idx));
+        Entry entry;
+        entry.group = group;
+        entry.priority = priority;
+        entry.renderable_index = idx;
+        entry.key = generate_render_key(priority, group.sort_key);
+        batch->entries.push_back(entry);
     }
+
+    sort_keys_dirty_ = true;
 }
 
+void RenderQueue::sort_if_necessary() const {
+    if(!sort_keys_dirty_ && visible_ == sorted_batches_) {
+        return;
+    }
+
+    sort_keys_.clear();
+    for(uint32_t b = 0; b < visible_.size(); ++b) {
+        auto& entries = visible_[b]->entries;
+        for(uint32_t e = 0; e < entries.size(); ++e) {
+            SortKey key;
+            key.key = entries[e].key;
+            key.batch_index = b;
+            key.entry_index = e;
+            sort_keys_.push_back(key);
+        }
+    }
+
+    radix_sort(sort_keys_, sort_scratch_, [](const SortKey& k) -> uint64_t {
+        return k.key;
+    });
+
+    sorted_batches_ = visible_;
+    sort_keys_dirty_ = false;
+    draws_dirty_ = true;
+}
+
+void RenderQueue::set_dynamic_batching_threshold(uint32_t max_vertices) {
+    if(max_vertices != dynamic_batcher_->vertex_threshold()) {
+        dynamic_batcher_->set_vertex_threshold(max_vertices);
+        draws_dirty_ = true;
+    }
+}
+
+uint32_t RenderQueue::dynamic_batching_threshold() const {
+    return dynamic_batcher_->vertex_threshold();
+}
+
+std::size_t RenderQueue::draws_saved_count() const {
+    return dynamic_batcher_->draws_saved();
+}
+
+void RenderQueue::build_draws_if_necessary() const {
+    /* The merged renderables can be kept as long as the draw order is
+     * unchanged. Reused nodes haven't moved, but their vertices or lights
+     * may have changed without invalidating the order */
+    if(!draws_dirty_ && !(dynamic_batcher_->is_enabled() && dynamic_batcher_->is_stale())) {
+        return;
+    }
+
+    draws_.clear();
+    dynamic_batcher_->reset();
+
+    const auto count = sort_keys_.size();
+    for(std::size_t i = 0; i < count;) {
+        auto& key = sort_keys_[i];
+        const Entry* entry = &visible_[key.batch_index]->entries[key.entry_index];
+        const Renderable* renderable = &visible_[key.batch_index]->renderables[entry->renderable_index];
+
+        auto j = i + 1;
+
+        if(dynamic_batcher_->is_candidate(renderable)) {
+            merge_scratch_.clear();
+            merge_scratch_.push_back(renderable);
+
+            uint32_t vertex_count = renderable->vertex_data->count();
+
+            for(; j < count; ++j) {
+                auto& next_key = sort_keys_[j];
+                const Entry* next = &visible_[next_key.batch_index]->entries[next_key.entry_index];
+                const Renderable* next_renderable = &visible_[next_key.batch_index]->renderables[next->renderable_index];
+
+                if(next->priority != entry->priority ||
+                    next->group.sort_key.pass != entry->group.sort_key.pass ||
+                    !dynamic_batcher_->is_candidate(next_renderable) ||
+                    !DynamicBatcher::are_compatible(renderable, next_renderable) ||
+                    vertex_count + next_renderable->vertex_data->count() > DYNAMIC_BATCH_MAX_VERTICES) {
+                    break;
+                }
+
+                vertex_count += next_renderable->vertex_data->count();
+                merge_scratch_.push_back(next_renderable);
+            }
+
+            if(merge_scratch_.size() > 1) {
+                renderable = dynamic_batcher_->merge(merge_scratch_.data(), merge_scratch_.size());
+            }
+        }
+
+        Draw draw;
+        draw.entry = entry;
+        draw.renderable = renderable;
+        draw.instance_run = 1;
+        draws_.push_back(draw);
+
+        i = j;
+    }
+
+    draws_dirty_ = false;
+}
+
+static bool is_instance_of(const Renderable* a, const Renderable* b) {
+    return (
+        a->vertex_data == b->vertex_data &&
+        a->index_data == b->index_data &&
+        a->index_element_count == b->index_element_count &&
+        a->morph_target == b->morph_target &&
+        a->morph_weight == b->morph_weight &&
+        a->joint_palette == b->joint_palette &&
+        a->arrangement == b->arrangement &&
+        a->material == b->material &&
+        same_lights(a, b)
+    );
+}
+
+void RenderQueue::find_instance_runs() const {
+    /* Merged renderables have their own vertex data so they never match
+     * anything, which leaves instancing for whatever batching didn't take */
+    const auto count = draws_.size();
+    for(std::size_t i = 0; i < count;) {
+        auto& first = draws_[i];
+
+        auto j = i + 1;
+        for(; j < count; ++j) {
+            auto& next = draws_[j];
+            if(next.entry->priority != first.entry->priority ||
+                !next.entry->group.has_same_state(first.entry->group) ||
+                !is_instance_of(first.renderable, next.renderable)) {
+                break;
+            }
+
+            next.instance_run = 1;
+        }
+
+        first.instance_run = uint32_t(j - i);
+        i = j;
+    }
+}
+
+void RenderQueue::merge(RenderQueue& other) {
+    for(auto source: other.visible_) {
+        Batch* target = unowned_.get();
+        if(source->node) {
+            auto it = batches_.find(source->node);
+            assert(it != batches_.end() && it->second->last_frame == frame_);
+            target = it->second.get();
+        }
+
+        auto previous = current_;
+        current_ = (target == unowned_.get()) ? nullptr : target;
+
+        target->renderables.reserve(target->renderables.size() + source->renderables.size());
+        for(auto& renderable: source->renderables) {
+            insert_renderable(std::move(renderable));
+        }
+
+        current_ = previous;
+
+        other.empty_batch(source);
+    }
+
+    other.visible_.clear();
+    other.renderable_count_ = 0;
+}
+
+Renderable* RenderQueue::renderable(const std::size_t i) {
+    auto remaining = i;
+    for(auto batch: visible_) {
+        if(remaining < batch->renderables.size()) {
+            return &batch->renderables[remaining];
+        }
+
+        remaining -= batch->renderables.size();
+    }
+
+    return nullptr;
+}
 
 void RenderQueue::clear() {
     thread::Lock<thread::Mutex> lock(queue_lock_);
-    for(auto& queue: priority_queues_) {
-        queue.clear();
-    }
 
-    renderables_.clear();
+    batches_.clear();
+    empty_batch(unowned_.get());
+    unowned_->last_frame = 0;
+
+    visible_.clear();
+    current_ = nullptr;
+
+    renderable_count_ = 0;
+    reused_node_count_ = 0;
+    rebuilt_node_count_ = 0;
+
+    sort_keys_.clear();
+    sorted_batches_.clear();
+    sort_keys_dirty_ = true;
+    near_plane_changed_ = true;
+
+    draws_.clear();
+    dynamic_batcher_->reset();
+    draws_dirty_ = true;
+
+    ++frame_;
 }
 
 void RenderQueue::traverse(RenderQueueVisitor* visitor, uint64_t frame_id) const {
     thread::Lock<thread::Mutex> lock(queue_lock_);
 
+    sort_if_necessary();
+    build_draws_if_necessary();
+
+    /* Lights can change without invalidating the draws, and runs are cheap
+     * to find, so do it every time */
+    find_instance_runs();
+
+    state_change_count_ = 0;
+
     visitor->start_traversal(*this, frame_id, stage_);
 
-    for(auto& queue: priority_queues_) {
-        IterationType pass_iteration_type = ITERATION_TYPE_ONCE;
-        MaterialPass* material_pass = nullptr, *last_pass = nullptr;
+    IterationType pass_iteration_type = ITERATION_TYPE_ONCE;
+    MaterialPass* material_pass = nullptr, *last_pass = nullptr;
+    const RenderGroup* last_group = nullptr;
+    RenderPriority last_priority = RENDER_PRIORITY_MIN;
 
-        const RenderGroup* last_group = nullptr;
+    instance_run_count_ = 0;
 
-        for(auto& p: queue) {
-            const RenderGroup* current_group = &p.first;
-            const Renderable* renderable = &renderables_[p.second];
+    for(std::size_t d = 0; d < draws_.size(); d += draws_[d].instance_run) {
+        auto& draw = draws_[d];
+        const Entry& entry = *draw.entry;
 
-            /* We do this here so that we don't change render group unless something in the
-             * new group is visible */
-            if(!last_group || *current_group != *last_group) {
-                visitor->change_render_group(last_group, current_group);
-            }
+        /* Each priority is rendered as a separate group of state changes */
+        if(entry.priority != last_priority) {
+            last_group = nullptr;
+            last_pass = nullptr;
+            last_priority = entry.priority;
+        }
 
-            material_pass = renderable->material->pass(current_group->sort_key.pass);
+        const RenderGroup* current_group = &entry.group;
+        const Renderable* renderable = draw.renderable;
 
-            if(material_pass != last_pass) {
-                pass_iteration_type = material_pass->iteration_type();
-                visitor->change_material_pass(last_pass, material_pass);
-                last_pass = material_pass;
-            }
+        /* We do this here so that we don't change render group unless something in the
+         * new group is visible */
+        if(!last_group || *current_group != *last_group) {
+            visitor->change_render_group(last_group, current_group);
+            ++state_change_count_;
+        }
 
-            uint32_t iterations = 1;
+        material_pass = renderable->material->pass(current_group->sort_key.pass);
 
-            // Get any lights which are visible and affecting the renderable this frame
-            auto& lights = renderable->lights_affecting_this_frame;
+        if(material_pass != last_pass) {
+            pass_iteration_type = material_pass->iteration_type();
+            visitor->change_material_pass(last_pass, material_pass);
+            last_pass = material_pass;
+            ++state_change_count_;
+        }
 
-            if(pass_iteration_type == ITERATION_TYPE_N) {
-                iterations = material_pass->max_iterations();
-            } else if(pass_iteration_type == ITERATION_TYPE_ONCE_PER_LIGHT) {
-                iterations = renderable->light_count;
+        if(draw.instance_run > 1) {
+            instance_scratch_.clear();
+            for(auto k = 0u; k < draw.instance_run; ++k) {
+                instance_scratch_.push_back(draws_[d + k].renderable);
             }
+            ++instance_run_count_;
+        }
 
-            for(Iteration i = 0; i < iterations; ++i) {
-                LightPtr next = nullptr;
+        uint32_t iterations = 1;
 
-                // Pass down the light if necessary, otherwise just pass nullptr
-                if(i < renderable->light_count) {
-                    next = lights[i];
-                } else {
-                    next = nullptr;
-                }
+        // Get any lights which are visible and affecting the renderable this frame
+        auto& lights = renderable->lights_affecting_this_frame;
 
-                if(pass_iteration_type == ITERATION_TYPE_ONCE_PER_LIGHT) {
-                    visitor->apply_lights(&next, 1);
-                } else if(pass_iteration_type == ITERATION_TYPE_N || pass_iteration_type == ITERATION_TYPE_ONCE) {
-                    visitor->apply_lights(&lights[0], (uint8_t) renderable->light_count);
-                }
-                visitor->visit(renderable, material_pass, i);
+        if(pass_iteration_type == ITERATION_TYPE_N) {
+            iterations = material_pass->max_iterations();
+        } else if(pass_iteration_type == ITERATION_TYPE_ONCE_PER_LIGHT) {
+            iterations = renderable->light_count;
+        }
+
+        for(Iteration i = 0; i < iterations; ++i) {
+            LightPtr next = nullptr;
+
+            // Pass down the light if necessary, otherwise just pass nullptr
+            if(i < renderable->light_count) {
+                next = lights[i];
+            } else {
+                next = nullptr;
+            }
+
+            if(pass_iteration_type == ITERATION_TYPE_ONCE_PER_LIGHT) {
+                visitor->apply_lights(&next, 1);
+            } else if(pass_iteration_type == ITERATION_TYPE_N || pass_iteration_type == ITERATION_TYPE_ONCE) {
+                visitor->apply_lights(&lights[0], (uint8_t) renderable->light_count);
             }
 
-            last_group = current_group;
+            if(draw.instance_run > 1) {
+                visitor->visit_instances(&instance_scratch_[0], instance_scratch_.size(), material_pass, i);
+            } else {
+                visitor->visit(renderable, material_pass, i);
+            }
         }
+
+        last_group = current_group;
     }
 
     visitor->end_traversal(*this, stage_);
 }
 
 std::size_t RenderQueue::group_count(Pass pass_number) const {
-    uint32_t i = 0;
-    auto& queue = priority_queues_.at(pass_number);
-    for(auto it = queue.begin(); it != queue.end(); it = queue.upper_bound(it->first)) {
-        ++i;
+    /* pass_number is the index of the priority queue, as this used to
+     * be one container per priority */
+    RenderPriority priority = RenderPriority(pass_number) + RENDER_PRIORITY_MIN;
+
+    sort_if_necessary();
+
+    std::size_t i = 0;
+    const RenderGroup* last_group = nullptr;
+    for(auto& key: sort_keys_) {
+        const Entry& entry = visible_[key.batch_index]->entries[key.entry_index];
+        if(entry.priority != priority) {
+            continue;
+        }
+
+        if(!last_group || entry.group != *last_group) {
+            ++i;
+        }
+
+        last_group = &entry.group;
     }
 
     return i;
@@ -19,9 +19,12 @@
 #pragma once
 
 #include <list>
+#include <memory>
 #include <set>
+#include <unordered_map>
 
 #include "../../generic/containers/contiguous_map.h"
+#include "../../generic/radix_sort.h"
 
 #include "../../types.h"
 #include "../../threads/shared_mutex.h"
@@ -33,14 +36,17 @@ class MaterialPass;
 class Renderer;
 struct Renderable;
 class Light;
+class StageNode;
 
 namespace batcher {
 
 struct RenderGroupKey {
     uint8_t pass; // 1 byte
     bool is_blended; // 1 byte
+    uint16_t material_id; // 2 bytes, identifies the material (and so program) used
     float distance_to_camera; // 4 bytes
-    uint16_t padding; // 2-bytes to get 8-byte alignment
+    uint16_t texture_id; // 2 bytes, identifies the primary texture
+    uint16_t padding; // 2-bytes to get 4-byte alignment
 };
 
 
@@ -75,10 +81,20 @@ struct RenderGroup {
         return false;
     }
 
-    bool operator==(const RenderGroup& rhs) const  {
+    /* True if both groups are drawn with the same state, whatever their
+     * distance from the camera */
+    bool has_same_state(const RenderGroup& rhs) const {
         return (
             sort_key.pass == rhs.sort_key.pass &&
             sort_key.is_blended == rhs.sort_key.is_blended &&
+            sort_key.material_id == rhs.sort_key.material_id &&
+            sort_key.texture_id == rhs.sort_key.texture_id
+        );
+    }
+
+    bool operator==(const RenderGroup& rhs) const  {
+        return (
+            has_same_state(rhs) &&
             sort_key.distance_to_camera == rhs.sort_key.distance_to_camera
         );
     }
@@ -88,7 +104,31 @@ struct RenderGroup {
     }
 };
 
-RenderGroupKey generate_render_group_key(const uint8_t pass, const bool is_blended, const float distance_to_camera);
+RenderGroupKey generate_render_group_key(
+    const uint8_t pass,
+    const bool is_blended,
+    const float distance_to_camera,
+    const uint16_t material_id=0,
+    const uint16_t texture_id=0
+);
+
+/*
+ * Packs everything the queue orders by into a single integer so that the
+ * draw order for a frame can be produced with one radix sort. From the most
+ * significant bit down:
+ *
+ *  opaque:  priority(9) pass(4) blended(1) material(14) texture(12) depth(24)
+ *  blended: priority(9) pass(4) blended(1) ~depth(24) material(14) texture(12)
+ *
+ * Opaque geometry is grouped by state and then drawn front-to-back within
+ * that state. Blended geometry must be drawn back-to-front so depth takes
+ * precedence over state.
+ */
+uint64_t generate_render_key(const RenderPriority priority, const RenderGroupKey& key);
+
+/* Maps a distance to a 24 bit integer which preserves ordering. Negative
+ * distances are clamped to zero */
+uint32_t quantise_depth(const float distance);
 
 class RenderGroupFactory {
 public:
@@ -110,6 +150,7 @@ typedef uint32_t Pass;
 typedef uint32_t Iteration;
 
 class RenderQueue;
+class DynamicBatcher;
 
 class RenderQueueVisitor {
 public:
@@ -123,71 +164,191 @@ public:
     virtual void apply_lights(const LightPtr* lights, const uint8_t count) = 0;
 
     virtual void visit(const Renderable*, const MaterialPass*, Iteration) = 0;
-    virtual void end_traversal(const RenderQueue& queue, Stage* stage) = 0;
-};
-
-
-class MaterialChangeWatcher {
-public:
-    MaterialChangeWatcher(RenderQueue* queue):
-        queue_(queue) {}
-
-    void watch(MaterialID material_id, Renderable* renderable);
-    void unwatch(Renderable* renderable);
-
-private:
-    RenderQueue* queue_;
-
-    /*
-     * We store a list of all the renderables that need to be reinserted if a material changes
-     */
-    std::unordered_map<MaterialID, std::set<Renderable*>> renderables_by_material_;
 
-    /*
-     * We store connections to material update signals, when all renderables are removed
-     * for a particular material, we disconnect the signal
-     */
-    std::unordered_map<MaterialID, sig::connection> material_update_conections_;
+    /* Visits a run of renderables which share vertex data, index data,
+     * material pass and lights, and so differ only in their transformation.
+     * Visitors which can draw them with a single instanced call should
+     * override this, by default each one is visited in turn. */
+    virtual void visit_instances(const Renderable* const* renderables, std::size_t count, const MaterialPass* pass, Iteration iteration) {
+        for(std::size_t i = 0; i < count; ++i) {
+            visit(renderables[i], pass, iteration);
+        }
+    }
 
-    void on_material_changed(MaterialID material);
+    virtual void end_traversal(const RenderQueue& queue, Stage* stage) = 0;
 };
 
 
+/* Batches which haven't been visible for this many frames are freed */
+const static uint64_t RENDER_QUEUE_BATCH_MAX_AGE = 120;
+
+/*
+ * The render queue is retained between frames. Renderables are stored in
+ * batches, one per stage node, along with their render groups and sort keys.
+ * Each frame a node is either reused as-is (if it hasn't changed) or has its
+ * batch emptied and refilled, so the cost of building the queue is
+ * proportional to what changed rather than to the number of visible nodes.
+ * The draw order is only re-sorted when something changed.
+ *
+ * Renderables inserted outside of begin_node() / end_node() go into a
+ * batch which is emptied on every reset().
+ */
 class RenderQueue {
 public:
     typedef std::function<void (bool, const RenderGroup*, Renderable*, MaterialPass*, Light*, Iteration)> TraverseCallback;
 
     RenderQueue();
+    ~RenderQueue();
 
+    /* Starts a new frame. Nothing is visible until it's inserted, or until
+     * its node is passed to begin_node() */
     void reset(Stage* stage, RenderGroupFactory* render_group_factory, CameraPtr camera);
 
+    /* Marks the node as visible this frame and directs any inserted
+     * renderables to it, until end_node() is called.
+     *
+     * Returns true if the renderables from the last frame the node was
+     * visible have been reused, in which case nothing should be inserted.
+     * That happens if the version and detail level match, and none of the
+     * materials or index data have changed since. Otherwise the node's
+     * renderables are cleared and should be inserted again. A version of zero
+     * is never reused. */
+    bool begin_node(StageNode* node, uint64_t version, DetailLevel detail_level);
+
+    /* Sets the lights affecting each of the current node's renderables */
+    void set_node_lights(const LightPtr* lights, const uint8_t count);
+
+    void end_node();
+
     void insert_renderable(Renderable&& renderable); // IMPORTANT, must update RenderGroups if they exist already
+
+    /* Frees everything, including any renderables retained for reuse */
     void clear();
 
+    /* When sorting is disabled, inserted renderables are only collected and
+     * not assigned to render groups. This lets renderables be gathered into
+     * separate queues on worker threads and then merged (in order) into a
+     * sorting queue on the main thread. Queues which don't sort never reuse
+     * renderables. */
+    void set_sorting_enabled(bool value) { sorting_enabled_ = value; }
+    bool is_sorting_enabled() const { return sorting_enabled_; }
+
+    /* Inserts all of the renderables collected by other this frame, in the
+     * order they were collected. Renderables collected for a node are
+     * inserted into this queue's batch for the same node, which must have
+     * been passed to begin_node() this frame. Other is left empty until its
+     * next reset(). */
+    void merge(RenderQueue& other);
+
     void traverse(RenderQueueVisitor* callback, uint64_t frame_id) const;
 
-    std::size_t queue_count() const { return priority_queues_.size(); }
+    std::size_t queue_count() const { return RENDER_PRIORITY_MAX - RENDER_PRIORITY_MIN; }
     std::size_t group_count(Pass pass_number) const;
 
-    std::size_t renderable_count() const { return renderables_.size(); }
-    Renderable* renderable(const std::size_t i) {
-        return &renderables_[i];
-    }
+    /* The renderables visible this frame, in the order they were added */
+    std::size_t renderable_count() const { return renderable_count_; }
+    Renderable* renderable(const std::size_t i);
+
+    /* The number of render group and material pass changes made during the
+     * last traversal, lower is better */
+    std::size_t state_change_count() const { return state_change_count_; }
+
+    /* The number of visible nodes whose renderables were reused, or
+     * regenerated, this frame */
+    std::size_t reused_node_count() const { return reused_node_count_; }
+    std::size_t rebuilt_node_count() const { return rebuilt_node_count_; }
+
+    /* When enabled, runs of renderables which would be drawn one after the
+     * other with the same material pass, vertex format and lights are merged
+     * into a single draw during traversal. Only renderables with at most
+     * max_vertices vertices are merged, zero (the default) disables it. */
+    void set_dynamic_batching_threshold(uint32_t max_vertices);
+    uint32_t dynamic_batching_threshold() const;
+
+    /* The number of draws saved by dynamic batching in the last traversal */
+    std::size_t draws_saved_count() const;
+
+    /* The number of runs of identical geometry passed to
+     * RenderQueueVisitor::visit_instances() in the last traversal */
+    std::size_t instance_run_count() const { return instance_run_count_; }
+
 private:
-    // std::map is ordered, so by using the RenderGroup as the key we
-    // minimize GL state changes (e.g. if a RenderGroupImpl orders by TextureID, then ShaderID
-    // then we'll see  (TexID(1), ShaderID(1)), (TexID(1), ShaderID(2)) for example meaning the
-    // texture doesn't change even if the shader does
-    typedef ContiguousMultiMap<RenderGroup, std::size_t> SortedRenderables;
+    /* One entry per renderable per material pass */
+    struct Entry {
+        RenderGroup group;
+        RenderPriority priority;
+        uint32_t renderable_index;
+        uint64_t key;
+    };
+
+    struct Batch;
+
+    struct SortKey {
+        uint64_t key;
+        uint32_t batch_index;
+        uint32_t entry_index;
+    };
 
     Stage* stage_ = nullptr;
     RenderGroupFactory* render_group_factory_ = nullptr;
     CameraPtr camera_;
 
-    std::vector<Renderable> renderables_;
-    std::array<SortedRenderables, RENDER_PRIORITY_MAX - RENDER_PRIORITY_MIN> priority_queues_;
-
-    void clean_empty_batches();
+    /* Distances are measured from the near plane, if it moves then the sort
+     * keys of every reused batch need recalculating */
+    Plane near_plane_;
+    bool near_plane_changed_ = true;
+
+    bool sorting_enabled_ = true;
+
+    uint64_t frame_ = 1;
+
+    std::unordered_map<StageNode*, std::unique_ptr<Batch>> batches_;
+    std::unique_ptr<Batch> unowned_;
+
+    /* Batches visible this frame, in the order they were added */
+    std::vector<Batch*> visible_;
+    Batch* current_ = nullptr;
+
+    std::size_t renderable_count_ = 0;
+    std::size_t reused_node_count_ = 0;
+    std::size_t rebuilt_node_count_ = 0;
+
+    Batch* make_visible(Batch* batch);
+    void empty_batch(Batch* batch);
+    bool can_reuse(const Batch* batch, uint64_t version, DetailLevel detail_level) const;
+    void update_distances(Batch* batch);
+    void evict_stale_batches();
+
+    /* Sort keys are only regenerated if a batch changed, or the visible
+     * batches differ from those at the last sort */
+    mutable std::vector<SortKey> sort_keys_;
+    mutable std::vector<SortKey> sort_scratch_;
+    mutable std::vector<Batch*> sorted_batches_;
+    mutable bool sort_keys_dirty_ = true;
+    mutable std::size_t state_change_count_ = 0;
+    mutable std::size_t instance_run_count_ = 0;
+
+    void sort_if_necessary() const;
+
+    /* What's actually drawn, in order. Usually one per sort key, unless
+     * dynamic batching merged some of them */
+    struct Draw {
+        const Entry* entry;
+        const Renderable* renderable;
+
+        /* The number of draws, starting with this one, which are instances
+         * of the same geometry. Only set on the first of each run */
+        uint32_t instance_run;
+    };
+
+    std::unique_ptr<DynamicBatcher> dynamic_batcher_;
+    mutable std::vector<Draw> draws_;
+    mutable std::vector<const Renderable*> merge_scratch_;
+    mutable std::vector<const Renderable*> instance_scratch_;
+    mutable bool draws_dirty_ = true;
+
+    void build_draws_if_necessary() const;
+    void find_instance_runs() const;
 
     mutable thread::Mutex queue_lock_;
 };
@@ -19,6 +19,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include "../../generic/property.h"
 #include "../../types.h"
 #include "../../interfaces.h"
@@ -68,6 +69,18 @@ struct Renderable final {
     const VertexData* vertex_data = nullptr;
     const IndexData* index_data = nullptr;
     std::size_t index_element_count = 0;
+
+    /* Set for keyframe animations which are blended by the renderer, the
+     * vertex_data is the current keyframe and this is the next one */
+    const VertexData* morph_target = nullptr;
+    float morph_weight = 0.0f;
+
+    /* Set for skeletal meshes which are skinned by the renderer, the
+     * vertex_data is the bind pose and this holds the joint indices and
+     * weights of each vertex */
+    const VertexData* skin_data = nullptr;
+    const std::vector<Mat4>* joint_palette = nullptr;
+
     RenderPriority render_priority = RENDER_PRIORITY_MAIN;
     Mat4 final_transformation;
     Material* material = nullptr;
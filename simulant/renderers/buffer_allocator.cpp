@@ -0,0 +1,288 @@
+#include <cassert>
+
+#include "buffer_allocator.h"
+
+namespace smlt {
+
+/* Index of the most significant set bit, x must not be zero */
+static uint32_t highest_bit(uint32_t x) {
+    assert(x);
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(x);
+#else
+    uint32_t r = 0;
+    while(x >>= 1) {
+        ++r;
+    }
+    return r;
+#endif
+}
+
+/* Index of the least significant set bit, x must not be zero */
+static uint32_t lowest_bit(uint32_t x) {
+    assert(x);
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    uint32_t r = 0;
+    while(!(x & 1)) {
+        x >>= 1;
+        ++r;
+    }
+    return r;
+#endif
+}
+
+BufferAllocator::BufferAllocator(uint32_t capacity, uint32_t alignment):
+    capacity_(capacity & ~(alignment - 1)),
+    alignment_(alignment),
+    alignment_log2_(highest_bit(alignment)) {
+
+    assert((alignment & (alignment - 1)) == 0);
+
+    for(auto& fl: free_lists_) {
+        for(auto& head: fl) {
+            head = NONE;
+        }
+    }
+
+    if(capacity_) {
+        auto block = new_block();
+        blocks_[block].offset = 0;
+        blocks_[block].size = capacity_;
+        insert_free(block);
+    }
+}
+
+void BufferAllocator::mapping(uint32_t size, uint32_t& fl, uint32_t& sl) const {
+    /* Sizes are always a multiple of the alignment, so work in those units.
+     * Small sizes get a list each, above that each power of two is split
+     * into SL_INDEX_COUNT linear classes */
+    auto units = size >> alignment_log2_;
+
+    if(units < SL_INDEX_COUNT) {
+        fl = 0;
+        sl = units;
+    } else {
+        auto bit = highest_bit(units);
+        fl = bit - SL_INDEX_COUNT_LOG2 + 1;
+        sl = (units >> (bit - SL_INDEX_COUNT_LOG2)) - SL_INDEX_COUNT;
+    }
+}
+
+uint32_t BufferAllocator::find_suitable_block(uint32_t size) const {
+    /* Round up to the next size class so that any block in the list we
+     * find is big enough, without having to walk it */
+    auto units = size >> alignment_log2_;
+    if(units >= SL_INDEX_COUNT) {
+        units += (1u << (highest_bit(units) - SL_INDEX_COUNT_LOG2)) - 1;
+    }
+
+    uint32_t fl, sl;
+    mapping(units << alignment_log2_, fl, sl);
+
+    if(fl >= FL_INDEX_COUNT) {
+        return NONE;
+    }
+
+    auto sl_map = sl_bitmap_[fl] & (~0u << sl);
+    if(!sl_map) {
+        auto fl_map = (fl + 1 < FL_INDEX_COUNT) ? fl_bitmap_ & (~0u << (fl + 1)) : 0;
+        if(!fl_map) {
+            return NONE;
+        }
+
+        fl = lowest_bit(fl_map);
+        sl_map = sl_bitmap_[fl];
+    }
+
+    return free_lists_[fl][lowest_bit(sl_map)];
+}
+
+void BufferAllocator::insert_free(uint32_t block) {
+    uint32_t fl, sl;
+    mapping(blocks_[block].size, fl, sl);
+
+    auto& head = free_lists_[fl][sl];
+
+    blocks_[block].free = true;
+    blocks_[block].prev_free = NONE;
+    blocks_[block].next_free = head;
+
+    if(head != NONE) {
+        blocks_[head].prev_free = block;
+    }
+
+    head = block;
+    fl_bitmap_ |= (1u << fl);
+    sl_bitmap_[fl] |= (1u << sl);
+}
+
+void BufferAllocator::remove_free(uint32_t block) {
+    uint32_t fl, sl;
+    mapping(blocks_[block].size, fl, sl);
+
+    auto& b = blocks_[block];
+    if(b.prev_free != NONE) {
+        blocks_[b.prev_free].next_free = b.next_free;
+    } else {
+        free_lists_[fl][sl] = b.next_free;
+    }
+
+    if(b.next_free != NONE) {
+        blocks_[b.next_free].prev_free = b.prev_free;
+    }
+
+    b.free = false;
+    b.prev_free = b.next_free = NONE;
+
+    if(free_lists_[fl][sl] == NONE) {
+        sl_bitmap_[fl] &= ~(1u << sl);
+        if(!sl_bitmap_[fl]) {
+            fl_bitmap_ &= ~(1u << fl);
+        }
+    }
+}
+
+uint32_t BufferAllocator::new_block() {
+    if(!unused_blocks_.empty()) {
+        auto block = unused_blocks_.back();
+        unused_blocks_.pop_back();
+        blocks_[block] = Block();
+        blocks_[block].in_use = true;
+        return block;
+    }
+
+    blocks_.push_back(Block());
+    blocks_.back().in_use = true;
+    return blocks_.size() - 1;
+}
+
+void BufferAllocator::recycle_block(uint32_t block) {
+    blocks_[block].in_use = false;
+    unused_blocks_.push_back(block);
+}
+
+BufferAllocator::Handle BufferAllocator::allocate(uint32_t size) {
+    size = (size) ? (size + alignment_ - 1) & ~(alignment_ - 1) : alignment_;
+    if(!size || size > free_bytes()) {
+        return INVALID_HANDLE;
+    }
+
+    auto block = find_suitable_block(size);
+    if(block == NONE) {
+        /* Rounding up to the next class can skip a block of exactly the
+         * right size, so check the requested class before giving up */
+        uint32_t fl, sl;
+        mapping(size, fl, sl);
+        for(auto b = free_lists_[fl][sl]; b != NONE; b = blocks_[b].next_free) {
+            if(blocks_[b].size >= size) {
+                block = b;
+                break;
+            }
+        }
+
+        if(block == NONE) {
+            return INVALID_HANDLE;
+        }
+    }
+
+    remove_free(block);
+
+    auto remaining = blocks_[block].size - size;
+    if(remaining >= alignment_) {
+        /* Split off the end of the block and return it to the free lists */
+        auto rest = new_block();
+
+        blocks_[rest].offset = blocks_[block].offset + size;
+        blocks_[rest].size = remaining;
+        blocks_[rest].prev_phys = block;
+        blocks_[rest].next_phys = blocks_[block].next_phys;
+
+        if(blocks_[rest].next_phys != NONE) {
+            blocks_[blocks_[rest].next_phys].prev_phys = rest;
+        }
+
+        blocks_[block].next_phys = rest;
+        blocks_[block].size = size;
+
+        insert_free(rest);
+    }
+
+    used_bytes_ += blocks_[block].size;
+    ++allocation_count_;
+
+    return block;
+}
+
+void BufferAllocator::release(Handle handle) {
+    assert(handle < blocks_.size());
+    assert(blocks_[handle].in_use && !blocks_[handle].free);
+
+    used_bytes_ -= blocks_[handle].size;
+    --allocation_count_;
+
+    auto block = handle;
+
+    /* Merge with the previous range if it's free */
+    auto prev = blocks_[block].prev_phys;
+    if(prev != NONE && blocks_[prev].free) {
+        remove_free(prev);
+
+        blocks_[prev].size += blocks_[block].size;
+        blocks_[prev].next_phys = blocks_[block].next_phys;
+        if(blocks_[prev].next_phys != NONE) {
+            blocks_[blocks_[prev].next_phys].prev_phys = prev;
+        }
+
+        recycle_block(block);
+        block = prev;
+    }
+
+    /* ...and the next one */
+    auto next = blocks_[block].next_phys;
+    if(next != NONE && blocks_[next].free) {
+        remove_free(next);
+
+        blocks_[block].size += blocks_[next].size;
+        blocks_[block].next_phys = blocks_[next].next_phys;
+        if(blocks_[block].next_phys != NONE) {
+            blocks_[blocks_[block].next_phys].prev_phys = block;
+        }
+
+        recycle_block(next);
+    }
+
+    insert_free(block);
+}
+
+uint32_t BufferAllocator::largest_free_range() const {
+    if(!fl_bitmap_) {
+        return 0;
+    }
+
+    /* The largest range must be in the highest populated size class, but
+     * that list isn't sorted so walk it */
+    auto fl = highest_bit(fl_bitmap_);
+    auto sl = highest_bit(sl_bitmap_[fl]);
+
+    uint32_t largest = 0;
+    for(auto block = free_lists_[fl][sl]; block != NONE; block = blocks_[block].next_free) {
+        if(blocks_[block].size > largest) {
+            largest = blocks_[block].size;
+        }
+    }
+
+    return largest;
+}
+
+float BufferAllocator::fragmentation() const {
+    auto free = free_bytes();
+    if(!free) {
+        return 0.0f;
+    }
+
+    return 1.0f - (float(largest_free_range()) / float(free));
+}
+
+}
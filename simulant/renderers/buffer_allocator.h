@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace smlt {
+
+/*
+ * A two-level segregated fit (TLSF) allocator for ranges of a GPU buffer.
+ *
+ * It doesn't touch any memory itself, it just hands out aligned offsets into
+ * [0, capacity) and keeps track of the free space. Allocation and release are
+ * O(1), and neighbouring free ranges are merged on release so the buffer
+ * doesn't fragment into unusable slivers over time.
+ */
+class BufferAllocator {
+public:
+    typedef uint32_t Handle;
+    static const Handle INVALID_HANDLE = ~0u;
+
+    /* alignment must be a power of two, capacity is rounded down to it */
+    BufferAllocator(uint32_t capacity, uint32_t alignment=16);
+
+    /* Returns INVALID_HANDLE if there's no free range big enough */
+    Handle allocate(uint32_t size);
+    void release(Handle handle);
+
+    uint32_t offset(Handle handle) const { return blocks_[handle].offset; }
+    /* The size of the range, this is the requested size rounded up */
+    uint32_t size(Handle handle) const { return blocks_[handle].size; }
+
+    uint32_t capacity() const { return capacity_; }
+    uint32_t alignment() const { return alignment_; }
+    uint32_t used_bytes() const { return used_bytes_; }
+    uint32_t free_bytes() const { return capacity_ - used_bytes_; }
+    uint32_t allocation_count() const { return allocation_count_; }
+
+    uint32_t largest_free_range() const;
+
+    /* 0.0 when all the free space is contiguous, approaching 1.0 as the
+     * free space is split into many small ranges */
+    float fragmentation() const;
+
+private:
+    static const uint32_t NONE = ~0u;
+
+    static const uint32_t SL_INDEX_COUNT_LOG2 = 4;
+    static const uint32_t SL_INDEX_COUNT = 1 << SL_INDEX_COUNT_LOG2;
+    static const uint32_t FL_INDEX_COUNT = 32;
+
+    struct Block {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+
+        /* Neighbours in the buffer */
+        uint32_t prev_phys = NONE;
+        uint32_t next_phys = NONE;
+
+        /* Neighbours in the free list for this size class */
+        uint32_t prev_free = NONE;
+        uint32_t next_free = NONE;
+
+        bool free = false;
+        bool in_use = false;
+    };
+
+    void mapping(uint32_t size, uint32_t& fl, uint32_t& sl) const;
+    uint32_t find_suitable_block(uint32_t size) const;
+
+    void insert_free(uint32_t block);
+    void remove_free(uint32_t block);
+
+    uint32_t new_block();
+    void recycle_block(uint32_t block);
+
+    uint32_t capacity_;
+    uint32_t alignment_;
+    uint32_t alignment_log2_;
+
+    uint32_t used_bytes_ = 0;
+    uint32_t allocation_count_ = 0;
+
+    uint32_t fl_bitmap_ = 0;
+    uint32_t sl_bitmap_[FL_INDEX_COUNT] = {0};
+    uint32_t free_lists_[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+    std::vector<Block> blocks_;
+    std::vector<uint32_t> unused_blocks_;
+};
+
+}
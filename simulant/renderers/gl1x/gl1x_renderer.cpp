@@ -44,13 +44,19 @@ batcher::RenderGroupKey GL1XRenderer::prepare_render_group(
     const float distance_to_camera) {
 
     _S_UNUSED(renderable);
-    _S_UNUSED(material_pass);
     _S_UNUSED(group);
 
+    /* Only the low bits of these end up in the sort key, that's fine as
+     * they're only used to group state changes together */
+    auto material = material_pass->material();
+    auto& texture = material_pass->diffuse_map();
+
     return batcher::generate_render_group_key(
         pass_number,
         is_blended,
-        distance_to_camera
+        distance_to_camera,
+        (material) ? (uint16_t) material->id().value() : 0,
+        (texture) ? (uint16_t) texture->id().value() : 0
     );
 }
 
@@ -17,6 +17,9 @@
 //     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
+#include <cstring>
+
 #include "generic_renderer.h"
 
 #include "../../nodes/actor.h"
@@ -24,6 +27,7 @@
 #include "../../nodes/camera.h"
 #include "../../nodes/light.h"
 #include "../../partitioner.h"
+#include "../../assets/meshes/skeleton.h"
 #include "../../types.h"
 #include "gpu_program.h"
 #include "vbo_manager.h"
@@ -66,7 +70,7 @@ GPUProgramID GenericRenderer::default_gpu_program_id() const {
 GenericRenderer::GenericRenderer(Window *window):
     Renderer(window),
     GLRenderer(window),
-    buffer_manager_(VBOManager::create()) {
+    buffer_manager_(VBOManager::create(&state_)) {
 
 }
 
@@ -78,17 +82,20 @@ batcher::RenderGroupKey GenericRenderer::prepare_render_group(
     const bool is_blended,
     const float distance_to_camera) {
 
-    _S_UNUSED(group);
     _S_UNUSED(renderable);
-    _S_UNUSED(material_pass);
-    _S_UNUSED(pass_number);
-    _S_UNUSED(is_blended);
-    _S_UNUSED(distance_to_camera);
+    _S_UNUSED(group);
+
+    /* Only the low bits of these end up in the sort key, that's fine as
+     * they're only used to group state changes together */
+    auto material = material_pass->material();
+    auto& texture = material_pass->diffuse_map();
 
     return batcher::generate_render_group_key(
         pass_number,
         is_blended,
-        distance_to_camera
+        distance_to_camera,
+        (material) ? (uint16_t) material->id().value() : 0,
+        (texture) ? (uint16_t) texture->id().value() : 0
     );
 }
 
@@ -142,57 +149,9 @@ void GenericRenderer::set_light_uniforms(const MaterialPass* pass, GPUProgram* p
 }
 
 void GenericRenderer::set_material_uniforms(const MaterialPass* pass, GPUProgram* program) {
-    auto mat = pass->material();
-
-    auto amb_loc = program->locate_uniform(AMBIENT_PROPERTY_NAME, true);
-    if(amb_loc > -1) {
-        program->set_uniform_colour(AMBIENT_PROPERTY_NAME, pass->ambient());
-    }
-
-    auto diff_loc = program->locate_uniform(DIFFUSE_PROPERTY_NAME, true);
-    if(diff_loc > -1) {
-        program->set_uniform_colour(DIFFUSE_PROPERTY_NAME, pass->diffuse());
-    }
-
-    auto spec_loc = program->locate_uniform(SPECULAR_PROPERTY_NAME, true);
-    if(spec_loc > -1) {
-        program->set_uniform_colour(SPECULAR_PROPERTY_NAME, pass->specular());
-    }
-
-    auto shin_loc = program->locate_uniform(SHININESS_PROPERTY_NAME, true);
-    if(shin_loc > -1) {
-        program->set_uniform_float(SHININESS_PROPERTY_NAME, pass->shininess());
-    }
-
-    auto ps_loc = program->locate_uniform(POINT_SIZE_PROPERTY_NAME, true);
-    if(ps_loc > -1) {
-        program->set_uniform_float(POINT_SIZE_PROPERTY_NAME, pass->point_size());
-    }
-
-    /* Each texture property has a counterpart matrix, this passes those down if they exist */
-    const auto& texture_props = mat->texture_properties();
-    uint8_t texture_unit = 0;
-    std::string name;
-    for(auto& tex_prop: texture_props) {
-        mat->property_name(tex_prop, name);
-
-        auto tloc = program->locate_uniform(name, true);
-        if(tloc > -1) {
-            // This texture is being used
-            program->set_uniform_int(tloc, texture_unit++);
-        }
-
-        auto shader_name = name;
-        shader_name += "_matrix";
-
-        auto loc = program->locate_uniform(shader_name, true);
-        if(loc > -1) {
-            const Mat4* mat;
-            if(pass->property_value(shader_name, mat)) {
-                program->set_uniform_mat4x4(loc, *mat);
-            }
-        }
-    }
+    /* The block holds every resolved property of the pass, including the
+     * texture matrices and any custom properties */
+    program->upload_parameter_block(pass->parameter_block());
 }
 
 void GenericRenderer::set_stage_uniforms(const MaterialPass *pass, GPUProgram *program, const Colour &global_ambient) {
@@ -207,34 +166,9 @@ void GenericRenderer::set_stage_uniforms(const MaterialPass *pass, GPUProgram *p
 }
 
 
-/* Shadows GL state to avoid unnecessary GL calls */
-static uint8_t enabled_vertex_attributes_ = 0;
-
-void enable_vertex_attribute(uint8_t i) {
-    uint8_t v = 1 << i;
-    if((enabled_vertex_attributes_ & v) == v) {
-        return;
-    }
-
-    GLCheck(glEnableVertexAttribArray, i);
-
-    enabled_vertex_attributes_ ^= v;
-}
-
-void disable_vertex_attribute(uint8_t i) {
-    uint8_t v = 1 << i;
-
-    if((enabled_vertex_attributes_ & v) != v) {
-        return;
-    }
-
-    GLCheck(glDisableVertexAttribArray, i);
-
-    enabled_vertex_attributes_ ^= v;
-}
-
 template<typename EnabledMethod, typename OffsetMethod>
-void send_attribute(int32_t loc,
+void send_attribute(GLStateCache& state,
+                    int32_t loc,
                     VertexAttributeType attr,
                     const VertexSpecification& vertex_spec,
                     EnabledMethod exists_on_data_predicate,
@@ -243,7 +177,7 @@ void send_attribute(int32_t loc,
     if(loc > -1 && (vertex_spec.*exists_on_data_predicate)()) {
         auto offset = (vertex_spec.*offset_func)(false);
 
-        enable_vertex_attribute(loc);
+        state.enable_vertex_attribute(loc);
 
         auto attr_for_type = attribute_for_type(attr, vertex_spec);
         auto attr_size = vertex_attribute_size(attr_for_type);
@@ -266,7 +200,7 @@ void send_attribute(int32_t loc,
             BUFFER_OFFSET(global_offset + offset)
         );
     } else if(loc > -1){
-        disable_vertex_attribute(loc);
+        state.disable_vertex_attribute(loc);
         //L_WARN_ONCE(_u("Couldn't locate attribute on the mesh: {0}").format(attr));
     }
 }
@@ -279,9 +213,10 @@ void GenericRenderer::set_auto_attributes_on_shader(GPUProgram* program, const R
      *  for templates!
      */
     const VertexSpecification& vertex_spec = renderable->vertex_data->vertex_specification();
-    auto offset = buffers->vertex_vbo->byte_offset(buffers->vertex_vbo_slot);
+    auto offset = buffers->vertex_offset;
 
     send_attribute(
+        state_,
         program->locate_attribute("s_position", true),
         VERTEX_ATTRIBUTE_TYPE_POSITION,
         vertex_spec,
@@ -291,6 +226,7 @@ void GenericRenderer::set_auto_attributes_on_shader(GPUProgram* program, const R
     );
 
     send_attribute(
+        state_,
         program->locate_attribute("s_diffuse", true),
         VERTEX_ATTRIBUTE_TYPE_DIFFUSE,
         vertex_spec,
@@ -299,44 +235,175 @@ void GenericRenderer::set_auto_attributes_on_shader(GPUProgram* program, const R
         offset
     );
 
-    send_attribute( program->locate_attribute("s_texcoord0", true),
+    send_attribute(state_, program->locate_attribute("s_texcoord0", true),
                     VERTEX_ATTRIBUTE_TYPE_TEXCOORD0, vertex_spec,
                     &VertexSpecification::has_texcoord0,
                     &VertexSpecification::texcoord0_offset, offset);
-    send_attribute(program->locate_attribute("s_texcoord1", true),
+    send_attribute(state_, program->locate_attribute("s_texcoord1", true),
                    VERTEX_ATTRIBUTE_TYPE_TEXCOORD1, vertex_spec,
                    &VertexSpecification::has_texcoord1,
                    &VertexSpecification::texcoord1_offset, offset);
-    send_attribute(program->locate_attribute("s_texcoord2", true),
+    send_attribute(state_, program->locate_attribute("s_texcoord2", true),
                    VERTEX_ATTRIBUTE_TYPE_TEXCOORD2, vertex_spec,
                    &VertexSpecification::has_texcoord2,
                    &VertexSpecification::texcoord2_offset, offset);
-    send_attribute(program->locate_attribute("s_texcoord3", true),
+    send_attribute(state_, program->locate_attribute("s_texcoord3", true),
                    VERTEX_ATTRIBUTE_TYPE_TEXCOORD3, vertex_spec,
                    &VertexSpecification::has_texcoord3,
                    &VertexSpecification::texcoord3_offset, offset);
-    send_attribute(program->locate_attribute("s_normal", true),
+    send_attribute(state_, program->locate_attribute("s_normal", true),
                    VERTEX_ATTRIBUTE_TYPE_NORMAL, vertex_spec,
                    &VertexSpecification::has_normals, &VertexSpecification::normal_offset, offset);
+
+    set_morph_attributes_on_shader(program, renderable, buffers);
+    set_skinning_attributes_on_shader(program, renderable, buffers);
+}
+
+void GenericRenderer::set_morph_attributes_on_shader(GPUProgram* program, const Renderable* renderable, GPUBuffer* buffers) {
+    auto position_loc = program->locate_attribute(MORPH_POSITION_ATTRIBUTE, true);
+    if(position_loc < 0) {
+        return;
+    }
+
+    auto normal_loc = program->locate_attribute(MORPH_NORMAL_ATTRIBUTE, true);
+    auto weight_loc = program->locate_uniform(MORPH_WEIGHT_PROPERTY, true);
+
+    if(!renderable->morph_target) {
+        /* Disabled attributes read as a constant, and a zero weight means
+         * the shader ignores them anyway */
+        state_.disable_vertex_attribute(position_loc);
+        if(normal_loc > -1) {
+            state_.disable_vertex_attribute(normal_loc);
+        }
+
+        if(weight_loc > -1) {
+            program->set_uniform_float(weight_loc, 0.0f);
+        }
+        return;
+    }
+
+    const VertexSpecification& morph_spec = renderable->morph_target->vertex_specification();
+
+    state_.bind_buffer(GL_ARRAY_BUFFER, buffers->morph_vbo);
+
+    send_attribute(state_, position_loc,
+                   VERTEX_ATTRIBUTE_TYPE_POSITION, morph_spec,
+                   &VertexSpecification::has_positions,
+                   &VertexSpecification::position_offset, buffers->morph_offset);
+
+    send_attribute(state_, normal_loc,
+                   VERTEX_ATTRIBUTE_TYPE_NORMAL, morph_spec,
+                   &VertexSpecification::has_normals,
+                   &VertexSpecification::normal_offset, buffers->morph_offset);
+
+    state_.bind_buffer(GL_ARRAY_BUFFER, buffers->vertex_vbo);
+
+    if(weight_loc > -1) {
+        program->set_uniform_float(weight_loc, renderable->morph_weight);
+    }
+}
+
+void GenericRenderer::set_skinning_attributes_on_shader(GPUProgram* program, const Renderable* renderable, GPUBuffer* buffers) {
+    auto indices_loc = program->locate_attribute(JOINT_INDICES_ATTRIBUTE, true);
+    if(indices_loc < 0) {
+        return;
+    }
+
+    auto weights_loc = program->locate_attribute(JOINT_WEIGHTS_ATTRIBUTE, true);
+
+    if(!renderable->skin_data || !renderable->joint_palette) {
+        /* Zero weights leave the vertices unskinned, the indices are zeroed
+         * too so that the shader never reads outside the palette */
+        state_.disable_vertex_attribute(indices_loc);
+        GLCheck(glVertexAttrib4f, indices_loc, 0.0f, 0.0f, 0.0f, 0.0f);
+        if(weights_loc > -1) {
+            state_.disable_vertex_attribute(weights_loc);
+            GLCheck(glVertexAttrib4f, weights_loc, 0.0f, 0.0f, 0.0f, 0.0f);
+        }
+        return;
+    }
+
+    const VertexSpecification& skin_spec = renderable->skin_data->vertex_specification();
+
+    state_.bind_buffer(GL_ARRAY_BUFFER, buffers->skin_vbo);
+
+    send_attribute(state_, indices_loc,
+                   VERTEX_ATTRIBUTE_TYPE_TEXCOORD0, skin_spec,
+                   &VertexSpecification::has_texcoord0,
+                   &VertexSpecification::texcoord0_offset, buffers->skin_offset);
+
+    send_attribute(state_, weights_loc,
+                   VERTEX_ATTRIBUTE_TYPE_TEXCOORD1, skin_spec,
+                   &VertexSpecification::has_texcoord1,
+                   &VertexSpecification::texcoord1_offset, buffers->skin_offset);
+
+    state_.bind_buffer(GL_ARRAY_BUFFER, buffers->vertex_vbo);
+
+    if(program->locate_uniform(JOINT_PALETTE_PROPERTY, true) > -1 && !renderable->joint_palette->empty()) {
+        program->set_uniform_mat4x4_array(JOINT_PALETTE_PROPERTY, *renderable->joint_palette);
+    }
+}
+
+bool GenericRenderer::supports_gpu_skinning(Material* material, uint32_t joint_count) {
+    if(!material || !material->pass_count() || joint_count > max_gpu_skinning_joints_) {
+        return false;
+    }
+
+    for(uint8_t i = 0; i < material->pass_count(); ++i) {
+        auto program = gpu_program(material->pass(i)->gpu_program_id());
+        if(!program || !program->is_complete()) {
+            return false;
+        }
+
+        if(program->locate_attribute(JOINT_INDICES_ATTRIBUTE, true) < 0) {
+            return false;
+        }
+
+        if(joint_count > program->uniform_array_size(JOINT_PALETTE_PROPERTY)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool GenericRenderer::supports_gpu_morphing(Material* material) {
+    if(!material || !material->pass_count()) {
+        return false;
+    }
+
+    /* Every pass has to blend, otherwise the passes wouldn't line up */
+    for(uint8_t i = 0; i < material->pass_count(); ++i) {
+        auto program = gpu_program(material->pass(i)->gpu_program_id());
+        if(!program || !program->is_complete()) {
+            return false;
+        }
+
+        if(program->locate_attribute(MORPH_POSITION_ATTRIBUTE, true) < 0) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 void GenericRenderer::set_blending_mode(BlendType type) {
     if(type == BLEND_NONE) {
-        GLCheck(glDisable, GL_BLEND);
+        state_.set_enabled(GL_BLEND, false);
         return;
     }
 
-    GLCheck(glEnable, GL_BLEND);
+    state_.set_enabled(GL_BLEND, true);
     switch(type) {
-        case BLEND_ADD: GLCheck(glBlendFunc, GL_ONE, GL_ONE);
+        case BLEND_ADD: state_.blend_func(GL_ONE, GL_ONE);
         break;
-        case BLEND_ALPHA: GLCheck(glBlendFunc, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        case BLEND_ALPHA: state_.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         break;
-        case BLEND_COLOUR: GLCheck(glBlendFunc, GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR);
+        case BLEND_COLOUR: state_.blend_func(GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR);
         break;
-        case BLEND_MODULATE: GLCheck(glBlendFunc, GL_DST_COLOR, GL_ZERO);
+        case BLEND_MODULATE: state_.blend_func(GL_DST_COLOR, GL_ZERO);
         break;
-        case BLEND_ONE_ONE_MINUS_ALPHA: GLCheck(glBlendFunc, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        case BLEND_ONE_ONE_MINUS_ALPHA: state_.blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
         break;
     default:
         throw std::logic_error("Invalid blend type specified");
@@ -392,6 +459,10 @@ void GL2RenderQueueVisitor::start_traversal(const batcher::RenderQueue& queue, u
     _S_UNUSED(stage);
 
     global_ambient_ = stage->ambient_light();
+
+    /* Viewport clears and texture uploads happen between traversals, and
+     * don't go through the state cache */
+    renderer_->state_.invalidate();
 }
 
 void GL2RenderQueueVisitor::end_traversal(const batcher::RenderQueue &queue, Stage* stage) {
@@ -418,19 +489,22 @@ void GL2RenderQueueVisitor::change_material_pass(const MaterialPass* prev, const
         program_->activate();
     }
 
+    /* The state cache skips anything which is already set, so there's no
+     * need to compare against the previous pass here */
+    auto& state = renderer_->state_;
+
+    /* Make sure the parameter block is uploaded first, that's where the
+     * texture uniform locations come from */
+    auto& block = pass_->parameter_block();
+    renderer_->set_material_uniforms(next, program_);
+
     /* First we bind any used texture properties to their associated variables */
     uint8_t texture_unit = 0;
-    std::string name;
 
-    const Material* mat = pass_->material();
-    for(auto& defined_property: mat->texture_properties()) {
-        if(!mat->property_name(defined_property, name)) {
-            continue;
-        }
-
-        const TexturePtr* tex_prop;
-        pass_->property_value(name, tex_prop);
-        const TexturePtr tex = *tex_prop;
+    auto& textures = block.textures();
+    auto& texture_locations = program_->parameter_texture_locations();
+    for(std::size_t i = 0; i < textures.size(); ++i) {
+        const TexturePtr& tex = textures[i];
 
         // Do we use this texture property? Then bind the texture appropriately
         // FIXME: Is this right? The GL1 renderer uses the existence of a texture_id
@@ -438,79 +512,56 @@ void GL2RenderQueueVisitor::change_material_pass(const MaterialPass* prev, const
         // and also whether there's a texture ID. The question is, should the material have some other
         // type of existence check for texture properties? Is checking the texture_id right for all situations?
         // If someone uses s_diffuse_map, but doesn't set a value, surely that should get the default texture?
-        auto loc = program_->locate_uniform(name, true);
+        auto loc = texture_locations[i];
         if(loc > -1 && (texture_unit + 1u) < _S_GL_MAX_TEXTURE_UNITS) {
-            GLCheck(glActiveTexture, GL_TEXTURE0 + texture_unit);
-            GLCheck(glBindTexture, GL_TEXTURE_2D, (tex) ? tex->_renderer_specific_id() : 0);
+            program_->set_uniform_int(loc, texture_unit);
+            state.bind_texture(texture_unit, (tex) ? tex->_renderer_specific_id() : 0);
             texture_unit++;
         }
     }
 
     /* Next, we wipe out any unused texture units */
     for(uint8_t i = texture_unit; i < _S_GL_MAX_TEXTURE_UNITS; ++i) {
-        GLCheck(glActiveTexture, GL_TEXTURE0 + texture_unit);
-        GLCheck(glBindTexture, GL_TEXTURE_2D, 0);
+        state.bind_texture(i, 0);
     }
 
-    if(!prev || prev->is_depth_test_enabled() != next->is_depth_test_enabled()) {
-        if(next->is_depth_test_enabled()) {
-            GLCheck(glEnable, GL_DEPTH_TEST);
-        } else {
-            GLCheck(glDisable, GL_DEPTH_TEST);
-        }
-    }
-
-    if(!prev || prev->is_depth_write_enabled() != next->is_depth_write_enabled()) {
-        if(next->is_depth_write_enabled()) {
-            GLCheck(glDepthMask, GL_TRUE);
-        } else {
-            GLCheck(glDepthMask, GL_FALSE);
-        }
-    }
+    state.set_enabled(GL_DEPTH_TEST, next->is_depth_test_enabled());
+    state.depth_mask(next->is_depth_write_enabled());
 
     if(!prev || prev->point_size() != next->point_size()) {
         glPointSize(next->point_size());
     }
 
-    if(!prev || prev->polygon_mode() != next->polygon_mode()) {
-        switch(next->polygon_mode()) {
-            case POLYGON_MODE_POINT:
-                glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
-            break;
-            case POLYGON_MODE_LINE:
-                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            break;
-            default:
-                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
+    switch(next->polygon_mode()) {
+        case POLYGON_MODE_POINT:
+            state.polygon_mode(GL_POINT);
+        break;
+        case POLYGON_MODE_LINE:
+            state.polygon_mode(GL_LINE);
+        break;
+        default:
+            state.polygon_mode(GL_FILL);
     }
 
-    if(!prev || prev->cull_mode() != next->cull_mode()) {
-        if(next->cull_mode() != CULL_MODE_NONE) {
-            glEnable(GL_CULL_FACE);
-        }
+    state.set_enabled(GL_CULL_FACE, next->cull_mode() != CULL_MODE_NONE);
 
-        switch(next->cull_mode()) {
-            case CULL_MODE_NONE:
-                glDisable(GL_CULL_FACE);
-            break;
-            case CULL_MODE_FRONT_FACE:
-                glCullFace(GL_FRONT);
-            break;
-            case CULL_MODE_BACK_FACE:
-                glCullFace(GL_BACK);
-            break;
-            case CULL_MODE_FRONT_AND_BACK_FACE:
-                glCullFace(GL_FRONT_AND_BACK);
-            break;
-        default:
-            assert(0 && "Invalid cull mode");
-        }
+    switch(next->cull_mode()) {
+        case CULL_MODE_NONE:
+        break;
+        case CULL_MODE_FRONT_FACE:
+            state.cull_face(GL_FRONT);
+        break;
+        case CULL_MODE_BACK_FACE:
+            state.cull_face(GL_BACK);
+        break;
+        case CULL_MODE_FRONT_AND_BACK_FACE:
+            state.cull_face(GL_FRONT_AND_BACK);
+        break;
+    default:
+        assert(0 && "Invalid cull mode");
     }
 
-    if(!prev || prev->blend_func() != next->blend_func()) {
-        renderer_->set_blending_mode(next->blend_func());
-    }
+    renderer_->set_blending_mode(next->blend_func());
 
     if(!prev || prev->shade_model() != next->shade_model()) {
         if(next->shade_model() == SHADE_MODEL_SMOOTH) {
@@ -521,31 +572,6 @@ void GL2RenderQueueVisitor::change_material_pass(const MaterialPass* prev, const
     }
 
     renderer_->set_stage_uniforms(next, program_, global_ambient_);
-    renderer_->set_material_uniforms(next, program_);
-
-    for(auto prop: mat->custom_properties()) {
-        if(!mat->property_name(prop.first, name)) {
-            continue;
-        }
-
-        switch(prop.second) {
-        case MATERIAL_PROPERTY_TYPE_INT:
-            const int* i;
-            pass_->property_value(name.c_str(), i);
-            program_->set_uniform_int(name, *i, /* fail_silently= */true);
-        break;
-        case MATERIAL_PROPERTY_TYPE_FLOAT:
-            const float* f;
-            pass_->property_value(name.c_str(), f);
-            program_->set_uniform_float(name, *f, /* fail_silently= */true);
-        break;
-        case MATERIAL_PROPERTY_TYPE_TEXTURE:
-            // Ignore, we handle textures separately
-        break;
-        default:
-            S_ERROR("UNIMPLEMENTED property type: {0}", prop.second);
-        }
-    }
 
    // rebind_attribute_locations_if_necessary(next, program_);
 }
@@ -564,7 +590,7 @@ void GenericRenderer::set_renderable_uniforms(const MaterialPass* pass, GPUProgr
     auto v_loc = program->locate_uniform(VIEW_MATRIX_PROPERTY, true);
     if(v_loc > -1) {
         program->set_uniform_mat4x4(
-            VIEW_MATRIX_PROPERTY,
+            v_loc,
             view
         );
     }
@@ -572,7 +598,7 @@ void GenericRenderer::set_renderable_uniforms(const MaterialPass* pass, GPUProgr
     auto mvp_loc = program->locate_uniform(MODELVIEW_PROJECTION_MATRIX_PROPERTY, true);
     if(mvp_loc > -1) {
         program->set_uniform_mat4x4(
-            MODELVIEW_PROJECTION_MATRIX_PROPERTY,
+            mvp_loc,
             modelview_projection
         );
     }
@@ -580,7 +606,7 @@ void GenericRenderer::set_renderable_uniforms(const MaterialPass* pass, GPUProgr
     auto mv_loc = program->locate_uniform(MODELVIEW_MATRIX_PROPERTY, true);
     if(mv_loc > -1) {
         program->set_uniform_mat4x4(
-            MODELVIEW_MATRIX_PROPERTY,
+            mv_loc,
             modelview
         );
     }
@@ -588,7 +614,7 @@ void GenericRenderer::set_renderable_uniforms(const MaterialPass* pass, GPUProgr
     auto p_loc = program->locate_uniform(PROJECTION_MATRIX_PROPERTY, true);
     if(p_loc > -1) {
         program->set_uniform_mat4x4(
-            PROJECTION_MATRIX_PROPERTY,
+            p_loc,
             projection
         );
     }
@@ -601,7 +627,7 @@ void GenericRenderer::set_renderable_uniforms(const MaterialPass* pass, GPUProgr
         inverse_transpose_modelview.transpose();
 
         program->set_uniform_mat3x3(
-            INVERSE_TRANSPOSE_MODELVIEW_MATRIX_PROPERTY,
+            itmv_loc,
             inverse_transpose_modelview
         );
     }
@@ -640,9 +666,40 @@ void GL2RenderQueueVisitor::do_visit(const Renderable* renderable, const Materia
     renderer_->set_renderable_uniforms(material_pass, program_, renderable, camera_);
     renderer_->prepare_to_render(renderable);
     renderer_->set_auto_attributes_on_shader(program_, renderable, renderer_->buffer_stash_.get());
+    renderer_->set_instance_model_constant(program_, renderable);
     renderer_->send_geometry(renderable, renderer_->buffer_stash_.get());
 }
 
+void GL2RenderQueueVisitor::visit_instances(const Renderable* const* renderables, std::size_t count, const MaterialPass* pass, batcher::Iteration iteration) {
+    /* Only shaders which read the model matrix from an attribute can be
+     * instanced, everything else is drawn one at a time */
+    auto loc = (renderer_->supports_instancing() && count > 1) ?
+        program_->locate_attribute(INSTANCE_MODEL_MATRIX_ATTRIBUTE, true) : -1;
+
+    if(loc < 0) {
+        batcher::RenderQueueVisitor::visit_instances(renderables, count, pass, iteration);
+        return;
+    }
+
+    /* Every instance shares the geometry, so the first one stands in for
+     * all of them. Only the view and projection uniforms make sense to an
+     * instanced shader, the model dependent ones are for the first instance */
+    const Renderable* first = renderables[0];
+
+    renderer_->set_renderable_uniforms(pass, program_, first, camera_);
+    renderer_->prepare_to_render(first);
+    renderer_->set_auto_attributes_on_shader(program_, first, renderer_->buffer_stash_.get());
+
+    instance_transforms_.resize(count * 16);
+    for(std::size_t i = 0; i < count; ++i) {
+        std::memcpy(&instance_transforms_[i * 16], renderables[i]->final_transformation.data(), sizeof(float) * 16);
+    }
+
+    renderer_->send_instanced_geometry(
+        first, renderer_->buffer_stash_.get(), loc, instance_transforms_.data(), count
+    );
+}
+
 static GLenum convert_id_type(IndexType type) {
     switch(type) {
     case INDEX_TYPE_8_BIT: return GL_UNSIGNED_BYTE;
@@ -693,12 +750,65 @@ void GenericRenderer::send_geometry(const Renderable *renderable, GPUBuffer *buf
     auto index_type = convert_id_type(renderable->index_data->index_type());
     auto arrangement = renderable->arrangement;
 
-    auto offset = buffers->index_vbo->byte_offset(buffers->index_vbo_slot);
+    auto offset = buffers->index_offset;
 
     GLCheck(glDrawElements, convert_arrangement(arrangement), element_count, index_type, BUFFER_OFFSET(offset));
     window->stats->increment_polygons_rendered(arrangement, element_count);
 }
 
+void GenericRenderer::set_instance_model_constant(GPUProgram* program, const Renderable* renderable) {
+    /* Outside of an instanced draw the instance attribute is constant, so
+     * the same shader works whether or not the renderable was instanced */
+    auto loc = program->locate_attribute(INSTANCE_MODEL_MATRIX_ATTRIBUTE, true);
+    if(loc < 0) {
+        return;
+    }
+
+    const float* model = renderable->final_transformation.data();
+    for(auto c = 0; c < 4; ++c) {
+        state_.disable_vertex_attribute(loc + c);
+        GLCheck(glVertexAttrib4fv, loc + c, model + (c * 4));
+    }
+}
+
+void GenericRenderer::send_instanced_geometry(const Renderable* renderable, GPUBuffer* buffers, int32_t model_location, const float* transforms, uint32_t count) {
+    const uint32_t matrix_size = sizeof(float) * 16;
+
+    auto instance_buffer = buffer_manager_->stream_instance_data(transforms, matrix_size * count);
+
+    /* A mat4 attribute takes four consecutive locations, one per column */
+    state_.bind_buffer(GL_ARRAY_BUFFER, instance_buffer.first);
+    for(auto c = 0; c < 4; ++c) {
+        auto loc = model_location + c;
+        state_.enable_vertex_attribute(loc);
+        GLCheck(glVertexAttribPointer,
+            loc, 4, GL_FLOAT, GL_FALSE, matrix_size,
+            BUFFER_OFFSET(instance_buffer.second + (c * sizeof(float) * 4))
+        );
+        GLCheck(glVertexAttribDivisorARB, loc, 1);
+    }
+
+    auto element_count = renderable->index_element_count;
+    auto index_type = convert_id_type(renderable->index_data->index_type());
+    auto arrangement = renderable->arrangement;
+
+    GLCheck(glDrawElementsInstancedARB,
+        convert_arrangement(arrangement), element_count, index_type,
+        BUFFER_OFFSET(buffers->index_offset), count
+    );
+
+    /* Leave the locations as plain attributes for whatever is drawn next */
+    for(auto c = 0; c < 4; ++c) {
+        GLCheck(glVertexAttribDivisorARB, model_location + c, 0);
+        state_.disable_vertex_attribute(model_location + c);
+    }
+
+    state_.bind_buffer(GL_ARRAY_BUFFER, buffers->vertex_vbo);
+
+    window->stats->increment_polygons_rendered(arrangement, element_count * count);
+    window->stats->increment_instanced_draws(count);
+}
+
 void GenericRenderer::init_context() {
     if(!gladLoadGL()) {
         throw std::runtime_error("Unable to intialize OpenGL 2.1");
@@ -718,6 +828,22 @@ void GenericRenderer::init_context() {
         GL_vendor, GL_renderer, GL_version, GL_extensions
     );
 
+    instancing_supported_ = GLAD_GL_ARB_instanced_arrays && GLAD_GL_ARB_draw_instanced;
+    S_INFO("Hardware instancing is {0}", (instancing_supported_) ? "available" : "unavailable");
+
+    /* Each mat4 takes 16 components, leave room for the matrices, lights
+     * and material properties every shader uses */
+    const GLint RESERVED_UNIFORM_COMPONENTS = 256;
+
+    GLint uniform_components = 0;
+    GLCheck(glGetIntegerv, GL_MAX_VERTEX_UNIFORM_COMPONENTS, &uniform_components);
+    max_gpu_skinning_joints_ = std::min<GLint>(
+        std::max<GLint>(uniform_components - RESERVED_UNIFORM_COMPONENTS, 0) / 16,
+        MAX_JOINTS_PER_MESH
+    );
+
+    S_INFO("GPU skinning supports up to {0} joints", max_gpu_skinning_joints_);
+
     GLCheck(glEnable, GL_DEPTH_TEST);
     GLCheck(glDepthFunc, GL_LEQUAL);
     GLCheck(glEnable, GL_CULL_FACE);
@@ -731,7 +857,28 @@ void GenericRenderer::prepare_to_render(const Renderable *renderable) {
     /* Here we allocate VBOs for the renderable if necessary, and then upload
      * any new data */
     buffer_stash_.reset(new GPUBuffer(buffer_manager_->update_and_fetch_buffers(renderable)));
-    buffer_stash_->bind_vbos();
+    buffer_stash_->bind_vbos(&state_);
+}
+
+void GenericRenderer::on_pre_render() {
+    buffer_manager_->begin_frame();
+
+    window->stats->set_gpu_buffer_stats(
+        buffer_manager_->buffer_count(),
+        buffer_manager_->bytes_uploaded_last_frame(),
+        buffer_manager_->fragmentation()
+    );
+
+    /* Report what the state and uniform caches saved last frame */
+    uint32_t calls_avoided = state_.calls_avoided();
+    state_.reset_calls_avoided();
+
+    program_manager_.each([&](uint32_t, GPUProgramPtr program) {
+        calls_avoided += program->uniform_calls_avoided();
+        program->reset_uniform_calls_avoided();
+    });
+
+    window->stats->set_gl_calls_avoided(calls_avoided);
 }
 
 
@@ -26,6 +26,7 @@
 #include "../gl_renderer.h"
 #include "../../assets/material.h"
 #include "../batching/render_queue.h"
+#include "gl_state_cache.h"
 
 namespace smlt {
 
@@ -48,6 +49,7 @@ public:
 
     void start_traversal(const batcher::RenderQueue& queue, uint64_t frame_id, Stage* stage);
     void visit(const Renderable* renderable, const MaterialPass* pass, batcher::Iteration);
+    void visit_instances(const Renderable* const* renderables, std::size_t count, const MaterialPass* pass, batcher::Iteration iteration) override;
     void end_traversal(const batcher::RenderQueue &queue, Stage* stage);
 
     void change_render_group(const batcher::RenderGroup *prev, const batcher::RenderGroup *next);
@@ -65,6 +67,10 @@ private:
 
     GL2RenderGroupImpl* current_group_ = nullptr;
 
+    /* Model matrices for the instanced draw being built, kept to avoid
+     * reallocating every run */
+    std::vector<float> instance_transforms_;
+
     void do_visit(const Renderable* renderable, const MaterialPass* material_pass, batcher::Iteration iteration);
 
     void rebind_attribute_locations_if_necessary(const MaterialPass* pass, GPUProgram* program);
@@ -97,6 +103,8 @@ public:
     GPUProgramPtr gpu_program(const GPUProgramID& program_id) const override;
     GPUProgramID current_gpu_program_id() const override;
     bool supports_gpu_programs() const override { return true; }
+    bool supports_gpu_morphing(Material* material) override;
+    bool supports_gpu_skinning(Material* material, uint32_t joint_count) override;
     GPUProgramID default_gpu_program_id() const override;
 
     std::string name() const override {
@@ -104,10 +112,20 @@ public:
     }
 
     void prepare_to_render(const Renderable* renderable) override;
+
+    /* True if the context supports ARB_instanced_arrays and ARB_draw_instanced */
+    bool supports_instancing() const { return instancing_supported_; }
 private:
     GPUProgramManager program_manager_;
     GPUProgramID default_gpu_program_id_ = 0;
+    bool instancing_supported_ = false;
+
+    /* The most joint matrices which fit in the vertex uniforms, alongside
+     * everything else a shader needs */
+    uint32_t max_gpu_skinning_joints_ = 0;
 
+    /* Must be declared before the buffer manager, which binds through it */
+    GLStateCache state_;
     std::shared_ptr<VBOManager> buffer_manager_;
 
     void set_light_uniforms(const MaterialPass* pass, GPUProgram* program, const LightPtr light);
@@ -116,9 +134,14 @@ private:
     void set_stage_uniforms(const MaterialPass* pass, GPUProgram* program, const Colour& global_ambient);
 
     void set_auto_attributes_on_shader(GPUProgram *program, const Renderable* buffer, GPUBuffer* buffers);
+    void set_morph_attributes_on_shader(GPUProgram* program, const Renderable* renderable, GPUBuffer* buffers);
+    void set_skinning_attributes_on_shader(GPUProgram* program, const Renderable* renderable, GPUBuffer* buffers);
     void set_blending_mode(BlendType type);
     void send_geometry(const Renderable* renderable, GPUBuffer* buffers);
 
+    void set_instance_model_constant(GPUProgram* program, const Renderable* renderable);
+    void send_instanced_geometry(const Renderable* renderable, GPUBuffer* buffers, int32_t model_location, const float* transforms, uint32_t count);
+
     /* Stashed here in prepare_to_render and used later for that renderable */
     std::shared_ptr<GPUBuffer> buffer_stash_;
 
@@ -135,6 +158,8 @@ private:
     void on_texture_unregister(TextureID tex_id, Texture* texture) override {
         GLRenderer::on_texture_unregister(tex_id, texture);
     }
+
+    void on_pre_render() override;
 };
 
 }
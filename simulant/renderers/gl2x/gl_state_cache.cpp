@@ -0,0 +1,187 @@
+#include <cassert>
+
+#include "gl_state_cache.h"
+#include "../../utils/gl_error.h"
+
+namespace smlt {
+
+static const uint8_t UNKNOWN_TEXTURE_UNIT = 0xFF;
+
+void GLStateCache::invalidate() {
+    blend_ = depth_test_ = cull_face_enabled_ = depth_mask_ = FLAG_UNKNOWN;
+
+    blend_source_ = blend_destination_ = UNKNOWN;
+    cull_face_ = UNKNOWN;
+    polygon_mode_ = UNKNOWN;
+
+    active_texture_ = UNKNOWN_TEXTURE_UNIT;
+    for(auto& texture: textures_) {
+        texture = UNKNOWN;
+    }
+
+    array_buffer_ = element_array_buffer_ = UNKNOWN;
+
+    enabled_attributes_ = 0;
+    known_attributes_ = 0;
+}
+
+GLStateCache::Flag* GLStateCache::flag_for(GLenum capability) {
+    switch(capability) {
+        case GL_BLEND: return &blend_;
+        case GL_DEPTH_TEST: return &depth_test_;
+        case GL_CULL_FACE: return &cull_face_enabled_;
+    default:
+        return nullptr;
+    }
+}
+
+GLuint* GLStateCache::buffer_for(GLenum target) {
+    switch(target) {
+        case GL_ARRAY_BUFFER: return &array_buffer_;
+        case GL_ELEMENT_ARRAY_BUFFER: return &element_array_buffer_;
+    default:
+        return nullptr;
+    }
+}
+
+void GLStateCache::set_enabled(GLenum capability, bool value) {
+    auto flag = flag_for(capability);
+    auto wanted = (value) ? FLAG_ENABLED : FLAG_DISABLED;
+
+    if(flag && *flag == wanted) {
+        ++calls_avoided_;
+        return;
+    }
+
+    if(value) {
+        GLCheck(glEnable, capability);
+    } else {
+        GLCheck(glDisable, capability);
+    }
+
+    if(flag) {
+        *flag = wanted;
+    }
+}
+
+void GLStateCache::blend_func(GLenum source, GLenum destination) {
+    if(blend_source_ == source && blend_destination_ == destination) {
+        ++calls_avoided_;
+        return;
+    }
+
+    GLCheck(glBlendFunc, source, destination);
+    blend_source_ = source;
+    blend_destination_ = destination;
+}
+
+void GLStateCache::depth_mask(bool value) {
+    auto wanted = (value) ? FLAG_ENABLED : FLAG_DISABLED;
+    if(depth_mask_ == wanted) {
+        ++calls_avoided_;
+        return;
+    }
+
+    GLCheck(glDepthMask, (value) ? GL_TRUE : GL_FALSE);
+    depth_mask_ = wanted;
+}
+
+void GLStateCache::cull_face(GLenum face) {
+    if(cull_face_ == face) {
+        ++calls_avoided_;
+        return;
+    }
+
+    GLCheck(glCullFace, face);
+    cull_face_ = face;
+}
+
+void GLStateCache::polygon_mode(GLenum mode) {
+    if(polygon_mode_ == mode) {
+        ++calls_avoided_;
+        return;
+    }
+
+    GLCheck(glPolygonMode, GL_FRONT_AND_BACK, mode);
+    polygon_mode_ = mode;
+}
+
+void GLStateCache::active_texture(uint8_t unit) {
+    assert(unit < _S_GL_MAX_TEXTURE_UNITS);
+
+    if(active_texture_ == unit) {
+        ++calls_avoided_;
+        return;
+    }
+
+    GLCheck(glActiveTexture, GL_TEXTURE0 + unit);
+    active_texture_ = unit;
+}
+
+void GLStateCache::bind_texture(uint8_t unit, GLuint texture) {
+    assert(unit < _S_GL_MAX_TEXTURE_UNITS);
+
+    if(textures_[unit] == texture) {
+        /* Both the unit switch and the bind are skipped */
+        calls_avoided_ += (active_texture_ == unit) ? 1 : 2;
+        return;
+    }
+
+    active_texture(unit);
+    GLCheck(glBindTexture, GL_TEXTURE_2D, texture);
+    textures_[unit] = texture;
+}
+
+void GLStateCache::bind_buffer(GLenum target, GLuint buffer) {
+    auto bound = buffer_for(target);
+    if(bound && *bound == buffer) {
+        ++calls_avoided_;
+        return;
+    }
+
+    GLCheck(glBindBuffer, target, buffer);
+
+    if(bound) {
+        *bound = buffer;
+    }
+}
+
+void GLStateCache::on_buffer_deleted(GLuint buffer) {
+    if(array_buffer_ == buffer) {
+        array_buffer_ = 0;
+    }
+
+    if(element_array_buffer_ == buffer) {
+        element_array_buffer_ = 0;
+    }
+}
+
+void GLStateCache::enable_vertex_attribute(uint8_t index) {
+    assert(index < MAX_VERTEX_ATTRIBUTES);
+
+    uint32_t bit = 1u << index;
+    if((known_attributes_ & bit) && (enabled_attributes_ & bit)) {
+        ++calls_avoided_;
+        return;
+    }
+
+    GLCheck(glEnableVertexAttribArray, index);
+    known_attributes_ |= bit;
+    enabled_attributes_ |= bit;
+}
+
+void GLStateCache::disable_vertex_attribute(uint8_t index) {
+    assert(index < MAX_VERTEX_ATTRIBUTES);
+
+    uint32_t bit = 1u << index;
+    if((known_attributes_ & bit) && !(enabled_attributes_ & bit)) {
+        ++calls_avoided_;
+        return;
+    }
+
+    GLCheck(glDisableVertexAttribArray, index);
+    known_attributes_ |= bit;
+    enabled_attributes_ &= ~bit;
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../gl_renderer.h"
+#include "../glad/glad/glad.h"
+
+namespace smlt {
+
+/*
+ * Shadows the GL state which the GL2 renderer changes while traversing a
+ * render queue, so that calls which wouldn't change anything are skipped.
+ *
+ * Anything outside the renderer (viewport clears, texture uploads) can touch
+ * the same state behind our back, so the cache should be invalidated before
+ * each traversal. Until a value has been set through the cache it's unknown,
+ * and the first call always goes through to GL.
+ */
+class GLStateCache {
+public:
+    GLStateCache() { invalidate(); }
+
+    /* Forget everything, the next call for each piece of state will go to GL */
+    void invalidate();
+
+    /* Only GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are tracked, anything
+     * else is passed straight through */
+    void set_enabled(GLenum capability, bool value);
+
+    void blend_func(GLenum source, GLenum destination);
+    void depth_mask(bool value);
+    void cull_face(GLenum face);
+    void polygon_mode(GLenum mode);
+
+    void active_texture(uint8_t unit);
+    void bind_texture(uint8_t unit, GLuint texture);
+
+    void bind_buffer(GLenum target, GLuint buffer);
+
+    /* Deleting a bound buffer unbinds it, and GL may reuse the name */
+    void on_buffer_deleted(GLuint buffer);
+
+    void enable_vertex_attribute(uint8_t index);
+    void disable_vertex_attribute(uint8_t index);
+
+    /* The number of GL calls skipped since the last reset */
+    uint32_t calls_avoided() const { return calls_avoided_; }
+    void reset_calls_avoided() { calls_avoided_ = 0; }
+
+private:
+    /* Tri-state so that unknown values always get sent */
+    enum Flag : uint8_t {
+        FLAG_UNKNOWN,
+        FLAG_DISABLED,
+        FLAG_ENABLED
+    };
+
+    static const GLenum UNKNOWN = ~0u;
+    static const uint8_t MAX_VERTEX_ATTRIBUTES = 32;
+
+    Flag* flag_for(GLenum capability);
+    GLuint* buffer_for(GLenum target);
+
+    Flag blend_;
+    Flag depth_test_;
+    Flag cull_face_enabled_;
+    Flag depth_mask_;
+
+    GLenum blend_source_;
+    GLenum blend_destination_;
+    GLenum cull_face_;
+    GLenum polygon_mode_;
+
+    uint8_t active_texture_;
+    GLuint textures_[_S_GL_MAX_TEXTURE_UNITS];
+
+    GLuint array_buffer_;
+    GLuint element_array_buffer_;
+
+    /* Which attributes are enabled, and which of those bits we know */
+    uint32_t enabled_attributes_;
+    uint32_t known_attributes_;
+
+    uint32_t calls_avoided_ = 0;
+};
+
+}
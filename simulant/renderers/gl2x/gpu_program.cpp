@@ -18,6 +18,8 @@
 //
 
 
+#include <cstring>
+
 #include "../../utils/gl_error.h"
 #include "../../utils/hash/md5.h"
 #include "gpu_program.h"
@@ -40,6 +42,16 @@ UniformInfo GPUProgram::uniform_info(const std::string& uniform_name) {
     return (*it).second;
 }
 
+uint32_t GPUProgram::uniform_array_size(const std::string& uniform_name) const {
+    /* Drivers may report arrays with or without the subscript */
+    auto it = uniform_info_.find(uniform_name + "[0]");
+    if(it == uniform_info_.end()) {
+        it = uniform_info_.find(uniform_name);
+    }
+
+    return (it == uniform_info_.end()) ? 0 : (uint32_t) (*it).second.size;
+}
+
 GLint GPUProgram::locate_uniform(const std::string& uniform_name, bool fail_silently) {
     /* Don't do anything costly if we already know where the uniform is */
     auto it = uniform_cache_.find(uniform_name);
@@ -88,65 +100,94 @@ GLint GPUProgram::locate_uniform(const std::string& uniform_name, bool fail_sile
     return location;
 }
 
+bool GPUProgram::update_shadow(GLint loc, const void* data, uint8_t words) {
+    assert(words <= 16);
+
+    auto& shadow = uniform_shadow_[loc];
+    if(shadow.words == words && std::memcmp(shadow.data, data, words * sizeof(uint32_t)) == 0) {
+        ++uniform_calls_avoided_;
+        return false;
+    }
+
+    shadow.words = words;
+    std::memcpy(shadow.data, data, words * sizeof(uint32_t));
+    return true;
+}
+
 void GPUProgram::set_uniform_int(const int32_t loc, const int32_t value) {
     assert(loc >= 0);
-    GLCheck(glUniform1i, loc, value);
+    if(update_shadow(loc, &value, 1)) {
+        GLCheck(glUniform1i, loc, value);
+    }
 }
 
 void GPUProgram::set_uniform_int(const std::string& uniform_name, const int32_t value, bool fail_silently) {
     GLint loc = locate_uniform(uniform_name, fail_silently);
     if(loc > -1) {
-        GLCheck(glUniform1i, loc, value);
+        set_uniform_int(loc, value);
     }
 }
 
 void GPUProgram::set_uniform_float(const int32_t loc, const float value) {
     assert(loc >= 0);
-    GLCheck(glUniform1f, loc, value);
+    if(update_shadow(loc, &value, 1)) {
+        GLCheck(glUniform1f, loc, value);
+    }
 }
 
 void GPUProgram::set_uniform_float(const std::string& uniform_name, const float value, bool fail_silently) {
     int32_t loc = locate_uniform(uniform_name, fail_silently);
     if(loc > -1) {
-        GLCheck(glUniform1f, loc, value);
+        set_uniform_float(loc, value);
     }
 }
 
 void GPUProgram::set_uniform_mat4x4(const int32_t loc, const Mat4& matrix) {
     assert(loc >= 0);
-    GLCheck(glUniformMatrix4fv, loc, 1, false, (GLfloat*)matrix.data());
+    if(update_shadow(loc, matrix.data(), 16)) {
+        GLCheck(glUniformMatrix4fv, loc, 1, false, (GLfloat*)matrix.data());
+    }
 }
 
 void GPUProgram::set_uniform_mat4x4(const std::string& uniform_name, const Mat4& matrix) {
     int32_t loc = locate_uniform(uniform_name);
     if(loc > -1) {
-        GLCheck(glUniformMatrix4fv, loc, 1, false, (GLfloat*)matrix.data());
+        set_uniform_mat4x4(loc, matrix);
+    }
+}
+
+void GPUProgram::set_uniform_mat3x3(const int32_t loc, const Mat3& matrix) {
+    assert(loc >= 0);
+    if(update_shadow(loc, matrix.data(), 9)) {
+        GLCheck(glUniformMatrix3fv, loc, 1, false, (GLfloat*)matrix.data());
     }
 }
 
 void GPUProgram::set_uniform_mat3x3(const std::string& uniform_name, const Mat3& matrix) {
     int32_t loc = locate_uniform(uniform_name);
     if(loc > -1) {
-        GLCheck(glUniformMatrix3fv, loc, 1, false, (GLfloat*)matrix.data());
+        set_uniform_mat3x3(loc, matrix);
     }
 }
 
 void GPUProgram::set_uniform_vec3(const std::string& uniform_name, const Vec3& values) {
     int32_t loc = locate_uniform(uniform_name);
-    if(loc > -1) {
+    if(loc > -1 && update_shadow(loc, &values, 3)) {
         GLCheck(glUniform3fv, loc, 1, (GLfloat*) &values);
     }
 }
 
 void GPUProgram::set_uniform_vec4(const int32_t loc, const Vec4& values) {
     assert(loc >= 0);
-    GLCheck(glUniform4fv, loc, 1, (GLfloat*) &values);
+    if(update_shadow(loc, &values, 4)) {
+        GLCheck(glUniform4fv, loc, 1, (GLfloat*) &values);
+    }
 }
 
 void GPUProgram::set_uniform_vec4(const std::string& uniform_name, const Vec4& values) {
     int32_t loc = locate_uniform(uniform_name);
     if(loc > -1) {
-        GLCheck(glUniform4fv, loc, 1, (GLfloat*) &values);
+        set_uniform_vec4(loc, values);
     }
 }
 
@@ -161,9 +202,92 @@ void GPUProgram::set_uniform_colour(const std::string& uniform_name, const Colou
 
 void GPUProgram::set_uniform_mat4x4_array(const std::string& uniform_name, const std::vector<Mat4>& matrices) {
     int32_t loc = locate_uniform(uniform_name);
+
+    /* Arrays aren't shadowed, but the first element shares the location */
+    uniform_shadow_.erase(loc);
     GLCheck(glUniformMatrix4fv, loc, matrices.size(), false, (GLfloat*) &matrices[0]);
 }
 
+void GPUProgram::upload_parameter_block(const MaterialParameterBlock& block) {
+    if(block.layout() != parameter_layout_) {
+        parameter_locations_.clear();
+        for(auto& parameter: block.parameters()) {
+            parameter_locations_.push_back(locate_uniform(parameter.name, true));
+        }
+
+        parameter_texture_locations_.clear();
+        for(auto& parameter: block.texture_parameters()) {
+            parameter_texture_locations_.push_back(locate_uniform(parameter.name, true));
+        }
+
+        parameter_layout_ = block.layout();
+        uploaded_parameter_block_ = 0;
+    }
+
+    if(block.version() == uploaded_parameter_block_) {
+        return;
+    }
+
+    auto& parameters = block.parameters();
+    for(std::size_t i = 0; i < parameters.size(); ++i) {
+        auto loc = parameter_locations_[i];
+        if(loc < 0) {
+            continue;
+        }
+
+        auto& parameter = parameters[i];
+        switch(parameter.type) {
+        case MATERIAL_PROPERTY_TYPE_BOOL:
+        case MATERIAL_PROPERTY_TYPE_INT:
+            set_uniform_int(loc, *block.value<int32_t>(parameter));
+        break;
+        case MATERIAL_PROPERTY_TYPE_FLOAT:
+            set_uniform_float(loc, *block.value<float>(parameter));
+        break;
+        case MATERIAL_PROPERTY_TYPE_VEC2: {
+            auto v = block.value<GLfloat>(parameter);
+            if(update_shadow(loc, v, 2)) {
+                GLCheck(glUniform2fv, loc, 1, v);
+            }
+        } break;
+        case MATERIAL_PROPERTY_TYPE_VEC3: {
+            auto v = block.value<GLfloat>(parameter);
+            if(update_shadow(loc, v, 3)) {
+                GLCheck(glUniform3fv, loc, 1, v);
+            }
+        } break;
+        case MATERIAL_PROPERTY_TYPE_VEC4: {
+            auto v = block.value<GLfloat>(parameter);
+            if(update_shadow(loc, v, 4)) {
+                GLCheck(glUniform4fv, loc, 1, v);
+            }
+        } break;
+        case MATERIAL_PROPERTY_TYPE_MAT3: {
+            /* Strip the std140 column padding */
+            auto v = block.value<GLfloat>(parameter);
+            GLfloat m[9];
+            for(auto c = 0; c < 3; ++c) {
+                std::memcpy(&m[c * 3], v + (c * 4), sizeof(GLfloat) * 3);
+            }
+
+            if(update_shadow(loc, m, 9)) {
+                GLCheck(glUniformMatrix3fv, loc, 1, false, m);
+            }
+        } break;
+        case MATERIAL_PROPERTY_TYPE_MAT4: {
+            auto v = block.value<GLfloat>(parameter);
+            if(update_shadow(loc, v, 16)) {
+                GLCheck(glUniformMatrix4fv, loc, 1, false, v);
+            }
+        } break;
+        default:
+            break;
+        }
+    }
+
+    uploaded_parameter_block_ = block.version();
+}
+
 void GPUProgram::rebuild_uniform_info() {
     //FIXME: Make this only happen when debugging
     //DEBUG info!
@@ -445,6 +569,9 @@ void GPUProgram::link(bool force) {
     // Rebuild the uniform information for debugging
     rebuild_uniform_info();
     uniform_cache_.clear();
+    uniform_shadow_.clear();
+    parameter_layout_ = 0;
+    uploaded_parameter_block_ = 0;
 
     is_linked_ = true;
     needs_relink_ = false;
@@ -30,6 +30,7 @@
 #include "../../utils/gl_thread_check.h"
 #include "../../generic/identifiable.h"
 #include "../../vertex_data.h"
+#include "../../assets/materials/parameter_block.h"
 
 #include "../glad/glad/glad.h"
 
@@ -107,12 +108,17 @@ public:
 
     UniformInfo uniform_info(const std::string& uniform_name);
 
+    /* The number of elements in a uniform array, zero if the program
+     * doesn't use it */
+    uint32_t uniform_array_size(const std::string& uniform_name) const;
+
     void clear_cache() {
         uniform_cache_.clear();
     }
 
     void set_uniform_int(const int32_t loc, const int32_t value);
     void set_uniform_mat4x4(const int32_t loc, const Mat4& values);
+    void set_uniform_mat3x3(const int32_t loc, const Mat3& values);
     void set_uniform_colour(const int32_t loc, const Colour& values);
     void set_uniform_vec4(const int32_t loc, const Vec4& values);
     void set_uniform_float(const int32_t loc, const float value);
@@ -126,6 +132,23 @@ public:
     void set_uniform_colour(const std::string& uniform_name, const Colour& values);
     void set_uniform_mat4x4_array(const std::string& uniform_name, const std::vector<Mat4>& matrices);
 
+    /* Sends every value in the block which this program has a uniform for.
+     * Nothing is sent if this block version was the last one uploaded, and
+     * uniform locations are only looked up when the block layout changes.
+     * The program must be current. */
+    void upload_parameter_block(const MaterialParameterBlock& block);
+
+    /* The uniform location for each of the block's texture parameters, -1
+     * if unused. Only valid after upload_parameter_block() */
+    const std::vector<GLint>& parameter_texture_locations() const {
+        return parameter_texture_locations_;
+    }
+
+    /* Setting a uniform to the value it already holds doesn't reach GL, this
+     * is the number of calls skipped since the last reset */
+    uint32_t uniform_calls_avoided() const { return uniform_calls_avoided_; }
+    void reset_uniform_calls_avoided() { uniform_calls_avoided_ = 0; }
+
     void relink() {
         if(needs_relink_) {
             link();
@@ -171,6 +194,24 @@ private:
     std::unordered_map<std::string, GLint> uniform_cache_;
     std::unordered_map<std::string, int32_t> attribute_cache_;
 
+    /* The last value sent to each uniform location. Uniform state belongs to
+     * the program so this survives switching programs, linking resets it */
+    struct UniformShadow {
+        uint8_t words = 0;
+        uint32_t data[16];
+    };
+
+    std::unordered_map<GLint, UniformShadow> uniform_shadow_;
+    uint32_t uniform_calls_avoided_ = 0;
+
+    /* Records the value for the location, returns false if it was already set */
+    bool update_shadow(GLint loc, const void* data, uint8_t words);
+
+    uint32_t parameter_layout_ = 0;
+    uint32_t uploaded_parameter_block_ = 0;
+    std::vector<GLint> parameter_locations_;
+    std::vector<GLint> parameter_texture_locations_;
+
     void link(bool force=false);
 
     uint32_t renderer_id_ = 0;
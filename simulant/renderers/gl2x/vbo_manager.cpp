@@ -2,405 +2,471 @@
 
 namespace smlt {
 
-void GPUBuffer::bind_vbos() {
-    vertex_vbo->bind(vertex_vbo_slot);
-    index_vbo->bind(index_vbo_slot);
+static void bind_buffer(GLStateCache* state, GLenum target, GLuint buffer) {
+    if(state) {
+        state->bind_buffer(target, buffer);
+    } else {
+        GLCheck(glBindBuffer, target, buffer);
+    }
 }
 
-void VBOManager::on_index_data_destroyed(IndexData* index_data) {
-    release_slot(index_data);
-}
+static void delete_gl_buffer(GLStateCache* state, GLuint buffer) {
+    if(state) {
+        state->on_buffer_deleted(buffer);
+    }
 
-void VBOManager::on_vertex_data_destroyed(VertexData* vertex_data) {
-    release_slot(vertex_data);
+    try {
+        glDeleteBuffers(1, &buffer);
+    } catch(...) {
+        S_WARN("Exception while deleting GL VBO");
+    }
 }
 
-template<typename Data>
-std::pair<VBO*, VBOSlot> VBOManager::perform_fetch_or_upload(const Data* vdata, VBOManager::DedicatedMap& dedicated_vbos, VBOManager::SlotMap& data_slots) {
-    uuid64 vid = vdata->uuid();
-
-    auto vit = data_slots.find(vid);
-
-    VBO* vvbo = nullptr;
-    VBOSlot vslot = 0;
+void GPUBuffer::bind_vbos(GLStateCache* state) {
+    bind_buffer(state, GL_ARRAY_BUFFER, vertex_vbo);
+    bind_buffer(state, GL_ELEMENT_ARRAY_BUFFER, index_vbo);
+}
 
-    bool upload_vdata = false;
+VBOArena::VBOArena(GLenum target, uint32_t buffer_size):
+    target_(target),
+    buffer_size_(buffer_size) {
 
-    if(vit == data_slots.end()) {
-        /* Could be dedicated? */
-        auto dvit = dedicated_vbos.find(vid);
-        if(dvit != dedicated_vbos.end()) {
-            vvbo = dvit->second.get();
-            vslot = 0;
-        } else {
-            /* OK, first time we've seen this vertex data, let's allocate! */
-            auto vpair = allocate_slot(vdata);
-            vvbo = vpair.first;
-            vslot = vpair.second;
+}
 
-            upload_vdata = true;
-        }
-    } else {
-        /* We've seen this before... does it need updating? */
-        vvbo = vit->second.first;
-        vslot = vit->second.second;
+VBOArena::~VBOArena() {
+    for(auto i = 0u; i < buffers_.size(); ++i) {
+        delete_buffer(i);
     }
+}
 
-    if(vdata->data_size() > vvbo->slot_size_in_bytes()) {
-        /* Data size increased past the slot size, we need to free and reallocate */
-        /* Data size increased past the slot size, we need to free and reallocate */
-        release_slot(vdata);
-        auto vpair = allocate_slot(vdata);
-        vvbo = vpair.first;
-        vslot = vpair.second;
-        upload_vdata = true;
+uint32_t VBOArena::new_buffer(uint32_t size, bool dedicated) {
+    uint32_t index;
+    if(!unused_buffers_.empty()) {
+        index = unused_buffers_.back();
+        unused_buffers_.pop_back();
+    } else {
+        index = buffers_.size();
+        buffers_.push_back(Buffer());
     }
 
-    // FIXME: What if the vertex buffer reduces in size to below the next slot, do we
-    // bother reallocating?
+    L_DEBUG_VBO(_F("Allocating new GL buffer of {0} bytes for target {1}").format(size, target_));
 
-    if(vdata->last_updated() > vvbo->slot_last_updated(vslot)) {
-        upload_vdata = true;
-    }
+    auto& buffer = buffers_[index];
+    buffer.size = size;
+    buffer.allocator.reset((dedicated) ? nullptr : new BufferAllocator(size, VBO_ALIGNMENT));
 
-    assert(vvbo);
+    GLCheck(glGenBuffers, 1, &buffer.gl_id);
+    bind_buffer(state_, target_, buffer.gl_id);
 
-    if(upload_vdata) {
-        /* Vertex data changed since previous upload, so upload again */
-        vvbo->bind(vslot);
-        vvbo->upload(vslot, vdata);
-    }
+    /* Shared buffers are filled piecemeal with glBufferSubData, dedicated ones
+     * are uploaded in one go */
+    GLCheck(glBufferData, target_, size, nullptr, (dedicated) ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
 
-    return std::make_pair(vvbo, vslot);
+    return index;
 }
 
-GPUBuffer VBOManager::update_and_fetch_buffers(const Renderable *renderable) {
-    const auto& vdata = renderable->vertex_data;
-    const auto& idata = renderable->index_data;
+void VBOArena::delete_buffer(uint32_t index) {
+    auto& buffer = buffers_[index];
+    if(!buffer.gl_id) {
+        return;
+    }
 
-    auto vpair = perform_fetch_or_upload(vdata, dedicated_vertex_vbos_, vertex_data_slots_);
-    auto ipair = perform_fetch_or_upload(idata, dedicated_index_vbos_, index_data_slots_);
+    delete_gl_buffer(state_, buffer.gl_id);
 
-    GPUBuffer buffer;
+    buffer.gl_id = 0;
+    buffer.size = 0;
+    buffer.allocator.reset();
+}
 
-    assert(vpair.first->target() == GL_ARRAY_BUFFER);
-    assert(ipair.first->target() == GL_ELEMENT_ARRAY_BUFFER);
+VBOAllocation VBOArena::allocate(uint32_t size) {
+    VBOAllocation ret;
 
-    buffer.index_vbo = ipair.first;
-    buffer.vertex_vbo = vpair.first;
-    buffer.index_vbo_slot = ipair.second;
-    buffer.vertex_vbo_slot = vpair.second;
+    if(size > buffer_size_) {
+        ret.buffer = new_buffer(size, true);
+        ret.size = size;
+        return ret;
+    }
 
-    return buffer;
-}
+    auto try_buffer = [&](uint32_t index) -> bool {
+        auto& allocator = buffers_[index].allocator;
+        if(!buffers_[index].gl_id || !allocator) {
+            return false;
+        }
 
-uint32_t VBOManager::dedicated_buffer_count() const {
-    return dedicated_index_vbos_.size() + dedicated_vertex_vbos_.size();
-}
+        auto handle = allocator->allocate(size);
+        if(handle == BufferAllocator::INVALID_HANDLE) {
+            return false;
+        }
 
-VBOManager::~VBOManager() {
-    for(auto& pair: vdata_destruction_connections_) {
-        pair.second.disconnect();
-    }
+        ret.buffer = index;
+        ret.handle = handle;
+        ret.offset = allocator->offset(handle);
+        ret.size = allocator->size(handle);
+        return true;
+    };
 
-    for(auto& pair: idata_destruction_connections_) {
-        pair.second.disconnect();
+    for(auto i = 0u; i < buffers_.size(); ++i) {
+        if(try_buffer(i)) {
+            return ret;
+        }
     }
-}
 
-VBOSlotSize VBOManager::calc_vbo_slot_size(uint32_t required_size_in_bytes) {
-    auto next_pow2 = [](uint32_t x) -> uint32_t {
-        uint32_t power = 1;
-        while(power < x)
-            power *= 2;
-        return power;
-    };
+    auto created = try_buffer(new_buffer(buffer_size_, false));
+    assert(created);
+    _S_UNUSED(created);
 
-    VBOSlotSize size = VBO_SLOT_SIZE_1K;
+    return ret;
+}
 
-    auto check = next_pow2(required_size_in_bytes);
+void VBOArena::release(const VBOAllocation& allocation) {
+    assert(allocation.is_valid());
 
-    assert(check <= (int) smlt::VBO_SLOT_SIZE_512K);
+    auto& buffer = buffers_[allocation.buffer];
+    if(buffer.allocator) {
+        buffer.allocator->release(allocation.handle);
 
-    if(check <= (int) VBO_SLOT_SIZE_1K) {
-        size = VBO_SLOT_SIZE_1K;
-    } else {
-        size = (VBOSlotSize) check;
+        /* Keep one empty shared buffer around so that a mesh being destroyed
+         * and recreated doesn't thrash buffer creation */
+        if(buffer.allocator->allocation_count() || buffer_count() - dedicated_buffer_count() == 1) {
+            return;
+        }
     }
 
-    return size;
+    delete_buffer(allocation.buffer);
+    unused_buffers_.push_back(allocation.buffer);
 }
 
-std::pair<VBO *, VBOSlot> VBOManager::allocate_slot(const VertexData *vertex_data) {
-    auto required_size = vertex_data->data_size();
-    auto spec = vertex_data->vertex_specification();
+void VBOArena::upload(const VBOAllocation& allocation, const void* data, uint32_t size) {
+    assert(allocation.is_valid());
+    assert(size <= allocation.size);
 
-    if(required_size >= int(VBO_SLOT_SIZE_512K)) {
-        /* Use a dedicated VBO */
-        auto pair = std::make_pair(vertex_data->uuid(), DedicatedVBO::create(required_size, spec));
-        dedicated_vertex_vbos_.insert(pair);
+    auto& buffer = buffers_[allocation.buffer];
+    bind_buffer(state_, target_, buffer.gl_id);
 
-        connect_destruction_signal(vertex_data);
-
-        auto vpair = std::make_pair(pair.second.get(), pair.second->allocate_slot());
-        vertex_data_slots_.insert(std::make_pair(vertex_data->uuid(), vpair));
-        return vpair;
+    if(buffer.allocator) {
+        GLCheck(glBufferSubData, target_, allocation.offset, size, data);
     } else {
-        /* Use one of the shared VBOs */
-        auto size = calc_vbo_slot_size(required_size);
-
-        auto idx = log2(int(size)) - 10; // Convert enum value to index
-        auto& entry = shared_vertex_vbos_[idx];
-        auto it = entry.find(spec);
-        if(it == entry.end()) {
-            // Create new VBO
-            auto new_vbo = SharedVBO::create(size, spec);
-            entry.insert(std::make_pair(spec, new_vbo));
-            it = entry.find(spec);
-        }
+        GLCheck(glBufferData, target_, size, data, GL_STATIC_DRAW);
+    }
+}
+
+uint32_t VBOArena::buffer_count() const {
+    return buffers_.size() - unused_buffers_.size();
+}
 
-        connect_destruction_signal(vertex_data);
+uint32_t VBOArena::dedicated_buffer_count() const {
+    uint32_t count = 0;
+    for(auto& buffer: buffers_) {
+        if(buffer.gl_id && !buffer.allocator) {
+            ++count;
+        }
+    }
+    return count;
+}
 
-        VBO* vbo = it->second.get();
-        auto vpair = std::make_pair(vbo, vbo->allocate_slot());
-        vertex_data_slots_.insert(std::make_pair(vertex_data->uuid(), vpair));
-        return vpair;
+uint64_t VBOArena::used_bytes() const {
+    uint64_t used = 0;
+    for(auto& buffer: buffers_) {
+        if(buffer.gl_id) {
+            used += (buffer.allocator) ? buffer.allocator->used_bytes() : buffer.size;
+        }
     }
+    return used;
 }
 
-void VBOManager::release_slot(const VertexData *vertex_data) {
-    auto vid = vertex_data->uuid();
-    auto it = vertex_data_slots_.find(vid);
-    if(it != vertex_data_slots_.end()) {
-        it->second.first->release_slot(it->second.second);
-        vertex_data_slots_.erase(it);
+uint64_t VBOArena::free_bytes() const {
+    uint64_t free = 0;
+    for(auto& buffer: buffers_) {
+        if(buffer.gl_id && buffer.allocator) {
+            free += buffer.allocator->free_bytes();
+        }
     }
+    return free;
+}
 
-    /* If this was a dedicate VBO, then destroy it */
-    auto dit = dedicated_vertex_vbos_.find(vid);
-    if(dit != dedicated_vertex_vbos_.end()) {
-        dedicated_vertex_vbos_.erase(vid);
+float VBOArena::fragmentation() const {
+    uint64_t free = 0;
+    uint32_t largest = 0;
+    for(auto& buffer: buffers_) {
+        if(buffer.gl_id && buffer.allocator) {
+            free += buffer.allocator->free_bytes();
+            largest = std::max(largest, buffer.allocator->largest_free_range());
+        }
     }
 
-    disconnect_destruction_signal(vertex_data);
+    return (free) ? 1.0f - (float(largest) / float(free)) : 0.0f;
 }
 
-void VBOManager::release_slot(const IndexData *index_data) {
-    auto vid = index_data->uuid();
-    auto it = index_data_slots_.find(vid);
-    if(it != index_data_slots_.end()) {
-        it->second.first->release_slot(it->second.second);
-        index_data_slots_.erase(it);
-    }
+VBORing::VBORing(GLenum target, uint32_t frame_size):
+    target_(target),
+    frame_size_(frame_size) {
+
+}
 
-    /* If this was a dedicate VBO, then destroy it */
-    auto dit = dedicated_index_vbos_.find(vid);
-    if(dit != dedicated_index_vbos_.end()) {
-        dedicated_index_vbos_.erase(vid);
+VBORing::~VBORing() {
+    if(gl_id_) {
+        delete_gl_buffer(state_, gl_id_);
     }
+}
 
-    disconnect_destruction_signal(index_data);
+void VBORing::begin_frame() {
+    ++frame_;
+    cursor_ = 0;
 }
 
-std::pair<VBO *, VBOSlot> VBOManager::allocate_slot(const IndexData *index_data) {
-    auto required_size = index_data->data_size();
-    auto index_type = index_data->index_type();
+void VBORing::reallocate(uint32_t frame_size) {
+    L_DEBUG_VBO(_F("Resizing streaming buffer to {0} bytes per frame").format(frame_size));
 
-    if(required_size >= int(VBO_SLOT_SIZE_512K)) {
-        /* Use a dedicated VBO */
-        auto pair = std::make_pair(index_data->uuid(), DedicatedVBO::create(required_size, index_type));
-        dedicated_index_vbos_.insert(pair);
+    if(!gl_id_) {
+        GLCheck(glGenBuffers, 1, &gl_id_);
+    }
 
-        connect_destruction_signal(index_data);
+    frame_size_ = frame_size;
 
-        auto ipair = std::make_pair(pair.second.get(), pair.second->allocate_slot());
-        index_data_slots_.insert(std::make_pair(index_data->uuid(), ipair));
-        return ipair;
-    } else {
-        /* Use one of the shared VBOs */
-        auto size = calc_vbo_slot_size(required_size);
-
-        auto idx = log2(int(size)) - 10; // Convert enum value to index
-        auto& entry = shared_index_vbos_[idx];
-        auto it = entry.find(index_type);
-        if(it == entry.end()) {
-            // Create new VBO
-            auto new_vbo = SharedVBO::create(size, index_type);
-            entry.insert(std::make_pair(index_type, new_vbo));
-            it = entry.find(index_type);
-        }
+    /* Respecifying the storage orphans the old one, so any draws which are
+     * still in flight are unaffected */
+    bind_buffer(state_, target_, gl_id_);
+    GLCheck(glBufferData, target_, frame_size_ * VBO_RING_FRAME_COUNT, nullptr, GL_STREAM_DRAW);
+
+    ++generation_;
+    cursor_ = 0;
+}
 
-        connect_destruction_signal(index_data);
+uint32_t VBORing::write(const void* data, uint32_t size) {
+    auto aligned_size = (size + VBO_ALIGNMENT - 1) & ~(VBO_ALIGNMENT - 1);
 
-        VBO* vbo = it->second.get();
-        auto ipair = std::make_pair(vbo, vbo->allocate_slot());
-        index_data_slots_.insert(std::make_pair(index_data->uuid(), ipair));
-        return ipair;
+    if(!gl_id_ || cursor_ + aligned_size > frame_size_) {
+        auto new_size = frame_size_;
+        while(cursor_ + aligned_size > new_size) {
+            new_size *= 2;
+        }
+
+        reallocate(new_size);
     }
+
+    auto offset = uint32_t(frame_ % VBO_RING_FRAME_COUNT) * frame_size_ + cursor_;
+    cursor_ += aligned_size;
+
+    bind_buffer(state_, target_, gl_id_);
+    GLCheck(glBufferSubData, target_, offset, size, data);
+
+    return offset;
 }
 
-void VBOManager::disconnect_destruction_signal(const VertexData *vertex_data) {
-    auto it = vdata_destruction_connections_.find(vertex_data->uuid());
-    if(it != vdata_destruction_connections_.end()) {
-        it->second.disconnect();
-        vdata_destruction_connections_.erase(it);
-    }
+VBOManager::VBOManager(GLStateCache* state):
+    vertex_arena_(GL_ARRAY_BUFFER),
+    index_arena_(GL_ELEMENT_ARRAY_BUFFER),
+    vertex_ring_(GL_ARRAY_BUFFER),
+    index_ring_(GL_ELEMENT_ARRAY_BUFFER),
+    instance_ring_(GL_ARRAY_BUFFER, VBO_INSTANCE_RING_INITIAL_FRAME_SIZE) {
+
+    vertex_arena_.set_state_cache(state);
+    index_arena_.set_state_cache(state);
+    vertex_ring_.set_state_cache(state);
+    index_ring_.set_state_cache(state);
+    instance_ring_.set_state_cache(state);
 }
 
-void VBOManager::disconnect_destruction_signal(const IndexData *index_data) {
-    auto it = idata_destruction_connections_.find(index_data->uuid());
-    if(it != idata_destruction_connections_.end()) {
-        it->second.disconnect();
-        idata_destruction_connections_.erase(it);
+VBOManager::~VBOManager() {
+    for(auto& pair: vertex_entries_) {
+        pair.second.destruction_connection.disconnect();
     }
-}
 
-void VBOManager::connect_destruction_signal(const VertexData* vdata) {
-    auto uuid = vdata->uuid();
-    auto existing = vdata_destruction_connections_.find(uuid);
-    if(existing != vdata_destruction_connections_.end()) {
-        existing->second.disconnect();
-        vdata_destruction_connections_.erase(existing);
+    for(auto& pair: index_entries_) {
+        pair.second.destruction_connection.disconnect();
     }
+}
+
+void VBOManager::begin_frame() {
+    ++frame_;
+
+    bytes_uploaded_last_frame_ = bytes_uploaded_;
+    bytes_uploaded_ = 0;
 
-    vdata_destruction_connections_.insert(std::make_pair(
-        uuid,
-        vdata->signal_destruction().connect(
-            std::bind(&VBOManager::on_vertex_data_destroyed, this, std::placeholders::_1)
-        )
-    ));
+    vertex_ring_.begin_frame();
+    index_ring_.begin_frame();
+    instance_ring_.begin_frame();
 }
 
-void VBOManager::connect_destruction_signal(const IndexData* vdata) {
-    auto uuid = vdata->uuid();
-    auto existing = idata_destruction_connections_.find(uuid);
-    if(existing != idata_destruction_connections_.end()) {
-        existing->second.disconnect();
-        idata_destruction_connections_.erase(existing);
+std::pair<GLuint, uint32_t> VBOManager::stream_instance_data(const void* data, uint32_t size) {
+    auto offset = instance_ring_.write(data, size);
+    bytes_uploaded_ += size;
+    return std::make_pair(instance_ring_.gl_id(), offset);
+}
+
+template<typename Data>
+std::pair<GLuint, uint32_t> VBOManager::perform_fetch_or_upload(const Data* data, VBOArena& arena, VBORing& ring, EntryMap& entries) {
+    auto it = entries.find(data->uuid());
+    if(it == entries.end()) {
+        it = entries.insert(std::make_pair(data->uuid(), Entry())).first;
+        it->second.destruction_connection = connect_destruction_signal(data);
     }
 
-    idata_destruction_connections_.insert(std::make_pair(
-        uuid,
-        vdata->signal_destruction().connect(
-            std::bind(&VBOManager::on_index_data_destroyed, this, std::placeholders::_1)
-        )
-    ));
-}
+    auto& entry = it->second;
+    const uint32_t size = data->data_size();
 
-VBOSlot SharedVBO::allocate_slot() {
-    if(!free_slots_.empty()) {
-        VBOSlot slot = free_slots_.front();
-        free_slots_.pop();
+    bool changed = !entry.uploaded || entry.uploaded_version != data->last_updated();
 
-        L_DEBUG_VBO(_F("Grabbed existing free slot {0}").format(slot));
-        return slot;
-    } else {
-        // Allocate a new GL buffer
-        // which creates new free slots
-        allocate_new_gl_buffer();
+    if(changed && entry.uploaded) {
+        /* Track how often this data changes, data which changes every frame
+         * is better off in the ring than being re-uploaded into an arena */
+        entry.consecutive_changes = (entry.last_change_frame + 1 >= frame_) ? entry.consecutive_changes + 1 : 1;
+        entry.last_change_frame = frame_;
+
+        if(!entry.streaming && entry.consecutive_changes >= VBO_STREAMING_PROMOTION_FRAMES) {
+            L_DEBUG_VBO(_F("Moving {0} to the streaming buffer").format(data->uuid()));
 
-        // Recurse
-        return allocate_slot();
+            arena.release(entry.allocation);
+            entry.allocation = VBOAllocation();
+            entry.streaming = true;
+        }
+    } else if(!entry.uploaded) {
+        entry.last_change_frame = frame_;
     }
-}
 
-void SharedVBO::release_slot(VBOSlot slot) {
-    L_DEBUG_VBO(_F("Releasing slot {0}").format(slot));
-    free_slots_.push(slot);
-}
+    if(entry.streaming && !changed && frame_ - entry.last_change_frame >= VBO_STREAMING_DEMOTION_FRAMES) {
+        L_DEBUG_VBO(_F("Moving {0} out of the streaming buffer").format(data->uuid()));
 
-void SharedVBO::upload(VBOSlot slot, const VertexData *vertex_data) {
-    const int SLOTS_PER_BUFFER = (VBO_SIZE / slot_size_in_bytes_);
-    uint32_t offset = (slot % SLOTS_PER_BUFFER) * slot_size_in_bytes_;
+        entry.streaming = false;
+        entry.consecutive_changes = 0;
+        changed = true;
+    }
 
-    bind(slot);
-    GLCheck(glBufferSubData, type_, offset, vertex_data->data_size(), vertex_data->data());
+    entry.uploaded = true;
+    entry.uploaded_version = data->last_updated();
+
+    if(entry.streaming) {
+        /* The ring is overwritten every few frames, so even unchanged data
+         * needs writing again once its copy has been recycled */
+        if(changed || !ring.is_intact(entry.ring_frame, entry.ring_generation)) {
+            entry.ring_offset = ring.write(data->data(), size);
+            entry.ring_frame = ring.frame();
+            entry.ring_generation = ring.generation();
+            bytes_uploaded_ += size;
+        }
 
-    metas_[slot].last_updated = TimeKeeper::now_in_us();
-}
+        return std::make_pair(ring.gl_id(), entry.ring_offset);
+    }
 
-void SharedVBO::upload(VBOSlot slot, const IndexData *index_data) {
-    const int SLOTS_PER_BUFFER = (VBO_SIZE / slot_size_in_bytes_);
-    uint32_t offset = (slot % SLOTS_PER_BUFFER) * slot_size_in_bytes_;
+    /* Reallocate if the data no longer fits, or if it's shrunk enough that
+     * we're wasting most of the range */
+    bool reallocate = !entry.allocation.is_valid() || size > entry.allocation.size || (
+        changed && size * 2 < entry.allocation.size && entry.allocation.size > VBO_ALIGNMENT
+    );
 
-    bind(slot);
+    if(reallocate) {
+        if(entry.allocation.is_valid()) {
+            arena.release(entry.allocation);
+        }
 
-    GLCheck(glBufferSubData, type_, offset, index_data->data_size(), index_data->data());
+        entry.allocation = arena.allocate(size);
+        changed = true;
+    }
 
-    metas_[slot].last_updated = TimeKeeper::now_in_us();
+    if(changed) {
+        arena.upload(entry.allocation, data->data(), size);
+        bytes_uploaded_ += size;
+    }
+
+    return std::make_pair(arena.gl_id(entry.allocation), entry.allocation.offset);
 }
 
-void SharedVBO::bind(VBOSlot slot) {
-    const int SLOTS_PER_BUFFER = (VBO_SIZE / slot_size_in_bytes_);
-    GLuint vbo_id = gl_ids_[slot / SLOTS_PER_BUFFER];
+template<typename Data>
+void VBOManager::release(const Data* data, VBOArena& arena, EntryMap& entries) {
+    auto it = entries.find(data->uuid());
+    if(it == entries.end()) {
+        return;
+    }
 
-    GLCheck(glBindBuffer, type_, vbo_id);
-}
+    if(it->second.allocation.is_valid()) {
+        arena.release(it->second.allocation);
+    }
 
-void DedicatedVBO::upload(VBOSlot, const VertexData* vertex_data) {
-    bind(0);
-    GLCheck(glBufferData, type_, vertex_data->data_size(), vertex_data->data(), GL_STATIC_DRAW);
-    last_updated_ = TimeKeeper::now_in_us();
+    it->second.destruction_connection.disconnect();
+    entries.erase(it);
 }
 
-void DedicatedVBO::upload(VBOSlot, const IndexData* index_data) {
-    bind(0);
-    GLCheck(glBufferData, type_, index_data->data_size(), index_data->data(), GL_STATIC_DRAW);
-    last_updated_ = TimeKeeper::now_in_us();
-}
+GPUBuffer VBOManager::update_and_fetch_buffers(const Renderable *renderable) {
+    auto vpair = perform_fetch_or_upload(renderable->vertex_data, vertex_arena_, vertex_ring_, vertex_entries_);
+    auto ipair = perform_fetch_or_upload(renderable->index_data, index_arena_, index_ring_, index_entries_);
 
-void DedicatedVBO::bind(VBOSlot) {
-    if(!gl_id_) {
-        GLCheck(glGenBuffers, 1, &gl_id_);
+    GPUBuffer buffer;
+    buffer.vertex_vbo = vpair.first;
+    buffer.vertex_offset = vpair.second;
+    buffer.index_vbo = ipair.first;
+    buffer.index_offset = ipair.second;
+
+    /* Keyframes don't change once they're built, so both sides of a morph
+     * end up in the arenas and are only ever uploaded once */
+    if(renderable->morph_target) {
+        auto mpair = perform_fetch_or_upload(renderable->morph_target, vertex_arena_, vertex_ring_, vertex_entries_);
+        buffer.morph_vbo = mpair.first;
+        buffer.morph_offset = mpair.second;
     }
 
-    GLCheck(glBindBuffer, type_, gl_id_);
-}
+    /* Likewise the joint weights, and the bind pose they skin */
+    if(renderable->skin_data) {
+        auto spair = perform_fetch_or_upload(renderable->skin_data, vertex_arena_, vertex_ring_, vertex_entries_);
+        buffer.skin_vbo = spair.first;
+        buffer.skin_offset = spair.second;
+    }
 
-VBOSlot DedicatedVBO::allocate_slot() {
-    assert(!allocated_);
-    allocated_ = true;
-    return 0;
+    return buffer;
 }
 
-void DedicatedVBO::release_slot(VBOSlot slot) {
-    assert(slot == 0);
-    assert(allocated_);
-    allocated_ = false;
-
-    // FIXME? Should we delete the GL buffer here?
+uint32_t VBOManager::buffer_count() const {
+    return vertex_arena_.buffer_count() + index_arena_.buffer_count() +
+        ((vertex_ring_.gl_id()) ? 1 : 0) + ((index_ring_.gl_id()) ? 1 : 0) +
+        ((instance_ring_.gl_id()) ? 1 : 0);
 }
 
-void SharedVBO::allocate_new_gl_buffer() {
-    /* Create a new GL VBO, then push back the
-         * free slot IDS */
+uint32_t VBOManager::dedicated_buffer_count() const {
+    return vertex_arena_.dedicated_buffer_count() + index_arena_.dedicated_buffer_count();
+}
 
-    L_DEBUG_VBO(_F("Allocating new GL buffer for target {0}").format(type_));
+float VBOManager::fragmentation() const {
+    /* Weight each arena by how much free space it has */
+    auto vfree = vertex_arena_.free_bytes();
+    auto ifree = index_arena_.free_bytes();
 
-    GLuint buffer;
+    if(!vfree && !ifree) {
+        return 0.0f;
+    }
 
-    GLCheck(glGenBuffers, 1, &buffer);
-    GLCheck(glBindBuffer, type_, buffer);
+    return (
+        vertex_arena_.fragmentation() * float(vfree) +
+        index_arena_.fragmentation() * float(ifree)
+    ) / float(vfree + ifree);
+}
 
-    // Upload VBO_SIZE of zeros so we an use buffersubdata afterwards
-    std::vector<uint8_t> init_data(VBO_SIZE, 0);
+bool VBOManager::is_streaming(const VertexData* vertex_data) const {
+    auto it = vertex_entries_.find(vertex_data->uuid());
+    return it != vertex_entries_.end() && it->second.streaming;
+}
 
-    /* FIXME: usage needs to change based on, well usage */
-    GLCheck(glBufferData, type_, VBO_SIZE, &init_data[0], GL_DYNAMIC_DRAW);
+bool VBOManager::is_streaming(const IndexData* index_data) const {
+    auto it = index_entries_.find(index_data->uuid());
+    return it != index_entries_.end() && it->second.streaming;
+}
 
-    const auto slots_per_buffer = VBO_SIZE / slot_size_;
+sig::connection VBOManager::connect_destruction_signal(const VertexData* vertex_data) {
+    return vertex_data->signal_destruction().connect(
+        std::bind(&VBOManager::on_vertex_data_destroyed, this, std::placeholders::_1)
+    );
+}
 
-    /* Push new meta data for each slot */
-    metas_.resize((gl_ids_.size() + 1) * slots_per_buffer);
+sig::connection VBOManager::connect_destruction_signal(const IndexData* index_data) {
+    return index_data->signal_destruction().connect(
+        std::bind(&VBOManager::on_index_data_destroyed, this, std::placeholders::_1)
+    );
+}
 
-    /* Push new free slots */
-    auto offset = gl_ids_.size() * slots_per_buffer;
-    for(VBOSlot i = 0; i < slots_per_buffer; ++i) {
-        free_slots_.push(offset + i);
-    }
+void VBOManager::on_vertex_data_destroyed(VertexData* vertex_data) {
+    release(vertex_data, vertex_arena_, vertex_entries_);
+}
 
-    /* Store the new VBO ID */
-    gl_ids_.push_back(buffer);
+void VBOManager::on_index_data_destroyed(IndexData* index_data) {
+    release(index_data, index_arena_, index_entries_);
 }
 
 }
@@ -1,16 +1,17 @@
 #pragma once
 
 #include <cstdint>
-#include <array>
+#include <memory>
 #include <unordered_map>
-#include <queue>
+#include <vector>
 
 #include "../../meshes/mesh.h"
 #include "../../generic/managed.h"
-#include "../../time_keeper.h"
 #include "../glad/glad/glad.h"
 #include "../../utils/gl_error.h"
 #include "../batching/renderable.h"
+#include "../buffer_allocator.h"
+#include "gl_state_cache.h"
 
 #include "../../logging.h"
 
@@ -23,237 +24,228 @@
 
 namespace smlt {
 
-/* The size of VBO to allocate */
-const uint32_t VBO_SIZE = 1024 * 512;
+/* Static data is sub-allocated from arena buffers of this size, anything
+ * bigger gets a buffer of its own */
+const uint32_t VBO_ARENA_BUFFER_SIZE = 1024 * 1024 * 4;
 
-typedef uint32_t VBOSlot;
+/* Offsets into buffers are aligned to this, which covers any index type
+ * and any vertex attribute */
+const uint32_t VBO_ALIGNMENT = 16;
 
-class VBO;
+/* The streaming ring is split into a region per frame. The GPU may still be
+ * reading from the previous frames' regions, so they aren't written again
+ * until they come back around */
+const uint32_t VBO_RING_FRAME_COUNT = 3;
+const uint32_t VBO_RING_INITIAL_FRAME_SIZE = 1024 * 256;
+
+/* Data which is re-uploaded this many frames in a row is moved to the
+ * streaming ring, and data which hasn't changed for VBO_STREAMING_DEMOTION_FRAMES
+ * is moved back to an arena */
+const uint32_t VBO_STREAMING_PROMOTION_FRAMES = 2;
+const uint32_t VBO_STREAMING_DEMOTION_FRAMES = 60;
+
+/* Per-instance transforms get a ring of their own, so that growing it can't
+ * orphan vertex data which is already bound for the current draw */
+const uint32_t VBO_INSTANCE_RING_INITIAL_FRAME_SIZE = 1024 * 64;
 
 struct GPUBuffer {
-    /* Slot into the VBO */
-    VBO* vertex_vbo;
-    VBO* index_vbo;
+    GLuint vertex_vbo = 0;
+    GLuint index_vbo = 0;
 
-    VBOSlot vertex_vbo_slot;
-    VBOSlot index_vbo_slot;
+    /* Byte offsets of the data within the buffers */
+    uint32_t vertex_offset = 0;
+    uint32_t index_offset = 0;
 
-    void sync_data_from_renderable(Renderable* renderable);
-    void bind_vbos();
-};
+    /* The renderable's morph target, if it has one */
+    GLuint morph_vbo = 0;
+    uint32_t morph_offset = 0;
 
-enum VBOSlotSize {
-    VBO_SLOT_SIZE_1K = (1 << 10),
-    VBO_SLOT_SIZE_2K = (1 << 11),
-    VBO_SLOT_SIZE_4K = (1 << 12),
-    VBO_SLOT_SIZE_8K = (1 << 13),
-    VBO_SLOT_SIZE_16K = (1 << 14),
-    VBO_SLOT_SIZE_32K = (1 << 15),
-    VBO_SLOT_SIZE_64K = (1 << 16),
-    VBO_SLOT_SIZE_128K = (1 << 17),
-    VBO_SLOT_SIZE_256K = (1 << 18),
-    VBO_SLOT_SIZE_512K = (1 << 19)
+    /* The renderable's joint indices and weights, if it's skinned */
+    GLuint skin_vbo = 0;
+    uint32_t skin_offset = 0;
+
+    void bind_vbos(GLStateCache* state=nullptr);
 };
 
-const int VBO_SLOT_SIZE_COUNT = 11;
+struct VBOAllocation {
+    uint32_t buffer = ~0u;
+    BufferAllocator::Handle handle = BufferAllocator::INVALID_HANDLE;
+    uint32_t offset = 0;
+    uint32_t size = 0;
 
-class VBO {
+    bool is_valid() const { return buffer != ~0u; }
+};
+
+/*
+ * A set of GL buffers of a single target which static data is sub-allocated
+ * from. Ranges are handed out by a BufferAllocator per buffer, new buffers
+ * are created when none of the existing ones have room.
+ */
+class VBOArena {
 public:
-    virtual ~VBO() {}
+    VBOArena(GLenum target, uint32_t buffer_size=VBO_ARENA_BUFFER_SIZE);
+    ~VBOArena();
 
-    virtual GLenum target() const = 0;
-    virtual void upload(VBOSlot, const VertexData* vertex_data) = 0;
-    virtual void upload(VBOSlot, const IndexData* index_data) = 0;
-    virtual void bind(VBOSlot) = 0;
-    virtual uint64_t slot_last_updated(VBOSlot slot) = 0;
-    virtual uint32_t byte_offset(VBOSlot slot) = 0;
-    virtual uint32_t slot_size_in_bytes() const = 0;
+    VBOArena(const VBOArena&) = delete;
+    VBOArena& operator=(const VBOArena&) = delete;
 
-    virtual VBOSlot allocate_slot() = 0;
-    virtual void release_slot(VBOSlot slot) = 0;
+    GLenum target() const { return target_; }
 
-    virtual uint32_t used_slot_count() const = 0;
-    virtual uint32_t free_slot_count() const = 0;
-};
+    /* Buffer binds and deletes go through this if set */
+    void set_state_cache(GLStateCache* state) { state_ = state; }
 
-class DedicatedVBO:
-    public RefCounted<DedicatedVBO>,
-    public VBO {
+    VBOAllocation allocate(uint32_t size);
+    void release(const VBOAllocation& allocation);
 
-public:
-    DedicatedVBO(uint32_t size, VertexSpecification spec):
-        size_in_bytes_(size),
-        spec_(spec),
-        type_(GL_ARRAY_BUFFER) {}
-
-    DedicatedVBO(uint32_t size, IndexType index_type):
-        size_in_bytes_(size),
-        index_type_(index_type),
-        type_(GL_ELEMENT_ARRAY_BUFFER) {}
-
-    ~DedicatedVBO() {
-        try {
-            if(gl_id_) glDeleteBuffers(1, &gl_id_);
-        } catch(...) {
-            S_WARN("Exception while deleting GL VBO");
-        }
+    void upload(const VBOAllocation& allocation, const void* data, uint32_t size);
+    GLuint gl_id(const VBOAllocation& allocation) const {
+        return buffers_[allocation.buffer].gl_id;
     }
 
-    uint64_t slot_last_updated(VBOSlot slot) { assert(slot == 0); return last_updated_; }
-    GLenum target() const { return type_; }
+    uint32_t buffer_count() const;
+    uint32_t dedicated_buffer_count() const;
 
-    void upload(VBOSlot, const VertexData* vertex_data);
-    void upload(VBOSlot, const IndexData* index_data);
-    void bind(VBOSlot);
+    uint64_t used_bytes() const;
+    uint64_t free_bytes() const;
 
-    uint32_t byte_offset(VBOSlot slot) {
-        assert(slot == 0);
-        return 0;
-    }
+    /* Fragmentation of the shared buffers' free space, 0.0 - 1.0 */
+    float fragmentation() const;
 
-    uint32_t slot_size_in_bytes() const {
-        return size_in_bytes_;
-    }
+private:
+    struct Buffer {
+        GLuint gl_id = 0;
 
-    VBOSlot allocate_slot();
-    void release_slot(VBOSlot slot);
+        /* Null for dedicated buffers */
+        std::unique_ptr<BufferAllocator> allocator;
+        uint32_t size = 0;
+    };
 
-    uint32_t used_slot_count() const {
-        return (allocated_) ? 1 : 0;
-    }
+    uint32_t new_buffer(uint32_t size, bool dedicated);
+    void delete_buffer(uint32_t index);
 
-    uint32_t free_slot_count() const {
-        return (allocated_) ? 0 : 1;
-    }
-private:
-    uint32_t size_in_bytes_;
-    VertexSpecification spec_;
-    IndexType index_type_;
-    GLenum type_;
+    GLenum target_;
+    uint32_t buffer_size_;
+    GLStateCache* state_ = nullptr;
 
-    uint64_t last_updated_ = 0;
-    bool allocated_ = false;
-    GLuint gl_id_ = 0;
+    std::vector<Buffer> buffers_;
+    std::vector<uint32_t> unused_buffers_;
 };
 
-class SharedVBO:
-    public RefCounted<SharedVBO>,
-    public VBO {
-
+/*
+ * A single GL buffer which is written linearly each frame, for data which
+ * changes every frame (particles, UI, animated meshes). Writing into a region
+ * the GPU has finished with avoids stalling on buffers which are in flight.
+ */
+class VBORing {
 public:
-    SharedVBO(VBOSlotSize slot_size, VertexSpecification spec):
-        slot_size_(slot_size),
-        slot_size_in_bytes_(int(slot_size)),
-        spec_(spec),
-        type_(GL_ARRAY_BUFFER) {}
-
-    SharedVBO(VBOSlotSize slot_size, IndexType type):
-        slot_size_(slot_size),
-        slot_size_in_bytes_(int(slot_size)),
-        index_type_(type),
-        type_(GL_ELEMENT_ARRAY_BUFFER) {}
-
-    uint64_t slot_last_updated(VBOSlot slot) {
-        assert(slot < metas_.size());
-        return metas_[slot].last_updated;
-    }
+    VBORing(GLenum target, uint32_t frame_size=VBO_RING_INITIAL_FRAME_SIZE);
+    ~VBORing();
 
-    GLenum target() const { return type_; }
+    VBORing(const VBORing&) = delete;
+    VBORing& operator=(const VBORing&) = delete;
 
-    VBOSlot allocate_slot();
+    void set_state_cache(GLStateCache* state) { state_ = state; }
 
-    void release_slot(VBOSlot slot);
+    void begin_frame();
 
-    void upload(VBOSlot slot, const VertexData* vertex_data);
-    void upload(VBOSlot slot, const IndexData* index_data);
-    void bind(VBOSlot slot);
+    /* Copies the data into this frame's region and returns its offset */
+    uint32_t write(const void* data, uint32_t size);
 
-    VBOSlotSize slot_size() const { return slot_size_; }
-    uint32_t slot_size_in_bytes() const { return int(slot_size_); }
+    GLuint gl_id() const { return gl_id_; }
+    uint64_t frame() const { return frame_; }
 
-    uint32_t byte_offset(VBOSlot slot) {
-        const int SLOTS_PER_BUFFER = (VBO_SIZE / slot_size_in_bytes_);
-        return (slot % SLOTS_PER_BUFFER) * slot_size_in_bytes_;
+    /* Whether data written during written_frame is still intact */
+    bool is_intact(uint64_t written_frame, uint32_t generation) const {
+        return generation == generation_ && frame_ - written_frame < VBO_RING_FRAME_COUNT;
     }
 
-    uint32_t used_slot_count() const {
-        return metas_.size() - free_slots_.size();
-    }
-
-    uint32_t free_slot_count() const {
-        return free_slots_.size();
-    }
+    /* Bumped whenever the buffer is reallocated, which loses everything
+     * that was previously written */
+    uint32_t generation() const { return generation_; }
+    uint32_t frame_size() const { return frame_size_; }
 
 private:
-    void allocate_new_gl_buffer();
-
-    VBOSlotSize slot_size_;
-    uint32_t slot_size_in_bytes_;
+    void reallocate(uint32_t frame_size);
 
-    VertexSpecification spec_;
-    IndexType index_type_;
-    GLenum type_;
-    std::queue<VBOSlot> free_slots_;
-    std::vector<GLuint> gl_ids_;
-
-    struct SlotMeta {
-        uint64_t last_updated = 0;
-        uint32_t uploaded_size = 0;
-    };
+    GLenum target_;
+    GLuint gl_id_ = 0;
+    GLStateCache* state_ = nullptr;
 
-    std::vector<SlotMeta> metas_;
+    uint32_t frame_size_ = 0;
+    uint32_t cursor_ = 0;
+    uint32_t generation_ = 0;
+    uint64_t frame_ = 0;
 };
 
 class VBOManager : public RefCounted<VBOManager> {
 public:
+    /* If a state cache is given all buffer binds are made through it */
+    VBOManager(GLStateCache* state=nullptr);
     virtual ~VBOManager();
+
     GPUBuffer update_and_fetch_buffers(const Renderable* renderable);
 
+    /* Must be called once per frame before rendering, this moves the
+     * streaming rings on to the next region */
+    void begin_frame();
+
+    /* Copies per-instance attributes into this frame's instance ring,
+     * returns the buffer and offset to point the attributes at */
+    std::pair<GLuint, uint32_t> stream_instance_data(const void* data, uint32_t size);
+
+    uint32_t buffer_count() const;
     uint32_t dedicated_buffer_count() const;
+    uint64_t bytes_uploaded_last_frame() const { return bytes_uploaded_last_frame_; }
+    float fragmentation() const;
 
 private:
-    VBOSlotSize calc_vbo_slot_size(uint32_t required_size_in_bytes);
+    struct Entry {
+        bool uploaded = false;
+        bool streaming = false;
+        VBOAllocation allocation;
 
-    std::pair<VBO*, VBOSlot> allocate_slot(const VertexData* vertex_data);
-    std::pair<VBO*, VBOSlot> allocate_slot(const IndexData* index_data);
+        uint64_t uploaded_version = 0;
+        uint64_t last_change_frame = 0;
+        uint32_t consecutive_changes = 0;
 
-    void release_slot(const VertexData* vertex_data);
-    void release_slot(const IndexData* index_data);
+        /* Where the data was last written to the ring, if streaming */
+        uint32_t ring_offset = 0;
+        uint64_t ring_frame = 0;
+        uint32_t ring_generation = 0;
 
-    /* Buffers for renderables which aren't dynamic and are less than 512k */
-    std::array<
-        std::unordered_map<VertexSpecification, SharedVBO::ptr>,
-        VBO_SLOT_SIZE_COUNT
-    > shared_vertex_vbos_;
+        sig::connection destruction_connection;
+    };
 
-    std::array<
-        std::unordered_map<IndexType, SharedVBO::ptr>,
-        VBO_SLOT_SIZE_COUNT
-    > shared_index_vbos_;
+    typedef std::unordered_map<uuid64, Entry> EntryMap;
 
-    typedef std::unordered_map<uuid64, DedicatedVBO::ptr> DedicatedMap;
-    typedef std::unordered_map<uuid64, std::pair<VBO*, VBOSlot>> SlotMap;
+    bool is_streaming(const VertexData* vertex_data) const;
+    bool is_streaming(const IndexData* index_data) const;
 
-    DedicatedMap dedicated_vertex_vbos_;
-    DedicatedMap dedicated_index_vbos_;
+    sig::connection connect_destruction_signal(const VertexData* vertex_data);
+    sig::connection connect_destruction_signal(const IndexData* index_data);
 
-    SlotMap vertex_data_slots_;
-    SlotMap index_data_slots_;
+    void on_vertex_data_destroyed(VertexData* vertex_data);
+    void on_index_data_destroyed(IndexData* index_data);
 
-    std::unordered_map<uuid64, sig::connection> vdata_destruction_connections_;
-    std::unordered_map<uuid64, sig::connection> idata_destruction_connections_;
+    template<typename Data>
+    std::pair<GLuint, uint32_t> perform_fetch_or_upload(const Data* data, VBOArena& arena, VBORing& ring, EntryMap& entries);
 
-    void connect_destruction_signal(const VertexData *vertex_data);
-    void connect_destruction_signal(const IndexData *vertex_data);
-    void disconnect_destruction_signal(const VertexData *vertex_data);
-    void disconnect_destruction_signal(const IndexData *vertex_data);
+    template<typename Data>
+    void release(const Data* data, VBOArena& arena, EntryMap& entries);
 
-    void on_vertex_data_destroyed(VertexData* vertex_data);
-    void on_index_data_destroyed(IndexData* vertex_data);
+    VBOArena vertex_arena_;
+    VBOArena index_arena_;
 
-    template<typename Data>
-    std::pair<VBO*, VBOSlot> perform_fetch_or_upload(const Data*, VBOManager::DedicatedMap&, VBOManager::SlotMap&);
+    VBORing vertex_ring_;
+    VBORing index_ring_;
+    VBORing instance_ring_;
+
+    EntryMap vertex_entries_;
+    EntryMap index_entries_;
 
+    uint64_t frame_ = 0;
+    uint64_t bytes_uploaded_ = 0;
+    uint64_t bytes_uploaded_last_frame_ = 0;
 };
 
 }
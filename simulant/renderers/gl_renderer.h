@@ -21,6 +21,35 @@ constexpr const char* const PROJECTION_MATRIX_PROPERTY = "s_projection";
 constexpr const char* const MODELVIEW_MATRIX_PROPERTY = "s_modelview";
 constexpr const char* const INVERSE_TRANSPOSE_MODELVIEW_MATRIX_PROPERTY = "s_inverse_transpose_modelview";
 
+/* Shaders which declare this mat4 attribute receive the model matrix per
+ * instance, and repeated meshes are drawn with a single instanced call */
+constexpr const char* const INSTANCE_MODEL_MATRIX_ATTRIBUTE = "s_instance_model";
+
+/* Shaders which declare the morph position attribute (and optionally the
+ * normal) can animate keyframed meshes on the GPU. The output should be
+ * mix(s_position, s_morph_position, s_morph_weight), the weight is 0.0 for
+ * anything which isn't morphing */
+constexpr const char* const MORPH_POSITION_ATTRIBUTE = "s_morph_position";
+constexpr const char* const MORPH_NORMAL_ATTRIBUTE = "s_morph_normal";
+constexpr const char* const MORPH_WEIGHT_PROPERTY = "s_morph_weight";
+
+/* Shaders which declare the joint indices attribute can skin skeletal
+ * meshes on the GPU, with the joint weights attribute and a mat4 array of
+ * joint matrices. Rigs with more joints than the shader's array holds are
+ * skinned on the CPU instead.
+ *
+ * The weights of a skinned vertex sum to one. For anything which isn't
+ * skinned the indices and weights are all zero, which plain linear blend
+ * skinning would collapse to the origin. Shaders must give whatever weight
+ * is missing to the identity, e.g.
+ *
+ *     skin += mat4(1.0) * (1.0 - dot(s_joint_weights, vec4(1.0)));
+ *
+ * The built-in lit_textured.vert is the reference. */
+constexpr const char* const JOINT_INDICES_ATTRIBUTE = "s_joint_indices";
+constexpr const char* const JOINT_WEIGHTS_ATTRIBUTE = "s_joint_weights";
+constexpr const char* const JOINT_PALETTE_PROPERTY = "s_joint_palette";
+
 #ifdef __DREAMCAST__
 // The Dreamcast only supports 2 multitexture units
 #define _S_GL_MAX_TEXTURE_UNITS 2
@@ -7,6 +7,8 @@
     APIs: gl=2.1
     Profile: compatibility
     Extensions:
+        GL_ARB_draw_instanced,
+        GL_ARB_instanced_arrays,
         GL_EXT_framebuffer_object,
         GL_EXT_paletted_texture,
         GL_EXT_shared_texture_palette
@@ -16,9 +18,9 @@
     Reproducible: False
 
     Commandline:
-        --profile="compatibility" --api="gl=2.1" --generator="c" --spec="gl" --omit-khrplatform --extensions="GL_EXT_framebuffer_object,GL_EXT_paletted_texture,GL_EXT_shared_texture_palette"
+        --profile="compatibility" --api="gl=2.1" --generator="c" --spec="gl" --omit-khrplatform --extensions="GL_ARB_draw_instanced,GL_ARB_instanced_arrays,GL_EXT_framebuffer_object,GL_EXT_paletted_texture,GL_EXT_shared_texture_palette"
     Online:
-        http://glad.dav1d.de/#profile=compatibility&language=c&specification=gl&loader=on&api=gl%3D2.1&extensions=GL_EXT_framebuffer_object&extensions=GL_EXT_paletted_texture&extensions=GL_EXT_shared_texture_palette
+        http://glad.dav1d.de/#profile=compatibility&language=c&specification=gl&loader=on&api=gl%3D2.1&extensions=GL_ARB_draw_instanced&extensions=GL_ARB_instanced_arrays&extensions=GL_EXT_framebuffer_object&extensions=GL_EXT_paletted_texture&extensions=GL_EXT_shared_texture_palette
 */
 
 #include <stdio.h>
@@ -813,9 +815,14 @@ PFNGLWINDOWPOS3IPROC glad_glWindowPos3i = NULL;
 PFNGLWINDOWPOS3IVPROC glad_glWindowPos3iv = NULL;
 PFNGLWINDOWPOS3SPROC glad_glWindowPos3s = NULL;
 PFNGLWINDOWPOS3SVPROC glad_glWindowPos3sv = NULL;
+int GLAD_GL_ARB_draw_instanced = 0;
+int GLAD_GL_ARB_instanced_arrays = 0;
 int GLAD_GL_EXT_framebuffer_object = 0;
 int GLAD_GL_EXT_paletted_texture = 0;
 int GLAD_GL_EXT_shared_texture_palette = 0;
+PFNGLDRAWARRAYSINSTANCEDARBPROC glad_glDrawArraysInstancedARB = NULL;
+PFNGLDRAWELEMENTSINSTANCEDARBPROC glad_glDrawElementsInstancedARB = NULL;
+PFNGLVERTEXATTRIBDIVISORARBPROC glad_glVertexAttribDivisorARB = NULL;
 PFNGLISRENDERBUFFEREXTPROC glad_glIsRenderbufferEXT = NULL;
 PFNGLBINDRENDERBUFFEREXTPROC glad_glBindRenderbufferEXT = NULL;
 PFNGLDELETERENDERBUFFERSEXTPROC glad_glDeleteRenderbuffersEXT = NULL;
@@ -1412,6 +1419,15 @@ static void load_GL_VERSION_2_1(GLADloadproc load) {
     glad_glUniformMatrix3x4fv = (PFNGLUNIFORMMATRIX3X4FVPROC)load("glUniformMatrix3x4fv");
     glad_glUniformMatrix4x3fv = (PFNGLUNIFORMMATRIX4X3FVPROC)load("glUniformMatrix4x3fv");
 }
+static void load_GL_ARB_draw_instanced(GLADloadproc load) {
+    if(!GLAD_GL_ARB_draw_instanced) return;
+    glad_glDrawArraysInstancedARB = (PFNGLDRAWARRAYSINSTANCEDARBPROC)load("glDrawArraysInstancedARB");
+    glad_glDrawElementsInstancedARB = (PFNGLDRAWELEMENTSINSTANCEDARBPROC)load("glDrawElementsInstancedARB");
+}
+static void load_GL_ARB_instanced_arrays(GLADloadproc load) {
+    if(!GLAD_GL_ARB_instanced_arrays) return;
+    glad_glVertexAttribDivisorARB = (PFNGLVERTEXATTRIBDIVISORARBPROC)load("glVertexAttribDivisorARB");
+}
 static void load_GL_EXT_framebuffer_object(GLADloadproc load) {
     if(!GLAD_GL_EXT_framebuffer_object) return;
     glad_glIsRenderbufferEXT = (PFNGLISRENDERBUFFEREXTPROC)load("glIsRenderbufferEXT");
@@ -1441,6 +1457,8 @@ static void load_GL_EXT_paletted_texture(GLADloadproc load) {
 }
 static int find_extensionsGL(void) {
     if (!get_exts()) return 0;
+    GLAD_GL_ARB_draw_instanced = has_ext("GL_ARB_draw_instanced");
+    GLAD_GL_ARB_instanced_arrays = has_ext("GL_ARB_instanced_arrays");
     GLAD_GL_EXT_framebuffer_object = has_ext("GL_EXT_framebuffer_object");
     GLAD_GL_EXT_paletted_texture = has_ext("GL_EXT_paletted_texture");
     GLAD_GL_EXT_shared_texture_palette = has_ext("GL_EXT_shared_texture_palette");
@@ -1514,6 +1532,8 @@ int gladLoadGLLoader(GLADloadproc load) {
     load_GL_VERSION_2_1(load);
 
     if (!find_extensionsGL()) return 0;
+    load_GL_ARB_draw_instanced(load);
+    load_GL_ARB_instanced_arrays(load);
     load_GL_EXT_framebuffer_object(load);
     load_GL_EXT_paletted_texture(load);
     return GLVersion.major != 0 || GLVersion.minor != 0;
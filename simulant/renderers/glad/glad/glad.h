@@ -7,6 +7,8 @@
     APIs: gl=2.1
     Profile: compatibility
     Extensions:
+        GL_ARB_draw_instanced,
+        GL_ARB_instanced_arrays,
         GL_EXT_framebuffer_object,
         GL_EXT_paletted_texture,
         GL_EXT_shared_texture_palette
@@ -16,9 +18,9 @@
     Reproducible: False
 
     Commandline:
-        --profile="compatibility" --api="gl=2.1" --generator="c" --spec="gl" --omit-khrplatform --extensions="GL_EXT_framebuffer_object,GL_EXT_paletted_texture,GL_EXT_shared_texture_palette"
+        --profile="compatibility" --api="gl=2.1" --generator="c" --spec="gl" --omit-khrplatform --extensions="GL_ARB_draw_instanced,GL_ARB_instanced_arrays,GL_EXT_framebuffer_object,GL_EXT_paletted_texture,GL_EXT_shared_texture_palette"
     Online:
-        http://glad.dav1d.de/#profile=compatibility&language=c&specification=gl&loader=on&api=gl%3D2.1&extensions=GL_EXT_framebuffer_object&extensions=GL_EXT_paletted_texture&extensions=GL_EXT_shared_texture_palette
+        http://glad.dav1d.de/#profile=compatibility&language=c&specification=gl&loader=on&api=gl%3D2.1&extensions=GL_ARB_draw_instanced&extensions=GL_ARB_instanced_arrays&extensions=GL_EXT_framebuffer_object&extensions=GL_EXT_paletted_texture&extensions=GL_EXT_shared_texture_palette
 */
 
 
@@ -2767,6 +2769,7 @@ typedef void (APIENTRYP PFNGLUNIFORMMATRIX4X3FVPROC)(GLint location, GLsizei cou
 GLAPI PFNGLUNIFORMMATRIX4X3FVPROC glad_glUniformMatrix4x3fv;
 #define glUniformMatrix4x3fv glad_glUniformMatrix4x3fv
 #endif
+#define GL_VERTEX_ATTRIB_ARRAY_DIVISOR_ARB 0x88FE
 #define GL_INVALID_FRAMEBUFFER_OPERATION_EXT 0x0506
 #define GL_MAX_RENDERBUFFER_SIZE_EXT 0x84E8
 #define GL_FRAMEBUFFER_BINDING_EXT 0x8CA6
@@ -2826,6 +2829,23 @@ GLAPI PFNGLUNIFORMMATRIX4X3FVPROC glad_glUniformMatrix4x3fv;
 #define GL_COLOR_INDEX16_EXT 0x80E7
 #define GL_TEXTURE_INDEX_SIZE_EXT 0x80ED
 #define GL_SHARED_TEXTURE_PALETTE_EXT 0x81FB
+#ifndef GL_ARB_draw_instanced
+#define GL_ARB_draw_instanced 1
+GLAPI int GLAD_GL_ARB_draw_instanced;
+typedef void (APIENTRYP PFNGLDRAWARRAYSINSTANCEDARBPROC)(GLenum mode, GLint first, GLsizei count, GLsizei primcount);
+GLAPI PFNGLDRAWARRAYSINSTANCEDARBPROC glad_glDrawArraysInstancedARB;
+#define glDrawArraysInstancedARB glad_glDrawArraysInstancedARB
+typedef void (APIENTRYP PFNGLDRAWELEMENTSINSTANCEDARBPROC)(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei primcount);
+GLAPI PFNGLDRAWELEMENTSINSTANCEDARBPROC glad_glDrawElementsInstancedARB;
+#define glDrawElementsInstancedARB glad_glDrawElementsInstancedARB
+#endif
+#ifndef GL_ARB_instanced_arrays
+#define GL_ARB_instanced_arrays 1
+GLAPI int GLAD_GL_ARB_instanced_arrays;
+typedef void (APIENTRYP PFNGLVERTEXATTRIBDIVISORARBPROC)(GLuint index, GLuint divisor);
+GLAPI PFNGLVERTEXATTRIBDIVISORARBPROC glad_glVertexAttribDivisorARB;
+#define glVertexAttribDivisorARB glad_glVertexAttribDivisorARB
+#endif
 #ifndef GL_EXT_framebuffer_object
 #define GL_EXT_framebuffer_object 1
 GLAPI int GLAD_GL_EXT_framebuffer_object;
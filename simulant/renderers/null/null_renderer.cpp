@@ -0,0 +1,128 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU Lesser General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU Lesser General Public License for more details.
+//
+//     You should have received a copy of the GNU Lesser General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+
+#include "null_renderer.h"
+#include "../../assets/material.h"
+#include "../../time_keeper.h"
+#include "../../window.h"
+
+namespace smlt {
+
+class NullRenderQueueVisitor : public batcher::RenderQueueVisitor {
+public:
+    NullRenderQueueVisitor(NullRenderer* renderer):
+        renderer_(renderer) {}
+
+    void start_traversal(const batcher::RenderQueue& queue, uint64_t frame_id, Stage* stage) override {
+        _S_UNUSED(queue);
+        _S_UNUSED(frame_id);
+        _S_UNUSED(stage);
+
+        started_ = TimeKeeper::now_in_us();
+        ++renderer_->stats_.traversals;
+    }
+
+    void change_render_group(const batcher::RenderGroup* prev, const batcher::RenderGroup* next) override {
+        _S_UNUSED(prev);
+        _S_UNUSED(next);
+
+        ++renderer_->stats_.render_group_changes;
+    }
+
+    void change_material_pass(const MaterialPass* prev, const MaterialPass* next) override {
+        _S_UNUSED(prev);
+        _S_UNUSED(next);
+
+        ++renderer_->stats_.material_pass_changes;
+    }
+
+    void apply_lights(const LightPtr* lights, const uint8_t count) override {
+        /* Only count changes, the same as a GL renderer would only
+         * upload lights which differ */
+        if(count == light_count_ && std::equal(lights, lights + count, lights_)) {
+            return;
+        }
+
+        std::copy(lights, lights + count, lights_);
+        light_count_ = count;
+        ++renderer_->stats_.light_changes;
+    }
+
+    void visit(const Renderable* renderable, const MaterialPass* pass, batcher::Iteration iteration) override {
+        _S_UNUSED(pass);
+        _S_UNUSED(iteration);
+
+        renderer_->prepare_to_render(renderable);
+
+        ++renderer_->stats_.draws;
+        renderer_->stats_.elements += renderable->index_element_count;
+
+        renderer_->window->stats->increment_polygons_rendered(
+            renderable->arrangement, renderable->index_element_count
+        );
+    }
+
+    void end_traversal(const batcher::RenderQueue& queue, Stage* stage) override {
+        _S_UNUSED(queue);
+        _S_UNUSED(stage);
+
+        renderer_->stats_.traversal_us += TimeKeeper::now_in_us() - started_;
+    }
+
+private:
+    NullRenderer* renderer_;
+    uint64_t started_ = 0;
+
+    LightPtr lights_[MAX_LIGHTS_PER_RENDERABLE];
+    uint8_t light_count_ = 0;
+};
+
+batcher::RenderGroupKey NullRenderer::prepare_render_group(
+    batcher::RenderGroup* group,
+    const Renderable *renderable,
+    const MaterialPass *material_pass,
+    const uint8_t pass_number,
+    const bool is_blended,
+    const float distance_to_camera) {
+
+    _S_UNUSED(renderable);
+    _S_UNUSED(group);
+
+    /* Same grouping as the GL1 renderer so that state change counts
+     * are comparable */
+    auto material = material_pass->material();
+    auto& texture = material_pass->diffuse_map();
+
+    return batcher::generate_render_group_key(
+        pass_number,
+        is_blended,
+        distance_to_camera,
+        (material) ? (uint16_t) material->id().value() : 0,
+        (texture) ? (uint16_t) texture->id().value() : 0
+    );
+}
+
+std::shared_ptr<batcher::RenderQueueVisitor> NullRenderer::get_render_queue_visitor(CameraPtr camera) {
+    _S_UNUSED(camera);
+    return std::make_shared<NullRenderQueueVisitor>(this);
+}
+
+}
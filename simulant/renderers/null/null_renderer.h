@@ -0,0 +1,97 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU Lesser General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU Lesser General Public License for more details.
+ *
+ *     You should have received a copy of the GNU Lesser General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../renderer.h"
+
+namespace smlt {
+
+const std::string NULL_RENDERER_NAME = "null";
+
+/* What the null renderer would have drawn, accumulated across traversals
+ * until reset_stats() is called */
+struct NullRenderStats {
+    uint32_t traversals = 0;
+    uint32_t draws = 0;
+    uint32_t render_group_changes = 0;
+    uint32_t material_pass_changes = 0;
+    uint32_t light_changes = 0;
+    uint64_t elements = 0;
+
+    /* Time spent inside RenderQueue::traverse(), excluding sorting */
+    uint64_t traversal_us = 0;
+};
+
+/*
+ * A renderer which never touches the GPU. Render queues are built, sorted
+ * and traversed as normal, but the visitor only counts what it would have
+ * submitted. This lets the CPU side of rendering be run (and benchmarked)
+ * on machines without a GL context, it's used with the HeadlessWindow.
+ */
+class NullRenderer:
+    public Renderer {
+
+public:
+    NullRenderer(Window* window):
+        Renderer(window) {}
+
+    batcher::RenderGroupKey prepare_render_group(
+        batcher::RenderGroup* group,
+        const Renderable *renderable,
+        const MaterialPass *material_pass,
+        const uint8_t pass_number,
+        const bool is_blended,
+        const float distance_to_camera
+    ) override;
+
+    std::shared_ptr<batcher::RenderQueueVisitor> get_render_queue_visitor(CameraPtr camera) override;
+
+    void init_context() override {}
+
+    std::string name() const override {
+        return NULL_RENDERER_NAME;
+    }
+
+    /* There are no shaders, so use the fixed-function built-in materials */
+    std::string material_directory() const override {
+        return "gl1x";
+    }
+
+    bool is_headless() const override { return true; }
+
+    void prepare_to_render(const Renderable* renderable) override {
+        _S_UNUSED(renderable);
+    }
+
+    const NullRenderStats& stats() const { return stats_; }
+    void reset_stats() { stats_ = NullRenderStats(); }
+
+    /* Every texture format is accepted, nothing is ever uploaded */
+    bool texture_format_is_native(TextureFormat fmt) override {
+        _S_UNUSED(fmt);
+        return true;
+    }
+
+private:
+    friend class NullRenderQueueVisitor;
+
+    NullRenderStats stats_;
+};
+
+}
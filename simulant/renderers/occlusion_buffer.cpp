@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "occlusion_buffer.h"
+#include "../math/vec4.h"
+#include "../meshes/mesh.h"
+#include "../math/simd.h"
+
+namespace smlt {
+
+using namespace simd;
+
+static const uint32_t ROW_ALIGNMENT = 16;
+
+/* Points closer to the eye than this (in clip space w) are treated as
+ * crossing the near plane */
+static const float NEAR_W_EPSILON = 1e-5f;
+
+std::shared_ptr<OccluderGeometry> OccluderGeometry::from_mesh(MeshPtr mesh) {
+    auto geometry = std::make_shared<OccluderGeometry>();
+    if(!mesh) {
+        return geometry;
+    }
+
+    auto vertices = mesh->vertex_data.get();
+    geometry->vertices.reserve(vertices->count());
+    for(uint32_t i = 0; i < vertices->count(); ++i) {
+        geometry->vertices.push_back(*vertices->position_at<Vec3>(i));
+    }
+
+    for(auto submesh: mesh->each_submesh()) {
+        submesh->each_triangle([&](uint32_t a, uint32_t b, uint32_t c) {
+            geometry->indices.push_back(a);
+            geometry->indices.push_back(b);
+            geometry->indices.push_back(c);
+        });
+    }
+
+    return geometry;
+}
+
+OcclusionBuffer::OcclusionBuffer(uint16_t width, uint16_t height):
+    width_(std::max<uint16_t>(OCCLUSION_TILE_SIZE, width & ~(OCCLUSION_TILE_SIZE - 1))),
+    height_(std::max<uint16_t>(OCCLUSION_TILE_SIZE, height & ~(OCCLUSION_TILE_SIZE - 1))),
+    tiles_x_(width_ / OCCLUSION_TILE_SIZE),
+    tiles_y_(height_ / OCCLUSION_TILE_SIZE) {
+
+}
+
+void OcclusionBuffer::begin(const Mat4& view_projection) {
+    view_projection_ = view_projection;
+    triangles_rasterized_ = 0;
+
+    /* Allocated lazily so that pipelines without occlusion culling don't
+     * pay for the buffer */
+    if(!depth_) {
+        storage_.resize((width_ * height_) + (ROW_ALIGNMENT / sizeof(float)));
+        depth_ = (float*) ((uintptr_t(storage_.data()) + (ROW_ALIGNMENT - 1)) & ~uintptr_t(ROW_ALIGNMENT - 1));
+        tiles_.resize(tiles_x_ * tiles_y_);
+    }
+
+    std::fill(depth_, depth_ + (width_ * height_), 1.0f);
+    std::fill(tiles_.begin(), tiles_.end(), 1.0f);
+}
+
+bool OcclusionBuffer::project(const Vec3& v, const Mat4& transform, ScreenVertex& out) const {
+    Vec4 clip = transform * Vec4(v, 1.0f);
+
+    /* Behind the eye, or in front of it but closer than the near plane */
+    if(clip.w < NEAR_W_EPSILON || clip.z < -clip.w) {
+        return false;
+    }
+
+    float inv_w = 1.0f / clip.w;
+    out.x = ((clip.x * inv_w) * 0.5f + 0.5f) * width_;
+    out.y = ((clip.y * inv_w) * 0.5f + 0.5f) * height_;
+    out.z = std::min((clip.z * inv_w) * 0.5f + 0.5f, 1.0f);
+    return true;
+}
+
+void OcclusionBuffer::rasterize(const Mat4& model, const OccluderGeometry& geometry) {
+    assert(depth_);
+
+    Mat4 transform = view_projection_ * model;
+
+    projected_.resize(geometry.vertices.size());
+    projected_valid_.resize(geometry.vertices.size());
+
+    for(std::size_t i = 0; i < geometry.vertices.size(); ++i) {
+        projected_valid_[i] = project(geometry.vertices[i], transform, projected_[i]);
+    }
+
+    for(std::size_t i = 0; i + 2 < geometry.indices.size(); i += 3) {
+        auto a = geometry.indices[i];
+        auto b = geometry.indices[i + 1];
+        auto c = geometry.indices[i + 2];
+
+        if(a >= projected_.size() || b >= projected_.size() || c >= projected_.size()) {
+            continue;
+        }
+
+        if(!projected_valid_[a] || !projected_valid_[b] || !projected_valid_[c]) {
+            continue;
+        }
+
+        rasterize_triangle(projected_[a], projected_[b], projected_[c]);
+    }
+}
+
+void OcclusionBuffer::rasterize_triangle(ScreenVertex a, ScreenVertex b, ScreenVertex c) {
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if(area == 0.0f) {
+        return;
+    }
+
+    /* Occluders are double-sided, so flip anything facing away */
+    if(area < 0.0f) {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    float min_x = std::min(a.x, std::min(b.x, c.x));
+    float max_x = std::max(a.x, std::max(b.x, c.x));
+    float min_y = std::min(a.y, std::min(b.y, c.y));
+    float max_y = std::max(a.y, std::max(b.y, c.y));
+
+    if(max_x < 0.0f || max_y < 0.0f || min_x >= width_ || min_y >= height_) {
+        return;
+    }
+
+    /* Start on a multiple of four pixels so that rows are processed as
+     * aligned blocks */
+    int x0 = std::max(0, int(std::floor(min_x))) & ~3;
+    int x1 = std::min(int(width_) - 1, int(std::ceil(max_x)));
+    int y0 = std::max(0, int(std::floor(min_y)));
+    int y1 = std::min(int(height_) - 1, int(std::ceil(max_y)));
+
+    /* Edge functions, each is positive on the inside of the edge. The value
+     * for edge n at p is ex[n] * p.x + ey[n] * p.y + ec[n] */
+    const ScreenVertex* v[3] = {&a, &b, &c};
+    float ex[3], ey[3], ec[3];
+    for(int e = 0; e < 3; ++e) {
+        auto& p = *v[(e + 1) % 3];
+        auto& q = *v[(e + 2) % 3];
+        ex[e] = p.y - q.y;
+        ey[e] = q.x - p.x;
+        ec[e] = (p.x * q.y) - (p.y * q.x);
+    }
+
+    /* Window space depth is linear in screen space, so it's a plane */
+    float inv_area = 1.0f / area;
+    float zx = ((ex[0] * a.z) + (ex[1] * b.z) + (ex[2] * c.z)) * inv_area;
+    float zy = ((ey[0] * a.z) + (ey[1] * b.z) + (ey[2] * c.z)) * inv_area;
+    float zc = ((ec[0] * a.z) + (ec[1] * b.z) + (ec[2] * c.z)) * inv_area;
+
+    /* The offset of each lane's pixel centre from the start of the block */
+    alignas(16) const float lane_offsets[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+    const float4 lanes = load(lane_offsets);
+
+    const float4 zero = splat(0.0f);
+    const float4 step_e0 = splat(ex[0] * 4.0f);
+    const float4 step_e1 = splat(ex[1] * 4.0f);
+    const float4 step_e2 = splat(ex[2] * 4.0f);
+    const float4 step_z = splat(zx * 4.0f);
+
+    alignas(16) float lane_depth[4];
+
+    for(int y = y0; y <= y1; ++y) {
+        float py = float(y) + 0.5f;
+        float px = float(x0);
+
+        float4 e0 = madd(splat(ex[0]), lanes, splat((ex[0] * px) + (ey[0] * py) + ec[0]));
+        float4 e1 = madd(splat(ex[1]), lanes, splat((ex[1] * px) + (ey[1] * py) + ec[1]));
+        float4 e2 = madd(splat(ex[2]), lanes, splat((ex[2] * px) + (ey[2] * py) + ec[2]));
+        float4 z = madd(splat(zx), lanes, splat((zx * px) + (zy * py) + zc));
+
+        float* row = depth_ + (y * width_);
+
+        for(int x = x0; x <= x1; x += 4) {
+            uint32_t inside = less_equal_mask(zero, e0) & less_equal_mask(zero, e1) & less_equal_mask(zero, e2);
+
+            if(inside == 0xF) {
+                store(row + x, min(load(row + x), z));
+            } else if(inside) {
+                store(lane_depth, z);
+                for(int i = 0; i < 4; ++i) {
+                    if((inside & (1 << i)) && lane_depth[i] < row[x + i]) {
+                        row[x + i] = lane_depth[i];
+                    }
+                }
+            }
+
+            e0 = add(e0, step_e0);
+            e1 = add(e1, step_e1);
+            e2 = add(e2, step_e2);
+            z = add(z, step_z);
+        }
+    }
+
+    ++triangles_rasterized_;
+}
+
+void OcclusionBuffer::finish() {
+    assert(depth_);
+
+    alignas(16) float lanes[4];
+
+    for(uint16_t ty = 0; ty < tiles_y_; ++ty) {
+        for(uint16_t tx = 0; tx < tiles_x_; ++tx) {
+            float4 farthest = splat(0.0f);
+
+            for(uint16_t y = 0; y < OCCLUSION_TILE_SIZE; ++y) {
+                const float* row = depth_ + (((ty * OCCLUSION_TILE_SIZE) + y) * width_) + (tx * OCCLUSION_TILE_SIZE);
+                for(uint16_t x = 0; x < OCCLUSION_TILE_SIZE; x += 4) {
+                    farthest = max(farthest, load(row + x));
+                }
+            }
+
+            store(lanes, farthest);
+            tiles_[(ty * tiles_x_) + tx] = std::max(
+                std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])
+            );
+        }
+    }
+}
+
+bool OcclusionBuffer::is_visible(const AABB& aabb) const {
+    if(!depth_) {
+        return true;
+    }
+
+    float min_x = width_, max_x = 0.0f;
+    float min_y = height_, max_y = 0.0f;
+    float nearest = 1.0f;
+
+    ScreenVertex projected;
+    for(auto& corner: aabb.corners()) {
+        /* Boxes which reach the camera can't be hidden */
+        if(!project(corner, view_projection_, projected)) {
+            return true;
+        }
+
+        min_x = std::min(min_x, projected.x);
+        max_x = std::max(max_x, projected.x);
+        min_y = std::min(min_y, projected.y);
+        max_y = std::max(max_y, projected.y);
+        nearest = std::min(nearest, projected.z);
+    }
+
+    /* Nothing to test against if it's off-screen, leave that to frustum
+     * culling */
+    if(max_x < 0.0f || max_y < 0.0f || min_x >= width_ || min_y >= height_) {
+        return true;
+    }
+
+    /* Grow the area by a pixel, occluders are only sampled at pixel centres */
+    int x0 = std::max(0, int(std::floor(min_x)) - 1);
+    int x1 = std::min(int(width_) - 1, int(std::ceil(max_x)) + 1);
+    int y0 = std::max(0, int(std::floor(min_y)) - 1);
+    int y1 = std::min(int(height_) - 1, int(std::ceil(max_y)) + 1);
+
+    for(int ty = y0 / OCCLUSION_TILE_SIZE; ty <= y1 / OCCLUSION_TILE_SIZE; ++ty) {
+        for(int tx = x0 / OCCLUSION_TILE_SIZE; tx <= x1 / OCCLUSION_TILE_SIZE; ++tx) {
+            /* Everything in this tile is in front of the box */
+            if(tiles_[(ty * tiles_x_) + tx] < nearest) {
+                continue;
+            }
+
+            int px0 = std::max(x0, tx * OCCLUSION_TILE_SIZE);
+            int px1 = std::min(x1, (tx * OCCLUSION_TILE_SIZE) + OCCLUSION_TILE_SIZE - 1);
+            int py0 = std::max(y0, ty * OCCLUSION_TILE_SIZE);
+            int py1 = std::min(y1, (ty * OCCLUSION_TILE_SIZE) + OCCLUSION_TILE_SIZE - 1);
+
+            for(int y = py0; y <= py1; ++y) {
+                const float* row = depth_ + (y * width_);
+                for(int x = px0; x <= px1; ++x) {
+                    if(row[x] >= nearest) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+}
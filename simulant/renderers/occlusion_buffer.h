@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../math/aabb.h"
+#include "../math/mat4.h"
+#include "../math/vec3.h"
+#include "../types.h"
+
+namespace smlt {
+
+/* The triangles a node occludes with, in the node's local space */
+struct OccluderGeometry {
+    std::vector<Vec3> vertices;
+    std::vector<uint32_t> indices;
+
+    static std::shared_ptr<OccluderGeometry> from_mesh(MeshPtr mesh);
+};
+
+const uint16_t OCCLUSION_BUFFER_DEFAULT_WIDTH = 256;
+const uint16_t OCCLUSION_BUFFER_DEFAULT_HEIGHT = 128;
+
+/* Each tile of the hierarchical-Z is this many pixels square */
+const uint16_t OCCLUSION_TILE_SIZE = 8;
+
+/*
+ * A low resolution depth buffer, rendered on the CPU, which is used to find
+ * nodes that are completely hidden behind occluders before we bother
+ * gathering their renderables.
+ *
+ * Each frame, begin() clears the buffer, the occluders are rasterized into it
+ * and finish() builds the hierarchical-Z: the farthest depth in each tile.
+ * Bounding boxes can then be tested with is_visible(). Most boxes are
+ * accepted or rejected using the tiles alone, only tiles which are partly
+ * covered are checked pixel by pixel.
+ *
+ * Depths are window space (0.0 is the near plane, 1.0 the far plane). The
+ * buffer covers the whole of the viewport regardless of its aspect ratio, so
+ * pixels are not necessarily square.
+ *
+ * Occluders must be conservative; they're drawn double-sided and anything
+ * they cover is considered hidden. Triangles which cross the near plane are
+ * skipped rather than clipped, which is always safe.
+ */
+class OcclusionBuffer {
+public:
+    OcclusionBuffer(
+        uint16_t width=OCCLUSION_BUFFER_DEFAULT_WIDTH,
+        uint16_t height=OCCLUSION_BUFFER_DEFAULT_HEIGHT
+    );
+
+    void begin(const Mat4& view_projection);
+    void rasterize(const Mat4& model, const OccluderGeometry& geometry);
+    void finish();
+
+    /* Returns false if the box is entirely hidden by the occluders */
+    bool is_visible(const AABB& aabb) const;
+
+    uint16_t width() const { return width_; }
+    uint16_t height() const { return height_; }
+
+    float depth_at(uint16_t x, uint16_t y) const { return depth_[(y * width_) + x]; }
+    float tile_depth_at(uint16_t tx, uint16_t ty) const { return tiles_[(ty * tiles_x_) + tx]; }
+
+    /* Triangles drawn since begin(), after skipping those that were
+     * off-screen, degenerate or crossed the near plane */
+    uint32_t triangles_rasterized() const { return triangles_rasterized_; }
+
+private:
+    struct ScreenVertex {
+        float x;
+        float y;
+        float z;
+    };
+
+    bool project(const Vec3& v, const Mat4& transform, ScreenVertex& out) const;
+    void rasterize_triangle(ScreenVertex a, ScreenVertex b, ScreenVertex c);
+
+    uint16_t width_;
+    uint16_t height_;
+    uint16_t tiles_x_;
+    uint16_t tiles_y_;
+
+    Mat4 view_projection_;
+
+    /* Rows are 16 byte aligned for the SIMD loads */
+    std::vector<float> storage_;
+    float* depth_ = nullptr;
+    std::vector<float> tiles_;
+
+    std::vector<ScreenVertex> projected_;
+    std::vector<uint8_t> projected_valid_;
+
+    uint32_t triangles_rasterized_ = 0;
+};
+
+}
@@ -81,6 +81,8 @@ void Renderer::pre_render() {
     for(auto wptr: texture_registry_){
         prepare_texture(wptr.second);
     }
+
+    on_pre_render();
 }
 
 static bool format_in_list(TextureFormat fmt, const TextureFormat* values) {
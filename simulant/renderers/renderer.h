@@ -64,6 +64,10 @@ public:
 
     virtual std::string name() const = 0;
 
+    /* The directory under simulant/materials holding the built-in materials
+     * for this renderer, this is what ${RENDERER} expands to in paths */
+    virtual std::string material_directory() const { return name(); }
+
     /* This function is called just before drawing the renderable, it can be
      * used to upload any data to VRAM if necessary */
     virtual void prepare_to_render(const Renderable* renderable) = 0;
@@ -98,6 +102,25 @@ public:
     // Render support flags
     virtual bool supports_gpu_programs() const { return false; }
 
+    /* True if renderables drawn with this material can have their
+     * morph_target blended in by the renderer */
+    virtual bool supports_gpu_morphing(Material* material) {
+        _S_UNUSED(material);
+        return false;
+    }
+
+    /* True if renderables drawn with this material can be skinned by the
+     * renderer with a palette of joint_count matrices */
+    virtual bool supports_gpu_skinning(Material* material, uint32_t joint_count) {
+        _S_UNUSED(material);
+        _S_UNUSED(joint_count);
+        return false;
+    }
+
+    /* Headless renderers have no GL context, so nothing else should
+     * make GL calls (e.g. viewport clears) while one is in use */
+    virtual bool is_headless() const { return false; }
+
     /*
      * Returns true if the texture has been allocated, false otherwise.
      */
@@ -163,6 +186,10 @@ private:
         _S_UNUSED(material);
     }
 
+    /* Called once per frame from pre_render(), on the main (render) thread,
+     * before any render queues are traversed */
+    virtual void on_pre_render() {}
+
     mutable thread::Mutex texture_registry_mutex_;
     std::unordered_map<TextureID, Texture*> texture_registry_;
 };
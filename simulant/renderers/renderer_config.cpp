@@ -1,6 +1,7 @@
 
 
 #include "renderer_config.h"
+#include "null/null_renderer.h"
 
 #ifdef __DREAMCAST__
     #include "gl1x/gl1x_renderer.h"
@@ -13,6 +14,11 @@
 
 namespace smlt {
 
+std::string chosen_renderer_name(const std::string& name) {
+    const char* env = std::getenv("SIMULANT_RENDERER");
+    return (env) ? env : name;
+}
+
 Renderer::ptr new_renderer(Window* window, const std::string& name) {
     /*
      * Different platforms return different renderers, the full list of supported renderers is
@@ -20,14 +26,14 @@ Renderer::ptr new_renderer(Window* window, const std::string& name) {
      *
      * - "gl2x"
      * - "gl1x"
+     * - "null" (draws nothing, available everywhere)
      *
      * If a renderer is unsupported a message will be logged and a null pointer returned
      */
 
     Renderer::ptr NOT_SUPPORTED;
 
-    const char* env = std::getenv("SIMULANT_RENDERER");
-    std::string chosen = (env) ? env : name;
+    std::string chosen = chosen_renderer_name(name);
 
     if(chosen.empty()) {
         /* NULL? Then return the default for the platform */
@@ -38,7 +44,9 @@ Renderer::ptr new_renderer(Window* window, const std::string& name) {
 #endif
     }
 
-    if(chosen == "gl1x") {
+    if(chosen == NULL_RENDERER_NAME) {
+        return std::make_shared<NullRenderer>(window);
+    } else if(chosen == "gl1x") {
 #ifdef __ANDROID__
         S_ERROR("{0} is not a supported renderer", name);
         return NOT_SUPPORTED;
@@ -22,5 +22,10 @@
 
 namespace smlt {
     Renderer::ptr new_renderer(Window *window, const std::string &name);
+
+    /* Returns the name of the renderer new_renderer() will choose, the
+     * SIMULANT_RENDERER environment variable takes precedence over name. An
+     * empty string means the platform default. */
+    std::string chosen_renderer_name(const std::string& name);
 }
 
@@ -79,6 +79,7 @@
 #include "renderers/renderer_config.h"
 
 #include "loaders/q2bsp_loader.h"
+#include "loaders/smsh_loader.h"
 #include "coroutines/helpers.h"
 
 #include "streams/file_ifstream.h"
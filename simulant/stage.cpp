@@ -36,6 +36,7 @@
 #include "partitioners/null_partitioner.h"
 #include "partitioners/spatial_hash.h"
 #include "partitioners/frustum_partitioner.h"
+#include "partitioners/bvh_partitioner.h"
 
 namespace smlt {
 
@@ -47,6 +48,7 @@ Stage::Stage(Window *parent, StageNodePool *node_pool, AvailablePartitioner part
     TypedDestroyableObject<Stage, Window>(parent),
     ContainerNode(this, STAGE_NODE_TYPE_STAGE),
     node_pool_(node_pool),
+    transforms_(new TransformSystem()),
     ui_(new ui::UIManager(this, node_pool_)),
     asset_manager_(LocalAssetManager::create(parent, parent->shared_assets.get())),
     geom_manager_(new GeomManager(node_pool_)),
@@ -417,6 +419,9 @@ void Stage::set_partitioner(AvailablePartitioner partitioner) {
         case PARTITIONER_HASH:
             partitioner_ = std::make_shared<SpatialHashPartitioner>(this);
         break;
+        case PARTITIONER_BVH:
+            partitioner_ = std::make_shared<BVHPartitioner>(this);
+        break;
         default: {
             throw std::logic_error("Invalid partitioner type specified");
         }
@@ -36,6 +36,7 @@
 #include "nodes/geom.h"
 #include "nodes/particle_system.h"
 #include "nodes/stage_node.h"
+#include "nodes/transform_system.h"
 #include "nodes/light.h"
 #include "types.h"
 #include "asset_manager.h"
@@ -207,6 +208,9 @@ public:
 private:
     StageNodePool* node_pool_ = nullptr;
 
+    /* Declared first so that it outlives every node in the stage */
+    std::unique_ptr<TransformSystem> transforms_;
+
     AABB aabb_;
 
     ActorCreatedSignal signal_actor_created_;
@@ -262,6 +266,7 @@ private:
 public:
     Property<decltype(&Stage::debug_)> debug = {this, &Stage::debug_};
     Property<decltype(&Stage::partitioner_)> partitioner = {this, &Stage::partitioner_};
+    Property<decltype(&Stage::transforms_)> transforms = {this, &Stage::transforms_};
     Property<decltype(&Stage::asset_manager_)> assets = {this, &Stage::asset_manager_};
     Property<decltype(&Stage::data_)> data = {this, &Stage::data_};
     Property<decltype(&Stage::ui_)> ui = {this, &Stage::ui_};
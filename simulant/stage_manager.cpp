@@ -25,6 +25,7 @@
 #include "nodes/camera.h"
 #include "compositor.h"
 #include "loader.h"
+#include "jobs/parallel.h"
 
 #include "renderers/batching/render_queue.h"
 
@@ -66,6 +67,42 @@ StagePtr StageManager::destroy_stage(StageID s) {
     return nullptr;
 }
 
+/* Thread-safe nodes are dispatched in batches of at least this many */
+const static std::size_t PARALLEL_UPDATE_MIN_BATCH_SIZE = 16;
+
+template<typename Func>
+void StageManager::update_nodes(Stage* stage, const Func& func) {
+    if(!parallel_update_enabled_ || !window_->jobs.get()) {
+        for(auto& node: stage->each_descendent()) {
+            func(&node);
+        }
+        return;
+    }
+
+    parallel_update_nodes_.clear();
+
+    for(auto& node: stage->each_descendent()) {
+        if(node.is_update_thread_safe()) {
+            parallel_update_nodes_.push_back(&node);
+        } else {
+            func(&node);
+        }
+    }
+
+    if(parallel_update_nodes_.empty()) {
+        return;
+    }
+
+    auto& nodes = parallel_update_nodes_;
+    auto transforms = stage->transforms.get();
+
+    transforms->begin_deferred_writes();
+    jobs::parallel_for(*window_->jobs.get(), 0, nodes.size(), PARALLEL_UPDATE_MIN_BATCH_SIZE, [&nodes, &func](std::size_t i) {
+        func(nodes[i]);
+    });
+    transforms->end_deferred_writes();
+}
+
 void StageManager::fixed_update(float dt) {
     /* safe_each locks the entire loop */
     for(auto stage: manager_) {
@@ -75,9 +112,9 @@ void StageManager::fixed_update(float dt) {
 
         stage->fixed_update(dt);
 
-        for(auto& node: stage->each_descendent()) {
-            node.fixed_update(dt);
-        }
+        update_nodes(stage, [dt](StageNode* node) {
+            node->fixed_update(dt);
+        });
     }
 }
 
@@ -104,9 +141,9 @@ void StageManager::update(float dt) {
 
         stage->update(dt);
 
-        for(auto& node: stage->each_descendent()) {
-            node.update(dt);
-        }
+        update_nodes(stage, [dt](StageNode* node) {
+            node->update(dt);
+        });
     }
 }
 
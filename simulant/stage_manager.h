@@ -90,9 +90,40 @@ public:
 
     uint32_t stage_node_pool_capacity() const;
     uint32_t stage_node_pool_capacity_in_bytes() const;
+
+    /*
+     * When enabled, update() and fixed_update() of nodes which report
+     * is_update_thread_safe() are run in batches on the job scheduler.
+     *
+     * For each stage, the other nodes are updated first on the main thread,
+     * in the usual order. Then the thread-safe nodes are updated in
+     * parallel. A thread-safe update must only:
+     *
+     *  - Read and write the node itself and its own behaviours
+     *  - Change the node's own local transformation (move_to etc.)
+     *  - Read (not write) other nodes' absolute transformations, which
+     *    are the values from before the parallel batch started
+     *
+     * It must not create, destroy or reparent nodes, read other nodes'
+     * bounds, touch assets, sound or the renderer, or fire signals which
+     * have listeners outside the node.
+     *
+     * The same two-pass ordering is used when there are no workers, so the
+     * results don't depend on the number of cores. late_update() is always
+     * run serially as it's meant for synchronising nodes with each other.
+     */
+    void set_parallel_update_enabled(bool value) { parallel_update_enabled_ = value; }
+    bool is_parallel_update_enabled() const { return parallel_update_enabled_; }
+
 private:
     Window* window_ = nullptr;
 
+    bool parallel_update_enabled_ = false;
+    std::vector<StageNode*> parallel_update_nodes_;
+
+    template<typename Func>
+    void update_nodes(Stage* stage, const Func& func);
+
 protected:
     void clean_up();
 
@@ -20,6 +20,85 @@ public:
         subactors_renderered_ = value;
     }
 
+    /* The number of render group and material pass changes made while
+     * traversing the render queues last frame */
+    uint32_t state_changes() const { return state_changes_; }
+    void set_state_changes(uint32_t value) {
+        state_changes_ = value;
+    }
+
+    /* The number of draw calls avoided last frame by merging small
+     * renderables together (dynamic batching) */
+    uint32_t draws_saved_by_batching() const { return draws_saved_by_batching_; }
+    void set_draws_saved_by_batching(uint32_t value) {
+        draws_saved_by_batching_ = value;
+    }
+
+    /* Nodes which passed frustum culling last frame but were skipped because
+     * they were hidden behind occluders, summed across pipelines */
+    uint32_t nodes_occluded() const { return nodes_occluded_; }
+    void set_nodes_occluded(uint32_t value) {
+        nodes_occluded_ = value;
+    }
+
+    /* Time spent in each phase of rendering last frame, summed across
+     * pipelines. Culling is the partitioner query, gathering builds the
+     * render queue, and traversal sorts it and submits it to the renderer */
+    uint64_t cull_time_us() const { return cull_time_us_; }
+    uint64_t gather_time_us() const { return gather_time_us_; }
+    uint64_t traversal_time_us() const { return traversal_time_us_; }
+
+    void set_render_phase_times(uint64_t cull_us, uint64_t gather_us, uint64_t traversal_us) {
+        cull_time_us_ = cull_us;
+        gather_time_us_ = gather_us;
+        traversal_time_us_ = traversal_us;
+    }
+
+    /* Animated poses computed last frame, and the number of times a pose
+     * was reused by another pipeline rendering the same node */
+    uint32_t poses_evaluated() const { return poses_evaluated_; }
+    uint32_t poses_reused() const { return poses_reused_; }
+
+    void set_pose_counts(uint32_t evaluated, uint32_t reused) {
+        poses_evaluated_ = evaluated;
+        poses_reused_ = reused;
+    }
+
+    /* GPU buffer usage as of the start of the frame. Bytes uploaded covers
+     * the previous frame, fragmentation is 0.0 when all the free space in the
+     * shared buffers is contiguous */
+    uint32_t gpu_buffer_count() const { return gpu_buffer_count_; }
+    uint64_t gpu_bytes_uploaded() const { return gpu_bytes_uploaded_; }
+    float gpu_buffer_fragmentation() const { return gpu_buffer_fragmentation_; }
+
+    void set_gpu_buffer_stats(uint32_t buffer_count, uint64_t bytes_uploaded, float fragmentation) {
+        gpu_buffer_count_ = buffer_count;
+        gpu_bytes_uploaded_ = bytes_uploaded;
+        gpu_buffer_fragmentation_ = fragmentation;
+    }
+
+    /* GL calls skipped last frame because the state or uniform value they
+     * would have set was already current */
+    uint32_t gl_calls_avoided() const { return gl_calls_avoided_; }
+    void set_gl_calls_avoided(uint32_t value) {
+        gl_calls_avoided_ = value;
+    }
+
+    /* Instanced draw calls made so far this frame, and the number of
+     * renderables they drew between them */
+    uint32_t instanced_draws() const { return instanced_draws_; }
+    uint32_t instances_rendered() const { return instances_rendered_; }
+
+    void increment_instanced_draws(uint32_t instance_count) {
+        instanced_draws_++;
+        instances_rendered_ += instance_count;
+    }
+
+    void reset_instanced_draws() {
+        instanced_draws_ = 0;
+        instances_rendered_ = 0;
+    }
+
     float frame_time() const { return frame_time_; }
     void set_frame_time(float value) {
         frame_time_ = value;
@@ -50,6 +129,25 @@ private:
     uint32_t subactors_renderered_ = 0;
     uint32_t frames_per_second_ = 0;
     uint32_t geometry_visible_ = 0;
+    uint32_t state_changes_ = 0;
+    uint32_t draws_saved_by_batching_ = 0;
+    uint32_t nodes_occluded_ = 0;
+
+    uint64_t cull_time_us_ = 0;
+    uint64_t gather_time_us_ = 0;
+    uint64_t traversal_time_us_ = 0;
+
+    uint32_t poses_evaluated_ = 0;
+    uint32_t poses_reused_ = 0;
+
+    uint32_t gpu_buffer_count_ = 0;
+    uint64_t gpu_bytes_uploaded_ = 0;
+    float gpu_buffer_fragmentation_ = 0.0f;
+
+    uint32_t gl_calls_avoided_ = 0;
+
+    uint32_t instanced_draws_ = 0;
+    uint32_t instances_rendered_ = 0;
 
     uint64_t fixed_steps_run_ = 0;
     uint64_t frames_run_ = 0;
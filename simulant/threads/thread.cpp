@@ -1,3 +1,4 @@
+#include <algorithm>
 
 #include <pthread.h>
 
@@ -8,6 +9,7 @@
 #include <pspthreadman.h>
 #else
 #include <time.h>
+#include <unistd.h>
 #endif
 
 #include "../logging.h"
@@ -153,6 +155,19 @@ void yield() {
 #endif
 }
 
+std::size_t cpu_count() {
+#if defined(__PSP__) || defined(__DREAMCAST__)
+    return 1;
+#elif defined(__WIN32__)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return std::max<std::size_t>(info.dwNumberOfProcessors, 1);
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (std::size_t) count : 1;
+#endif
+}
+
 ThreadID this_thread_id() {
 #ifdef __PSP__
     return (ThreadID) sceKernelGetThreadId();
@@ -159,6 +159,10 @@ private:
 void yield();
 void sleep(size_t ms);
 
+/* Returns the number of CPU cores available to the process, this is
+ * always at least 1 */
+std::size_t cpu_count();
+
 ThreadID this_thread_id();
 
 }
@@ -308,10 +308,22 @@ enum MeshArrangement {
     MESH_ARRANGEMENT_LINE_STRIP
 };
 
+/* Used for multiple levels of detail when rendering stage nodes */
+
+enum DetailLevel {
+    DETAIL_LEVEL_NEAREST = 0,
+    DETAIL_LEVEL_NEAR,
+    DETAIL_LEVEL_MID,
+    DETAIL_LEVEL_FAR,
+    DETAIL_LEVEL_FARTHEST,
+    DETAIL_LEVEL_MAX
+};
+
 enum AvailablePartitioner {
     PARTITIONER_NULL,
     PARTITIONER_FRUSTUM,
-    PARTITIONER_HASH
+    PARTITIONER_HASH,
+    PARTITIONER_BVH
 };
 
 enum LightType {
@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include "simplify.h"
+#include "../../math/vec3.h"
+
+namespace smlt {
+namespace utils {
+
+namespace {
+
+/* A symmetric 4x4 matrix, only the upper triangle is stored */
+struct Quadric {
+    double a[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    void add_plane(double nx, double ny, double nz, double d) {
+        a[0] += nx * nx; a[1] += nx * ny; a[2] += nx * nz; a[3] += nx * d;
+        a[4] += ny * ny; a[5] += ny * nz; a[6] += ny * d;
+        a[7] += nz * nz; a[8] += nz * d;
+        a[9] += d * d;
+    }
+
+    Quadric& operator+=(const Quadric& rhs) {
+        for(int i = 0; i < 10; ++i) {
+            a[i] += rhs.a[i];
+        }
+        return *this;
+    }
+
+    /* The sum of the squared distances from p to each plane */
+    double evaluate(const Vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+             + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+             + a[7] * z * z + 2 * a[8] * z
+             + a[9];
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+
+    bool operator<(const Collapse& rhs) const {
+        return cost < rhs.cost;
+    }
+};
+
+struct PositionHash {
+    std::size_t operator()(const Vec3& v) const {
+        uint32_t bits[3];
+        std::memcpy(bits, &v.x, sizeof(float));
+        std::memcpy(bits + 1, &v.y, sizeof(float));
+        std::memcpy(bits + 2, &v.z, sizeof(float));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+struct PositionEqual {
+    bool operator()(const Vec3& a, const Vec3& b) const {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+};
+
+static uint64_t edge_key(uint32_t a, uint32_t b) {
+    return (a < b) ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+static Vec3 triangle_normal(const Vec3& a, const Vec3& b, const Vec3& c) {
+    return (b - a).cross(c - a);
+}
+
+}
+
+SimplifyResult simplify(
+    const std::vector<Vec3>& positions,
+    std::vector<std::vector<uint32_t>>& triangle_lists,
+    uint32_t target_triangle_count,
+    float max_error) {
+
+    SimplifyResult result;
+
+    const uint32_t vertex_count = positions.size();
+    const uint32_t NO_LIST = ~0u;
+    const uint32_t MULTIPLE_LISTS = ~0u - 1;
+
+    /* Flatten the triangles, remembering which list each came from */
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> owners;
+    for(uint32_t l = 0; l < triangle_lists.size(); ++l) {
+        auto& list = triangle_lists[l];
+        for(std::size_t i = 0; i + 2 < list.size(); i += 3) {
+            if(list[i] >= vertex_count || list[i + 1] >= vertex_count || list[i + 2] >= vertex_count) {
+                continue;
+            }
+
+            indices.insert(indices.end(), list.begin() + i, list.begin() + i + 3);
+            owners.push_back(l);
+        }
+    }
+
+    const uint32_t triangle_count = owners.size();
+    result.triangles_before = result.triangles_after = triangle_count;
+
+    if(triangle_count <= target_triangle_count) {
+        return result;
+    }
+
+    /* Find the vertices which mustn't move */
+    std::vector<uint8_t> locked(vertex_count, 0);
+    std::vector<uint32_t> vertex_list(vertex_count, NO_LIST);
+    std::unordered_map<uint64_t, uint32_t> edge_counts;
+
+    const float big = std::numeric_limits<float>::max();
+    Vec3 min(big, big, big), max(-big, -big, -big);
+
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        for(uint32_t k = 0; k < 3; ++k) {
+            auto v = indices[(t * 3) + k];
+
+            if(vertex_list[v] == NO_LIST) {
+                vertex_list[v] = owners[t];
+            } else if(vertex_list[v] != owners[t]) {
+                vertex_list[v] = MULTIPLE_LISTS;
+            }
+
+            edge_counts[edge_key(v, indices[(t * 3) + ((k + 1) % 3)])]++;
+
+            min = Vec3(std::min(min.x, positions[v].x), std::min(min.y, positions[v].y), std::min(min.z, positions[v].z));
+            max = Vec3(std::max(max.x, positions[v].x), std::max(max.y, positions[v].y), std::max(max.z, positions[v].z));
+        }
+    }
+
+    /* Vertices which share a position (UV seams, hard normals and the like)
+     * are linked into a ring through next_at_position, and remap points at
+     * the first of them. Quadrics are kept per position so both sides of a
+     * seam agree on costs. */
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<uint32_t> next_at_position(vertex_count);
+    std::vector<uint32_t> wedge_counts(vertex_count, 0);
+
+    std::unordered_map<Vec3, uint32_t, PositionHash, PositionEqual> first_at_position;
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        remap[v] = next_at_position[v] = v;
+
+        if(vertex_list[v] == NO_LIST) {
+            continue;
+        }
+
+        if(vertex_list[v] == MULTIPLE_LISTS) {
+            locked[v] = 1;
+        }
+
+        auto it = first_at_position.find(positions[v]);
+        if(it == first_at_position.end()) {
+            first_at_position.insert(std::make_pair(positions[v], v));
+        } else {
+            remap[v] = it->second;
+            next_at_position[v] = next_at_position[it->second];
+            next_at_position[it->second] = v;
+        }
+
+        wedge_counts[remap[v]]++;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> position_edge_counts;
+    for(auto& edge: edge_counts) {
+        position_edge_counts[edge_key(remap[edge.first >> 32], remap[edge.first & 0xFFFFFFFF])] += edge.second;
+    }
+
+    /* An edge with a single triangle is either the open border of the
+     * surface, which is locked, or one side of a seam when another pair of
+     * vertices at the same positions has the other triangle */
+    std::vector<uint32_t> seam_edges(vertex_count, 0);
+    for(auto& edge: edge_counts) {
+        if(edge.second != 1) {
+            continue;
+        }
+
+        uint32_t a = edge.first >> 32;
+        uint32_t b = edge.first & 0xFFFFFFFF;
+
+        if(position_edge_counts[edge_key(remap[a], remap[b])] == 2) {
+            seam_edges[a]++;
+            seam_edges[b]++;
+        } else {
+            locked[a] = 1;
+            locked[b] = 1;
+        }
+    }
+
+    /* A seam can only be collapsed along where exactly two vertices meet
+     * and the seam carries on through both of them, anything else
+     * (where several copies meet, the ends of seams) stays put */
+    for(uint32_t v = 0; v < vertex_count; ++v) {
+        if(next_at_position[v] == v) {
+            /* The tip of a cut, the seam stops here */
+            if(seam_edges[v]) {
+                locked[v] = 1;
+            }
+            continue;
+        }
+
+        auto sibling = next_at_position[v];
+        if(wedge_counts[remap[v]] != 2 || seam_edges[v] != 2 || seam_edges[sibling] != 2) {
+            locked[v] = 1;
+        }
+    }
+
+    /* Each position starts with the planes of the triangles around it */
+    std::vector<Quadric> quadrics(vertex_count);
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        auto& a = positions[indices[t * 3]];
+        auto& b = positions[indices[(t * 3) + 1]];
+        auto& c = positions[indices[(t * 3) + 2]];
+
+        auto n = triangle_normal(a, b, c);
+        auto length = n.length();
+        if(length == 0.0f) {
+            continue;
+        }
+
+        n /= length;
+
+        for(uint32_t k = 0; k < 3; ++k) {
+            quadrics[remap[indices[(t * 3) + k]]].add_plane(n.x, n.y, n.z, -n.dot(a));
+        }
+
+        /* Seams also get a plane standing up from each of their edges so
+         * collapsing along them doesn't drag the seam off its line */
+        for(uint32_t k = 0; k < 3; ++k) {
+            auto v0 = indices[(t * 3) + k];
+            auto v1 = indices[(t * 3) + ((k + 1) % 3)];
+
+            if(edge_counts[edge_key(v0, v1)] != 1 || position_edge_counts[edge_key(remap[v0], remap[v1])] != 2) {
+                continue;
+            }
+
+            auto side = (positions[v1] - positions[v0]).cross(n);
+            auto side_length = side.length();
+            if(side_length == 0.0f) {
+                continue;
+            }
+
+            side /= side_length;
+
+            auto d = -side.dot(positions[v0]);
+            quadrics[remap[v0]].add_plane(side.x, side.y, side.z, d);
+            quadrics[remap[v1]].add_plane(side.x, side.y, side.z, d);
+        }
+    }
+
+    double size = (max - min).length();
+    double max_distance = double(max_error) * size;
+    double max_cost = max_distance * max_distance;
+    double worst_cost = 0.0;
+
+    std::vector<uint8_t> alive(triangle_count, 1);
+    uint32_t alive_count = triangle_count;
+
+    std::vector<uint32_t> adjacency_offsets;
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> touched;
+
+    /* Each pass collapses as many independent edges as it can, cheapest
+     * first, then the adjacency is rebuilt */
+    while(alive_count > target_triangle_count) {
+        adjacency_offsets.assign(vertex_count + 1, 0);
+        for(uint32_t t = 0; t < triangle_count; ++t) {
+            if(alive[t]) {
+                for(uint32_t k = 0; k < 3; ++k) {
+                    adjacency_offsets[indices[(t * 3) + k] + 1]++;
+                }
+            }
+        }
+
+        for(uint32_t v = 0; v < vertex_count; ++v) {
+            adjacency_offsets[v + 1] += adjacency_offsets[v];
+        }
+
+        adjacency.resize(adjacency_offsets[vertex_count]);
+        std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for(uint32_t t = 0; t < triangle_count; ++t) {
+            if(alive[t]) {
+                for(uint32_t k = 0; k < 3; ++k) {
+                    adjacency[fill[indices[(t * 3) + k]]++] = t;
+                }
+            }
+        }
+
+        /* How many live triangles use both a and b */
+        auto shared_triangles = [&](uint32_t a, uint32_t b) -> uint32_t {
+            uint32_t count = 0;
+            for(auto i = adjacency_offsets[a]; i < adjacency_offsets[a + 1]; ++i) {
+                uint32_t* tri = &indices[adjacency[i] * 3];
+                if(tri[0] == b || tri[1] == b || tri[2] == b) {
+                    ++count;
+                }
+            }
+            return count;
+        };
+
+        /* Reject anything which would flip a triangle over */
+        auto flips = [&](uint32_t from, uint32_t to) -> bool {
+            for(auto i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; ++i) {
+                uint32_t* tri = &indices[adjacency[i] * 3];
+
+                if(tri[0] == to || tri[1] == to || tri[2] == to) {
+                    continue;
+                }
+
+                Vec3 p[3], q[3];
+                for(uint32_t k = 0; k < 3; ++k) {
+                    p[k] = positions[tri[k]];
+                    q[k] = (tri[k] == from) ? positions[to] : p[k];
+                }
+
+                auto before = triangle_normal(p[0], p[1], p[2]);
+                auto after = triangle_normal(q[0], q[1], q[2]);
+                if(before.dot(after) <= 0.0f) {
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+        auto move = [&](uint32_t from, uint32_t to) {
+            for(auto i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; ++i) {
+                auto t = adjacency[i];
+                uint32_t* tri = &indices[t * 3];
+
+                for(uint32_t k = 0; k < 3; ++k) {
+                    if(tri[k] == from) {
+                        tri[k] = to;
+                    }
+
+                    /* Everything around the collapse has stale costs now */
+                    touched[tri[k]] = 1;
+                }
+
+                if(tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+                    alive[t] = 0;
+                    --alive_count;
+                }
+            }
+
+            touched[from] = 1;
+        };
+
+        collapses.clear();
+        for(uint32_t t = 0; t < triangle_count; ++t) {
+            if(!alive[t]) {
+                continue;
+            }
+
+            for(uint32_t k = 0; k < 3; ++k) {
+                auto a = indices[(t * 3) + k];
+                auto b = indices[(t * 3) + ((k + 1) % 3)];
+
+                Quadric q = quadrics[remap[a]];
+                q += quadrics[remap[b]];
+
+                if(!locked[a]) {
+                    collapses.push_back({a, b, q.evaluate(positions[b])});
+                }
+
+                if(!locked[b]) {
+                    collapses.push_back({b, a, q.evaluate(positions[a])});
+                }
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end());
+
+        touched.assign(vertex_count, 0);
+        uint32_t collapsed = 0;
+
+        for(auto& collapse: collapses) {
+            if(alive_count <= target_triangle_count || collapse.cost > max_cost) {
+                break;
+            }
+
+            auto from = collapse.from;
+            auto to = collapse.to;
+
+            if(touched[from] || touched[to]) {
+                continue;
+            }
+
+            /* Seam vertices only move along the seam, and the vertex on the
+             * other side has to move to the matching vertex with it or the
+             * seam would crack open */
+            uint32_t pair_from = from, pair_to = to;
+            if(next_at_position[from] != from) {
+                if(shared_triangles(from, to) != 1) {
+                    continue;
+                }
+
+                pair_from = next_at_position[from];
+                pair_to = to;
+                for(auto w = next_at_position[to]; w != to; w = next_at_position[w]) {
+                    if(shared_triangles(pair_from, w)) {
+                        pair_to = w;
+                        break;
+                    }
+                }
+
+                if(pair_to == to || touched[pair_from] || touched[pair_to]) {
+                    continue;
+                }
+
+                if(flips(pair_from, pair_to)) {
+                    continue;
+                }
+            }
+
+            if(flips(from, to)) {
+                continue;
+            }
+
+            move(from, to);
+            if(pair_from != from) {
+                move(pair_from, pair_to);
+            }
+
+            quadrics[remap[to]] += quadrics[remap[from]];
+
+            worst_cost = std::max(worst_cost, collapse.cost);
+            ++collapsed;
+        }
+
+        if(!collapsed) {
+            break;
+        }
+    }
+
+    for(auto& list: triangle_lists) {
+        list.clear();
+    }
+
+    for(uint32_t t = 0; t < triangle_count; ++t) {
+        if(alive[t]) {
+            auto& list = triangle_lists[owners[t]];
+            list.insert(list.end(), indices.begin() + (t * 3), indices.begin() + (t * 3) + 3);
+        }
+    }
+
+    result.triangles_after = alive_count;
+    result.error = (size > 0.0) ? float(std::sqrt(std::max(worst_cost, 0.0)) / size) : 0.0f;
+    return result;
+}
+
+}
+}
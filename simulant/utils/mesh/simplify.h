@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../../types.h"
+
+namespace smlt {
+
+struct LODOptions {
+    /* The fraction of the source triangles to aim for at each detail level.
+     * DETAIL_LEVEL_NEAREST is always the source mesh */
+    float ratios[DETAIL_LEVEL_MAX] = {1.0f, 0.5f, 0.25f, 0.125f, 0.0625f};
+
+    /* Collapses which would move the surface further than this fraction of
+     * the mesh's size are never made, so simple meshes stop short of the
+     * ratio rather than losing their shape */
+    float max_error = 0.05f;
+};
+
+struct LODReport {
+    uint32_t triangle_counts[DETAIL_LEVEL_MAX] = {0, 0, 0, 0, 0};
+
+    /* The largest collapse made for each level, as a fraction of the mesh's
+     * size */
+    float errors[DETAIL_LEVEL_MAX] = {0, 0, 0, 0, 0};
+};
+
+namespace utils {
+
+struct SimplifyResult {
+    uint32_t triangles_before = 0;
+    uint32_t triangles_after = 0;
+    float error = 0.0f;
+};
+
+/*
+ * Simplifies triangle lists by repeatedly collapsing the edge which least
+ * changes the surface, measured with quadric error metrics.
+ *
+ * Each edge collapse moves one vertex onto a neighbour, so no new vertices
+ * are created and the results index the same vertex data as the input. That
+ * means vertex attributes never need interpolating, but to avoid stretching
+ * them across discontinuities some vertices are never moved:
+ *
+ *  - Vertices used by more than one triangle list (submesh boundaries)
+ *  - Vertices on the open border of a surface
+ *  - Vertices where more than two copies share a position, or where an
+ *    attribute seam (UV seams, hard normals and the like) ends or branches
+ *    off
+ *
+ * Elsewhere on a seam, a vertex only collapses along the seam and the copy
+ * on the other side collapses to the matching vertex at the same time, so
+ * the seam is simplified without cracking open.
+ *
+ * Triangles which would flip over are rejected too. triangle_lists is
+ * updated in place.
+ */
+SimplifyResult simplify(
+    const std::vector<Vec3>& positions,
+    std::vector<std::vector<uint32_t>>& triangle_lists,
+    uint32_t target_triangle_count,
+    float max_error
+);
+
+}
+}
@@ -564,6 +564,12 @@ bool VertexData::clone_into(VertexData& other) {
     return true;
 }
 
+void VertexData::assign(const uint8_t* data, uint32_t vertex_count) {
+    data_.assign(data, data + (vertex_count * stride_));
+    vertex_count_ = vertex_count;
+    cursor_position_ = 0;
+}
+
 static constexpr uint32_t calc_index_stride(IndexType type) {
     return (type == INDEX_TYPE_16_BIT) ? sizeof(uint16_t) : (type == INDEX_TYPE_8_BIT) ? sizeof(uint8_t) : sizeof(uint32_t);
 }
@@ -602,6 +608,13 @@ std::vector<uint32_t> IndexData::all() {
     return ret;
 }
 
+void IndexData::assign(const uint8_t* data, uint32_t count, uint32_t min_index, uint32_t max_index) {
+    indices_.assign(data, data + (count * stride_));
+    count_ = count;
+    min_index_ = min_index;
+    max_index_ = max_index;
+}
+
 void IndexData::done() {
     signal_update_complete_();
     last_updated_ = TimeKeeper::now_in_us();
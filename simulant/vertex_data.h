@@ -207,6 +207,12 @@ public:
     */
     bool clone_into(VertexData& other);
 
+    /* Replaces all of the vertices with vertex_count vertices copied straight
+     * from data, which must already be laid out to match the vertex
+     * specification. This is much faster than the cursor API for bulk loads.
+     * You must still call done() afterwards. */
+    void assign(const uint8_t* data, uint32_t vertex_count);
+
 private:
     VertexSpecification vertex_specification_;
     std::vector<uint8_t> data_;
@@ -421,6 +427,12 @@ public:
 
     IndexType index_type() const { return index_type_; }
 
+    /* Replaces all of the indices with count indices copied straight from
+     * data, which must already be of this index type. min_index and
+     * max_index aren't checked so must be correct. You must still call
+     * done() afterwards. */
+    void assign(const uint8_t* data, uint32_t count, uint32_t min_index, uint32_t max_index);
+
 private:
     IndexType index_type_;
     std::vector<uint8_t> indices_;
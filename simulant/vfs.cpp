@@ -92,7 +92,7 @@ Path VirtualFileSystem::locate_file(const Path &filename) const {
     // FIXME: Don't use unicode!
     Path final_name(unicode(filename.str()).replace(
         "${RENDERER}",
-        window_->renderer->name()
+        window_->renderer->material_directory()
     ).replace(
         "${PLATFORM}",
         get_platform()->name()
@@ -44,12 +44,15 @@
 #include "loaders/wav_loader.h"
 #include "loaders/ms3d_loader.h"
 #include "loaders/dtex_loader.h"
+#include "loaders/smsh_loader.h"
 
 #include "nodes/camera.h"
 
 #include "renderers/renderer_config.h"
 #include "sound.h"
 #include "compositor.h"
+#include "jobs/job_scheduler.h"
+#include "async_loader.h"
 #include "stage.h"
 #include "virtual_gamepad.h"
 #include "scenes/loading.h"
@@ -233,7 +236,9 @@ void Window::_clean_up() {
         sound_driver_.reset();
     }
 
+    async_loader_.reset();
     asset_manager_.reset();
+    jobs_.reset();
 
     destroy_window();
     GLThreadCheck::clean_up();
@@ -272,6 +277,22 @@ bool Window::initialize_assets_and_devices() {
     sound_driver_ = create_sound_driver(application_->config_.development.force_sound_driver);
     sound_driver_->startup();
 
+    if(!jobs_) {
+        /* The main thread runs jobs too, so by default leave it a core */
+        auto worker_count = application_->config_.general.job_worker_count;
+        if(worker_count < 0) {
+            worker_count = int32_t(thread::cpu_count()) - 1;
+        }
+
+        jobs_ = std::make_shared<jobs::JobScheduler>(std::size_t(worker_count));
+    }
+
+    if(!async_loader_) {
+        async_loader_ = std::make_shared<AsyncLoader>(
+            application_->config_.general.async_loader_thread_count
+        );
+    }
+
     // Initialize the render_sequence once we have a renderer
     compositor_ = std::make_shared<Compositor>(this);
 
@@ -303,6 +324,7 @@ bool Window::initialize_assets_and_devices() {
         register_loader(std::make_shared<smlt::loaders::WAVLoaderType>());
         register_loader(std::make_shared<smlt::loaders::MS3DLoaderType>());
         register_loader(std::make_shared<smlt::loaders::DTEXLoaderType>());
+        register_loader(std::make_shared<smlt::loaders::SMSHLoaderType>());
 
         S_INFO("Initializing the default resources");
 
@@ -489,6 +511,10 @@ bool Window::run_frame() {
 
     signal_frame_started_();
 
+    /* Nothing from the last frame is still running, so scratch memory
+     * can be reused */
+    jobs_->new_frame();
+
     float dt = 0.0f;
     if(!first_frame) {
         // Update timers
@@ -527,14 +553,21 @@ bool Window::run_frame() {
     {
         thread::Lock<thread::Mutex> rendering_lock(context_lock_);
         if(has_context()) {
+            /* Create any assets which have finished loading in the
+             * background, textures are uploaded as part of this */
+            async_loader_->update(application_->config_.general.async_load_budget_us);
 
             stats->reset_polygons_rendered();
+            stats->reset_instanced_draws();
             compositor_->run();
 
             signal_pre_swap_();
 
             swap_buffers();
-            GLChecker::end_of_frame_check();
+
+            if(!renderer_->is_headless()) {
+                GLChecker::end_of_frame_check();
+            }
 
             //std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
@@ -54,6 +54,12 @@ namespace scenes {
     class Loading;
 }
 
+class AsyncLoader;
+
+namespace jobs {
+    class JobScheduler;
+}
+
 class Application;
 class InputState;
 
@@ -345,6 +351,8 @@ private:
 
     std::shared_ptr<scenes::Loading> loading_;
     std::shared_ptr<smlt::Compositor> compositor_;
+    std::shared_ptr<jobs::JobScheduler> jobs_;
+    std::shared_ptr<AsyncLoader> async_loader_;
     generic::DataCarrier data_carrier_;
     std::shared_ptr<VirtualGamepad> virtual_gamepad_;
     std::shared_ptr<TimeKeeper> time_keeper_;
@@ -397,9 +405,18 @@ public:
     S_DEFINE_PROPERTY(input_state, &Window::input_state_);
     S_DEFINE_PROPERTY(stats, &Window::stats_);
     S_DEFINE_PROPERTY(compositor, &Window::compositor_);
+    S_DEFINE_PROPERTY(jobs, &Window::jobs_);
+    S_DEFINE_PROPERTY(async_loader, &Window::async_loader_);
 
     SoundDriver* _sound_driver() const { return sound_driver_.get(); }
 
+    /* Replaces the renderer and returns the previous one. This is for tests
+     * which stub out renderer capabilities, nothing is moved across */
+    std::shared_ptr<Renderer> _swap_renderer(std::shared_ptr<Renderer> renderer) {
+        std::swap(renderer_, renderer);
+        return renderer;
+    }
+
     void run_update();
     void run_fixed_updates();
     void request_frame_time(float ms);
@@ -16,11 +16,13 @@ private:
     StagePtr stage_;
     MeshPtr mesh_;
     CameraPtr camera_;
+    batcher::RenderQueue queue_;
 public:
     void set_up() {
         smlt::test::SimulantTestCase::set_up();
 
         vbo_manager_ = VBOManager::create();
+        queue_.clear();
         stage_ = window->new_stage();
 
         mesh_ = stage_->assets->new_mesh(smlt::VertexSpecification::DEFAULT);
@@ -29,123 +31,142 @@ public:
         camera_ = stage_->new_camera();
     }
 
+    Renderable* renderable_for(MeshPtr mesh) {
+        auto actor = stage_->new_actor_with_mesh(mesh->id());
+
+        queue_.reset(stage_, window->renderer.get(), camera_);
+        actor->_get_renderables(&queue_, camera_, DETAIL_LEVEL_NEAREST);
+
+        assert_equal(queue_.renderable_count(), 1u);
+        return queue_.renderable(0);
+    }
+
+    void fill_vertices(MeshPtr mesh, uint32_t count) {
+        mesh->vertex_data->clear();
+        for(auto i = 0u; i < count; ++i) {
+            mesh->vertex_data->position(Vec3());
+            mesh->vertex_data->move_next();
+        }
+
+        /* Make sure the update time moves on */
+        thread::sleep(1);
+        mesh->vertex_data->done();
+    }
+
     void test_shared_vertex_vbo() {
-        auto ret1 = vbo_manager_->allocate_slot(mesh_->vertex_data);
-        VBO* vbo = ret1.first;
-        assert_equal(vbo->used_slot_count(), 1u);
-        assert_equal(vbo->free_slot_count(), (VBO_SIZE / vbo->slot_size_in_bytes()) - 1);
+        auto buffers1 = vbo_manager_->update_and_fetch_buffers(renderable_for(mesh_));
+        auto used = vbo_manager_->vertex_arena_.used_bytes();
+        assert_true(used >= mesh_->vertex_data->data_size());
 
         auto mesh2 = stage_->assets->new_mesh(smlt::VertexSpecification::DEFAULT);
         mesh2->new_submesh_as_cube("cube", stage_->assets->new_material(), 1.0f);
 
-        auto ret3 = vbo_manager_->allocate_slot(mesh2->vertex_data);
-        assert_equal(ret1.first, ret3.first);
-        assert_not_equal(ret1.second, ret3.second); // New slot, same VBO
+        auto buffers2 = vbo_manager_->update_and_fetch_buffers(renderable_for(mesh2));
 
-        assert_equal(vbo->used_slot_count(), 2u);
-        assert_equal(vbo->free_slot_count(), (VBO_SIZE / vbo->slot_size_in_bytes()) - 2);
+        /* Same buffer, different range */
+        assert_equal(buffers1.vertex_vbo, buffers2.vertex_vbo);
+        assert_not_equal(buffers1.vertex_offset, buffers2.vertex_offset);
+        assert_equal(buffers2.vertex_offset % VBO_ALIGNMENT, 0u);
+        assert_equal(vbo_manager_->vertex_arena_.buffer_count(), 1u);
 
         stage_->assets->destroy_mesh(mesh2->id());
         mesh2.reset(); // Remove refcount
+        queue_.clear();
         stage_->assets->run_garbage_collection();
 
-        // Slot should've been freed
-        assert_equal(vbo->used_slot_count(), 1u);
-        assert_equal(vbo->free_slot_count(), (VBO_SIZE / vbo->slot_size_in_bytes()) - 1);
+        // Range should've been freed
+        assert_equal(vbo_manager_->vertex_arena_.used_bytes(), used);
     }
 
     void test_shared_index_vbo() {
-        auto ret1 = vbo_manager_->allocate_slot(mesh_->first_submesh()->index_data);
-        VBO* vbo = ret1.first;
-        assert_equal(vbo->used_slot_count(), 1u);
-        assert_equal(vbo->free_slot_count(), (VBO_SIZE / vbo->slot_size_in_bytes()) - 1);
+        auto buffers1 = vbo_manager_->update_and_fetch_buffers(renderable_for(mesh_));
+        auto used = vbo_manager_->index_arena_.used_bytes();
 
         auto mesh2 = stage_->assets->new_mesh(smlt::VertexSpecification::DEFAULT);
         mesh2->new_submesh_as_cube("cube", stage_->assets->new_material(), 1.0f);
 
-        auto ret3 = vbo_manager_->allocate_slot(mesh2->first_submesh()->index_data);
-        assert_equal(ret1.first, ret3.first);
-        assert_not_equal(ret1.second, ret3.second); // New slot, same VBO
-
-        assert_equal(vbo->used_slot_count(), 2u);
-        assert_equal(vbo->free_slot_count(), (VBO_SIZE / vbo->slot_size_in_bytes()) - 2);
+        auto buffers2 = vbo_manager_->update_and_fetch_buffers(renderable_for(mesh2));
+        assert_equal(buffers1.index_vbo, buffers2.index_vbo);
+        assert_not_equal(buffers1.index_offset, buffers2.index_offset);
 
         stage_->assets->destroy_mesh(mesh2->id());
         mesh2.reset(); // Remove refcount
+        queue_.clear();
         stage_->assets->run_garbage_collection();
 
-        // Slot should've been freed
-        assert_equal(vbo->used_slot_count(), 1u);
-        assert_equal(vbo->free_slot_count(), (VBO_SIZE / vbo->slot_size_in_bytes()) - 1);
+        assert_equal(vbo_manager_->index_arena_.used_bytes(), used);
     }
 
     void test_dedicated_vbo() {
-        auto ret1 = vbo_manager_->allocate_slot(mesh_->vertex_data);
-        VBO* vbo = ret1.first;
-        assert_equal(vbo->used_slot_count(), 1u);
-        assert_equal(vbo->free_slot_count(), (VBO_SIZE / vbo->slot_size_in_bytes()) - 1);
+        vbo_manager_->update_and_fetch_buffers(renderable_for(mesh_));
 
         auto mesh2 = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh2->new_submesh_as_cube("cube", stage_->assets->new_material(), 1.0f);
 
-        /* 50000 verts should tip over 512k always */
-        for(auto i = 0; i < 50000; ++i) {
-            mesh2->vertex_data->position(Vec3());
-            mesh2->vertex_data->move_next();
-        }
-        mesh2->vertex_data->done();
+        auto stride = mesh2->vertex_data->vertex_specification().stride();
+        fill_vertices(mesh2, (VBO_ARENA_BUFFER_SIZE / stride) + 1);
 
-        auto ret2 = vbo_manager_->allocate_slot(mesh2->vertex_data);
+        auto buffers = vbo_manager_->update_and_fetch_buffers(renderable_for(mesh2));
         assert_equal(vbo_manager_->dedicated_buffer_count(), 1u);
-
-        vbo = ret2.first;
-        assert_equal(vbo->used_slot_count(), 1u);
-        assert_equal(vbo->free_slot_count(), 0u); // No free slots in a dedicated one
+        assert_equal(buffers.vertex_offset, 0u);
 
         stage_->assets->destroy_mesh(mesh2->id());
         mesh2.reset(); // Remove refcount
+        queue_.clear();
         stage_->assets->run_garbage_collection();
 
         assert_equal(vbo_manager_->dedicated_buffer_count(), 0u);
     }
 
     void test_promotion_to_dedicated() {
-        auto ret1 = vbo_manager_->allocate_slot(mesh_->vertex_data);
-        VBO* vbo = ret1.first;
-        assert_equal(vbo->used_slot_count(), 1u);
-        assert_equal(vbo->free_slot_count(), (VBO_SIZE / vbo->slot_size_in_bytes()) - 1);
-
-        /* 50000 verts should tip over 512k always */
-        for(auto i = 0; i < 50000; ++i) {
-            mesh_->vertex_data->position(Vec3());
-            mesh_->vertex_data->move_next();
-        }
-        mesh_->vertex_data->done();
-
-        assert_equal(vbo->used_slot_count(), 1u);
+        auto renderable = renderable_for(mesh_);
+        vbo_manager_->update_and_fetch_buffers(renderable);
         assert_equal(vbo_manager_->dedicated_buffer_count(), 0u);
 
-        auto actor = stage_->new_actor_with_mesh(mesh_->id());
+        auto stride = mesh_->vertex_data->vertex_specification().stride();
+        fill_vertices(mesh_, (VBO_ARENA_BUFFER_SIZE / stride) + 1);
 
-        batcher::RenderQueue queue;
-        queue.reset(stage_, window->renderer.get(), camera_);
-
-        actor->_get_renderables(&queue, camera_, DETAIL_LEVEL_NEAREST);
+        vbo_manager_->update_and_fetch_buffers(renderable);
+        assert_equal(vbo_manager_->dedicated_buffer_count(), 1u);
+    }
 
-        std::vector<Renderable*> result;
-        for(auto i = 0u; i < queue.renderable_count(); ++i) {
-            result.push_back(queue.renderable(i));
-        }
+    void test_demotion_to_shared() {
+        auto renderable = renderable_for(mesh_);
 
-        vbo_manager_->update_and_fetch_buffers(result[0]);
+        auto stride = mesh_->vertex_data->vertex_specification().stride();
+        fill_vertices(mesh_, (VBO_ARENA_BUFFER_SIZE / stride) + 1);
 
+        vbo_manager_->update_and_fetch_buffers(renderable);
         assert_equal(vbo_manager_->dedicated_buffer_count(), 1u);
 
-        // VBO is not destroyed, maybe it should be?
-        assert_equal(vbo->used_slot_count(), 0u);
+        fill_vertices(mesh_, 24);
+
+        vbo_manager_->update_and_fetch_buffers(renderable);
+        assert_equal(vbo_manager_->dedicated_buffer_count(), 0u);
     }
 
-    void test_demotion_to_shared() {
-        throw test::SkippedTestError("Demotion from dedicated to shared VBOs when data reduces in size is not yet implemented. See #192");
+    void test_frequently_changing_data_is_streamed() {
+        auto renderable = renderable_for(mesh_);
+        vbo_manager_->update_and_fetch_buffers(renderable);
+        assert_false(vbo_manager_->is_streaming(mesh_->vertex_data));
+
+        for(auto i = 0u; i < VBO_STREAMING_PROMOTION_FRAMES; ++i) {
+            vbo_manager_->begin_frame();
+            fill_vertices(mesh_, 24);
+            vbo_manager_->update_and_fetch_buffers(renderable);
+        }
+
+        assert_true(vbo_manager_->is_streaming(mesh_->vertex_data));
+        assert_true(vbo_manager_->bytes_uploaded_ > 0u);
+
+        /* Unchanged data is written to the ring again once its copy
+         * has been recycled, and eventually moves back to an arena */
+        for(auto i = 0u; i < VBO_STREAMING_DEMOTION_FRAMES; ++i) {
+            vbo_manager_->begin_frame();
+            vbo_manager_->update_and_fetch_buffers(renderable);
+        }
+
+        assert_false(vbo_manager_->is_streaming(mesh_->vertex_data));
     }
 };
 
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <random>
+
+#include "simulant/test.h"
+#include "../simulant/partitioners/impl/aabb_tree.h"
+#include "../simulant/frustum.h"
+
+namespace {
+
+using namespace smlt;
+
+class AABBTreeTests : public smlt::test::TestCase {
+public:
+    void test_insert_and_remove() {
+        AABBTree tree;
+        int a, b;
+
+        auto pa = tree.insert(AABB(Vec3(0, 0, 0), 1.0), &a);
+        auto pb = tree.insert(AABB(Vec3(10, 0, 0), 1.0), &b);
+
+        assert_equal(tree.size(), 2u);
+        assert_equal(tree.user_data(pa), &a);
+        assert_true(tree.validate());
+
+        tree.remove(pa);
+        assert_equal(tree.size(), 1u);
+        assert_equal(tree.user_data(pb), &b);
+        assert_true(tree.validate());
+
+        tree.remove(pb);
+        assert_true(tree.empty());
+        assert_true(tree.validate());
+    }
+
+    void test_small_moves_stay_in_fat_aabb() {
+        AABBTree tree(0.5f);
+        int a;
+
+        auto proxy = tree.insert(AABB(Vec3(0, 0, 0), 1.0), &a);
+
+        assert_false(tree.update(proxy, AABB(Vec3(0.25, 0, 0), 1.0)));
+        assert_true(tree.update(proxy, AABB(Vec3(5, 0, 0), 1.0)));
+
+        assert_true(tree.fat_aabb(proxy).contains_point(Vec3(5, 0, 0)));
+    }
+
+    void test_retrieving_objects_within_a_box() {
+        AABBTree tree(0.0f);
+        int entry1, entry2, entry3;
+
+        tree.insert(AABB(Vec3(0.5, 0.5, 0.5), 0.5), &entry1);
+        tree.insert(AABB(Vec3(0, 0, 0), 5.0), &entry2);
+        tree.insert(AABB(Vec3(10, 10, 10), 1.0), &entry3);
+
+        std::vector<void*> results;
+        tree.find_objects_within_box(AABB(Vec3(), 5.0), results);
+        assert_equal(results.size(), 2u);
+
+        results.clear();
+        tree.find_objects_within_box(AABB(Vec3(150.0, 150.0, 150.0), 1.0), results);
+        assert_equal(results.size(), 0u);
+
+        results.clear();
+        tree.find_objects_within_box(AABB(Vec3(), 400), results);
+        assert_equal(results.size(), 3u);
+    }
+
+    void test_retrieving_objects_within_frustum() {
+        AABBTree tree;
+        int entry1, entry2, entry3, entry4;
+
+        tree.insert(AABB(Vec3(0.5, 0.5, -0.5), 0.5), &entry1);
+        tree.insert(AABB(Vec3(0, 0, -1), 5.0), &entry2);
+        tree.insert(AABB(Vec3(10, 10, -200), 1.0), &entry3);
+        tree.insert(AABB(Vec3(0, 0, 1), 1.0), &entry4);
+
+        Mat4 projection = Mat4::as_projection(Degrees(45.0), 16.0 / 9.0, 0.1, 100.0);
+
+        Frustum frustum;
+        frustum.build(&projection);
+
+        std::vector<void*> results;
+        tree.find_objects_within_frustum(frustum, results);
+
+        assert_equal(results.size(), 2u);
+    }
+
+    void test_retrieving_objects_intersecting_ray() {
+        AABBTree tree(0.0f);
+        int entry1, entry2, entry3;
+
+        tree.insert(AABB(Vec3(5, 0, 0), 1.0), &entry1);
+        tree.insert(AABB(Vec3(20, 0, 0), 1.0), &entry2);
+        tree.insert(AABB(Vec3(5, 10, 0), 1.0), &entry3);
+
+        std::vector<void*> results;
+        tree.find_objects_intersecting_ray(Vec3(), Vec3(1, 0, 0), 10.0f, results);
+
+        assert_equal(results.size(), 1u);
+        assert_equal(results[0], &entry1);
+
+        results.clear();
+        tree.find_objects_intersecting_ray(Vec3(), Vec3(1, 0, 0), 100.0f, results);
+        assert_equal(results.size(), 2u);
+    }
+
+    void test_tree_stays_balanced() {
+        AABBTree tree;
+
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+
+        const int count = 1000;
+        std::vector<int> entries(count);
+        std::vector<AABBTreeProxy> proxies;
+
+        /* Inserting in a line is the worst case without rotations */
+        for(int i = 0; i < count; ++i) {
+            proxies.push_back(tree.insert(AABB(Vec3(i * 2.0f, 0, 0), 1.0), &entries[i]));
+        }
+
+        assert_true(tree.validate());
+        assert_true(tree.height() < 32);
+
+        for(int i = 0; i < count; ++i) {
+            tree.update(proxies[i], AABB(Vec3(dist(rng), dist(rng), dist(rng)), 1.0));
+        }
+
+        for(int i = 0; i < count; i += 2) {
+            tree.remove(proxies[i]);
+        }
+
+        assert_equal(tree.size(), std::size_t(count / 2));
+        assert_true(tree.validate());
+        assert_true(tree.height() < 32);
+    }
+};
+
+}
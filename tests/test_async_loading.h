@@ -0,0 +1,169 @@
+#pragma once
+
+#include "simulant/simulant.h"
+#include "simulant/test.h"
+#include "simulant/async_loader.h"
+#include "simulant/loaders/obj_loader.h"
+
+namespace {
+
+using namespace smlt;
+
+class AsyncLoadingTests : public test::SimulantTestCase {
+public:
+    template<typename T>
+    void run_frames_until_finished(AssetFuture<T>& future) {
+        for(int i = 0; i < 1000 && !future.is_finished(); ++i) {
+            window->run_frame();
+            thread::sleep(1);
+        }
+    }
+
+    void test_texture_matches_synchronous_load() {
+        auto future = window->shared_assets->new_texture_from_file_async("flare.tga");
+        assert_true(future.is_valid());
+
+        run_frames_until_finished(future);
+
+        assert_true(future.is_ready());
+
+        auto tex = future.result();
+        auto expected = window->shared_assets->new_texture_from_file("flare.tga");
+
+        assert_true(tex);
+        assert_true(window->shared_assets->has_texture(tex->id()));
+        assert_equal(tex->width(), expected->width());
+        assert_equal(tex->height(), expected->height());
+    }
+
+    void test_mesh_loads_in_background() {
+        auto stage = window->new_stage();
+        auto future = stage->assets->new_mesh_from_file_async("cube.obj");
+
+        run_frames_until_finished(future);
+
+        assert_true(future.is_ready());
+        assert_equal(future.result()->submesh_count(), 1u);
+
+        window->destroy_stage(stage->id());
+    }
+
+    void test_obj_parsed_without_creating_assets() {
+        std::string obj_file(R"(
+            v 0 0 0
+            v 1 0 0
+            v 0 1 0
+            f 1 2 3
+        )");
+
+        loaders::OBJLoader loader(
+            "test.obj",
+            std::make_shared<std::istringstream>(obj_file)
+        );
+
+        auto materials = window->shared_assets->material_count();
+        auto textures = window->shared_assets->texture_count();
+
+        /* This is what runs on a loader thread */
+        loader.prepare();
+
+        assert_equal(window->shared_assets->material_count(), materials);
+        assert_equal(window->shared_assets->texture_count(), textures);
+
+        auto mesh = window->shared_assets->new_mesh(VertexSpecification::DEFAULT);
+        loader.into(*mesh);
+
+        assert_equal(mesh->vertex_data->count(), 3u);
+        assert_equal(mesh->submesh_count(), 1u);
+        assert_equal(mesh->first_submesh()->index_data->count(), 3u);
+    }
+
+    void test_missing_file_fails() {
+        auto future = window->shared_assets->new_texture_from_file_async("does_not_exist.png");
+
+        run_frames_until_finished(future);
+
+        assert_true(future.is_failed());
+        assert_false(future.result());
+    }
+
+    void test_cancelled_load_is_never_created() {
+        auto future = window->shared_assets->new_texture_from_file_async("flare.tga");
+        assert_true(future.cancel());
+
+        for(int i = 0; i < 100 && window->async_loader->pending_count(); ++i) {
+            window->run_frame();
+            thread::sleep(1);
+        }
+
+        assert_true(future.is_cancelled());
+        assert_false(future.result());
+    }
+
+    void test_higher_priority_finalised_first() {
+        /* No threads, so everything happens in update() */
+        AsyncLoader loader(0);
+
+        std::vector<int> order;
+        auto request = [&](int priority) {
+            return std::make_shared<AsyncLoadRequest>(priority, []() {}, [&order, priority]() {
+                order.push_back(priority);
+            });
+        };
+
+        loader.submit(request(0));
+        loader.submit(request(5));
+        loader.submit(request(-5));
+
+        /* A zero budget still finalises one request per update */
+        assert_equal(loader.update(0), 1u);
+        assert_equal(loader.update(0), 1u);
+        assert_equal(loader.update(0), 1u);
+        assert_equal(loader.pending_count(), 0u);
+
+        assert_equal(order.size(), 3u);
+        assert_equal(order[0], 5);
+        assert_equal(order[1], 0);
+        assert_equal(order[2], -5);
+    }
+
+    void test_pending_count_skips_cancelled() {
+        AsyncLoader loader(0);
+
+        auto first = std::make_shared<AsyncLoadRequest>(ASYNC_LOAD_PRIORITY_DEFAULT, []() {}, []() {});
+        auto second = std::make_shared<AsyncLoadRequest>(ASYNC_LOAD_PRIORITY_DEFAULT, []() {}, []() {});
+
+        loader.submit(first);
+        loader.submit(second);
+        assert_equal(loader.pending_count(), 2u);
+
+        assert_true(second->cancel());
+        assert_equal(loader.pending_count(), 1u);
+
+        /* The cancelled request is still queued, but nothing is left to
+         * finalise once the first is done */
+        assert_equal(loader.update(0), 1u);
+        assert_equal(first->status(), ASYNC_LOAD_STATUS_COMPLETE);
+        assert_equal(loader.pending_count(), 0u);
+    }
+
+    void test_cancel_fails_once_finalising() {
+        AsyncLoader loader(0);
+
+        bool cancelled = true;
+        AsyncLoadRequestPtr request;
+        request = std::make_shared<AsyncLoadRequest>(ASYNC_LOAD_PRIORITY_DEFAULT, []() {}, [&]() {
+            assert_equal(request->status(), ASYNC_LOAD_STATUS_FINALISING);
+            cancelled = request->cancel();
+        });
+
+        loader.submit(request);
+        loader.update(0);
+        loader.update(0);
+
+        assert_false(cancelled);
+        assert_equal(request->status(), ASYNC_LOAD_STATUS_COMPLETE);
+    }
+};
+
+}
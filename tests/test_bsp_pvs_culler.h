@@ -0,0 +1,117 @@
+#pragma once
+
+#include "simulant/simulant.h"
+#include "simulant/test.h"
+#include "simulant/nodes/geoms/bsp_pvs_culler.h"
+#include "simulant/nodes/geom.h"
+
+namespace {
+
+using namespace smlt;
+
+class BSPPVSCullerTests : public smlt::test::SimulantTestCase {
+public:
+    void test_decompress_pvs() {
+        BSPVisibility visibility;
+        visibility.cluster_faces.resize(20);
+
+        /* One byte, a run of one zero byte, then another byte */
+        visibility.pvs_data = {0x01, 0x00, 0x01, 0x80};
+        visibility.pvs_offsets = {0};
+
+        std::vector<uint8_t> bits;
+        visibility.decompress_pvs(0, bits);
+
+        assert_equal(bits.size(), 3u);
+        assert_equal(bits[0], 0x01);
+        assert_equal(bits[1], 0x00);
+        assert_equal(bits[2], 0x80);
+
+        /* No PVS for the cluster means everything is visible */
+        visibility.decompress_pvs(1, bits);
+        assert_equal(bits[1], 0xFF);
+    }
+
+    void test_only_potentially_visible_clusters_are_drawn() {
+        auto stage = window->new_stage();
+        auto camera = stage->new_camera();
+
+        auto mat1 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mat2 = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        auto left = mesh->new_submesh_as_box("left", mat1, 1.0, 1.0, 1.0, Vec3(-2, 0, -10));
+        auto right = mesh->new_submesh_as_box("right", mat2, 1.0, 1.0, 1.0, Vec3(2, 0, -10));
+
+        /* Split down x = 0, the left cluster can't see the right one but
+         * the right one can see both */
+        auto visibility = std::make_shared<BSPVisibility>();
+
+        BSPVisibility::Node node;
+        node.normal = Vec3(1, 0, 0);
+        node.distance = 0.0f;
+        node.children[0] = -2;
+        node.children[1] = -1;
+        visibility->nodes.push_back(node);
+
+        BSPVisibility::Leaf leaf;
+        leaf.cluster = 0;
+        visibility->leaves.push_back(leaf);
+        leaf.cluster = 1;
+        visibility->leaves.push_back(leaf);
+
+        visibility->faces.resize(2);
+        visibility->faces[0].material = mat1->id();
+        visibility->faces[0].indices = left->index_data->all();
+        visibility->faces[1].material = mat2->id();
+        visibility->faces[1].indices = right->index_data->all();
+
+        visibility->cluster_faces = {{0}, {1}};
+        visibility->pvs_data = {0x01, 0x03};
+        visibility->pvs_offsets = {0, 1};
+
+        mesh->data->stash(BSPVisibilityPtr(visibility), BSP_VISIBILITY_DATA_KEY);
+
+        GeomCullerOptions options;
+        options.type = GEOM_CULLER_TYPE_BSP_PVS;
+        auto geom = stage->new_geom_with_mesh(mesh->id(), options);
+
+        auto culler = dynamic_cast<BSPPVSCuller*>(geom->culler.get());
+        assert_true(culler);
+
+        batcher::RenderQueue queue;
+        queue.reset(stage, window->renderer.get(), camera);
+
+        culler->renderables_visible(camera->frustum(), Vec3(-1, 0, 0), &queue);
+        assert_equal(culler->visible_cluster(), 0);
+        assert_equal(queue.renderable_count(), 1u);
+        assert_equal(queue.renderable(0)->material, mat1.get());
+
+        queue.clear();
+        culler->renderables_visible(camera->frustum(), Vec3(1, 0, 0), &queue);
+        assert_equal(culler->visible_cluster(), 1);
+        assert_equal(queue.renderable_count(), 2u);
+
+        /* Moving back reuses the decompressed PVS */
+        queue.clear();
+        culler->renderables_visible(camera->frustum(), Vec3(-1, 0, 0), &queue);
+        assert_equal(queue.renderable_count(), 1u);
+        assert_equal(culler->pvs_cache_misses(), 2u);
+    }
+
+    void test_falls_back_without_visibility_data() {
+        auto stage = window->new_stage();
+
+        auto material = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_box("box", material, 1.0, 1.0, 1.0);
+
+        GeomCullerOptions options;
+        options.type = GEOM_CULLER_TYPE_BSP_PVS;
+        auto geom = stage->new_geom_with_mesh(mesh->id(), options);
+
+        assert_false(dynamic_cast<BSPPVSCuller*>(geom->culler.get()));
+    }
+};
+
+}
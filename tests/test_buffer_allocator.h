@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "simulant/test.h"
+#include "simulant/renderers/buffer_allocator.h"
+
+namespace {
+
+using namespace smlt;
+
+class BufferAllocatorTests : public smlt::test::TestCase {
+public:
+    void test_allocations_are_aligned_and_disjoint() {
+        BufferAllocator allocator(1024 * 64, 16);
+
+        auto a = allocator.allocate(10);
+        auto b = allocator.allocate(100);
+        auto c = allocator.allocate(1000);
+
+        assert_not_equal(c, BufferAllocator::INVALID_HANDLE);
+
+        assert_equal(allocator.offset(a) % 16, 0u);
+        assert_equal(allocator.offset(b) % 16, 0u);
+        assert_equal(allocator.offset(c) % 16, 0u);
+
+        assert_equal(allocator.size(a), 16u);
+        assert_true(allocator.offset(a) + allocator.size(a) <= allocator.offset(b));
+        assert_true(allocator.offset(b) + allocator.size(b) <= allocator.offset(c));
+
+        assert_equal(allocator.allocation_count(), 3u);
+    }
+
+    void test_exhaustion() {
+        BufferAllocator allocator(1024, 16);
+
+        auto all = allocator.allocate(1024);
+        assert_not_equal(all, BufferAllocator::INVALID_HANDLE);
+        assert_equal(allocator.free_bytes(), 0u);
+        assert_equal(allocator.allocate(16), BufferAllocator::INVALID_HANDLE);
+
+        allocator.release(all);
+        assert_equal(allocator.free_bytes(), 1024u);
+    }
+
+    void test_release_coalesces() {
+        BufferAllocator allocator(1024 * 64, 16);
+
+        std::vector<BufferAllocator::Handle> handles;
+        for(int i = 0; i < 64; ++i) {
+            handles.push_back(allocator.allocate(1024));
+        }
+
+        assert_equal(allocator.allocate(16), BufferAllocator::INVALID_HANDLE);
+
+        /* Free every other range, the space is there but it's split up */
+        for(auto i = 0u; i < handles.size(); i += 2) {
+            allocator.release(handles[i]);
+        }
+
+        assert_equal(allocator.largest_free_range(), 1024u);
+        assert_true(allocator.fragmentation() > 0.9f);
+        assert_equal(allocator.allocate(2048), BufferAllocator::INVALID_HANDLE);
+
+        for(auto i = 1u; i < handles.size(); i += 2) {
+            allocator.release(handles[i]);
+        }
+
+        assert_equal(allocator.largest_free_range(), 1024u * 64);
+        assert_close(allocator.fragmentation(), 0.0f, 0.0001f);
+        assert_equal(allocator.used_bytes(), 0u);
+    }
+};
+
+}
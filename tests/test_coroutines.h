@@ -25,6 +25,63 @@ public:
         assert_equal(value, 100);
     }
 
+    void test_resume_many() {
+        std::vector<cort::CoroutineID> routines;
+        int counter = 0;
+
+        for(int i = 0; i < 100; ++i) {
+            routines.push_back(cort::start_coroutine([&counter]() {
+                for(int j = 0; j < 3; ++j) {
+                    ++counter;
+                    cort::yield_coroutine();
+                }
+            }));
+        }
+
+        for(int frame = 0; frame < 3; ++frame) {
+            for(auto id: routines) {
+                assert_equal(cort::resume_coroutine(id), cort::CO_RESULT_RUNNING);
+            }
+
+            assert_equal(counter, (frame + 1) * 100);
+        }
+
+        for(auto id: routines) {
+            /* Returns from the final yield */
+            cort::resume_coroutine(id);
+            assert_equal(cort::resume_coroutine(id), cort::CO_RESULT_FINISHED);
+            cort::stop_coroutine(id);
+            assert_equal(cort::resume_coroutine(id), cort::CO_RESULT_INVALID);
+        }
+    }
+
+    void test_stop_unwinds_stack() {
+#ifndef SIMULANT_COROUTINE_UCONTEXT
+        skip_if(true, "Thread-backed coroutines exit without unwinding");
+#endif
+
+        auto destroyed = std::make_shared<bool>(false);
+
+        struct Guard {
+            std::shared_ptr<bool> flag;
+            ~Guard() { *flag = true; }
+        };
+
+        auto id = cort::start_coroutine([destroyed]() {
+            Guard guard{destroyed};
+            while(true) {
+                cort::yield_coroutine();
+            }
+        });
+
+        cort::resume_coroutine(id);
+        cort::resume_coroutine(id);
+        assert_false(*destroyed);
+
+        cort::stop_coroutine(id);
+        assert_true(*destroyed);
+    }
+
 };
 
 }
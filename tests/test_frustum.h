@@ -130,6 +130,40 @@ public:
 
         assert_close(frustum.depth(), 99.0f, 0.001f);
     }
+
+    void test_classify_aabb() {
+        Mat4 projection = Mat4::as_projection(Degrees(45.0), 16.0 / 9.0, 1.0, 100.0);
+
+        Frustum frustum;
+        frustum.build(&projection);
+
+        Vec3 half(0.5f, 0.5f, 0.5f);
+
+        assert_equal(frustum.classify_aabb(Vec3(0, 0, -10), half), FRUSTUM_CONTAINS_ALL);
+        assert_equal(frustum.classify_aabb(Vec3(0, 0, -1), Vec3(0.1f, 0.1f, 0.1f)), FRUSTUM_CONTAINS_PARTIAL);
+        assert_equal(frustum.classify_aabb(Vec3(0, 0, 10), half), FRUSTUM_CONTAINS_NONE);
+
+        /* The mask should only keep the planes which were straddled */
+        uint8_t mask = FRUSTUM_PLANE_MASK_ALL;
+        frustum.classify_aabb(Vec3(0, 0, -1), Vec3(0.1f, 0.1f, 0.1f), &mask);
+        assert_equal(mask, uint8_t(1 << FRUSTUM_PLANE_NEAR));
+
+        /* ...and the plane which rejected the box should be remembered */
+        uint8_t last_failed = FRUSTUM_PLANE_NONE;
+        frustum.classify_aabb(Vec3(0, 0, -200), half, nullptr, &last_failed);
+        assert_equal(last_failed, uint8_t(FRUSTUM_PLANE_FAR));
+
+        Vec3 centres[] = {Vec3(0, 0, -10), Vec3(0, 0, 10), Vec3(0, 0, -200)};
+        Vec3 extents[] = {half, half, half};
+        uint8_t visible[3];
+        uint8_t planes[3] = {FRUSTUM_PLANE_NONE, FRUSTUM_PLANE_NONE, FRUSTUM_PLANE_NONE};
+
+        assert_equal(frustum.cull_aabbs(centres, extents, 3, visible, planes), 1u);
+        assert_equal(visible[0], 1);
+        assert_equal(visible[1], 0);
+        assert_equal(visible[2], 0);
+        assert_equal(planes[2], uint8_t(FRUSTUM_PLANE_FAR));
+    }
 };
 
 #endif // TEST_FRUSTUM_H
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "simulant/test.h"
+#include "simulant/jobs/parallel.h"
+
+namespace {
+
+using namespace smlt;
+using namespace smlt::jobs;
+
+class JobSchedulerTests : public smlt::test::TestCase {
+public:
+    void test_parallel_for_runs_every_item() {
+        JobScheduler scheduler(3);
+
+        std::vector<int> results(1000, 0);
+        for(int run = 0; run < 3; ++run) {
+            parallel_for(scheduler, 0, results.size(), 16, [&results](std::size_t i) {
+                results[i] += int(i);
+            });
+        }
+
+        for(std::size_t i = 0; i < results.size(); ++i) {
+            assert_equal(results[i], int(i) * 3);
+        }
+    }
+
+    void test_parallel_reduce() {
+        JobScheduler scheduler(3);
+
+        auto total = parallel_reduce(
+            scheduler, 0, 100000, 100, uint64_t(0),
+            [](std::size_t begin, std::size_t end) -> uint64_t {
+                uint64_t sum = 0;
+                for(auto i = begin; i < end; ++i) {
+                    sum += i;
+                }
+                return sum;
+            },
+            [](uint64_t a, uint64_t b) { return a + b; }
+        );
+
+        assert_equal(total, uint64_t(99999) * 100000 / 2);
+    }
+
+    void test_no_workers() {
+        JobScheduler scheduler(0);
+
+        Counter counter;
+        int ran = 0;
+        scheduler.run([&ran]() { ++ran; }, &counter);
+        scheduler.run([&ran]() { ++ran; }, &counter);
+
+        assert_false(counter.is_complete());
+        scheduler.wait(counter);
+        assert_equal(ran, 2);
+    }
+
+    void test_run_after_waits_for_dependency() {
+        JobScheduler scheduler(3);
+
+        for(int run = 0; run < 20; ++run) {
+            std::atomic<int> first(0);
+            int seen = -1;
+
+            Counter dependency, done;
+            for(int i = 0; i < 50; ++i) {
+                scheduler.run([&first]() { ++first; }, &dependency);
+            }
+
+            scheduler.run_after(dependency, [&]() { seen = first.load(); }, &done);
+            scheduler.wait(done);
+            scheduler.wait(dependency);
+
+            assert_equal(seen, 50);
+        }
+    }
+
+    void test_stress_nested_jobs() {
+        JobScheduler scheduler(4);
+
+        std::atomic<int> total(0);
+
+        for(int frame = 0; frame < 50; ++frame) {
+            Counter counter;
+
+            for(int i = 0; i < 64; ++i) {
+                /* Jobs which spawn and wait on jobs of their own */
+                scheduler.run([&]() {
+                    Counter inner;
+                    for(int j = 0; j < 16; ++j) {
+                        scheduler.run([&total]() { ++total; }, &inner);
+                    }
+                    scheduler.wait(inner);
+                }, &counter);
+            }
+
+            scheduler.wait(counter);
+            assert_equal(total.load(), (frame + 1) * 64 * 16);
+            scheduler.new_frame();
+        }
+    }
+
+    void test_jobs_from_other_threads() {
+        JobScheduler scheduler(2);
+
+        Counter counter;
+        std::atomic<int> ran(0);
+
+        thread::Thread producer([&]() {
+            for(int i = 0; i < 500; ++i) {
+                scheduler.run([&ran]() { ++ran; }, &counter);
+            }
+        });
+        producer.join();
+
+        scheduler.wait(counter);
+        assert_equal(ran.load(), 500);
+    }
+
+    void test_frame_allocator() {
+        FrameAllocator allocator(256);
+
+        auto a = allocator.allocate_array<uint32_t>(16);
+        auto b = allocator.allocate(8, 64);
+
+        assert_equal(uintptr_t(a) % alignof(uint32_t), uintptr_t(0));
+        assert_equal(uintptr_t(b) % 64, uintptr_t(0));
+
+        /* Bigger than a block */
+        auto c = allocator.allocate_array<uint8_t>(1024);
+        c[1023] = 1;
+
+        auto capacity = allocator.capacity();
+        allocator.reset();
+        assert_equal(allocator.used(), 0u);
+
+        allocator.allocate_array<uint32_t>(16);
+        allocator.allocate_array<uint8_t>(1024);
+        assert_equal(allocator.capacity(), capacity);
+    }
+};
+
+}
@@ -50,6 +50,71 @@ public:
         assert_equal(pass2->diffuse(), smlt::Colour::RED);
     }
 
+    void test_parameter_block() {
+        auto mat = window->shared_assets->new_material();
+        mat->set_diffuse(smlt::Colour::RED);
+        mat->set_property_value("my_value", 2.0f);
+
+        auto pass = mat->pass(0);
+
+        auto& block = pass->parameter_block();
+        auto version = block.version();
+        auto layout = block.layout();
+
+        auto diffuse = block.find(DIFFUSE_PROPERTY_HASH);
+        assert_true(diffuse);
+        assert_equal(diffuse->offset % 16, 0u);
+        assert_equal(*block.value<Colour>(*diffuse), smlt::Colour::RED);
+
+        auto custom = block.find(material_property_hash("my_value"));
+        assert_true(custom);
+        assert_equal(*block.value<float>(*custom), 2.0f);
+
+        /* Nothing changed, nothing rebuilt */
+        assert_equal(pass->parameter_block().version(), version);
+
+        /* Changing the material changes the pass' values, but not the layout */
+        mat->set_diffuse(smlt::Colour::GREEN);
+        assert_not_equal(pass->parameter_block().version(), version);
+        assert_equal(pass->parameter_block().layout(), layout);
+        assert_equal(*block.value<Colour>(*block.find(DIFFUSE_PROPERTY_HASH)), smlt::Colour::GREEN);
+
+        pass->set_diffuse(smlt::Colour::BLUE);
+        assert_equal(*pass->parameter_block().value<Colour>(*block.find(DIFFUSE_PROPERTY_HASH)), smlt::Colour::BLUE);
+
+        /* New properties change the layout */
+        mat->set_property_value("my_other_value", 1);
+        assert_not_equal(pass->parameter_block().layout(), layout);
+    }
+
+    void test_parameter_block_layouts_are_shared() {
+        auto mat1 = window->shared_assets->new_material();
+        auto mat2 = window->shared_assets->new_material();
+
+        mat1->set_property_value("my_value", 2.0f);
+        mat2->set_property_value("my_value", 3.0f);
+
+        auto& block1 = mat1->pass(0)->parameter_block();
+        auto& block2 = mat2->pass(0)->parameter_block();
+
+        /* Same parameters, so a program can keep its uniform locations */
+        assert_equal(block1.layout(), block2.layout());
+        assert_not_equal(block1.version(), block2.version());
+    }
+
+    void test_custom_texture_matrix_in_parameter_block() {
+        auto mat = window->shared_assets->new_material();
+        mat->set_property_value("my_map", window->shared_assets->new_texture(8, 8));
+
+        mat->pass(0)->set_property_value("my_map_matrix", Mat4::as_scaling(2.0f));
+
+        auto& block = mat->pass(0)->parameter_block();
+        auto matrix = block.find(material_property_hash("my_map_matrix"));
+        assert_true(matrix);
+        assert_equal(block.value<Mat4>(*matrix)->data()[0], 2.0f);
+        assert_equal(block.value<Mat4>(*matrix)->data()[5], 2.0f);
+    }
+
     void test_pass_resizing() {
         auto mat1 = window->shared_assets->new_material();
 
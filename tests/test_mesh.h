@@ -379,6 +379,132 @@ public:
         assert_not_equal(mesh->id(), stage_->assets->find_mesh("Mesh 2")->id());
     }
 
+    void test_generate_lods() {
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::POSITION_ONLY);
+
+        /* A flat 10x10 grid, everything but the border can be collapsed
+         * without changing the shape */
+        const int size = 11;
+        for(int z = 0; z < size; ++z) {
+            for(int x = 0; x < size; ++x) {
+                mesh->vertex_data->position(float(x), 0.0f, float(z));
+                mesh->vertex_data->move_next();
+            }
+        }
+        mesh->vertex_data->done();
+
+        auto submesh = mesh->new_submesh("grid");
+        for(int z = 0; z < size - 1; ++z) {
+            for(int x = 0; x < size - 1; ++x) {
+                uint32_t i = (z * size) + x;
+                submesh->index_data->index(i);
+                submesh->index_data->index(i + size);
+                submesh->index_data->index(i + 1);
+                submesh->index_data->index(i + 1);
+                submesh->index_data->index(i + size);
+                submesh->index_data->index(i + size + 1);
+            }
+        }
+        submesh->index_data->done();
+
+        auto actor = stage_->new_actor_with_mesh(mesh->id());
+
+        auto report = mesh->generate_lods();
+        assert_equal(report.triangle_counts[DETAIL_LEVEL_NEAREST], 200u);
+        assert_equal(report.triangle_counts[DETAIL_LEVEL_NEAR], 100u);
+        assert_true(report.triangle_counts[DETAIL_LEVEL_FARTHEST] < report.triangle_counts[DETAIL_LEVEL_NEAR]);
+        assert_close(report.errors[DETAIL_LEVEL_FARTHEST], 0.0f, 0.0001f);
+
+        auto near = mesh->lod_mesh(DETAIL_LEVEL_NEAR);
+        assert_true(near);
+        assert_equal(near->vertex_data.get(), mesh->vertex_data.get());
+        assert_equal(near->first_submesh()->index_data->count(), 300u);
+
+        /* Actors pick the new levels up, but explicit meshes win */
+        assert_equal(actor->best_mesh(DETAIL_LEVEL_NEAREST)->id(), mesh->id());
+        assert_equal(actor->best_mesh(DETAIL_LEVEL_NEAR)->id(), near->id());
+
+        auto other = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        actor->set_mesh(other->id(), DETAIL_LEVEL_NEAR);
+        assert_equal(actor->best_mesh(DETAIL_LEVEL_NEAR)->id(), other->id());
+    }
+
+    void test_simplify_collapses_along_seams() {
+        /* The same 10x10 grid, but with the middle column split in two like
+         * a UV seam, the right half using its own copies */
+        const int size = 11;
+        std::vector<Vec3> positions;
+        for(int z = 0; z < size; ++z) {
+            for(int x = 0; x < size; ++x) {
+                positions.push_back(Vec3(float(x), 0.0f, float(z)));
+            }
+        }
+
+        const uint32_t seam_start = positions.size();
+        for(int z = 0; z < size; ++z) {
+            positions.push_back(Vec3(5.0f, 0.0f, float(z)));
+        }
+
+        auto index = [&](int x, int z, bool right) -> uint32_t {
+            return (x == 5 && right) ? seam_start + z : (z * size) + x;
+        };
+
+        std::vector<std::vector<uint32_t>> lists(1);
+        for(int z = 0; z < size - 1; ++z) {
+            for(int x = 0; x < size - 1; ++x) {
+                bool right = x >= 5;
+                lists[0].push_back(index(x, z, right));
+                lists[0].push_back(index(x, z + 1, right));
+                lists[0].push_back(index(x + 1, z, right));
+                lists[0].push_back(index(x + 1, z, right));
+                lists[0].push_back(index(x, z + 1, right));
+                lists[0].push_back(index(x + 1, z + 1, right));
+            }
+        }
+
+        auto result = utils::simplify(positions, lists, 0, 0.05f);
+
+        /* Pinning the seam would leave at least 56 triangles */
+        assert_equal(result.triangles_before, 200u);
+        assert_true(result.triangles_after < 56u);
+
+        /* Neither side picked up the other's vertices, and every edge away
+         * from the border is still shared by two triangles so the seam
+         * hasn't cracked open */
+        auto on_border = [](const Vec3& p) {
+            return p.x == 0.0f || p.x == 10.0f || p.z == 0.0f || p.z == 10.0f;
+        };
+
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> edges;
+        auto position_id = [&](uint32_t i) -> uint32_t {
+            return uint32_t(positions[i].z) * size + uint32_t(positions[i].x);
+        };
+
+        auto& indices = lists[0];
+        for(std::size_t i = 0; i < indices.size(); i += 3) {
+            bool left = false, right = false;
+            for(uint32_t k = 0; k < 3; ++k) {
+                auto v = indices[i + k];
+                left = left || (v < seam_start && positions[v].x < 5.0f);
+                right = right || v >= seam_start || positions[v].x > 5.0f;
+
+                auto a = position_id(v);
+                auto b = position_id(indices[i + ((k + 1) % 3)]);
+                edges[std::make_pair(std::min(a, b), std::max(a, b))]++;
+            }
+
+            assert_false(left && right);
+        }
+
+        for(auto& edge: edges) {
+            if(edge.second != 2) {
+                auto a = edge.first.first;
+                auto b = edge.first.second;
+                assert_true(on_border(positions[a]) && on_border(positions[b]));
+            }
+        }
+    }
+
 private:
     smlt::CameraPtr camera_;
     smlt::StagePtr stage_;
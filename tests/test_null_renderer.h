@@ -0,0 +1,85 @@
+#pragma once
+
+#include "simulant/simulant.h"
+#include "simulant/test.h"
+#include "simulant/renderers/null/null_renderer.h"
+#include "simulant/renderers/renderer_config.h"
+
+namespace {
+
+using namespace smlt;
+
+class NullRendererTests : public smlt::test::SimulantTestCase {
+public:
+    void set_up() {
+        SimulantTestCase::set_up();
+        stage_ = window->new_stage();
+    }
+
+    void tear_down() {
+        window->destroy_stage(stage_->id());
+    }
+
+    void test_traversal_is_recorded() {
+        NullRenderer renderer(window);
+
+        auto mat1 = stage_->assets->new_material();
+        auto mat2 = stage_->assets->new_material();
+
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("one", mat1, 1.0f);
+        mesh->new_submesh_as_cube("two", mat2, 1.0f);
+
+        auto actor = stage_->new_actor_with_mesh(mesh);
+        auto camera = stage_->new_camera();
+
+        batcher::RenderQueue queue;
+        queue.reset(stage_, &renderer, camera);
+        actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+
+        auto visitor = renderer.get_render_queue_visitor(camera);
+        queue.traverse(visitor.get(), 0);
+
+        assert_equal(renderer.stats().traversals, 1u);
+        assert_equal(renderer.stats().draws, 2u);
+        assert_equal(renderer.stats().render_group_changes, 2u);
+        assert_equal(renderer.stats().elements, uint64_t(72));
+
+        renderer.reset_stats();
+        assert_equal(renderer.stats().draws, 0u);
+    }
+
+    void test_builtin_materials_are_fixed_function() {
+        auto renderer = std::make_shared<NullRenderer>(window);
+        assert_equal(renderer->material_directory(), "gl1x");
+
+        auto previous = window->_swap_renderer(renderer);
+        auto path = window->vfs->locate_file(Material::BuiltIns::LIT_TEXTURED);
+        window->_swap_renderer(previous);
+
+        assert_true(path.str().find("gl1x") != std::string::npos);
+    }
+
+    void test_renderer_chosen_from_environment() {
+        const char* current = std::getenv("SIMULANT_RENDERER");
+        std::string previous = (current) ? current : "";
+
+        setenv("SIMULANT_RENDERER", NULL_RENDERER_NAME.c_str(), 1);
+        auto renderer = new_renderer(window, "gl2x");
+
+        if(current) {
+            setenv("SIMULANT_RENDERER", previous.c_str(), 1);
+        } else {
+            unsetenv("SIMULANT_RENDERER");
+        }
+
+        assert_true(renderer);
+        assert_equal(renderer->name(), NULL_RENDERER_NAME);
+        assert_true(renderer->is_headless());
+    }
+
+private:
+    StagePtr stage_;
+};
+
+}
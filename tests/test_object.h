@@ -219,6 +219,85 @@ public:
         assert_equal(10.0f, actor2->absolute_position().z);
     }
 
+    void test_deep_hierarchy_resolves_lazily() {
+        std::vector<ActorPtr> chain;
+        chain.push_back(stage_->new_actor());
+
+        for(int i = 1; i < 50; ++i) {
+            auto actor = stage_->new_actor();
+            actor->set_parent(chain.back());
+            actor->move_to(1, 0, 0);
+            chain.push_back(actor);
+        }
+
+        stage_->transforms->resolve_all();
+
+        for(int i = 0; i < 10; ++i) {
+            chain[0]->move_to(i, 0, 0);
+        }
+
+        assert_equal(smlt::Vec3(58, 0, 0), chain.back()->absolute_position());
+        assert_equal(smlt::Vec3(34, 0, 0), chain[25]->absolute_position());
+
+        chain[0]->rotate_to(smlt::Quaternion(smlt::Degrees(0), smlt::Degrees(90), smlt::Degrees(0)));
+        stage_->transforms->resolve_all();
+
+        assert_close(chain.back()->absolute_position().z, -49.0f, 0.0001f);
+    }
+
+    void test_resolve_all_updates_bounds() {
+        auto mesh = stage_->assets->new_mesh(smlt::VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", stage_->assets->new_material(), 1.0f);
+
+        auto parent = stage_->new_actor();
+        auto child = stage_->new_actor_with_mesh(mesh);
+        child->set_parent(parent);
+        stage_->transforms->resolve_all();
+
+        smlt::AABB bounds;
+        child->signal_bounds_updated().connect([&](const smlt::AABB& aabb) {
+            bounds = aabb;
+        });
+
+        parent->move_to(10, 0, 0);
+        stage_->transforms->resolve_all();
+
+        assert_close(bounds.centre().x, 10.0f, 0.0001f);
+    }
+
+    void test_transformed_aabb_follows_unresolved_move() {
+        auto mesh = stage_->assets->new_mesh(smlt::VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", stage_->assets->new_material(), 1.0f);
+
+        auto actor = stage_->new_actor_with_mesh(mesh);
+        stage_->transforms->resolve_all();
+
+        actor->move_to(10, 0, 0);
+
+        /* No resolve_all() in between */
+        assert_close(actor->transformed_aabb().centre().x, 10.0f, 0.0001f);
+    }
+
+    void test_released_slot_detaches_children() {
+        auto transforms = stage_->transforms.get();
+
+        auto parent = stage_->new_actor();
+        auto child = stage_->new_actor();
+        child->set_parent(parent);
+        transforms->resolve_all();
+
+        auto parent_slot = parent->transform_slot_;
+        auto child_slot = child->transform_slot_;
+        assert_equal(transforms->parent(child_slot), parent_slot);
+
+        transforms->release(parent_slot);
+        assert_equal(transforms->parent(child_slot), smlt::NULL_TRANSFORM_SLOT);
+        assert_true(transforms->is_dirty(child_slot));
+
+        /* Give the slot back so the parent can be destroyed as usual */
+        parent->transform_slot_ = transforms->allocate(parent);
+    }
+
     void test_set_parent_to_self_does_nothing() {
         auto actor1 = stage_->new_actor();
 
@@ -298,6 +377,24 @@ public:
         a2->late_update(0);
         assert_equal(a2->absolute_position(), smlt::Vec3(50, 0, 0));
     }
+    void test_absolute_transformation_without_transform_system() {
+        /* The stage has no transform slot, so composes its own */
+        stage_->move_to(1, 2, 3);
+        stage_->rotate_y_by(smlt::Degrees(30));
+        stage_->scale_by(smlt::Vec3(2, 3, 4));
+
+        auto actor = stage_->new_actor();
+        actor->move_to(1, 2, 3);
+        actor->rotate_y_by(smlt::Degrees(30));
+        actor->scale_by(smlt::Vec3(2, 3, 4));
+
+        auto expected = actor->absolute_transformation();
+        auto actual = stage_->absolute_transformation();
+        for(int i = 0; i < 16; ++i) {
+            assert_close(expected[i], actual[i], 0.0001f);
+        }
+    }
+
 private:
     smlt::CameraPtr camera_;
     smlt::StagePtr stage_;
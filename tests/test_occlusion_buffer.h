@@ -0,0 +1,80 @@
+#pragma once
+
+#include "simulant/test.h"
+#include "simulant/renderers/occlusion_buffer.h"
+
+namespace {
+
+using namespace smlt;
+
+class OcclusionBufferTests : public smlt::test::TestCase {
+public:
+    void set_up() {
+        TestCase::set_up();
+
+        /* The default camera looks down -Z from the origin */
+        projection_ = Mat4::as_projection(Degrees(60), 2.0f, 1.0f, 100.0f);
+
+        /* A wall 10 units square, 10 units away */
+        wall_.vertices = {
+            Vec3(-5, -5, -10), Vec3(5, -5, -10), Vec3(5, 5, -10), Vec3(-5, 5, -10)
+        };
+        wall_.indices = {0, 1, 2, 0, 2, 3};
+    }
+
+    void test_boxes_behind_occluders_are_hidden() {
+        OcclusionBuffer buffer;
+        buffer.begin(projection_);
+        buffer.rasterize(Mat4(), wall_);
+        buffer.finish();
+
+        assert_equal(buffer.triangles_rasterized(), 2u);
+
+        assert_false(buffer.is_visible(AABB(Vec3(0, 0, -20), 1.0f)));
+        assert_true(buffer.is_visible(AABB(Vec3(0, 0, -5), 1.0f)));
+        assert_true(buffer.is_visible(AABB(Vec3(15, 0, -20), 1.0f)));
+
+        /* Partly behind the wall, partly sticking out */
+        assert_true(buffer.is_visible(AABB(Vec3(10, 0, -20), 2.0f)));
+    }
+
+    void test_winding_is_ignored() {
+        wall_.indices = {0, 2, 1, 0, 3, 2};
+
+        OcclusionBuffer buffer;
+        buffer.begin(projection_);
+        buffer.rasterize(Mat4(), wall_);
+        buffer.finish();
+
+        assert_false(buffer.is_visible(AABB(Vec3(0, 0, -20), 1.0f)));
+    }
+
+    void test_triangles_crossing_the_near_plane_are_skipped() {
+        OcclusionBuffer buffer;
+        buffer.begin(projection_);
+        buffer.rasterize(Mat4::as_translation(Vec3(0, 0, 10)), wall_);
+        buffer.finish();
+
+        assert_equal(buffer.triangles_rasterized(), 0u);
+        assert_true(buffer.is_visible(AABB(Vec3(0, 0, -20), 1.0f)));
+    }
+
+    void test_hierarchical_z_holds_farthest_depth() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.begin(projection_);
+        buffer.rasterize(Mat4(), wall_);
+        buffer.finish();
+
+        /* The middle of the screen is covered by the wall, the corner isn't */
+        auto centre = buffer.tile_depth_at(4, 2);
+        assert_true(centre < 1.0f);
+        assert_close(centre, buffer.depth_at(32, 16), 0.0001f);
+        assert_equal(buffer.tile_depth_at(0, 0), 1.0f);
+    }
+
+private:
+    Mat4 projection_;
+    OccluderGeometry wall_;
+};
+
+}
@@ -2,6 +2,8 @@
 
 #include "simulant/simulant.h"
 #include "simulant/test.h"
+#include "simulant/assets/particles/colour_fader.h"
+#include "simulant/assets/particles/size_manipulator.h"
 
 namespace {
 
@@ -34,6 +36,141 @@ public:
 
         assert_false(system->has_active_emitters());
     }
+
+    void test_quota_is_respected() {
+        auto stage = window->new_stage();
+        ParticleScriptPtr script = stage->assets->new_particle_script_from_file(
+            ParticleScript::BuiltIns::FIRE
+        );
+
+        script->set_quota(10);
+        script->mutable_emitter(0)->emission_rate = 1000.0f;
+
+        ParticleSystemPtr system = stage->new_particle_system(script);
+        system->update(1.0f);
+
+        assert_equal(10u, system->particle_count());
+        assert_equal(10u, system->particles().capacity());
+    }
+
+    void test_expired_particles_are_compacted() {
+        particles::ParticleArrays particles;
+        particles.set_capacity(10);
+
+        /* Every other particle expires after the first update */
+        for(int i = 0; i < 10; ++i) {
+            particles.push(
+                Vec3(i, 0, 0), Vec3(0, 1, 0), Vec2(1, 1),
+                (i % 2) ? 5.0f : 0.5f, Colour::WHITE
+            );
+        }
+
+        particles::integrate(particles, 1.0f);
+        assert_equal(5u, particles::kill_expired(particles));
+        assert_equal(5u, particles.count());
+
+        float total = 0.0f;
+        for(std::size_t i = 0; i < particles.count(); ++i) {
+            assert_close(4.0f, particles.ttl[i], 0.0001f);
+            assert_close(1.0f, particles.y[i], 0.0001f);
+            total += particles.x[i];
+        }
+
+        /* The odd particles survived */
+        assert_close(1.0f + 3.0f + 5.0f + 7.0f + 9.0f, total, 0.0001f);
+
+        /* Growing keeps the live particles */
+        particles.set_capacity(100);
+        assert_equal(5u, particles.count());
+        assert_close(4.0f, particles.ttl[4], 0.0001f);
+    }
+
+    void test_colour_fader_blends_between_colours() {
+        particles::ParticleArrays particles;
+        fill_part_way_through_lifetimes(particles);
+
+        std::vector<Colour> colours = {Colour::RED, Colour::GREEN, Colour::BLUE};
+        ColourFader fader(nullptr, colours, true);
+        fader.manipulate(nullptr, particles, 0.0f);
+
+        for(std::size_t i = 0; i < particles.count(); ++i) {
+            /* The per-particle loop the blocked version replaced */
+            float t = colours.size() * ((particles.lifetime[i] - particles.ttl[i]) / particles.lifetime[i]);
+            std::size_t c = std::size_t(t);
+            float f = t - float(c);
+            Colour expected = colours[c] * (1.0f - f) + colours[std::min(c + 1, colours.size() - 1)] * f;
+
+            auto colour = particles.colour(i);
+            assert_close(expected.r, colour.r, 0.0001f);
+            assert_close(expected.g, colour.g, 0.0001f);
+            assert_close(expected.b, colour.b, 0.0001f);
+            assert_close(expected.a, colour.a, 0.0001f);
+        }
+
+        /* Without interpolation each particle takes the colour it's in */
+        ColourFader stepped(nullptr, colours, false);
+        stepped.manipulate(nullptr, particles, 0.0f);
+
+        for(std::size_t i = 0; i < particles.count(); ++i) {
+            float t = colours.size() * ((particles.lifetime[i] - particles.ttl[i]) / particles.lifetime[i]);
+            assert_true(particles.colour(i) == colours[std::size_t(t)]);
+        }
+    }
+
+    void test_size_manipulator_follows_curve() {
+        auto stage = window->new_stage();
+        ParticleScriptPtr script = stage->assets->new_particle_script_from_file(
+            ParticleScript::BuiltIns::FIRE
+        );
+
+        /* Only the x scale of the system is applied to the curve */
+        ParticleSystemPtr system = stage->new_particle_system(script);
+        system->scale_by(Vec3(2.0f, 3.0f, 1.0f));
+
+        particles::ParticleArrays particles;
+        fill_part_way_through_lifetimes(particles);
+
+        SizeManipulator linear(script.get());
+        linear.set_linear_curve(0.5f);
+        linear.manipulate(system, particles, 0.0f);
+
+        for(std::size_t i = 0; i < particles.count(); ++i) {
+            float e = particles.lifetime[i] - particles.ttl[i];
+            float n = e / particles.lifetime[i];
+            assert_close(linear_curve(particles.initial_width[i], n, e, 1.0f), particles.width[i], 0.0001f);
+            assert_close(linear_curve(particles.initial_height[i], n, e, 1.0f), particles.height[i], 0.0001f);
+        }
+
+        SizeManipulator bell(script.get());
+        bell.set_bell_curve(3.0f, 0.25f);
+        bell.manipulate(system, particles, 0.0f);
+
+        for(std::size_t i = 0; i < particles.count(); ++i) {
+            float e = particles.lifetime[i] - particles.ttl[i];
+            float n = e / particles.lifetime[i];
+            assert_close(bell_curve(particles.initial_width[i], n, e, 6.0f, 0.25f), particles.width[i], 0.0001f);
+            assert_close(bell_curve(particles.initial_height[i], n, e, 6.0f, 0.25f), particles.height[i], 0.0001f);
+        }
+
+        window->destroy_stage(stage->id());
+    }
+
+private:
+    /* Seven particles, so the last block of four is only partly live */
+    void fill_part_way_through_lifetimes(particles::ParticleArrays& particles) {
+        particles.set_capacity(7);
+
+        for(int i = 0; i < 7; ++i) {
+            float lifetime = 2.0f + float(i);
+            particles.push(
+                Vec3(), Vec3(), Vec2(1.0f + i, 2.0f + i), lifetime, Colour::WHITE
+            );
+
+            particles.ttl[i] = lifetime * (1.0f - (float(i) + 0.5f) / 7.0f);
+        }
+
+        assert_not_equal(particles.count() % particles::PARTICLE_SIMD_WIDTH, 0u);
+    }
 };
 
 }
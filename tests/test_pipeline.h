@@ -96,7 +96,121 @@ public:
         assert_not_equal(p->camera(), camera);
     }
 
+    void test_pose_evaluated_once_per_frame() {
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_cube("cube", stage->assets->new_material(), 1.0);
+
+        auto unpacker = std::make_shared<CountingUnpacker>(source->vertex_data.get());
+        source->enable_animation(MESH_ANIMATION_TYPE_VERTEX_MORPH, 2, unpacker);
+        source->add_animation("idle", 0, 1, 1.0f);
+
+        auto actor = stage->new_actor_with_mesh(source);
+        actor->move_to(0, 0, -10);
+
+        camera->set_perspective_projection(Degrees(45.0), 1.0);
+
+        auto p1 = window->compositor->render(stage, camera);
+        auto p2 = window->compositor->render(stage, camera);
+        p1->activate();
+        p2->activate();
+
+        window->compositor->run();
+
+        assert_equal(unpacker->unpacked, 1u);
+        assert_equal(window->stats->poses_evaluated(), 1u);
+        assert_equal(window->stats->poses_reused(), 1u);
+
+        /* Culled actors aren't animated at all */
+        actor->move_to(0, 0, 10);
+        window->compositor->run();
+
+        assert_equal(unpacker->unpacked, 1u);
+        assert_equal(window->stats->poses_evaluated(), 0u);
+
+        p1->destroy();
+        p2->destroy();
+    }
+
+    void test_pose_unpacked_outside_frame_when_stale() {
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_cube("cube", stage->assets->new_material(), 1.0);
+
+        auto unpacker = std::make_shared<CountingUnpacker>(source->vertex_data.get());
+        source->enable_animation(MESH_ANIMATION_TYPE_VERTEX_MORPH, 2, unpacker);
+        source->add_animation("idle", 0, 1, 1.0f);
+
+        auto actor = stage->new_actor_with_mesh(source);
+
+        batcher::RenderQueue queue;
+        queue.reset(stage, window->renderer.get(), camera);
+
+        actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+        actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+        assert_equal(unpacker->unpacked, 1u);
+
+        /* Moving the animation on makes the cached pose out of date */
+        actor->update(0.1f);
+        actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+        assert_equal(unpacker->unpacked, 2u);
+    }
+
+    void test_occluded_nodes_are_not_gathered() {
+        auto mesh = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", stage->assets->new_material(), 1.0);
+
+        /* A flat wall with a cube hidden behind it */
+        auto wall = stage->new_actor_with_mesh(mesh);
+        wall->move_to(0, 0, -10);
+        wall->scale_by(Vec3(4.0f, 4.0f, 1.0f));
+        wall->set_occluder_mesh(mesh);
+
+        auto hidden = stage->new_actor_with_mesh(mesh);
+        hidden->move_to(0, 0, -30);
+
+        camera->set_perspective_projection(Degrees(45.0), 1.0);
+
+        pipeline->set_occlusion_culling_enabled(true);
+        pipeline->activate();
+        window->compositor->run();
+
+        auto& queue = window->compositor->render_queues_[pipeline];
+        assert_equal(window->stats->nodes_occluded(), 1u);
+        assert_equal(queue->renderable_count(), 1u);
+
+        /* Moving out from behind the wall brings it back */
+        hidden->move_to(8, 0, -30);
+        window->compositor->run();
+
+        assert_equal(window->stats->nodes_occluded(), 0u);
+        assert_equal(queue->renderable_count(), 2u);
+
+        hidden->move_to(0, 0, -30);
+        pipeline->set_occlusion_culling_enabled(false);
+        window->compositor->run();
+
+        assert_equal(window->stats->nodes_occluded(), 0u);
+        assert_equal(queue->renderable_count(), 2u);
+    }
+
 private:
+    class CountingUnpacker : public FrameUnpacker {
+    public:
+        CountingUnpacker(VertexData* source):
+            source_(source) {}
+
+        void prepare_unpack(uint32_t, uint32_t, float, Rig* const, Debug* const) override {}
+
+        void unpack_frame(const uint32_t, const uint32_t, const float, Rig* const, VertexData* const out, Debug* const) override {
+            source_->clone_into(*out);
+            ++unpacked;
+        }
+
+        uint32_t unpacked = 0;
+
+    private:
+        VertexData* source_;
+    };
+
     StagePtr stage;
     CameraPtr camera;
     PipelinePtr pipeline;
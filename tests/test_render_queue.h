@@ -3,7 +3,10 @@
 #include "simulant/simulant.h"
 #include "simulant/test.h"
 #include "simulant/renderers/batching/render_queue.h"
+#include "simulant/renderers/null/null_renderer.h"
+#include "simulant/renderers/gl2x/generic_renderer.h"
 #include "simulant/generic/containers/contiguous_map.h"
+#include "simulant/jobs/job_scheduler.h"
 
 namespace {
 
@@ -97,7 +100,571 @@ public:
         assert_true(pass0_blended_100_tex1 < pass1_blended_10_tex1);
     }
 
+    void test_render_key_ordering() {
+        using batcher::generate_render_key;
+        using batcher::generate_render_group_key;
+
+        // Priority always takes precedence
+        assert_true(
+            generate_render_key(RENDER_PRIORITY_BACKGROUND, generate_render_group_key(1, true, 1.0f, 5, 5)) <
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, false, 100.0f, 1, 1))
+        );
+
+        // Then the pass, then blending
+        assert_true(
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, true, 1.0f)) <
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(1, false, 1.0f))
+        );
+
+        assert_true(
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, false, 100.0f)) <
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, true, 1.0f))
+        );
+
+        // Opaque renderables are grouped by material, then front-to-back
+        assert_true(
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, false, 100.0f, 1, 1)) <
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, false, 1.0f, 2, 1))
+        );
+
+        assert_true(
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, false, 10.0f, 1, 1)) <
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, false, 10.5f, 1, 1))
+        );
+
+        // Blended renderables are always back-to-front
+        assert_true(
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, true, 100.0f, 2, 1)) <
+            generate_render_key(RENDER_PRIORITY_MAIN, generate_render_group_key(0, true, 10.0f, 1, 1))
+        );
+    }
+
+    void test_depth_quantisation() {
+        assert_equal(batcher::quantise_depth(-5.0f), 0u);
+        assert_equal(batcher::quantise_depth(0.0f), 0u);
+        assert_true(batcher::quantise_depth(0.5f) < batcher::quantise_depth(1.0f));
+        assert_true(batcher::quantise_depth(1000.0f) < batcher::quantise_depth(1001.0f));
+    }
+
+    void test_radix_sort_is_stable() {
+        std::vector<std::pair<uint64_t, int>> values = {
+            {3, 0}, {1, 1}, {0xFF00000000000000ull, 2}, {1, 3}, {256, 4}, {3, 5}
+        };
+
+        std::vector<std::pair<uint64_t, int>> scratch;
+        radix_sort(values, scratch, [](const std::pair<uint64_t, int>& p) { return p.first; });
+
+        std::vector<int> order;
+        for(auto& p: values) {
+            order.push_back(p.second);
+        }
+
+        std::vector<int> expected = {1, 3, 0, 5, 4, 2};
+        for(std::size_t i = 0; i < expected.size(); ++i) {
+            assert_equal(order[i], expected[i]);
+        }
+    }
+
+    void test_unchanged_nodes_are_reused() {
+        auto material = stage_->assets->new_material();
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", material, 1.0f);
+
+        auto actor = stage_->new_actor_with_mesh(mesh);
+        auto camera = stage_->new_camera();
+
+        batcher::RenderQueue queue;
+
+        auto gather = [&]() -> bool {
+            queue.reset(stage_, window->renderer.get(), camera);
+            bool reused = queue.begin_node(actor, actor->renderables_version(), DETAIL_LEVEL_NEAREST);
+            if(!reused) {
+                actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+            }
+            queue.end_node();
+            return reused;
+        };
+
+        assert_false(gather());
+        assert_true(gather());
+        assert_equal(queue.renderable_count(), 1u);
+        assert_equal(queue.reused_node_count(), 1u);
+
+        actor->move_to(0, 0, -10);
+        assert_false(gather());
+        assert_true(gather());
+
+        material->set_diffuse(Colour::RED);
+        assert_false(gather());
+        assert_true(gather());
+
+        /* Queues which don't sort never reuse anything */
+        queue.set_sorting_enabled(false);
+        assert_false(gather());
+    }
+
+    void test_dynamic_batching() {
+        NullRenderer renderer(window);
+
+        auto material = stage_->assets->new_material();
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", material, 1.0f);
+
+        auto camera = stage_->new_camera();
+
+        batcher::RenderQueue queue;
+        queue.set_dynamic_batching_threshold(batcher::DYNAMIC_BATCH_DEFAULT_VERTEX_THRESHOLD);
+        queue.reset(stage_, &renderer, camera);
+
+        /* Rotated and unevenly scaled, so normals have to go through the
+         * inverse transpose to stay perpendicular to their faces */
+        std::vector<ActorPtr> actors;
+        for(int i = 0; i < 10; ++i) {
+            auto actor = stage_->new_actor_with_mesh(mesh);
+            actor->move_to(i * 2, 0, -10);
+            actor->rotate_y_by(Degrees(float(i) * 10.0f));
+            actor->scale_by(Vec3(1.0f, 1.0f + float(i) * 0.5f, 1.0f));
+            actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+            actors.push_back(actor);
+        }
+
+        auto visitor = renderer.get_render_queue_visitor(camera);
+        queue.traverse(visitor.get(), 0);
+
+        assert_equal(renderer.stats().draws, 1u);
+        assert_equal(renderer.stats().elements, uint64_t(36 * 10));
+        assert_equal(queue.draws_saved_count(), 9u);
+
+        /* The merged vertices are in world space, with an identity transform */
+        RecordingVisitor recorder;
+        queue.traverse(&recorder, 0);
+        assert_equal(recorder.visits.size(), 1u);
+        assert_true(recorder.visits[0].translation == Vec3());
+
+        auto merged = recorder.visits[0].vertex_data;
+        auto source = mesh->vertex_data.get();
+        assert_equal(merged->count(), source->count() * 10);
+
+        /* Each actor's vertices were copied as one block, but the blocks are
+         * in draw order so find each actor's by its first vertex */
+        for(auto& actor: actors) {
+            auto transform = actor->absolute_transformation();
+            auto inverse = transform.inversed();
+            Mat4 normal_matrix;
+            for(int c = 0; c < 4; ++c) {
+                for(int r = 0; r < 4; ++r) {
+                    normal_matrix[(c * 4) + r] = inverse[(r * 4) + c];
+                }
+            }
+
+            auto expected_position = [&](uint32_t v) -> Vec3 {
+                auto p = *source->position_at<Vec3>(v);
+                auto t = transform * Vec4(p, 1.0f);
+                return Vec3(t.x, t.y, t.z);
+            };
+
+            auto first = expected_position(0);
+            uint32_t base = ~0u;
+            for(uint32_t b = 0; b < merged->count(); b += source->count()) {
+                if((*merged->position_at<Vec3>(b) - first).length() < 0.0001f) {
+                    base = b;
+                    break;
+                }
+            }
+
+            assert_not_equal(base, ~0u);
+
+            for(uint32_t v = 0; v < source->count(); ++v) {
+                auto position = *merged->position_at<Vec3>(base + v);
+                auto expected = expected_position(v);
+                assert_close(position.x, expected.x, 0.0001f);
+                assert_close(position.y, expected.y, 0.0001f);
+                assert_close(position.z, expected.z, 0.0001f);
+
+                auto n = *source->normal_at<Vec3>(v);
+                auto t = normal_matrix * Vec4(n, 0.0f);
+                auto expected_normal = Vec3(t.x, t.y, t.z).normalized();
+
+                auto normal = *merged->normal_at<Vec3>(base + v);
+                assert_close(normal.x, expected_normal.x, 0.0001f);
+                assert_close(normal.y, expected_normal.y, 0.0001f);
+                assert_close(normal.z, expected_normal.z, 0.0001f);
+            }
+        }
+
+        /* Nothing changed, so the merged renderable is kept */
+        renderer.reset_stats();
+        queue.traverse(visitor.get(), 1);
+        assert_equal(renderer.stats().draws, 1u);
+
+        renderer.reset_stats();
+        queue.set_dynamic_batching_threshold(0);
+        queue.traverse(visitor.get(), 2);
+        assert_equal(renderer.stats().draws, 10u);
+        assert_equal(queue.draws_saved_count(), 0u);
+    }
+
+    void test_2d_positions_are_not_batched() {
+        batcher::DynamicBatcher batcher;
+        batcher.set_vertex_threshold(batcher::DYNAMIC_BATCH_DEFAULT_VERTEX_THRESHOLD);
+
+        VertexData flat(VertexSpecification{VERTEX_ATTRIBUTE_2F});
+        VertexData solid(VertexSpecification{VERTEX_ATTRIBUTE_3F});
+        for(auto i = 0; i < 3; ++i) {
+            flat.position(i, 0);
+            flat.move_next();
+            solid.position(i, 0, 0);
+            solid.move_next();
+        }
+
+        Renderable renderable;
+        renderable.vertex_data = &solid;
+        assert_true(batcher.is_candidate(&renderable));
+
+        /* There's no z to carry the translation of the transform */
+        renderable.vertex_data = &flat;
+        assert_false(batcher.is_candidate(&renderable));
+    }
+
+    void test_instance_runs() {
+        NullRenderer renderer(window);
+
+        auto material = stage_->assets->new_material();
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", material, 1.0f);
+
+        auto camera = stage_->new_camera();
+
+        batcher::RenderQueue queue;
+        queue.reset(stage_, &renderer, camera);
+
+        for(int i = 0; i < 10; ++i) {
+            auto actor = stage_->new_actor_with_mesh(mesh);
+            actor->move_to(i * 2, 0, -10);
+            actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+        }
+
+        auto visitor = renderer.get_render_queue_visitor(camera);
+        queue.traverse(visitor.get(), 0);
+
+        /* The null renderer doesn't instance, so each one is still visited */
+        assert_equal(queue.instance_run_count(), 1u);
+        assert_equal(renderer.stats().draws, 10u);
+
+        /* Merged renderables are never instanced */
+        renderer.reset_stats();
+        queue.set_dynamic_batching_threshold(batcher::DYNAMIC_BATCH_DEFAULT_VERTEX_THRESHOLD);
+        queue.traverse(visitor.get(), 1);
+        assert_equal(queue.instance_run_count(), 0u);
+        assert_equal(renderer.stats().draws, 1u);
+    }
+
+    void test_instance_runs_span_depths() {
+        NullRenderer renderer(window);
+
+        auto material = stage_->assets->new_material();
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", material, 1.0f);
+
+        auto camera = stage_->new_camera();
+
+        batcher::RenderQueue queue;
+        queue.reset(stage_, &renderer, camera);
+
+        for(int i = 0; i < 10; ++i) {
+            auto actor = stage_->new_actor_with_mesh(mesh);
+            actor->move_to(0, 0, -10.0f - (i * 3.0f));
+            actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+        }
+
+        auto visitor = renderer.get_render_queue_visitor(camera);
+        queue.traverse(visitor.get(), 0);
+
+        assert_equal(queue.instance_run_count(), 1u);
+        assert_equal(renderer.stats().draws, 10u);
+    }
+
+    void test_parallel_gather_matches_serial() {
+        auto camera = stage_->new_camera();
+        camera->set_perspective_projection(Degrees(45.0), 1.0);
+
+        auto pipeline = window->compositor->render(stage_, camera);
+        pipeline->activate();
+
+        stage_->new_light_as_point(Vec3(0, 5, -20));
+
+        std::vector<MeshPtr> meshes;
+        for(int i = 0; i < 3; ++i) {
+            auto material = stage_->assets->new_material();
+            material->set_diffuse(Colour(float(i) / 3.0f, 0, 0, 1));
+
+            auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+            mesh->new_submesh_as_cube("cube", material, 1.0f);
+            meshes.push_back(mesh);
+        }
+
+        std::vector<ActorPtr> actors;
+        for(int i = 0; i < 200; ++i) {
+            auto actor = stage_->new_actor_with_mesh(meshes[i % meshes.size()]);
+            actor->move_to(float(i % 20) - 10.0f, float(i / 20) - 5.0f, -40.0f - float(i % 7));
+            actors.push_back(actor);
+        }
+
+        /* Make sure the gather is split up however many cores this has,
+         * and that batching doesn't replace what was gathered */
+        auto jobs = window->jobs_;
+        window->jobs_ = std::make_shared<jobs::JobScheduler>(3);
+
+        auto threshold = window->compositor->dynamic_batching_threshold();
+        window->compositor->set_dynamic_batching_threshold(0);
+
+        auto render = [&](bool parallel, bool reuse) -> std::vector<RecordingVisitor::Visit> {
+            auto& queue = window->compositor->render_queues_[pipeline];
+            if(queue && !reuse) {
+                queue->clear();
+            }
+
+            window->compositor->set_parallel_gather_enabled(parallel);
+            window->compositor->run();
+
+            RecordingVisitor visitor;
+            window->compositor->render_queues_.at(pipeline)->traverse(&visitor, 0);
+            return visitor.visits;
+        };
+
+        auto serial = render(false, false);
+        assert_true(serial.size() >= actors.size());
+
+        /* Each node's candidate lights came from frame scratch memory */
+        assert_true(window->jobs_->frame_allocator().used() > 0);
+        assert_true(render(true, false) == serial);
+
+        /* Some nodes are reused and the rest gathered on the workers */
+        for(std::size_t i = 0; i < actors.size(); i += 3) {
+            actors[i]->move_by(0, 0, -0.5f);
+        }
+
+        auto parallel = render(true, true);
+        assert_true(window->compositor->render_queues_.at(pipeline)->reused_node_count() > 0);
+        assert_true(render(false, false) == parallel);
+
+        window->compositor->set_parallel_gather_enabled(false);
+        window->compositor->set_dynamic_batching_threshold(threshold);
+        window->jobs_ = jobs;
+
+        pipeline->destroy();
+    }
+
+    void test_instanced_program_draws_once() {
+        auto renderer = dynamic_cast<GenericRenderer*>(window->renderer.get());
+        skip_if(!renderer || !renderer->supports_instancing(), "Instancing needs the GL2 renderer");
+
+        auto material = stage_->assets->new_material_from_file(Material::BuiltIns::LIT_TEXTURED);
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", material, 1.0f);
+
+        auto camera = stage_->new_camera();
+        camera->set_perspective_projection(Degrees(45.0), 1.0);
+
+        auto pipeline = window->compositor->render(stage_, camera);
+        pipeline->activate();
+
+        for(int i = 0; i < 10; ++i) {
+            auto actor = stage_->new_actor_with_mesh(mesh);
+            actor->move_to((i * 2.0f) - 9.0f, 0, -30.0f);
+        }
+
+        window->run_frame();
+
+        /* One instanced call per pass that ran, each covering every actor */
+        assert_true(window->stats->instanced_draws() > 0);
+        assert_equal(window->stats->instances_rendered(), window->stats->instanced_draws() * 10);
+
+        pipeline->destroy();
+    }
+
+    void test_morphing_renderables_are_kept_apart() {
+        NullRenderer renderer(window);
+
+        auto material = stage_->assets->new_material();
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", material, 1.0f);
+
+        auto camera = stage_->new_camera();
+
+        batcher::RenderQueue queue;
+        queue.set_dynamic_batching_threshold(batcher::DYNAMIC_BATCH_DEFAULT_VERTEX_THRESHOLD);
+        queue.reset(stage_, &renderer, camera);
+
+        auto submesh = mesh->first_submesh();
+        for(int i = 0; i < 10; ++i) {
+            Renderable renderable;
+            renderable.vertex_data = mesh->vertex_data.get();
+            renderable.index_data = submesh->index_data.get();
+            renderable.index_element_count = submesh->index_data->count();
+            renderable.material = material.get();
+            renderable.morph_target = mesh->vertex_data.get();
+            renderable.morph_weight = float(i) / 10.0f;
+            queue.insert_renderable(std::move(renderable));
+        }
+
+        auto visitor = renderer.get_render_queue_visitor(camera);
+        queue.traverse(visitor.get(), 0);
+
+        /* Each is blended differently, so they can't share a draw */
+        assert_equal(renderer.stats().draws, 10u);
+        assert_equal(queue.draws_saved_count(), 0u);
+        assert_equal(queue.instance_run_count(), 0u);
+    }
+
+    void test_actor_selects_gpu_morph() {
+        auto mesh = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        mesh->new_submesh_as_cube("cube", stage_->assets->new_material(), 1.0f);
+
+        auto unpacker = std::make_shared<KeyframeUnpacker>(mesh->vertex_data.get());
+        mesh->enable_animation(MESH_ANIMATION_TYPE_VERTEX_MORPH, 2, unpacker);
+        mesh->add_animation("idle", 0, 1, 1.0f);
+
+        auto actor = stage_->new_actor_with_mesh(mesh);
+        auto camera = stage_->new_camera();
+
+        auto renderer = std::make_shared<MorphingRenderer>(window);
+        auto previous = window->_swap_renderer(renderer);
+
+        batcher::RenderQueue queue;
+        queue.reset(stage_, renderer.get(), camera);
+
+        actor->evaluate_pose(1);
+        actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+
+        assert_equal(unpacker->unpacked, 0u);
+        assert_equal(queue.renderable_count(), 1u);
+        assert_equal(queue.renderable(0)->vertex_data, unpacker->keyframe_vertex_data(0));
+        assert_equal(queue.renderable(0)->morph_target, unpacker->keyframe_vertex_data(1));
+        assert_close(queue.renderable(0)->morph_weight, 0.0f, 0.0001f);
+
+        /* Without renderer support the actor unpacks on the CPU instead */
+        renderer->morphing = false;
+        queue.clear();
+
+        actor->evaluate_pose(2);
+        actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+
+        window->_swap_renderer(previous);
+
+        assert_equal(unpacker->unpacked, 1u);
+        assert_equal(queue.renderable_count(), 1u);
+        assert_false(queue.renderable(0)->morph_target);
+        assert_not_equal(queue.renderable(0)->vertex_data, unpacker->keyframe_vertex_data(0));
+    }
+
+    void test_md2_actor_morphs_on_gpu() {
+        skip_if(!dynamic_cast<GenericRenderer*>(window->renderer.get()), "GPU morphing needs the GL2 renderer");
+
+        auto mesh = stage_->assets->new_mesh_from_file("ogro.md2");
+        auto actor = stage_->new_actor_with_mesh(mesh);
+        actor->move_to(0, 0, -100.0f);
+
+        auto camera = stage_->new_camera();
+        camera->set_perspective_projection(Degrees(45.0), 1.0);
+
+        auto pipeline = window->compositor->render(stage_, camera);
+        pipeline->activate();
+
+        /* Shaders are built the first time they're drawn with, so the
+         * first frame may still unpack on the CPU */
+        window->run_frame();
+        window->run_frame();
+
+        assert_true(window->renderer->supports_gpu_morphing(mesh->first_submesh()->material().get()));
+        assert_true(actor->morph_from_);
+        assert_true(actor->morph_to_);
+
+        pipeline->destroy();
+    }
+
 private:
+    /* Records everything each draw would depend on, in traversal order */
+    class RecordingVisitor : public batcher::RenderQueueVisitor {
+    public:
+        struct Visit {
+            const VertexData* vertex_data;
+            const IndexData* index_data;
+            const MaterialPass* pass;
+            Vec3 translation;
+            const Light* light;
+            uint8_t light_count;
+
+            bool operator==(const Visit& rhs) const {
+                return vertex_data == rhs.vertex_data &&
+                    index_data == rhs.index_data &&
+                    pass == rhs.pass &&
+                    translation == rhs.translation &&
+                    light == rhs.light &&
+                    light_count == rhs.light_count;
+            }
+        };
+
+        std::vector<Visit> visits;
+
+        void start_traversal(const batcher::RenderQueue&, uint64_t, Stage*) override {}
+        void change_render_group(const batcher::RenderGroup*, const batcher::RenderGroup*) override {}
+        void change_material_pass(const MaterialPass*, const MaterialPass*) override {}
+        void apply_lights(const LightPtr*, const uint8_t) override {}
+        void end_traversal(const batcher::RenderQueue&, Stage*) override {}
+
+        void visit(const Renderable* renderable, const MaterialPass* pass, batcher::Iteration) override {
+            auto& m = renderable->final_transformation;
+
+            Visit v;
+            v.vertex_data = renderable->vertex_data;
+            v.index_data = renderable->index_data;
+            v.pass = pass;
+            v.translation = Vec3(m[12], m[13], m[14]);
+            v.light = (renderable->light_count) ? renderable->lights_affecting_this_frame[0] : nullptr;
+            v.light_count = renderable->light_count;
+            visits.push_back(v);
+        }
+    };
+
+    class MorphingRenderer : public NullRenderer {
+    public:
+        MorphingRenderer(Window* window):
+            NullRenderer(window) {}
+
+        bool supports_gpu_morphing(Material*) override {
+            return morphing;
+        }
+
+        bool morphing = true;
+    };
+
+    class KeyframeUnpacker : public FrameUnpacker {
+    public:
+        KeyframeUnpacker(VertexData* source) {
+            for(auto& frame: frames_) {
+                frame = std::make_shared<VertexData>(source->vertex_specification());
+                source->clone_into(*frame);
+            }
+        }
+
+        void prepare_unpack(uint32_t, uint32_t, float, Rig* const, Debug* const) override {}
+
+        void unpack_frame(const uint32_t current, const uint32_t, const float, Rig* const, VertexData* const out, Debug* const) override {
+            frames_[current]->clone_into(*out);
+            ++unpacked;
+        }
+
+        const VertexData* keyframe_vertex_data(uint32_t frame) override {
+            return frames_[frame].get();
+        }
+
+        uint32_t unpacked = 0;
+
+    private:
+        std::shared_ptr<VertexData> frames_[2];
+    };
+
     StagePtr stage_;
 
 };
@@ -2,6 +2,8 @@
 
 #include "simulant/test.h"
 #include "simulant/simulant.h"
+#include "simulant/renderers/null/null_renderer.h"
+#include "simulant/renderers/gl2x/generic_renderer.h"
 
 namespace {
 
@@ -49,7 +51,240 @@ public:
         assert_equal(a1->rig->joint_count(), 5u);
     }
 
+    void test_skinning_matches_reference() {
+        /* Enough vertices to be split across the job scheduler */
+        const uint32_t vertex_count = SKINNING_PARALLEL_MIN_VERTICES + 3;
+
+        auto m = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        for(uint32_t i = 0; i < vertex_count; ++i) {
+            float f = float(i) / float(vertex_count);
+            m->vertex_data->position(Vec3(f * 2.0f - 1.0f, std::sin(f * 20.0f), std::cos(f * 7.0f)));
+            m->vertex_data->normal(Vec3(std::cos(f * 5.0f), 1.0f, f).normalized());
+            m->vertex_data->move_next();
+        }
+        m->vertex_data->done();
+
+        m->add_skeleton(2);
+        m->skeleton->joint(0)->move_to(Vec3(0, -1, 0));
+        m->skeleton->joint(1)->move_to(Vec3(0, 1, 0));
+
+        SkeletalFrameUnpacker unpacker(m.get(), 1, vertex_count);
+        for(uint32_t i = 0; i < vertex_count; ++i) {
+            /* Leave some vertices on a single joint */
+            if(i % 3) {
+                unpacker.link_vertex_to_joint(i, 0, 0.75f);
+                unpacker.link_vertex_to_joint(i, 1, 0.25f);
+            } else {
+                unpacker.link_vertex_to_joint(i, 1, 1.0f);
+            }
+        }
+
+        Rig rig(m->skeleton.get());
+        rig.joint(0)->rotate_to(Quaternion(Vec3(0, 0, 1), Degrees(30)));
+        rig.joint(1)->rotate_to(Quaternion(Vec3(1, 0, 0), Degrees(45)));
+        rig.joint(1)->move_to(Vec3(0.5f, 0.0f, 0.0f));
+
+        VertexData out(m->vertex_data->vertex_specification());
+        unpacker.unpack_frame(0, 0, 0.0f, &rig, &out);
+
+        assert_equal(out.count(), vertex_count);
+
+        /* Each joint's skinning matrix, built as its posed world transform
+         * times the inverse of its bind pose world transform */
+        auto world_matrix = [](const Quaternion& rotation, const Vec3& translation) -> Mat4 {
+            return Mat4::as_translation(translation) * Mat4(rotation);
+        };
+
+        std::vector<Mat4> skinning;
+        for(auto j = 0u; j < m->skeleton->joint_count(); ++j) {
+            auto joint = m->skeleton->joint(j);
+            auto bind = world_matrix(joint->absolute_rotation(), joint->absolute_translation());
+            auto pose = world_matrix(rig.joint(j)->absolute_rotation_, rig.joint(j)->absolute_translation_);
+            skinning.push_back(pose * bind.inversed());
+        }
+
+        for(uint32_t i = 0; i < vertex_count; ++i) {
+            auto p = *m->vertex_data->position_at<Vec3>(i);
+            auto n = *m->vertex_data->normal_at<Vec3>(i);
+            auto sv = &unpacker.vertices()[i];
+
+            Vec4 blended_p, blended_n;
+            for(auto k = 0; k < MAX_JOINTS_PER_VERTEX; ++k) {
+                auto j = sv->joints[k];
+                if(j < 0) {
+                    continue;
+                }
+
+                blended_p = blended_p + (skinning[j] * Vec4(p, 1.0f)) * sv->weights[k];
+                blended_n = blended_n + (skinning[j] * Vec4(n, 0.0f)) * sv->weights[k];
+            }
+
+            Vec3 expected_p(blended_p.x, blended_p.y, blended_p.z);
+            Vec3 expected_n(blended_n.x, blended_n.y, blended_n.z);
+            expected_n.normalize();
+
+            auto actual_p = *out.position_at<Vec3>(i);
+            auto actual_n = *out.normal_at<Vec3>(i);
+
+            assert_close(actual_p.x, expected_p.x, 0.0001f);
+            assert_close(actual_p.y, expected_p.y, 0.0001f);
+            assert_close(actual_p.z, expected_p.z, 0.0001f);
+            assert_close(actual_n.x, expected_n.x, 0.0001f);
+            assert_close(actual_n.y, expected_n.y, 0.0001f);
+            assert_close(actual_n.z, expected_n.z, 0.0001f);
+        }
+    }
+
+    void test_gpu_skinning_data_matches_cpu() {
+        auto m = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        m->new_submesh_as_box("box", stage_->assets->new_material(), 1.0f, 2.0f, 3.0f);
+
+        const uint32_t vertex_count = m->vertex_data->count();
+
+        m->add_skeleton(2);
+        m->skeleton->joint(1)->move_to(Vec3(0, 1, 0));
+
+        SkeletalFrameUnpacker unpacker(m.get(), 1, vertex_count);
+        for(uint32_t i = 0; i < vertex_count; ++i) {
+            unpacker.link_vertex_to_joint(i, i % 2, 0.5f);
+            unpacker.link_vertex_to_joint(i, 1, 0.5f);
+        }
+
+        auto skin = unpacker.skin_vertex_data();
+        assert_equal(skin->count(), vertex_count);
+        assert_equal(skin->texcoord0_at<Vec4>(2)->y, 1.0f);
+        assert_equal(skin->texcoord1_at<Vec4>(2)->x, 0.5f);
+        assert_equal(skin->texcoord1_at<Vec4>(2)->z, 0.0f);
+
+        Rig rig(m->skeleton.get());
+        rig.joint(0)->rotate_to(Quaternion(Vec3(0, 1, 0), Degrees(90)));
+        rig.joint(1)->move_to(Vec3(0, 0, 2));
+
+        std::vector<Mat4> palette;
+        unpacker.build_joint_palette(&rig, palette);
+        assert_equal(palette.size(), 2u);
+
+        VertexData out(m->vertex_data->vertex_specification());
+        unpacker.unpack_frame(0, 0, 0.0f, &rig, &out);
+
+        /* What the vertex shader would do with the same data */
+        for(uint32_t i = 0; i < vertex_count; ++i) {
+            auto p = Vec4(*m->vertex_data->position_at<Vec3>(i), 1.0f);
+            auto joints = *skin->texcoord0_at<Vec4>(i);
+            auto weights = *skin->texcoord1_at<Vec4>(i);
+
+            Vec4 expected = (palette[int(joints.x)] * p) * weights.x + (palette[int(joints.y)] * p) * weights.y;
+            auto actual = *out.position_at<Vec3>(i);
+
+            assert_close(actual.x, expected.x, 0.0001f);
+            assert_close(actual.y, expected.y, 0.0001f);
+            assert_close(actual.z, expected.z, 0.0001f);
+        }
+    }
+
+    void test_actor_selects_gpu_skinning() {
+        auto m = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        m->new_submesh_as_box("box", stage_->assets->new_material(), 1.0f, 2.0f, 3.0f);
+
+        const uint32_t vertex_count = m->vertex_data->count();
+
+        m->add_skeleton(2);
+        m->skeleton->joint(1)->move_to(Vec3(0, 1, 0));
+
+        auto unpacker = std::make_shared<SkeletalFrameUnpacker>(m.get(), 1, vertex_count);
+        for(uint32_t i = 0; i < vertex_count; ++i) {
+            unpacker->link_vertex_to_joint(i, i % 2, 1.0f);
+        }
+
+        m->enable_animation(MESH_ANIMATION_TYPE_SKELETAL, 1, unpacker);
+        m->add_animation("idle", 0, 0, 1.0f);
+
+        auto actor = stage_->new_actor_with_mesh(m);
+        auto camera = stage_->new_camera();
+
+        auto renderer = std::make_shared<SkinningRenderer>(window);
+        auto previous = window->_swap_renderer(renderer);
+
+        batcher::RenderQueue queue;
+        queue.reset(stage_, renderer.get(), camera);
+
+        actor->evaluate_pose(1);
+        actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+
+        assert_equal(queue.renderable_count(), 1u);
+        assert_equal(queue.renderable(0)->vertex_data, m->vertex_data.get());
+        assert_equal(queue.renderable(0)->skin_data, unpacker->skin_vertex_data());
+        assert_true(queue.renderable(0)->joint_palette);
+        assert_equal(queue.renderable(0)->joint_palette->size(), 2u);
+
+        /* A rig larger than the renderer's budget is skinned on the CPU */
+        renderer->max_joints = 1;
+        queue.clear();
+
+        actor->evaluate_pose(2);
+        actor->_get_renderables(&queue, camera, DETAIL_LEVEL_NEAREST);
+
+        window->_swap_renderer(previous);
+
+        assert_equal(queue.renderable_count(), 1u);
+        assert_not_equal(queue.renderable(0)->vertex_data, m->vertex_data.get());
+        assert_false(queue.renderable(0)->skin_data);
+        assert_false(queue.renderable(0)->joint_palette);
+    }
+
+    void test_builtin_shader_skins_on_gpu() {
+        skip_if(!dynamic_cast<GenericRenderer*>(window->renderer.get()), "GPU skinning needs the GL2 renderer");
+
+        auto m = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+        auto material = stage_->assets->new_material_from_file(Material::BuiltIns::LIT_TEXTURED);
+        m->new_submesh_as_box("box", material, 1.0f, 2.0f, 3.0f);
+
+        const uint32_t vertex_count = m->vertex_data->count();
+
+        m->add_skeleton(2);
+        m->skeleton->joint(1)->move_to(Vec3(0, 1, 0));
+
+        auto unpacker = std::make_shared<SkeletalFrameUnpacker>(m.get(), 1, vertex_count);
+        for(uint32_t i = 0; i < vertex_count; ++i) {
+            unpacker->link_vertex_to_joint(i, i % 2, 1.0f);
+        }
+
+        m->enable_animation(MESH_ANIMATION_TYPE_SKELETAL, 1, unpacker);
+        m->add_animation("idle", 0, 0, 1.0f);
+
+        auto actor = stage_->new_actor_with_mesh(m);
+        actor->move_to(0, 0, -10.0f);
+
+        auto camera = stage_->new_camera();
+        camera->set_perspective_projection(Degrees(45.0), 1.0);
+
+        auto pipeline = window->compositor->render(stage_, camera);
+        pipeline->activate();
+
+        /* Shaders are built the first time they're drawn with */
+        window->run_frame();
+        window->run_frame();
+
+        assert_true(window->renderer->supports_gpu_skinning(material.get(), 2));
+        assert_false(window->renderer->supports_gpu_skinning(material.get(), MAX_JOINTS_PER_MESH));
+        assert_true(actor->skin_data_);
+
+        pipeline->destroy();
+    }
+
 private:
+    class SkinningRenderer : public NullRenderer {
+    public:
+        SkinningRenderer(Window* window):
+            NullRenderer(window) {}
+
+        bool supports_gpu_skinning(Material*, uint32_t joint_count) override {
+            return joint_count <= max_joints;
+        }
+
+        uint32_t max_joints = 4;
+    };
+
     StagePtr stage_;
 };
 
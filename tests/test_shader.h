@@ -44,6 +44,31 @@ public:
 
         assert_equal(1, loc);
 #endif
+#endif
+    }
+
+    void test_redundant_uniforms_are_skipped() {
+#ifndef _arch_dreamcast
+#ifndef PSP
+        smlt::GPUProgram::ptr program = smlt::GPUProgram::create(
+            smlt::GPUProgramID(1),
+            window->renderer,
+            "uniform vec3 c; void main(){ gl_Position = vec4(c, 1.0); }",
+            "void main(){ gl_FragColor = vec4(1.0); }"
+        );
+
+        program->build();
+        program->activate();
+
+        program->set_uniform_vec3("c", smlt::Vec3(1, 2, 3));
+        assert_equal(program->uniform_calls_avoided(), 0u);
+
+        program->set_uniform_vec3("c", smlt::Vec3(1, 2, 3));
+        assert_equal(program->uniform_calls_avoided(), 1u);
+
+        program->set_uniform_vec3("c", smlt::Vec3(3, 2, 1));
+        assert_equal(program->uniform_calls_avoided(), 1u);
+#endif
 #endif
     }
 
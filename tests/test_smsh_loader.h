@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "simulant/simulant.h"
+#include "simulant/test.h"
+#include "simulant/loaders/smsh_loader.h"
+
+namespace {
+
+using namespace smlt;
+
+class SMSHLoaderTests : public test::SimulantTestCase {
+public:
+    void test_round_trip() {
+        auto stage = window->new_stage();
+
+        auto material = stage->assets->new_material_from_file(Material::BuiltIns::DIFFUSE_ONLY);
+        material->set_diffuse(Colour::RED);
+
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_box("box", material, 1.0, 2.0, 3.0, Vec3(1, 0, 0));
+        source->new_submesh_as_rectangle("rect", material, 1.0, 1.0);
+
+        auto filename = kfs::path::join(kfs::temp_dir(), "round_trip.smsh");
+        assert_true(loaders::SMSHWriter(*source).write(filename));
+
+        auto mesh = stage->assets->new_mesh_from_file(filename);
+
+        assert_equal(mesh->vertex_data->count(), source->vertex_data->count());
+        assert_true(mesh->vertex_data->vertex_specification() == source->vertex_data->vertex_specification());
+        assert_equal(
+            std::memcmp(mesh->vertex_data->data(), source->vertex_data->data(), source->vertex_data->data_size()),
+            0
+        );
+
+        assert_equal(mesh->submesh_count(), 2u);
+
+        auto box = mesh->find_submesh("box");
+        assert_true(box);
+        assert_true(*box->index_data == *source->find_submesh("box")->index_data);
+        assert_equal(box->index_data->max_index(), source->find_submesh("box")->index_data->max_index());
+
+        /* Both submeshes share the one material */
+        assert_equal(box->material(), mesh->find_submesh("rect")->material());
+        assert_true(box->material()->pass(0)->diffuse() == Colour::RED);
+
+        assert_close(mesh->aabb().min().x, source->aabb().min().x, 0.0001f);
+        assert_close(mesh->aabb().max().z, source->aabb().max().z, 0.0001f);
+
+        std::remove(filename.c_str());
+    }
+
+    void test_truncated_file_throws() {
+        auto stage = window->new_stage();
+
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_cube("cube", stage->assets->new_material(), 1.0);
+
+        auto filename = kfs::path::join(kfs::temp_dir(), "truncated.smsh");
+        assert_true(loaders::SMSHWriter(*source).write(filename));
+
+        std::string data;
+        {
+            std::ifstream in(filename, std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        {
+            std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+            out.write(data.c_str(), data.size() / 2);
+        }
+
+        assert_raises(std::logic_error, [&]() {
+            stage->assets->new_mesh_from_file(filename);
+        });
+
+        std::remove(filename.c_str());
+    }
+
+    void test_vertex_morph_round_trip() {
+        auto stage = window->new_stage();
+
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_cube("cube", stage->assets->new_material(), 1.0);
+
+        auto unpacker = std::make_shared<SlidingUnpacker>(source->vertex_data.get());
+        source->enable_animation(MESH_ANIMATION_TYPE_VERTEX_MORPH, 3, unpacker);
+        source->add_animation("walk", 0, 1, 5.0f);
+        source->add_animation("run", 1, 2, 10.0f);
+
+        auto filename = kfs::path::join(kfs::temp_dir(), "morph.smsh");
+        assert_true(loaders::SMSHWriter(*source).write(filename));
+
+        auto mesh = stage->assets->new_mesh_from_file(filename);
+
+        assert_equal(mesh->animation_type(), MESH_ANIMATION_TYPE_VERTEX_MORPH);
+        assert_equal(mesh->animation_frames(), 3u);
+
+        /* The baked frames blend the same way the source frames did */
+        VertexData expected(source->vertex_data->vertex_specification());
+        VertexData actual(source->vertex_data->vertex_specification());
+
+        source->animated_frame_data_->unpack_frame(1, 2, 0.5f, nullptr, &expected);
+        mesh->animated_frame_data_->unpack_frame(1, 2, 0.5f, nullptr, &actual);
+
+        assert_equal(actual.count(), source->vertex_data->count());
+        for(uint32_t i = 0; i < actual.count(); ++i) {
+            auto e = *expected.position_at<Vec3>(i);
+            auto a = *actual.position_at<Vec3>(i);
+            assert_close(a.x, e.x, 0.0001f);
+            assert_close(a.y, e.y, 0.0001f);
+            assert_close(a.z, e.z, 0.0001f);
+        }
+
+        /* Named animations keep their frames, rate and order */
+        assert_equal(mesh->animation_count(), 2u);
+        assert_equal(mesh->first_animation_, "walk");
+
+        auto run = mesh->animation("run");
+        assert_true(run);
+        assert_equal(run->frames.first, 1u);
+        assert_equal(run->frames.second, 2u);
+        assert_close(run->duration, source->animation("run")->duration, 0.0001f);
+
+        std::remove(filename.c_str());
+    }
+
+    void test_diffuse_map_round_trip() {
+        auto stage = window->new_stage();
+
+        auto texture = stage->assets->new_texture_from_file("flare.tga");
+        auto material = stage->assets->new_material_from_file(Material::BuiltIns::TEXTURE_ONLY);
+        material->set_diffuse_map(texture);
+
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_rectangle("rect", material, 1.0, 1.0);
+
+        auto filename = kfs::path::join(kfs::temp_dir(), "diffuse_map.smsh");
+        assert_true(loaders::SMSHWriter(*source).write(filename));
+
+        auto mesh = stage->assets->new_mesh_from_file(filename);
+        auto loaded = mesh->first_submesh()->material()->pass(0)->diffuse_map();
+
+        assert_true(loaded);
+        assert_equal(loaded->source().str(), texture->source().str());
+        assert_equal(loaded->width(), texture->width());
+        assert_equal(loaded->height(), texture->height());
+
+        std::remove(filename.c_str());
+    }
+
+    void test_frame_vertex_count_mismatch_throws() {
+        auto stage = window->new_stage();
+
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_cube("cube", stage->assets->new_material(), 1.0);
+
+        /* The last frame is missing a vertex, blending into it would read
+         * past its end */
+        auto unpacker = std::make_shared<SlidingUnpacker>(source->vertex_data.get());
+        unpacker->short_frame = 1;
+        source->enable_animation(MESH_ANIMATION_TYPE_VERTEX_MORPH, 2, unpacker);
+
+        auto filename = kfs::path::join(kfs::temp_dir(), "short_frame.smsh");
+        assert_true(loaders::SMSHWriter(*source).write(filename));
+
+        assert_raises(std::logic_error, [&]() {
+            stage->assets->new_mesh_from_file(filename);
+        });
+
+        std::remove(filename.c_str());
+    }
+
+    void test_index_past_vertices_throws() {
+        auto stage = window->new_stage();
+
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_rectangle("rect", stage->assets->new_material(), 1.0, 1.0);
+
+        auto submesh = source->first_submesh();
+        submesh->index_data->index(source->vertex_data->count());
+        submesh->index_data->done();
+
+        auto filename = kfs::path::join(kfs::temp_dir(), "bad_index.smsh");
+        assert_true(loaders::SMSHWriter(*source).write(filename));
+
+        assert_raises(std::logic_error, [&]() {
+            stage->assets->new_mesh_from_file(filename);
+        });
+
+        std::remove(filename.c_str());
+    }
+
+    void test_unknown_vertex_attribute_throws() {
+        auto stage = window->new_stage();
+
+        auto source = stage->assets->new_mesh(VertexSpecification::DEFAULT);
+        source->new_submesh_as_rectangle("rect", stage->assets->new_material(), 1.0, 1.0);
+
+        auto filename = kfs::path::join(kfs::temp_dir(), "bad_attribute.smsh");
+        assert_true(loaders::SMSHWriter(*source).write(filename));
+
+        /* The position attribute follows the magic and version */
+        {
+            std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(8);
+            file.put(char(200));
+        }
+
+        assert_raises(std::logic_error, [&]() {
+            stage->assets->new_mesh_from_file(filename);
+        });
+
+        std::remove(filename.c_str());
+    }
+
+private:
+    /* Frame N is the source mesh moved N units along x */
+    class SlidingUnpacker : public FrameUnpacker {
+    public:
+        SlidingUnpacker(VertexData* source):
+            source_(source) {}
+
+        void prepare_unpack(uint32_t, uint32_t, float, Rig* const, Debug* const) override {}
+
+        void unpack_frame(const uint32_t current_frame, const uint32_t next_frame, const float t, Rig* const, VertexData* const out, Debug* const) override {
+            source_->clone_into(*out);
+
+            float offset = (float(current_frame) * (1.0f - t)) + (float(next_frame) * t);
+            for(uint32_t i = 0; i < out->count(); ++i) {
+                auto p = *out->position_at<Vec3>(i);
+                out->move_to(i);
+                out->position(p.x + offset, p.y, p.z);
+            }
+
+            if(current_frame == short_frame) {
+                out->resize(out->count() - 1);
+            }
+
+            out->done();
+        }
+
+        uint32_t short_frame = ~0u;
+
+    private:
+        VertexData* source_;
+    };
+};
+
+}
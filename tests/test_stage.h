@@ -4,11 +4,44 @@
 
 #include "simulant/simulant.h"
 #include "simulant/test.h"
+#include "simulant/behaviours/stage_node_behaviour.h"
 
 namespace {
 
 using namespace smlt;
 
+/* Moves its node along X on every update, and reads the parent's position */
+class XMover:
+    public behaviours::StageNodeBehaviour,
+    public RefCounted<XMover> {
+
+public:
+    XMover(bool thread_safe):
+        thread_safe_(thread_safe) {}
+
+    const char* name() const override { return "x_mover"; }
+
+    bool is_update_thread_safe() const override {
+        return thread_safe_;
+    }
+
+    float parent_x = -1.0f;
+
+private:
+    void update(float dt) override {
+        _S_UNUSED(dt);
+
+        stage_node->move_by(1, 0, 0);
+
+        auto parent = dynamic_cast<StageNode*>(stage_node->parent());
+        if(parent) {
+            parent_x = parent->absolute_position().x;
+        }
+    }
+
+    bool thread_safe_;
+};
+
 class StageTests : public smlt::test::SimulantTestCase {
 public:
 
@@ -249,6 +282,43 @@ public:
 
         assert_items_equal(found, expected);
     }
+
+    void test_parallel_update() {
+        auto stage = window->new_stage();
+        auto camera = stage->new_camera();
+        window->compositor->render(stage, camera)->activate();
+
+        window->set_parallel_update_enabled(true);
+
+        auto serial = stage->new_actor();
+        serial->set_update_thread_safe(true);
+        serial->new_behaviour<XMover>(false);
+
+        std::vector<ActorPtr> actors;
+        for(int i = 0; i < 200; ++i) {
+            auto actor = stage->new_actor_with_parent(serial);
+            actor->set_update_thread_safe(true);
+            actor->new_behaviour<XMover>(true);
+            actors.push_back(actor);
+        }
+
+        assert_false(serial->is_update_thread_safe());
+        assert_true(actors[0]->is_update_thread_safe());
+
+        window->update(0.1f);
+        window->update(0.1f);
+
+        for(auto actor: actors) {
+            /* Serial nodes are updated first, so the children see their
+             * parent's new position */
+            assert_equal(actor->behaviour<XMover>()->parent_x, 2.0f);
+            assert_equal(actor->position().x, 2.0f);
+            assert_equal(actor->absolute_position().x, 4.0f);
+        }
+
+        window->set_parallel_update_enabled(false);
+        window->destroy_stage(stage->id());
+    }
 };
 
-}
+}
\ No newline at end of file